@@ -0,0 +1,55 @@
+#include <benchmark/benchmark.h>
+
+#include <api_server/data/encoding.h>
+
+#include "procs.h"
+
+using namespace data;
+
+namespace
+{
+
+/// @brief Encodes the process list, reporting the encoded size as a counter so the encodings can be compared
+void BM_EncodeProcs(benchmark::State& state, const Encoding encoding)
+{
+    const auto procs = bench::make_procs(static_cast<std::size_t>(state.range(0)));
+    std::size_t size = 0;
+    for (auto _ : state)
+    {
+        const auto encoded = encode(procs, encoding);
+        size = encoded.size();
+        benchmark::DoNotOptimize(encoded.data());
+    }
+    state.counters["bytes"] = static_cast<double>(size);
+    state.counters["bytes_per_proc"] = static_cast<double>(size) / static_cast<double>(state.range(0));
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void BM_DecodeProcTable(benchmark::State& state)
+{
+    const auto encoded = encode_proc_table(bench::make_procs(static_cast<std::size_t>(state.range(0))));
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(decode_proc_table(encoded));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void BM_DecodeJson(benchmark::State& state)
+{
+    const auto encoded = encode(bench::make_procs(static_cast<std::size_t>(state.range(0))), Encoding::Json);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(nlohmann::json::parse(encoded));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+} // namespace
+
+BENCHMARK_CAPTURE(BM_EncodeProcs, json, Encoding::Json)->Arg(1000);
+BENCHMARK_CAPTURE(BM_EncodeProcs, msgpack, Encoding::MsgPack)->Arg(1000);
+BENCHMARK_CAPTURE(BM_EncodeProcs, cbor, Encoding::Cbor)->Arg(1000);
+BENCHMARK_CAPTURE(BM_EncodeProcs, proctable, Encoding::ProcTable)->Arg(1000);
+BENCHMARK(BM_DecodeJson)->Arg(1000);
+BENCHMARK(BM_DecodeProcTable)->Arg(1000);
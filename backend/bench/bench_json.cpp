@@ -0,0 +1,83 @@
+#include <benchmark/benchmark.h>
+
+#include <api_server/data/types.h>
+
+#include "procs.h"
+
+using namespace data;
+
+namespace
+{
+
+std::string dump_with_nlohmann(const std::vector<ProcSnapshot>& procs)
+{
+    auto json_array = nlohmann::json::array();
+    std::transform(procs.cbegin(), procs.cend(), std::back_inserter(json_array),
+                   [](const ProcSnapshot& proc) { return to_json(proc); });
+    return json_array.dump();
+}
+
+void BM_ProcsNlohmann(benchmark::State& state)
+{
+    const auto procs = bench::make_procs(static_cast<std::size_t>(state.range(0)));
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(dump_with_nlohmann(procs));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void BM_ProcsJsonWriter(benchmark::State& state)
+{
+    const auto procs = bench::make_procs(static_cast<std::size_t>(state.range(0)));
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(to_json_string(procs));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void BM_ProcsJsonWriterReusedBuffer(benchmark::State& state)
+{
+    const auto procs = bench::make_procs(static_cast<std::size_t>(state.range(0)));
+    std::string json;
+    for (auto _ : state)
+    {
+        json.clear();
+        JsonWriter writer{json};
+        writer.begin_array();
+        for (const auto& proc : procs)
+        {
+            write_json(writer, proc);
+        }
+        writer.end_array();
+        benchmark::DoNotOptimize(json.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void BM_MemNlohmann(benchmark::State& state)
+{
+    const MemSnapshot mem{16384000u, 4096000u, 75.0f};
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(to_json(mem).dump());
+    }
+}
+
+void BM_MemJsonWriter(benchmark::State& state)
+{
+    const MemSnapshot mem{16384000u, 4096000u, 75.0f};
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(to_json_string(mem));
+    }
+}
+
+} // namespace
+
+BENCHMARK(BM_ProcsNlohmann)->Arg(100)->Arg(1000)->Arg(10000);
+BENCHMARK(BM_ProcsJsonWriter)->Arg(100)->Arg(1000)->Arg(10000);
+BENCHMARK(BM_ProcsJsonWriterReusedBuffer)->Arg(100)->Arg(1000)->Arg(10000);
+BENCHMARK(BM_MemNlohmann);
+BENCHMARK(BM_MemJsonWriter);
@@ -0,0 +1,222 @@
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <api_server/data/datastore.h>
+#include <api_server/filesystem/monitor.h>
+#include <api_server/filesystem/parsers.h>
+#include <api_server/filesystem/source.h>
+#include <api_server/logger.h>
+#include <testing/fake_proc.h>
+
+#include "procs.h"
+
+using namespace filesystem;
+
+namespace
+{
+
+/// @brief Processes replaced between polls, as a fraction of all of them
+constexpr std::size_t CHURN_DIVISOR{100u};
+
+/// @brief Returns a fake proc tree of the given size, shared by the benchmarks and kept until exit since the larger
+/// ones take a while to write
+FakeProcTree& fake_proc_tree(const std::size_t procs)
+{
+    static std::map<std::size_t, std::unique_ptr<FakeProcTree>> trees;
+    auto& tree = trees[procs];
+    if (!tree)
+        tree = std::make_unique<FakeProcTree>(procs);
+    return *tree;
+}
+
+/// @brief A monitor of a fake proc tree
+struct FakeHost
+{
+    explicit FakeHost(const std::size_t procs) : tree{fake_proc_tree(procs)}
+    {
+        config.proc_root = tree.proc_root();
+        config.cgroup_root = tree.cgroup_root();
+    }
+
+    FakeProcTree& tree;
+    MonitorConfig config;
+    StdStreamLogger logger{LogLevel::Error};
+    data::DataStore datastore;
+};
+
+/// @brief Reads each process's copy of a file in turn, parsing it with `parse`
+template <typename Parse> void parse_proc_files(benchmark::State& state, const char* file, Parse parse)
+{
+    const auto& tree = fake_proc_tree(1000u);
+    const auto& pids = tree.pids();
+    std::size_t next{0u};
+    for (auto _ : state)
+    {
+        std::ifstream input{tree.proc_root() / std::to_string(pids[next]) / file};
+        benchmark::DoNotOptimize(parse(input));
+        next = (next + 1u) % pids.size();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+/// @brief Reads the datastore the way request handlers do, until stopped
+void read_datastore(const data::DataStore& datastore, const std::atomic<bool>& running)
+{
+    while (running.load(std::memory_order_relaxed))
+    {
+        benchmark::DoNotOptimize(datastore.get_snapshot());
+        benchmark::DoNotOptimize(datastore.get_proc_list());
+        benchmark::DoNotOptimize(datastore.get_proc_delta(datastore.generation() - 1u, {}));
+    }
+}
+
+} // namespace
+
+static void BM_Discovery(benchmark::State& state)
+{
+    FakeHost host{static_cast<std::size_t>(state.range(0))};
+    Monitor monitor{host.logger, host.datastore, host.config};
+    for (auto _ : state)
+        benchmark::DoNotOptimize(monitor.discover_current_procs());
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Discovery)->Arg(1000)->Arg(10000)->Arg(100000)->Unit(benchmark::kMillisecond);
+
+static void BM_ParseStatus(benchmark::State& state)
+{
+    parse_proc_files(state, "status", [](std::istream& input) { return parse_dictionary_file(input); });
+}
+BENCHMARK(BM_ParseStatus);
+
+static void BM_ParseStat(benchmark::State& state)
+{
+    parse_proc_files(state, "stat", [](std::istream& input) {
+        std::string line;
+        std::getline(input, line);
+        return parse_stat_line(line);
+    });
+}
+BENCHMARK(BM_ParseStat);
+
+static void BM_ParseCmdline(benchmark::State& state)
+{
+    parse_proc_files(state, "cmdline", [](std::istream& input) {
+        std::string command;
+        input >> command;
+        return command;
+    });
+}
+BENCHMARK(BM_ParseCmdline);
+
+/// @brief A full poll, with 1% of the processes replaced since the previous one
+static void BM_Poll(benchmark::State& state)
+{
+    const auto procs = static_cast<std::size_t>(state.range(0));
+    FakeHost host{procs};
+    Monitor monitor{host.logger, host.datastore, host.config};
+    monitor.check_filesystem_changes(); // So that CPU usage is calculated, as in every poll after the first
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        host.tree.churn(procs / CHURN_DIVISOR);
+        host.tree.advance();
+        state.ResumeTiming();
+        monitor.check_filesystem_changes();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Poll)->Arg(1000)->Arg(10000)->Arg(100000)->Unit(benchmark::kMillisecond);
+
+/// @brief Replaying a capture of polls with churn, i.e. a poll's parsing and storing without the filesystem reads
+static void BM_PollReplay(benchmark::State& state)
+{
+    constexpr int RECORDED_POLLS{5};
+    const auto procs = static_cast<std::size_t>(state.range(0));
+    FakeHost host{procs};
+    const auto capture_path = (host.tree.proc_root().parent_path() / "bench.capture").string();
+    {
+        auto source = std::make_unique<RecordingProcSource>(std::make_unique<LiveProcSource>(host.config.proc_root),
+                                                            capture_path);
+        Monitor recorder{host.logger, host.datastore, host.config, std::move(source)};
+        for (int i = 0; i < RECORDED_POLLS; ++i)
+        {
+            host.tree.churn(procs / CHURN_DIVISOR);
+            host.tree.advance();
+            recorder.check_filesystem_changes();
+        }
+    }
+
+    for (auto _ : state)
+    {
+        // Each iteration replays the whole capture into the same datastore, so every poll after the very first
+        // calculates usage against the previous one
+        Monitor monitor{host.logger, host.datastore, host.config,
+                        std::make_unique<ReplayProcSource>(capture_path, 0.0)};
+        while (monitor.check_filesystem_changes())
+        {
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * RECORDED_POLLS * state.range(0));
+    std::filesystem::remove(capture_path);
+}
+BENCHMARK(BM_PollReplay)->Arg(1000)->Arg(10000)->Unit(benchmark::kMillisecond);
+
+/// @brief Storing and publishing a poll's processes, while threads read the datastore concurrently
+static void BM_DataStorePublish(benchmark::State& state)
+{
+    const auto procs = bench::make_procs(static_cast<std::size_t>(state.range(0)));
+    data::DataStore datastore;
+    datastore.store_proc_snapshots(procs);
+    datastore.publish_generation();
+
+    std::atomic<bool> running{true};
+    std::vector<std::thread> readers;
+    for (int64_t i = 0; i < state.range(1); ++i)
+        readers.emplace_back(read_datastore, std::cref(datastore), std::cref(running));
+    for (auto _ : state)
+    {
+        datastore.store_proc_snapshots(procs);
+        datastore.publish_generation();
+    }
+    running.store(false);
+    for (auto& reader : readers)
+        reader.join();
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_DataStorePublish)
+    ->ArgsProduct({{1000, 10000, 100000}, {0, 4}})
+    ->ArgNames({"procs", "readers"})
+    ->Unit(benchmark::kMillisecond);
+
+/// @brief Reading a process from the datastore, while it is being published continuously
+static void BM_DataStoreRead(benchmark::State& state)
+{
+    const auto procs = bench::make_procs(static_cast<std::size_t>(state.range(0)));
+    data::DataStore datastore;
+    datastore.store_proc_snapshots(procs);
+    datastore.publish_generation();
+
+    std::atomic<bool> running{true};
+    std::thread publisher{[&]() {
+        while (running.load(std::memory_order_relaxed))
+        {
+            datastore.store_proc_snapshots(procs);
+            datastore.publish_generation();
+        }
+    }};
+    uint32_t pid{1u};
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(datastore.get_proc_snapshot(pid));
+        pid = pid % static_cast<uint32_t>(procs.size()) + 1u;
+    }
+    running.store(false);
+    publisher.join();
+}
+BENCHMARK(BM_DataStoreRead)->Arg(1000)->Arg(10000)->Arg(100000);
@@ -0,0 +1,104 @@
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include <api_server/logger.h>
+#include <api_server/server/router.h>
+
+using namespace server;
+
+namespace
+{
+
+/// @brief Heap allocations made by the process, counted by the replaced operator new
+std::atomic<std::size_t> allocation_count{0u};
+
+} // namespace
+
+void* operator new(const std::size_t size)
+{
+    allocation_count.fetch_add(1u, std::memory_order_relaxed);
+    if (auto ptr = std::malloc(size == 0u ? 1u : size))
+        return ptr;
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+namespace
+{
+
+/// @brief A router with the same routes as the ApiController, each answering with an empty response
+class ApiRoutes
+{
+public:
+    ApiRoutes()
+    {
+        for (const auto* resource : {"/api/uptime", "/api/cpus", "/api/procs", "/api/procs/{pid}",
+                                     "/api/procs/{pid}/threads", "/api/mem", "/api/proctree", "/api/cgroups",
+                                     "/api/stats", "/api/snapshot", "/api/stream"})
+        {
+            router.add_route(bb::http::verb::get, resource, [](const HttpRequest&) { return HttpResponse{}; });
+        }
+    }
+
+    StdStreamLogger logger{LogLevel::Error};
+    Router router{logger};
+};
+
+/// @brief Routes the same request repeatedly, reporting the heap allocations made per request
+void route(benchmark::State& state, const char* target)
+{
+    ApiRoutes routes;
+    const BoostHttpRequest request{bb::http::verb::get, target, 11};
+    const auto allocations_before = allocation_count.load();
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(routes.router.process_http_request(request));
+    }
+    state.counters["allocs_per_request"] = static_cast<double>(allocation_count.load() - allocations_before) /
+                                           static_cast<double>(state.iterations());
+}
+
+void BM_RouteStatic(benchmark::State& state)
+{
+    route(state, "/api/mem");
+}
+
+void BM_RoutePathParameter(benchmark::State& state)
+{
+    route(state, "/api/procs/1234/threads");
+}
+
+void BM_RouteQuery(benchmark::State& state)
+{
+    route(state, "/api/proctree?root=1&depth=3");
+}
+
+void BM_RouteEncodedQuery(benchmark::State& state)
+{
+    route(state, "/api/snapshot?fields=uptime%2Cmem&limit=10");
+}
+
+void BM_RouteNotFound(benchmark::State& state)
+{
+    route(state, "/api/disks");
+}
+
+} // namespace
+
+BENCHMARK(BM_RouteStatic);
+BENCHMARK(BM_RoutePathParameter);
+BENCHMARK(BM_RouteQuery);
+BENCHMARK(BM_RouteEncodedQuery);
+BENCHMARK(BM_RouteNotFound);
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <api_server/data/types.h>
+
+namespace bench
+{
+
+/// @brief Generates processes resembling a busy host: every other process has an smaps sample and all share a cgroup
+inline std::vector<data::ProcSnapshot> make_procs(const std::size_t count)
+{
+    std::vector<data::ProcSnapshot> procs(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        auto& proc = procs[i];
+        proc.snapshot_time = 1000.0;
+        proc.pid = static_cast<int32_t>(i + 1);
+        proc.ppid = 1;
+        proc.name = "worker-" + std::to_string(i);
+        proc.command = "/usr/lib/worker --config=/etc/worker/worker.conf --id=" + std::to_string(i);
+        proc.mem_usage_percent = 0.01f * static_cast<float>(i % 100);
+        proc.cpu_usage_percent = 100.0f / static_cast<float>(i + 3);
+        proc.cgroup = "/system.slice/worker.service";
+        if (i % 2 == 0)
+            proc.smaps = data::SmapsSample{999.0, 2048u, 1024u, 0u};
+    }
+    return procs;
+}
+
+} // namespace bench
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "logger.h"
+
+/// @brief Tuning of the AsyncLogger
+struct AsyncLoggerConfig
+{
+    std::size_t capacity{8192u};                    // Records held before new ones are dropped, a power of two
+    std::string file_path{};                        // Log to this file instead of stdout/stderr if set
+    std::size_t rotate_size{0u};                    // Rotate the file once it reaches this many bytes, 0 to never
+    std::size_t rotated_files{3u};                  // Rotated files kept, as <file_path>.1 (newest) to .<N>
+    std::chrono::milliseconds poll_interval{10};    // How long the writer sleeps when there are no records
+};
+
+/// @brief Logger that hands messages to a background writer thread, so that logging threads never wait on I/O.
+/// Messages are copied into the slots of a fixed size ring, which logging threads claim without locking. The writer
+/// drains the ring in batches, with one write per batch. If the writer falls behind and the ring fills up, messages
+/// are dropped and counted rather than blocking the logging threads.
+class AsyncLogger : public Logger
+{
+public:
+    explicit AsyncLogger(const LogLevel level, const AsyncLoggerConfig& config = {});
+
+    /// @brief Writes the remaining messages and stops the writer
+    ~AsyncLogger() override;
+
+    AsyncLogger(const AsyncLogger&) = delete;
+    AsyncLogger& operator=(const AsyncLogger&) = delete;
+
+    /// @brief Blocks until the messages logged before the call have been written
+    /// [Concurrent execution]
+    void flush() const;
+
+    /// @brief Returns the number of messages dropped because the ring was full
+    /// [Concurrent execution]
+    uint64_t dropped() const
+    {
+        return m_dropped.load(std::memory_order_relaxed);
+    }
+
+protected:
+    /// @brief Copies the message into the next free slot of the ring
+    /// [Concurrent execution]
+    void write(const LogLevel level, const std::string_view message) const override;
+
+private:
+    struct Slot
+    {
+        std::atomic<uint64_t> sequence{0u}; // Position the slot is next writable at, or readable at when one more
+        LogLevel level{LogLevel::Info};
+        std::string message{}; // Reused, so that its capacity is kept between messages
+    };
+
+    /// @brief Writer thread, draining the ring until the logger is destroyed
+    void run();
+
+    /// @brief Moves the available messages out of the ring into the batches, freeing their slots
+    /// @return False if the ring was empty
+    bool drain();
+
+    /// @brief Writes the batched messages to their destinations
+    void write_batches();
+
+    /// @brief Opens the log file, or switches to the standard streams if it can't be opened
+    void open_file();
+
+    /// @brief Renames the log file to <file_path>.1, shifting any older files along, and starts a new one
+    void rotate_file();
+
+    const AsyncLoggerConfig m_config;
+    const std::size_t m_mask;
+    std::unique_ptr<Slot[]> m_slots;
+    mutable std::atomic<uint64_t> m_enqueue_position{0u};
+    uint64_t m_dequeue_position{0u};               // Only used by the writer
+    std::atomic<uint64_t> m_written_position{0u}; // Messages before this position have been written
+    mutable std::atomic<uint64_t> m_dropped{0u};
+    uint64_t m_dropped_reported{0u};
+    std::atomic<bool> m_running{true};
+    std::string m_batch{};       // Messages for stdout, or the log file
+    std::string m_error_batch{}; // Messages for stderr, when not logging to a file
+    std::FILE* m_file{nullptr};
+    std::size_t m_file_size{0u};
+    std::thread m_writer;
+};
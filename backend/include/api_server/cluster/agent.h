@@ -0,0 +1,99 @@
+#pragma once
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/beast.hpp>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "api_server/cluster/store.h"
+#include "api_server/data/snapshot.h"
+
+namespace cluster
+{
+
+namespace bb = boost::beast;
+
+/// @brief The outcome of fetching an agent's snapshot
+struct FetchResult
+{
+    enum class Status
+    {
+        Updated,   // A new snapshot
+        Unchanged, // The agent hasn't published a generation since the last fetch
+        Failed,
+    };
+
+    Status status{Status::Failed};
+    data::Snapshot snapshot; // If Updated
+    std::string error;       // If Failed
+    std::chrono::nanoseconds duration{0};
+};
+
+/// @brief Decodes a snapshot served by an agent's /api/snapshot as MessagePack
+/// @throw nlohmann::json::exception if it isn't one
+data::Snapshot decode_agent_snapshot(const std::string_view msgpack);
+
+/// @brief Fetches the snapshots of one agent, asynchronously on the aggregator's io_context.
+/// The connection is kept alive between fetches, and re-established once if the agent closed it while idle. Fetches
+/// send the ETag of the last snapshot, so that an agent that hasn't polled since answers with a bodyless 304. Only one
+/// fetch runs at a time, and every step of it is bounded by the timeout.
+class AgentClient : public std::enable_shared_from_this<AgentClient>
+{
+public:
+    using Handler = std::function<void(FetchResult)>;
+
+    /// @brief Snapshots larger than this fail to fetch
+    static constexpr std::size_t MAX_BODY_SIZE{256u * 1024u * 1024u};
+
+    AgentClient(boost::asio::io_context& context, AgentEndpoint agent, const std::chrono::milliseconds timeout);
+
+    const AgentEndpoint& agent() const
+    {
+        return m_agent;
+    }
+
+    /// @brief Returns true while a fetch is running
+    bool busy() const
+    {
+        return m_handler != nullptr;
+    }
+
+    /// @brief Fetches the agent's latest snapshot, calling the handler on the io_context once done. Not to be called
+    /// while busy().
+    void fetch(Handler handler);
+
+    /// @brief Closes the connection, failing the fetch in progress if any
+    void close();
+
+private:
+    void resolve();
+    void connect();
+    void write();
+    void read();
+    void on_response(const bb::error_code& error);
+
+    /// @brief Retries on a new connection if the kept-alive one turned out to be closed, else fails the fetch
+    void on_error(const bb::error_code& error, const std::string_view step);
+    void finish(FetchResult result);
+
+    const AgentEndpoint m_agent;
+    const std::chrono::milliseconds m_timeout;
+    boost::asio::ip::tcp::resolver m_resolver;
+    bb::tcp_stream m_stream;
+    std::optional<boost::asio::ip::tcp::resolver::results_type> m_endpoints; // Resolved once
+    bool m_connected{false};
+    bool m_reused{false}; // The fetch is on a connection kept alive from an earlier one
+    bb::flat_buffer m_buffer;
+    bb::http::request<bb::http::empty_body> m_request;
+    std::optional<bb::http::response_parser<bb::http::string_body>> m_parser;
+    std::string m_etag; // Of the last snapshot fetched
+    std::chrono::steady_clock::time_point m_start;
+    Handler m_handler; // Of the fetch in progress
+};
+
+} // namespace cluster
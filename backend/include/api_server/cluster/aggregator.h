@@ -0,0 +1,67 @@
+#pragma once
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "api_server/cluster/agent.h"
+#include "api_server/cluster/store.h"
+#include "api_server/logger.h"
+
+namespace cluster
+{
+
+/// @brief Tuning of the Aggregator
+struct AggregatorConfig
+{
+    std::chrono::milliseconds poll_interval{1000}; // Between the starts of polls of every agent
+    std::chrono::milliseconds timeout{2000};       // For each step of a fetch: connecting, sending and receiving
+    std::size_t max_concurrency{32u};              // Fetches in flight at once
+};
+
+/// @brief Periodically fetches the snapshot of every agent of the cluster store into it.
+/// Fetches run asynchronously on one thread, at most max_concurrency at a time, each agent's over its own kept-alive
+/// connection. An agent whose fetch from the previous poll is still running (i.e. it is slow but hasn't timed out) is
+/// skipped rather than queued again.
+class Aggregator
+{
+public:
+    Aggregator(const Logger& logger, ClusterStore& store, const AggregatorConfig& config = {});
+
+    /// @brief Polls the agents every poll interval until stop() is called (blocking)
+    void start();
+
+    /// @brief Makes start() return, abandoning the fetches in flight. Can be called from any thread.
+    void stop();
+
+    /// @brief Polls every agent once, returning once all of their fetches have finished (blocking). Not to be called
+    /// while start() is running.
+    void poll_once();
+
+private:
+    /// @brief Queues a fetch of every agent that isn't still being fetched, then schedules the next poll if
+    /// `schedule_next`
+    void begin_poll(const bool schedule_next);
+
+    /// @brief Starts queued fetches until max_concurrency are in flight
+    void fetch_queued();
+
+    void on_fetched(const std::size_t index, FetchResult result);
+
+    const Logger& m_logger;
+    ClusterStore& m_store;
+    const AggregatorConfig m_config;
+    boost::asio::io_context m_context; // Only run by the thread in start() or poll_once(), so needs no locking
+    boost::asio::steady_timer m_timer;
+    std::vector<std::shared_ptr<AgentClient>> m_clients;
+    std::deque<std::size_t> m_queue; // Indices of the clients waiting to fetch
+    std::size_t m_in_flight{0u};
+    std::chrono::steady_clock::time_point m_next_poll;
+};
+
+} // namespace cluster
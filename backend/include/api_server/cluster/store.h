@@ -0,0 +1,137 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "api_server/data/snapshot.h"
+
+namespace cluster
+{
+
+/// @brief An api_server agent polled by the aggregator
+struct AgentEndpoint
+{
+    std::string node; // Labels the agent's processes in merged results, "host:port" unless named
+    std::string host;
+    std::string port;
+};
+
+/// @brief Parses an agent given as "[node=]host:port"
+/// @throw std::runtime_error if it has no host or port
+AgentEndpoint parse_agent_endpoint(const std::string_view spec);
+
+/// @brief What a merged process list is sorted by, descending
+enum class ProcOrder
+{
+    Cpu,
+    Mem,
+};
+
+/// @brief The latest state of one agent
+struct NodeState
+{
+    AgentEndpoint agent;
+    bool reachable{false};
+    std::string error;                                            // Of the last fetch, if it failed
+    std::optional<std::chrono::steady_clock::time_point> updated; // Of the last successful fetch
+    std::chrono::nanoseconds fetch_duration{0};                   // Of the last fetch
+    uint64_t failures{0u};                                        // Consecutive failed fetches
+    data::Snapshot snapshot;                                      // Latest fetched, with the agent's generation
+    std::vector<uint32_t> by_cpu; // Indices of the snapshot's processes in ProcOrder::Cpu
+    std::vector<uint32_t> by_mem; // In ProcOrder::Mem
+};
+
+/// @brief A process of one node, in a merged process list
+struct ClusterProc
+{
+    std::string node;
+    data::ProcSnapshot proc;
+};
+
+inline nlohmann::json to_json(const ClusterProc& proc)
+{
+    auto json = data::to_json(proc.proc);
+    json["node"] = proc.node;
+    return json;
+}
+
+/// @brief Totals of the reachable nodes
+struct ClusterSummary
+{
+    uint64_t generation{0u};
+    uint32_t nodes{0u};
+    uint32_t nodes_reachable{0u};
+    uint64_t processes{0u};
+    uint32_t cpus{0u};
+    float cpu_usage_percent{0.0f}; // [0.0, 100.0] of all CPUs of the reachable nodes
+    uint64_t total_memory_kB{0u};
+    uint64_t free_memory_kB{0u};
+    float mem_usage_percent{0.0f}; // [0.0, 100.0]
+};
+
+inline nlohmann::json to_json(const ClusterSummary& summary)
+{
+    return nlohmann::json{{"generation", summary.generation},
+                          {"nodes", summary.nodes},
+                          {"nodes_reachable", summary.nodes_reachable},
+                          {"processes", summary.processes},
+                          {"cpus", summary.cpus},
+                          {"cpu_usage_percent", summary.cpu_usage_percent},
+                          {"total_memory_kB", summary.total_memory_kB},
+                          {"free_memory_kB", summary.free_memory_kB},
+                          {"mem_usage_percent", summary.mem_usage_percent}};
+}
+
+/// @brief Combines the latest snapshots of every agent, for the aggregator's endpoints.
+/// Each node's state is replaced whole by the aggregator and shared with readers, which never wait on a merge. Only
+/// reachable nodes count towards merged results; an unreachable node's last snapshot is kept for its status.
+class ClusterStore
+{
+public:
+    /// @throw std::runtime_error if two agents have the same node name
+    explicit ClusterStore(const std::vector<AgentEndpoint>& agents);
+
+    /// @brief Returns the number of changes to the nodes' data, for caching merged results
+    uint64_t generation() const
+    {
+        return m_generation.load(std::memory_order_acquire);
+    }
+
+    /// @brief Stores a node's newly fetched snapshot [Concurrent execution]
+    void update(const std::string& node, data::Snapshot snapshot, const std::chrono::nanoseconds fetch_duration);
+
+    /// @brief Records a fetch that found the node's snapshot unchanged [Concurrent execution]
+    void mark_unchanged(const std::string& node, const std::chrono::nanoseconds fetch_duration);
+
+    /// @brief Records a failed fetch, leaving the node out of merged results until it is reachable again
+    /// [Concurrent execution]
+    void mark_failed(const std::string& node, const std::string& error, const std::chrono::nanoseconds fetch_duration);
+
+    /// @brief Returns every node's latest state, in the order the agents were given
+    std::vector<std::shared_ptr<const NodeState>> nodes() const;
+
+    /// @brief Returns the `count` processes of the reachable nodes using the most CPU or memory, merged from each
+    /// node's processes in that order
+    std::vector<ClusterProc> top_procs(const std::size_t count, const ProcOrder order) const;
+
+    ClusterSummary summary() const;
+
+private:
+    /// @brief Replaces a node's state with a copy changed by `change` [Concurrent execution]
+    template <typename Change> void modify(const std::string& node, const bool changes_results, Change change);
+
+    mutable std::mutex m_mutex;
+    std::vector<std::shared_ptr<const NodeState>> m_nodes;
+    std::unordered_map<std::string, std::size_t> m_node_indices; // By node name, fixed at construction
+    std::atomic<uint64_t> m_generation{0u};
+};
+
+} // namespace cluster
@@ -1,11 +1,21 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
 #include <mutex>
 #include <optional>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+#include "api_server/metrics/poll.h"
+#include "api_server/metrics/trace.h"
+#include "prochistory.h"
+#include "proctree.h"
+#include "snapshot.h"
 #include "types.h"
 
 namespace data
@@ -17,6 +27,68 @@ class DataStore
 public:
     DataStore() = default;
 
+    /// @brief Returns the number of completed monitor polls.
+    /// All datasets derived from the same poll share a generation.
+    uint64_t generation() const
+    {
+        return m_generation.load(std::memory_order_acquire);
+    }
+
+    /// @brief Marks the end of a monitor poll, after all of its datasets have been stored. Their current values are
+    /// captured as the generation's Snapshot. Only called by the monitor.
+    void publish_generation()
+    {
+        const auto generation = m_generation.load(std::memory_order_acquire) + 1u;
+        auto snapshot = std::make_shared<Snapshot>();
+        snapshot->generation = generation;
+        snapshot->uptime = get_uptime();
+        snapshot->cpus = get_cpu_snapshots();
+        snapshot->mem = get_mem_snapshot();
+        {
+            const auto lock = lock_traced(m_proc_snapshots_mutex, "proc_snapshots");
+            snapshot->procs = m_proc_list;
+            snapshot->proc_tree = std::make_shared<const ProcTree>(m_proc_tree);
+        }
+        {
+            const std::unique_lock lock{m_cgroup_snapshots_mutex};
+            snapshot->cgroups = m_cgroup_snapshots;
+        }
+        {
+            const std::unique_lock lock{m_thread_snapshots_mutex};
+            snapshot->threads = m_thread_snapshots;
+        }
+        {
+            const auto lock = lock_traced(m_proc_history_mutex, "proc_history");
+            m_proc_history.record(generation, snapshot->procs.value());
+        }
+        {
+            const auto lock = lock_traced(m_snapshot_mutex, "snapshot");
+            m_snapshot = std::move(snapshot);
+        }
+        m_generation.store(generation, std::memory_order_release);
+        const std::unique_lock lock{m_publish_listeners_mutex};
+        for (const auto& listener : m_publish_listeners)
+        {
+            listener(generation);
+        }
+    }
+
+    /// @brief Registers a function to be called with each new generation once it is published, on the monitor's
+    /// thread. The listener must outlive the datastore's publishing.
+    void on_publish(std::function<void(uint64_t generation)> listener)
+    {
+        const std::unique_lock lock{m_publish_listeners_mutex};
+        m_publish_listeners.push_back(std::move(listener));
+    }
+
+    /// @brief Returns the datasets of the latest published generation, which are all from the same poll unlike the
+    /// results of separate calls to get_uptime(), get_cpu_snapshots() etc. that may already be of the next poll.
+    std::shared_ptr<const Snapshot> get_snapshot() const
+    {
+        const std::unique_lock lock{m_snapshot_mutex};
+        return m_snapshot;
+    }
+
     Uptime get_uptime() const
     {
         const std::unique_lock lock{m_uptime_mutex};
@@ -25,7 +97,7 @@ public:
 
     void set_uptime(const Uptime& uptime)
     {
-        std::unique_lock lock{m_uptime_mutex};
+        const auto lock = lock_traced(m_uptime_mutex, "uptime");
         m_uptime = uptime;
     }
 
@@ -37,7 +109,7 @@ public:
 
     void set_mem_snapshot(const MemSnapshot& mem_snapshot)
     {
-        std::unique_lock lock{m_mem_snapshot_mutex};
+        const auto lock = lock_traced(m_mem_snapshot_mutex, "mem_snapshot");
         m_mem_snapshot = mem_snapshot;
     }
 
@@ -69,7 +141,7 @@ public:
 
     void store_cpu_snapshots(const std::vector<CpuSnapshot>& snapshots)
     {
-        const std::unique_lock lock{m_cpu_snapshots_mutex};
+        const auto lock = lock_traced(m_cpu_snapshots_mutex, "cpu_snapshots");
         m_cpu_snapshots.clear();
         for (const auto& snapshot : snapshots)
         {
@@ -88,32 +160,184 @@ public:
 
     void store_proc_snapshots(const std::vector<ProcSnapshot>& snapshots)
     {
-        const std::unique_lock lock{m_proc_snapshots_mutex};
+        const auto lock = lock_traced(m_proc_snapshots_mutex, "proc_snapshots");
         m_proc_snapshots.clear();
         for (const auto& snapshot : snapshots)
         {
             m_proc_snapshots[snapshot.pid] = snapshot;
         }
+        m_proc_tree.update(m_proc_snapshots);
+        auto list = std::make_shared<std::vector<ProcSnapshot>>();
+        list->reserve(m_proc_snapshots.size());
+        std::transform(m_proc_snapshots.cbegin(), m_proc_snapshots.cend(), std::back_inserter(*list),
+                       [](const auto& pair) { return pair.second; });
+        m_proc_list = std::move(list);
     }
 
     std::vector<ProcSnapshot> get_proc_snapshots() const
     {
         const std::unique_lock lock{m_proc_snapshots_mutex};
-        std::vector<ProcSnapshot> snapshots;
-        std::transform(m_proc_snapshots.cbegin(), m_proc_snapshots.cend(), std::back_inserter(snapshots),
-                       [](const auto& pair) { return pair.second; });
-        return snapshots;
+        return *m_proc_list;
     }
 
-    std::optional<ProcSnapshot> get_proc_snapshot(const uint32_t pid)
+    /// @brief Returns the latest process snapshots ordered by PID, as an immutable list that is shared rather than
+    /// copied, e.g. for responses that are streamed over longer than a poll
+    std::shared_ptr<const std::vector<ProcSnapshot>> get_proc_list() const
     {
         const std::unique_lock lock{m_proc_snapshots_mutex};
-        if (m_proc_snapshots.find(pid) != m_proc_snapshots.end())
-            return m_proc_snapshots[pid];
+        return m_proc_list;
+    }
+
+    /// @brief Returns the changes to the process list since a generation, or the full list if the generation is too
+    /// old for its changes to still be known
+    ProcListDelta get_proc_delta(const uint64_t since, const ProcDeltaThresholds& thresholds) const
+    {
+        const std::unique_lock lock{m_proc_history_mutex};
+        return m_proc_history.delta_since(since, thresholds);
+    }
+
+    /// @brief Returns the changes to the process list from a generation to that of a published snapshot, or the
+    /// snapshot's full list if the generation is too old for its changes to still be known
+    ProcListDelta get_proc_delta(const uint64_t since, const ProcDeltaThresholds& thresholds,
+                                 const Snapshot& snapshot) const
+    {
+        static const std::vector<ProcSnapshot> no_procs;
+        const auto& procs = snapshot.procs ? *snapshot.procs.value() : no_procs;
+        const std::unique_lock lock{m_proc_history_mutex};
+        return m_proc_history.delta(since, snapshot.generation, procs, thresholds);
+    }
+
+    std::optional<ProcSnapshot> get_proc_snapshot(const uint32_t pid) const
+    {
+        const std::unique_lock lock{m_proc_snapshots_mutex};
+        if (const auto iter = m_proc_snapshots.find(pid); iter != m_proc_snapshots.end())
+            return iter->second;
+        return std::nullopt;
+    }
+
+    void store_smaps_sample(const int32_t pid, const SmapsSample& sample)
+    {
+        const std::unique_lock lock{m_smaps_samples_mutex};
+        m_smaps_samples[pid] = sample;
+    }
+
+    std::unordered_map<int32_t, SmapsSample> get_smaps_samples() const
+    {
+        const std::unique_lock lock{m_smaps_samples_mutex};
+        return m_smaps_samples;
+    }
+
+    /// @brief Discards samples for processes that are no longer running
+    void prune_smaps_samples(const std::vector<int32_t>& live_pids)
+    {
+        const std::unordered_set<int32_t> live{live_pids.cbegin(), live_pids.cend()};
+        const std::unique_lock lock{m_smaps_samples_mutex};
+        for (auto iter = m_smaps_samples.begin(); iter != m_smaps_samples.end();)
+        {
+            if (live.count(iter->first) == 0)
+                iter = m_smaps_samples.erase(iter);
+            else
+                ++iter;
+        }
+    }
+
+    /// @brief Records a request for the threads of a process to be monitored
+    void request_thread_monitoring(const int32_t pid)
+    {
+        const std::unique_lock lock{m_thread_snapshots_mutex};
+        m_thread_requests[pid] = std::chrono::steady_clock::now();
+    }
+
+    /// @brief Returns the processes whose threads have been requested within `max_age`, forgetting older requests
+    std::vector<int32_t> get_thread_monitoring_requests(const std::chrono::steady_clock::duration max_age)
+    {
+        const auto now = std::chrono::steady_clock::now();
+        const std::unique_lock lock{m_thread_snapshots_mutex};
+        std::vector<int32_t> pids;
+        for (auto iter = m_thread_requests.begin(); iter != m_thread_requests.end();)
+        {
+            if (now - iter->second > max_age)
+            {
+                iter = m_thread_requests.erase(iter);
+                continue;
+            }
+            pids.push_back(iter->first);
+            ++iter;
+        }
+        return pids;
+    }
+
+    void store_thread_snapshots(const std::vector<ProcThreads>& snapshots)
+    {
+        auto by_pid = std::make_shared<std::unordered_map<int32_t, ProcThreads>>();
+        for (const auto& snapshot : snapshots)
+        {
+            (*by_pid)[snapshot.pid] = snapshot;
+        }
+        const std::unique_lock lock{m_thread_snapshots_mutex};
+        m_thread_snapshots = std::move(by_pid);
+    }
+
+    std::optional<ProcThreads> get_thread_snapshots(const int32_t pid) const
+    {
+        const std::unique_lock lock{m_thread_snapshots_mutex};
+        if (const auto iter = m_thread_snapshots->find(pid); iter != m_thread_snapshots->end())
+            return iter->second;
         return std::nullopt;
     }
 
+    void store_cgroup_snapshots(const std::vector<CgroupSnapshot>& snapshots)
+    {
+        auto shared = std::make_shared<const std::vector<CgroupSnapshot>>(snapshots);
+        const std::unique_lock lock{m_cgroup_snapshots_mutex};
+        m_cgroup_snapshots = std::move(shared);
+    }
+
+    std::vector<CgroupSnapshot> get_cgroup_snapshots() const
+    {
+        const std::unique_lock lock{m_cgroup_snapshots_mutex};
+        return *m_cgroup_snapshots;
+    }
+
+    /// @brief Instrumentation of the monitor's polls, recorded by the monitor [Concurrent execution]
+    metrics::PollMetrics& poll_metrics()
+    {
+        return m_poll_metrics;
+    }
+
+    /// @brief Recent spans of the monitor's polls, recorded by the monitor and the datastore [Concurrent execution]
+    metrics::FlightRecorder& flight_recorder()
+    {
+        return m_flight_recorder;
+    }
+
 private:
+    /// @brief Locks a mutex that the monitor writes under, recording the wait in the flight recorder if it was slow,
+    /// e.g. because a request held it. Uncontended locks aren't timed.
+    std::unique_lock<std::mutex> lock_traced(std::mutex& mutex, const char* name)
+    {
+        std::unique_lock lock{mutex, std::try_to_lock};
+        if (!lock.owns_lock())
+        {
+            const auto start = std::chrono::steady_clock::now();
+            lock.lock();
+            const auto end = std::chrono::steady_clock::now();
+            if (m_flight_recorder.is_slow(end - start))
+                m_flight_recorder.record("lock", name, start, end, generation() + 1u);
+        }
+        return lock;
+    }
+
+    std::atomic<uint64_t> m_generation{0u};
+    metrics::PollMetrics m_poll_metrics;
+    metrics::FlightRecorder m_flight_recorder;
+
+    mutable std::mutex m_snapshot_mutex;
+    std::shared_ptr<const Snapshot> m_snapshot{std::make_shared<Snapshot>()};
+
+    std::mutex m_publish_listeners_mutex;
+    std::vector<std::function<void(uint64_t)>> m_publish_listeners;
+
     mutable std::mutex m_uptime_mutex;
     Uptime m_uptime;
 
@@ -125,6 +349,23 @@ private:
 
     mutable std::mutex m_proc_snapshots_mutex;
     std::map<uint32_t, ProcSnapshot> m_proc_snapshots;
+    std::shared_ptr<const std::vector<ProcSnapshot>> m_proc_list{std::make_shared<std::vector<ProcSnapshot>>()};
+    ProcTree m_proc_tree;
+
+    mutable std::mutex m_proc_history_mutex;
+    ProcHistory m_proc_history;
+
+    mutable std::mutex m_thread_snapshots_mutex;
+    std::unordered_map<int32_t, std::chrono::steady_clock::time_point> m_thread_requests;
+    std::shared_ptr<const std::unordered_map<int32_t, ProcThreads>> m_thread_snapshots{
+        std::make_shared<std::unordered_map<int32_t, ProcThreads>>()}; // Replaced rather than modified, as published
+
+    mutable std::mutex m_cgroup_snapshots_mutex;
+    std::shared_ptr<const std::vector<CgroupSnapshot>> m_cgroup_snapshots{
+        std::make_shared<std::vector<CgroupSnapshot>>()}; // Replaced rather than modified, as published
+
+    mutable std::mutex m_smaps_samples_mutex;
+    std::unordered_map<int32_t, SmapsSample> m_smaps_samples;
 };
 
 }; // namespace data
\ No newline at end of file
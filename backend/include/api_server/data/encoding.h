@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "proctable.h"
+#include "types.h"
+
+namespace data
+{
+
+/// @brief Representations that data can be serialized to
+enum class Encoding
+{
+    Json,
+    MsgPack,
+    Cbor,
+    ProcTable, // Fixed layout binary process table, only for lists of processes (see proctable.h)
+};
+
+/// @brief Returns the media type of an encoding, for the Content-Type header
+inline std::string_view media_type(const Encoding encoding)
+{
+    switch (encoding)
+    {
+    case Encoding::Json:
+        return "application/json";
+    case Encoding::MsgPack:
+        return "application/msgpack";
+    case Encoding::Cbor:
+        return "application/cbor";
+    case Encoding::ProcTable:
+        return PROC_TABLE_MEDIA_TYPE;
+    }
+    return "application/octet-stream";
+}
+
+/// @brief Serializes a JSON document, which must not be a process table.
+/// Invalid UTF-8 in JSON strings is replaced with U+FFFD, as by the JsonWriter, rather than failing the response.
+inline std::string encode_document(const nlohmann::json& document, const Encoding encoding)
+{
+    std::vector<std::uint8_t> encoded;
+    switch (encoding)
+    {
+    case Encoding::Json:
+        return document.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+    case Encoding::MsgPack:
+        encoded = nlohmann::json::to_msgpack(document);
+        return {encoded.begin(), encoded.end()};
+    case Encoding::Cbor:
+        encoded = nlohmann::json::to_cbor(document);
+        return {encoded.begin(), encoded.end()};
+    case Encoding::ProcTable:
+        break;
+    }
+    throw std::invalid_argument{"Cannot encode a document as " + std::string{media_type(encoding)}};
+}
+
+/// @brief Serializes anything with a to_json overload. JSON goes through the JsonWriter where possible, the binary
+/// encodings carry the same document as the JSON.
+template <typename Serializable> inline std::string encode(const Serializable& serializable, const Encoding encoding)
+{
+    if (encoding == Encoding::Json)
+        return to_json_string(serializable);
+    return encode_document(to_json(serializable), encoding);
+}
+
+inline std::string encode(const std::vector<ProcSnapshot>& procs, const Encoding encoding)
+{
+    if (encoding == Encoding::ProcTable)
+        return encode_proc_table(procs);
+    return encode<std::vector<ProcSnapshot>>(procs, encoding);
+}
+
+} // namespace data
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace data
+{
+
+/// @brief Serializes JSON directly into a string, without building an nlohmann::json document first.
+/// Output is byte-identical to nlohmann::json::dump() as long as object keys are written in ascending order, which is
+/// the order nlohmann sorts them in. Strings that are not valid UTF-8 have each invalid sequence replaced with U+FFFD
+/// (as dump() does with error_handler_t::replace) rather than throwing. The rare doubles for which nlohmann's
+/// formatting is not the shortest are written shorter, with the same value.
+/// Appends to the given string, so a buffer can be cleared and reused between documents without reallocating.
+class JsonWriter
+{
+public:
+    explicit JsonWriter(std::string& out) : m_out(out)
+    {
+    }
+
+    void begin_object()
+    {
+        separate();
+        m_out.push_back('{');
+        m_needs_comma = false;
+    }
+
+    void end_object()
+    {
+        m_out.push_back('}');
+        m_needs_comma = true;
+    }
+
+    void begin_array()
+    {
+        separate();
+        m_out.push_back('[');
+        m_needs_comma = false;
+    }
+
+    void end_array()
+    {
+        m_out.push_back(']');
+        m_needs_comma = true;
+    }
+
+    /// @brief Writes an object key, which is expected to be a literal that needs no escaping
+    void key(const std::string_view key)
+    {
+        separate();
+        m_out.push_back('"');
+        m_out.append(key);
+        m_out.append("\":", 2);
+        m_needs_comma = false;
+    }
+
+    void null()
+    {
+        separate();
+        m_out.append("null", 4);
+        m_needs_comma = true;
+    }
+
+    void value(const bool value)
+    {
+        separate();
+        value ? m_out.append("true", 4) : m_out.append("false", 5);
+        m_needs_comma = true;
+    }
+
+    template <typename Integer, std::enable_if_t<std::is_integral_v<Integer>, bool> = true>
+    void value(const Integer value)
+    {
+        separate();
+        char buffer[24];
+        const auto result = std::to_chars(std::begin(buffer), std::end(buffer), value);
+        m_out.append(buffer, static_cast<std::size_t>(result.ptr - buffer));
+        m_needs_comma = true;
+    }
+
+    /// @brief nlohmann stores every floating point number as a double, so floats are widened before formatting
+    void value(const float value)
+    {
+        this->value(static_cast<double>(value));
+    }
+
+    void value(const double value);
+
+    void value(const std::string_view value);
+
+    void value(const char* value)
+    {
+        this->value(std::string_view{value});
+    }
+
+    template <typename Value> void member(const std::string_view key, const Value& value)
+    {
+        this->key(key);
+        this->value(value);
+    }
+
+private:
+    void separate()
+    {
+        if (m_needs_comma)
+            m_out.push_back(',');
+    }
+
+    /// @brief Appends a finite double in nlohmann's layout, from the shortest digits that round-trip
+    void append_double(const double value);
+
+    void append_escaped(const std::string_view value);
+
+    std::string& m_out;
+    bool m_needs_comma{false};
+};
+
+} // namespace data
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "types.h"
+
+namespace data
+{
+
+/// @brief Minimum changes to CPU and memory usage that make a process count as changed in a ProcListDelta.
+/// At 0, any change counts.
+struct ProcDeltaThresholds
+{
+    float cpu_usage_percent{0.0f};
+    float mem_usage_percent{0.0f};
+};
+
+/// @brief The changes to the process list from one generation to another, or the whole list if the changes are no
+/// longer known
+struct ProcListDelta
+{
+    uint64_t since{0u};
+    uint64_t generation{0u};
+    bool full{false};                  // The client should replace its list with `added`
+    std::vector<ProcSnapshot> added;   // Processes that started since, or every process if full
+    std::vector<ProcSnapshot> changed; // Latest rows of processes that changed since
+    std::vector<int32_t> removed;      // PIDs of processes that exited since
+};
+
+inline nlohmann::json to_json(const ProcListDelta& delta)
+{
+    return nlohmann::json{{"since", delta.since},
+                          {"generation", delta.generation},
+                          {"full", delta.full},
+                          {"added", to_json(delta.added)},
+                          {"changed", to_json(delta.changed)},
+                          {"removed", delta.removed}};
+}
+
+inline void write_json(JsonWriter& writer, const ProcListDelta& delta)
+{
+    writer.begin_object();
+    writer.key("added");
+    writer.begin_array();
+    for (const auto& proc : delta.added)
+    {
+        write_json(writer, proc);
+    }
+    writer.end_array();
+    writer.key("changed");
+    writer.begin_array();
+    for (const auto& proc : delta.changed)
+    {
+        write_json(writer, proc);
+    }
+    writer.end_array();
+    writer.member("full", delta.full);
+    writer.member("generation", delta.generation);
+    writer.key("removed");
+    writer.begin_array();
+    for (const auto pid : delta.removed)
+    {
+        writer.value(pid);
+    }
+    writer.end_array();
+    writer.member("since", delta.since);
+    writer.end_object();
+}
+
+/// @brief Remembers how the process list changed over the last WINDOW generations, so that clients can fetch only
+/// what changed since the generation they have. Each generation is diffed against the previous one once, when it is
+/// recorded; a delta over several generations is composed from these at request time.
+/// Not thread-safe, owned by the DataStore.
+class ProcHistory
+{
+public:
+    using ProcList = std::shared_ptr<const std::vector<ProcSnapshot>>;
+
+    static constexpr std::size_t WINDOW{60u}; // Generations of changes kept
+
+    /// @brief Records the process list of a newly published generation, ordered by PID
+    void record(const uint64_t generation, ProcList procs);
+
+    /// @brief Returns the changes since a generation, or the full list if it is outside the window
+    ProcListDelta delta_since(const uint64_t since, const ProcDeltaThresholds& thresholds = {}) const;
+
+    /// @brief Returns the changes from generation `since` to `until`, or the full list of `until` if either is outside
+    /// the window
+    /// @param procs The process list of generation `until`, ordered by PID
+    ProcListDelta delta(const uint64_t since, const uint64_t until, const std::vector<ProcSnapshot>& procs,
+                        const ProcDeltaThresholds& thresholds = {}) const;
+
+private:
+    /// @brief A process that was running in both generations, with its usage in the earlier one
+    struct Change
+    {
+        int32_t pid{0};
+        float cpu_usage_percent{0.0f};
+        float mem_usage_percent{0.0f};
+        uint32_t mem_usage_kB{0u};
+        bool other_fields_changed{false}; // Anything other than the CPU and memory usage
+    };
+
+    /// @brief The changes from the previous generation to `generation`
+    struct GenerationChanges
+    {
+        uint64_t generation{0u};
+        std::vector<int32_t> added;
+        std::vector<int32_t> removed;
+        std::vector<Change> changed;
+    };
+
+    static GenerationChanges diff(const uint64_t generation, const std::vector<ProcSnapshot>& previous,
+                                  const std::vector<ProcSnapshot>& current);
+
+    uint64_t m_generation{0u};
+    ProcList m_procs{std::make_shared<std::vector<ProcSnapshot>>()};
+    std::deque<GenerationChanges> m_changes; // Consecutive generations, oldest first
+};
+
+} // namespace data
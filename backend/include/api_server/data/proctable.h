@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "types.h"
+
+namespace data
+{
+
+/// @brief Media type of the binary process table
+constexpr std::string_view PROC_TABLE_MEDIA_TYPE{"application/vnd.task-manager.proctable"};
+
+/// @brief Compact binary form of a list of processes, for collectors that scrape many hosts and would rather not
+/// parse JSON. Every field is little-endian and at a fixed offset:
+///
+///   Header (24 bytes)
+///     char[4]   magic             "PTBL"
+///     uint16    version           Changes only when the layout changes incompatibly
+///     uint16    record_size       Fields may be appended to records without a version change, so skip by this
+///     uint32    record_count
+///     uint32    strings_size      Size of the string table following the records
+///     float64   snapshot_time     System uptime when the processes were read
+///   Records (record_count * record_size bytes)
+///     int32     pid
+///     int32     ppid
+///     float32   cpu_usage_percent
+///     float32   mem_usage_percent
+///     uint32    mem_usage_kB
+///     uint32    flags             Bit 0: the smaps fields are set
+///     uint32    pss_kB
+///     uint32    uss_kB
+///     uint32    swap_kB
+///     float32   smaps_age_seconds
+///     uint32    name_offset,    name_size       Byte ranges of the string table
+///     uint32    command_offset, command_size
+///     uint32    cgroup_offset,  cgroup_size
+///   String table (strings_size bytes)
+///     UTF-8 strings, not null-terminated. Repeated strings, e.g. cgroups, are stored once.
+struct ProcTable
+{
+    static constexpr uint16_t VERSION{1u};
+    static constexpr uint16_t HEADER_SIZE{24u};
+    static constexpr uint16_t RECORD_SIZE{64u};
+    static constexpr uint32_t FLAG_SMAPS{1u << 0};
+
+    double snapshot_time{0.0};
+    std::vector<ProcSnapshot> procs;
+};
+
+/// @brief Serializes processes from one poll to the binary process table
+std::string encode_proc_table(const std::vector<ProcSnapshot>& procs);
+
+/// @brief Reads a binary process table, as a reference for collectors
+/// @return nullopt if the table is malformed or of an unsupported version
+std::optional<ProcTable> decode_proc_table(const std::string_view encoded);
+
+} // namespace data
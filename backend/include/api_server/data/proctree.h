@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+#include "types.h"
+
+namespace data
+{
+
+/// @brief A process and (up to a depth limit) its descendants, with resource usage rolled up over the whole subtree.
+/// Trees are built, serialized and destroyed without recursion, as a long chain of forks would overflow the stack.
+struct ProcTreeNode
+{
+    ProcTreeNode() = default;
+    ProcTreeNode(const ProcTreeNode&) = default;
+    ProcTreeNode(ProcTreeNode&&) = default;
+    ProcTreeNode& operator=(const ProcTreeNode&) = default;
+    ProcTreeNode& operator=(ProcTreeNode&&) = default;
+    ~ProcTreeNode();
+
+    ProcSnapshot process;
+    float subtree_cpu_usage_percent{0.0f};
+    float subtree_mem_usage_percent{0.0f};
+    uint64_t subtree_mem_usage_kB{0u};
+    uint32_t descendant_count{0u};
+    uint32_t child_count{0u};
+    bool expanded{false}; // False if the depth limit was reached before this node's children
+    std::vector<ProcTreeNode> children;
+};
+
+nlohmann::json to_json(const ProcTreeNode& node);
+
+void write_json(JsonWriter& writer, const ProcTreeNode& node);
+
+/// @brief Parent/child hierarchy of processes, indexed by ppid.
+/// The hierarchy is updated incrementally from one generation of process snapshots to the next: only processes that
+/// appeared, exited or were re-parented touch the adjacency lists. Subtree rollups are recalculated on every update.
+/// Not thread-safe, owned by the DataStore.
+class ProcTree
+{
+public:
+    using Procs = std::map<uint32_t, ProcSnapshot>;
+
+    /// @brief Brings the tree up to date with the latest generation of process snapshots
+    void update(const Procs& procs);
+
+    /// @brief Returns the PIDs of processes without a (known) parent
+    std::vector<int32_t> roots() const;
+
+    /// @brief Returns the PIDs of the direct children of a process, in ascending order
+    std::vector<int32_t> children(const int32_t pid) const;
+
+    /// @brief Builds the subtree rooted at a process
+    /// @param procs The generation of process snapshots the tree was last updated with, ordered by PID
+    /// @param depth Number of levels of descendants to include, or nullopt for the entire subtree
+    /// @return The subtree, or nullopt if the process is not in the tree
+    std::optional<ProcTreeNode> subtree(const std::vector<ProcSnapshot>& procs, const int32_t pid,
+                                        const std::optional<uint32_t> depth) const;
+
+    /// @brief Builds the subtrees of all root processes
+    /// @param procs The generation of process snapshots the tree was last updated with, ordered by PID
+    std::vector<ProcTreeNode> forest(const std::vector<ProcSnapshot>& procs,
+                                     const std::optional<uint32_t> depth) const;
+
+    std::size_t size() const
+    {
+        return m_nodes.size();
+    }
+
+private:
+    struct Node
+    {
+        int32_t ppid{0};
+        bool is_root{true};
+        std::vector<int32_t> children; // Sorted
+        float subtree_cpu_usage_percent{0.0f};
+        float subtree_mem_usage_percent{0.0f};
+        uint64_t subtree_mem_usage_kB{0u};
+        uint32_t descendant_count{0u};
+    };
+
+    void add_node(const int32_t pid, const int32_t ppid);
+    void make_root(const int32_t pid, Node& node);
+    void remove_node(const int32_t pid);
+    void attach(const int32_t pid, Node& node);
+    void detach(const int32_t pid, Node& node);
+
+    /// @brief Returns true if `ancestor` is `pid` or one of its ancestors
+    bool is_ancestor(const int32_t ancestor, int32_t pid) const;
+
+    /// @brief Recalculates the subtree rollups of every node
+    void update_rollups(const Procs& procs);
+
+    /// @brief Builds the subtree rooted at `pid` into `out`
+    void build_node(const std::vector<ProcSnapshot>& procs, const int32_t pid, const std::optional<uint32_t> depth,
+                    ProcTreeNode& out) const;
+
+    std::unordered_map<int32_t, Node> m_nodes;
+    std::set<int32_t> m_roots;
+    std::unordered_map<int32_t, std::vector<int32_t>> m_roots_by_ppid; // To adopt them when their parent is added
+};
+
+} // namespace data
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "proctree.h"
+#include "types.h"
+
+namespace data
+{
+
+/// @brief The system-wide datasets of one monitor poll, published together so that they are consistent with each
+/// other, e.g. process memory usage against the same total memory. Datasets left out of a projection are nullopt.
+struct Snapshot
+{
+    uint64_t generation{0u};
+    std::optional<Uptime> uptime;
+    std::optional<std::vector<CpuSnapshot>> cpus;
+    std::optional<MemSnapshot> mem;
+    std::optional<std::shared_ptr<const std::vector<ProcSnapshot>>> procs; // Shared with the DataStore
+
+    // Datasets of the generation that aren't part of the snapshot's document, so that responses derived from them are
+    // of the same poll too. Null unless the snapshot was published by a DataStore.
+    std::shared_ptr<const ProcTree> proc_tree;                               // Of `procs`
+    std::shared_ptr<const std::vector<CgroupSnapshot>> cgroups;
+    std::shared_ptr<const std::unordered_map<int32_t, ProcThreads>> threads; // Of the processes monitored, by PID
+};
+
+inline nlohmann::json to_json(const Snapshot& snapshot)
+{
+    nlohmann::json json{{"generation", snapshot.generation}};
+    if (snapshot.uptime)
+        json["uptime"] = to_json(snapshot.uptime.value());
+    if (snapshot.cpus)
+        json["cpus"] = to_json(snapshot.cpus.value());
+    if (snapshot.mem)
+        json["mem"] = to_json(snapshot.mem.value());
+    if (snapshot.procs)
+        json["procs"] = to_json(*snapshot.procs.value());
+    return json;
+}
+
+inline void write_json(JsonWriter& writer, const Snapshot& snapshot)
+{
+    writer.begin_object();
+    if (snapshot.cpus)
+    {
+        writer.key("cpus");
+        writer.begin_array();
+        for (const auto& cpu : snapshot.cpus.value())
+        {
+            write_json(writer, cpu);
+        }
+        writer.end_array();
+    }
+    writer.member("generation", snapshot.generation);
+    if (snapshot.mem)
+    {
+        writer.key("mem");
+        write_json(writer, snapshot.mem.value());
+    }
+    if (snapshot.procs)
+    {
+        writer.key("procs");
+        writer.begin_array();
+        for (const auto& proc : *snapshot.procs.value())
+        {
+            write_json(writer, proc);
+        }
+        writer.end_array();
+    }
+    if (snapshot.uptime)
+    {
+        writer.key("uptime");
+        write_json(writer, snapshot.uptime.value());
+    }
+    writer.end_object();
+}
+
+} // namespace data
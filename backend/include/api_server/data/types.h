@@ -1,24 +1,84 @@
 #pragma once
 
 #include <algorithm>
+#include <map>
 #include <nlohmann/json.hpp>
+#include <optional>
 #include <string>
+#include <type_traits>
+#include <vector>
+
+#include "json_writer.h"
 
 namespace data
 {
 
+template <typename JsonSerializable> inline nlohmann::json to_json(const std::vector<JsonSerializable>& serializables)
+{
+    auto json_array = nlohmann::json::array();
+    std::transform(serializables.cbegin(), serializables.cend(), std::back_inserter(json_array),
+                   [](const JsonSerializable& dto) { return to_json(dto); });
+    return json_array;
+}
+
+template <typename T, typename = void> struct is_json_writable : std::false_type
+{
+};
+
+template <typename T>
+struct is_json_writable<T, std::void_t<decltype(write_json(std::declval<JsonWriter&>(), std::declval<const T&>()))>>
+    : std::true_type
+{
+};
+
+/// @brief Size of the last document of a type that was serialized on this thread, used to size the next one
+template <typename JsonSerializable> inline std::size_t& json_size_hint()
+{
+    thread_local std::size_t size_hint{0u};
+    return size_hint;
+}
+
+/// @brief Serializes with the JsonWriter if the type supports it, otherwise by building an nlohmann::json document
 template <typename JsonSerializable> inline std::string to_json_string(const JsonSerializable& serializable)
 {
-    return to_json(serializable).dump();
+    if constexpr (is_json_writable<JsonSerializable>::value)
+    {
+        auto& size_hint = json_size_hint<JsonSerializable>();
+        std::string json;
+        json.reserve(size_hint);
+        JsonWriter writer{json};
+        write_json(writer, serializable);
+        size_hint = json.size();
+        return json;
+    }
+    else
+    {
+        return to_json(serializable).dump();
+    }
 }
 
 template <typename JsonSerializable>
 inline std::string to_json_string(const std::vector<JsonSerializable>& serializables)
 {
-    auto json_array = nlohmann::json::array();
-    std::transform(serializables.cbegin(), serializables.cend(), std::back_inserter(json_array),
-                   [](const JsonSerializable& dto) { return to_json(dto); });
-    return json_array.dump();
+    if constexpr (is_json_writable<JsonSerializable>::value)
+    {
+        auto& size_hint = json_size_hint<std::vector<JsonSerializable>>();
+        std::string json;
+        json.reserve(size_hint);
+        JsonWriter writer{json};
+        writer.begin_array();
+        for (const auto& serializable : serializables)
+        {
+            write_json(writer, serializable);
+        }
+        writer.end_array();
+        size_hint = json.size();
+        return json;
+    }
+    else
+    {
+        return to_json(serializables).dump();
+    }
 }
 
 /// @brief Data sourced from /proc/uptime
@@ -40,6 +100,27 @@ inline nlohmann::json to_json(const Uptime& uptime)
                           {"formatted", uptime.formatted}};
 }
 
+// Keys in the order nlohmann sorts them, so that both serializations are identical
+inline void write_json(JsonWriter& writer, const Uptime& uptime)
+{
+    writer.begin_object();
+    writer.member("formatted", uptime.formatted);
+    writer.member("hours", uptime.hours);
+    writer.member("minutes", uptime.minutes);
+    writer.member("seconds", uptime.seconds);
+    writer.member("total_seconds", uptime.total_seconds);
+    writer.end_object();
+}
+
+/// @brief Data sourced from /proc/[pid]/smaps_rollup, which is too expensive to read on every poll
+struct SmapsSample
+{
+    double sample_time{0.0};  // System uptime when sampled
+    uint32_t pss_kB{0u};      // Proportional set size, shared pages divided between the processes sharing them
+    uint32_t uss_kB{0u};      // Unique set size, pages private to the process
+    uint32_t swap_kB{0u};
+};
+
 /// @brief Data sourced from
 ///        /proc/[pid]/status
 ///                 ../stat
@@ -56,8 +137,28 @@ struct ProcSnapshot
     uint32_t utime{0u};
     uint32_t stime{0u};
     float cpu_usage_percent{0.0f}; // [0.0, 100.0]
+    std::optional<SmapsSample> smaps; // Latest sample from the background collector, if any
+    std::string cgroup;               // Path in the cgroup v2 hierarchy, empty if unknown
 };
 
+inline nlohmann::json to_json(const SmapsSample& sample, const double snapshot_time)
+{
+    return nlohmann::json{{"pss_kB", sample.pss_kB},
+                          {"uss_kB", sample.uss_kB},
+                          {"swap_kB", sample.swap_kB},
+                          {"age_seconds", std::max(0.0, snapshot_time - sample.sample_time)}};
+}
+
+inline void write_json(JsonWriter& writer, const SmapsSample& sample, const double snapshot_time)
+{
+    writer.begin_object();
+    writer.member("age_seconds", std::max(0.0, snapshot_time - sample.sample_time));
+    writer.member("pss_kB", sample.pss_kB);
+    writer.member("swap_kB", sample.swap_kB);
+    writer.member("uss_kB", sample.uss_kB);
+    writer.end_object();
+}
+
 inline nlohmann::json to_json(const ProcSnapshot& snapshot)
 {
     return nlohmann::json{{"pid", snapshot.pid},
@@ -65,7 +166,117 @@ inline nlohmann::json to_json(const ProcSnapshot& snapshot)
                           {"name", snapshot.name},
                           {"command", snapshot.command},
                           {"mem_usage_percent", snapshot.mem_usage_percent},
-                          {"cpu_usage_percent", snapshot.cpu_usage_percent}};
+                          {"cpu_usage_percent", snapshot.cpu_usage_percent},
+                          {"smaps", snapshot.smaps ? to_json(snapshot.smaps.value(), snapshot.snapshot_time) : nullptr},
+                          {"cgroup", snapshot.cgroup}};
+}
+
+inline void write_json(JsonWriter& writer, const ProcSnapshot& snapshot)
+{
+    writer.begin_object();
+    writer.member("cgroup", snapshot.cgroup);
+    writer.member("command", snapshot.command);
+    writer.member("cpu_usage_percent", snapshot.cpu_usage_percent);
+    writer.member("mem_usage_percent", snapshot.mem_usage_percent);
+    writer.member("name", snapshot.name);
+    writer.member("pid", snapshot.pid);
+    writer.member("ppid", snapshot.ppid);
+    writer.key("smaps");
+    if (snapshot.smaps)
+        write_json(writer, snapshot.smaps.value(), snapshot.snapshot_time);
+    else
+        writer.null();
+    writer.end_object();
+}
+
+/// @brief Data sourced from /proc/[pid]/task/[tid]/stat
+struct ThreadSnapshot
+{
+    double snapshot_time{0.0};
+    int32_t tid{0};
+    std::string name;
+    uint32_t utime{0u};
+    uint32_t stime{0u};
+    float cpu_usage_percent{0.0f}; // [0.0, 100.0]
+};
+
+inline nlohmann::json to_json(const ThreadSnapshot& snapshot)
+{
+    return nlohmann::json{{"tid", snapshot.tid},
+                          {"name", snapshot.name},
+                          {"cpu_usage_percent", snapshot.cpu_usage_percent},
+                          {"snapshot_time", snapshot.snapshot_time}};
+}
+
+/// @brief The threads of a process selected for thread monitoring.
+/// Processes with many threads are sampled a window at a time, so not every thread is read on every poll.
+struct ProcThreads
+{
+    int32_t pid{0};
+    uint32_t thread_count{0u};   // All threads of the process
+    uint32_t sampled_count{0u};  // Threads read during the latest poll
+    std::vector<ThreadSnapshot> threads;
+};
+
+inline nlohmann::json to_json(const ProcThreads& proc_threads)
+{
+    auto threads = nlohmann::json::array();
+    std::transform(proc_threads.threads.cbegin(), proc_threads.threads.cend(), std::back_inserter(threads),
+                   [](const ThreadSnapshot& thread) { return to_json(thread); });
+    return nlohmann::json{{"pid", proc_threads.pid},
+                          {"thread_count", proc_threads.thread_count},
+                          {"sampled_count", proc_threads.sampled_count},
+                          {"threads", threads}};
+}
+
+/// @brief Data sourced from /proc/[pid]/io
+struct ProcIoCounters
+{
+    uint64_t rchar{0u};
+    uint64_t wchar{0u};
+    uint64_t syscr{0u};
+    uint64_t syscw{0u};
+    uint64_t read_bytes{0u};
+    uint64_t write_bytes{0u};
+    uint64_t cancelled_write_bytes{0u};
+};
+
+inline nlohmann::json to_json(const ProcIoCounters& io)
+{
+    return nlohmann::json{{"rchar", io.rchar},
+                          {"wchar", io.wchar},
+                          {"syscr", io.syscr},
+                          {"syscw", io.syscw},
+                          {"read_bytes", io.read_bytes},
+                          {"write_bytes", io.write_bytes},
+                          {"cancelled_write_bytes", io.cancelled_write_bytes}};
+}
+
+/// @brief Extended metrics for a single process that are too expensive to collect on every poll.
+/// Data sourced from
+///        /proc/[pid]/status
+///                 ../io
+///                 ../fd/
+struct ProcDetails
+{
+    int32_t pid{0};
+    uint32_t threads{0u};
+    uint64_t voluntary_ctxt_switches{0u};
+    uint64_t nonvoluntary_ctxt_switches{0u};
+    std::optional<uint32_t> fd_count;  // Not readable without permission to inspect the process
+    std::optional<ProcIoCounters> io;  // As above
+    std::map<std::string, std::string> status;
+};
+
+inline nlohmann::json to_json(const ProcDetails& details)
+{
+    return nlohmann::json{{"pid", details.pid},
+                          {"threads", details.threads},
+                          {"voluntary_ctxt_switches", details.voluntary_ctxt_switches},
+                          {"nonvoluntary_ctxt_switches", details.nonvoluntary_ctxt_switches},
+                          {"fd_count", details.fd_count ? nlohmann::json(details.fd_count.value()) : nullptr},
+                          {"io", details.io ? to_json(details.io.value()) : nullptr},
+                          {"status", details.status}};
 }
 
 /// @brief Data sourced from /proc/stat
@@ -83,11 +294,49 @@ inline nlohmann::json to_json(const CpuSnapshot& snapshot)
     return nlohmann::json{{"id", snapshot.id}, {"usage_percent", snapshot.usage_percent}};
 }
 
+inline void write_json(JsonWriter& writer, const CpuSnapshot& snapshot)
+{
+    writer.begin_object();
+    writer.member("id", snapshot.id);
+    writer.member("usage_percent", snapshot.usage_percent);
+    writer.end_object();
+}
+
+/// @brief Data sourced from a cgroup v2 directory
+///        /sys/fs/cgroup/[path]/cpu.stat
+///                               ../memory.current
+///                               ../memory.stat
+struct CgroupSnapshot
+{
+    double snapshot_time{0.0};
+    std::string path; // Relative to the root of the hierarchy, e.g. "/system.slice/docker-1234.scope"
+    uint64_t usage_usec{0u};
+    uint64_t user_usec{0u};
+    uint64_t system_usec{0u};
+    float cpu_usage_percent{0.0f}; // [0.0, 100.0] of all CPUs
+    uint64_t mem_usage_bytes{0u};
+    float mem_usage_percent{0.0f}; // [0.0, 100.0]
+    uint64_t mem_anon_bytes{0u};
+    uint64_t mem_file_bytes{0u};
+    uint32_t proc_count{0u}; // Monitored processes in this cgroup (not including descendant cgroups)
+};
+
+inline nlohmann::json to_json(const CgroupSnapshot& snapshot)
+{
+    return nlohmann::json{{"path", snapshot.path},
+                          {"cpu_usage_percent", snapshot.cpu_usage_percent},
+                          {"mem_usage_bytes", snapshot.mem_usage_bytes},
+                          {"mem_usage_percent", snapshot.mem_usage_percent},
+                          {"mem_anon_bytes", snapshot.mem_anon_bytes},
+                          {"mem_file_bytes", snapshot.mem_file_bytes},
+                          {"proc_count", snapshot.proc_count}};
+}
+
 /// @brief Data sourced from /proc/meminfo
 struct MemSnapshot
 {
     uint32_t total_memory_kB{0u};
-    uint32_t free_memory_kB{0u};
+    uint32_t free_memory_kB{0u}; // MemAvailable, which unlike MemFree counts reclaimable caches
     float usage_percent{0.0f}; // [0.0, 100.0]
 };
 
@@ -98,4 +347,13 @@ inline nlohmann::json to_json(const MemSnapshot& snapshot)
                           {"usage_percent", snapshot.usage_percent}};
 }
 
+inline void write_json(JsonWriter& writer, const MemSnapshot& snapshot)
+{
+    writer.begin_object();
+    writer.member("free_memory_kB", snapshot.free_memory_kB);
+    writer.member("total_memory_kB", snapshot.total_memory_kB);
+    writer.member("usage_percent", snapshot.usage_percent);
+    writer.end_object();
+}
+
 }; // namespace data
\ No newline at end of file
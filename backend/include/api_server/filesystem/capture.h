@@ -0,0 +1,86 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <zlib.h>
+
+namespace filesystem
+{
+
+/// @brief The proc files read by one monitor poll
+struct CapturedPoll
+{
+    std::chrono::nanoseconds time{0}; // Since the first poll of the capture
+    std::vector<int32_t> pids;
+    std::unordered_map<std::string, std::optional<std::string>> files; // By path relative to the proc root, nullopt
+                                                                        // if the file didn't exist
+};
+
+/// @brief Writes the proc files read by monitor polls to a gzip compressed capture file.
+/// The file starts with the 8 bytes "PROCCAP1", followed by the records of each poll: a tag byte and its fields, with
+/// integers in little-endian order and strings prefixed by their uint32 length.
+///   'P' uint64 time_ns  Start of a poll
+///   'L' uint32 count, count * int32 pid  The processes listed
+///   'F' string path, uint8 exists, [string contents]  A file read
+///   'E'  End of the poll
+/// Each poll is flushed once ended, so a capture cut short (e.g. the server was killed) is only missing the last
+/// poll. Once a poll fails to be written (e.g. the disk is full), the writer stops recording, leaving the polls before
+/// it readable.
+class CaptureWriter
+{
+public:
+    /// @throw std::runtime_error if the file can't be created
+    explicit CaptureWriter(const std::string& path);
+    ~CaptureWriter();
+
+    CaptureWriter(const CaptureWriter&) = delete;
+    CaptureWriter& operator=(const CaptureWriter&) = delete;
+
+    void begin_poll(const std::chrono::nanoseconds time);
+    void pids(const std::vector<int32_t>& pids);
+    void file(const std::string_view path, const std::optional<std::string>& contents);
+    /// @throw std::runtime_error if the poll couldn't be written, after which the later polls aren't either
+    void end_poll();
+
+private:
+    void write_u8(const uint8_t value);
+    void write_u32(const uint32_t value);
+    void write_u64(const uint64_t value);
+    void write_string(const std::string_view value);
+
+    gzFile m_file;
+    std::string m_buffer; // The poll being written, compressed once it ends
+    bool m_failed{false}; // A poll couldn't be written, so recording stopped
+};
+
+/// @brief Reads the polls of a capture file written by a CaptureWriter, in order
+class CaptureReader
+{
+public:
+    /// @throw std::runtime_error if the file can't be opened or isn't a capture
+    explicit CaptureReader(const std::string& path);
+    ~CaptureReader();
+
+    CaptureReader(const CaptureReader&) = delete;
+    CaptureReader& operator=(const CaptureReader&) = delete;
+
+    /// @brief Returns the next poll, or nullopt at the end of the capture, including after a partly written poll
+    /// @throw std::runtime_error if the capture is corrupt
+    std::optional<CapturedPoll> next_poll();
+
+private:
+    /// @brief Reads exactly `size` bytes, returning false at the end of the file
+    bool read(void* data, const std::size_t size);
+    bool read_u32(uint32_t& value);
+    bool read_u64(uint64_t& value);
+    bool read_string(std::string& value);
+
+    gzFile m_file;
+};
+
+} // namespace filesystem
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "api_server/data/datastore.h"
+#include "api_server/data/types.h"
+#include "api_server/filesystem/types.h"
+#include "api_server/logger.h"
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace filesystem
+{
+
+/// @brief Reads container-level CPU and memory usage from the cgroup v2 unified hierarchy.
+/// The kernel already accounts usage per cgroup, which is both cheaper and more accurate than summing the
+/// processes in each one.
+class CgroupCollector
+{
+public:
+    /// @param cgroup_root Mount point of the cgroup filesystem. In hybrid mode the unified hierarchy is found in its
+    /// "unified" sub-directory.
+    CgroupCollector(Logger& logger, data::DataStore& datastore, const std::filesystem::path& cgroup_root = dir::cgroup,
+                    const std::filesystem::path& proc_root = dir::proc);
+
+    /// @brief Returns the cgroup of a process, reading /proc/[pid]/cgroup only the first time the process is seen
+    const std::string& proc_cgroup(const int32_t pid);
+
+    /// @brief Forgets the cgroups of processes that have exited
+    void retain_procs(const std::vector<int32_t>& pids);
+
+    /// @brief Reads every cgroup in the hierarchy into the datastore, calculating CPU usage since the last read
+    /// @param procs The latest process snapshots, with their cgroup set
+    void collect(const std::vector<data::ProcSnapshot>& procs, const double snapshot_time);
+
+private:
+    /// @brief Returns the root of the unified hierarchy, or nullopt if there is none
+    std::optional<std::filesystem::path> find_unified_root(const std::filesystem::path& cgroup_root) const;
+
+    /// @brief Reads the cpu.stat and memory files of a cgroup
+    data::CgroupSnapshot read_cgroup(const std::filesystem::path& dir, const std::string& path) const;
+
+    Logger& m_logger;
+    data::DataStore& m_datastore;
+    const std::filesystem::path m_proc_root;
+    const std::optional<std::filesystem::path> m_root;
+    const uint32_t m_cpu_count;
+    std::unordered_map<std::string, data::CgroupSnapshot> m_prev_snapshots;
+    std::unordered_map<int32_t, std::string> m_proc_cgroups;
+};
+
+} // namespace filesystem
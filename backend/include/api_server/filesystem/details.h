@@ -0,0 +1,60 @@
+#pragma once
+
+#include "api_server/data/types.h"
+#include "api_server/filesystem/types.h"
+#include "api_server/logger.h"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+namespace filesystem
+{
+
+/// @brief Collects extended process metrics on demand, for one process at a time.
+/// Results are cached for a short time, and concurrent requests for the same process are
+/// coalesced into a single collection.
+class ProcDetailsCollector
+{
+public:
+    static constexpr std::chrono::milliseconds CACHE_TTL{2000}; // How long collected details are served for
+
+    explicit ProcDetailsCollector(const Logger& logger, const std::filesystem::path& proc_root = dir::proc);
+
+    /// @brief Returns extended metrics for a process, collecting them if there is no fresh cached copy.
+    /// [Concurrent execution]
+    /// @return Details, or nullopt if the process does not exist
+    std::optional<data::ProcDetails> get(const int32_t pid);
+
+private:
+    using Result = std::shared_future<std::optional<data::ProcDetails>>;
+
+    struct CacheEntry
+    {
+        std::chrono::steady_clock::time_point collected_at;
+        Result result;
+    };
+
+    /// @brief Reads the extended metrics from /proc/[pid]/
+    std::optional<data::ProcDetails> collect(const int32_t pid) const;
+
+    /// @brief Reads /proc/[pid]/io, which is only readable with permission to inspect the process
+    std::optional<data::ProcIoCounters> read_proc_io(const std::filesystem::path& proc_dir) const;
+
+    /// @brief Counts the entries in /proc/[pid]/fd, which is only readable with permission to inspect the process
+    std::optional<uint32_t> count_proc_fds(const std::filesystem::path& proc_dir) const;
+
+    /// @brief Removes expired entries that are not being collected [Must hold m_cache_mutex]
+    void prune_cache(const std::chrono::steady_clock::time_point now);
+
+    const Logger& m_logger;
+    const std::filesystem::path m_proc_root;
+    std::mutex m_cache_mutex;
+    std::unordered_map<int32_t, CacheEntry> m_cache;
+};
+
+} // namespace filesystem
@@ -2,10 +2,16 @@
 
 #include "api_server/data/datastore.h"
 #include "api_server/data/types.h"
+#include "api_server/filesystem/cgroups.h"
+#include "api_server/filesystem/source.h"
+#include "api_server/filesystem/threads.h"
+#include "api_server/filesystem/types.h"
 #include "api_server/logger.h"
 
+#include <atomic>
 #include <chrono>
 #include <filesystem>
+#include <memory>
 #include <optional>
 #include <string>
 #include <vector>
@@ -13,6 +19,14 @@
 namespace filesystem
 {
 
+/// @brief Optional features of the Monitor
+struct MonitorConfig
+{
+    std::optional<float> thread_cpu_threshold_percent; // Also monitor threads of processes using this much CPU
+    std::filesystem::path proc_root{dir::proc};         // e.g. a copy of /proc, for benchmarks and tests
+    std::filesystem::path cgroup_root{dir::cgroup};
+};
+
 /// @brief Periodically reads the /proc filesystem to obtain the latest system and process information to put into the
 /// datastore
 class Monitor
@@ -22,15 +36,24 @@ class Monitor
     static constexpr uint8_t CLK_TCK{100}; // Hard-coded for now, but should be read from system
 
 public:
-    Monitor(Logger& logger, data::DataStore& datastore);
+    /// @param source Where to read proc files from, by default the live proc tree at the config's proc root
+    Monitor(Logger& logger, data::DataStore& datastore, const MonitorConfig& config = {},
+            std::unique_ptr<ProcSource> source = nullptr);
 
     /// @brief Starts the monitor loop (blocking)
     void start();
 
-private:
-    /// @brief Reads the latest process and resource information from the filesystem
-    void check_filesystem_changes();
+    /// @brief Makes start() return after the current poll. It also returns once a replayed capture has ended.
+    void stop();
 
+    /// @brief Reads the latest process and resource information from the filesystem, i.e. one poll
+    /// @return false if the source has no more polls, i.e. the end of a replayed capture
+    bool check_filesystem_changes();
+
+    /// @brief Returns PIDs for all the current processes found in the proc root
+    std::vector<int32_t> discover_current_procs();
+
+private:
     /// @brief Reads /proc/uptime
     void read_system_uptime();
 
@@ -44,29 +67,34 @@ private:
     void read_proc_files();
 
     /// @brief Reads /proc/[pid]/status for process information
-    void read_proc_status(const std::filesystem::path& proc_dir, data::ProcSnapshot& snapshot);
+    void read_proc_status(const std::string& proc_dir, data::ProcSnapshot& snapshot);
 
     /// @brief Reads /proc/[pid]/stat for process CPU infromation
-    void read_proc_stat(const std::filesystem::path& proc_dir, data::ProcSnapshot& snapshot);
+    void read_proc_stat(const std::string& proc_dir, data::ProcSnapshot& snapshot);
 
     /// @brief Reads /proc/[pid]/cmdline for the command that started a process
-    void read_proc_cmdline(const std::filesystem::path& proc_dir, data::ProcSnapshot& snapshot);
-
-    /// @brief For files in the /proc filesystem that contain data formatted as a series of `key: value`
-    /// lines - this function reads the file data into an in-memory map.
-    std::unordered_map<std::string, std::string> parse_dictionary_file(std::ifstream& input) const;
+    void read_proc_cmdline(const std::string& proc_dir, data::ProcSnapshot& snapshot);
 
-    /// @brief Returns PIDs for all the current processes found in /proc
-    std::vector<int32_t> discover_current_procs() const;
+    /// @brief Records a phase of the poll in its histogram and the flight recorder
+    void record_phase(metrics::Histogram& histogram, const char* name,
+                      const std::chrono::steady_clock::time_point start,
+                      const std::chrono::steady_clock::time_point end);
 
-    /// @brief Returns true if a sub-directory of /proc represents a process
-    bool is_proc_dir(const std::filesystem::directory_entry& entry) const;
+    /// @brief Records a read of a process's file in the flight recorder if it was slow, e.g. blocked on a process in
+    /// uninterruptible sleep. The file's path is only built if it is recorded.
+    void trace_slow_read(const std::string& proc_dir, const char* name, const int32_t pid,
+                         const std::chrono::steady_clock::time_point start,
+                         const std::chrono::steady_clock::time_point end);
 
     /// @brief Parse CPU stats from stat line, calculating CPU usage since last read
     std::optional<data::CpuSnapshot> parse_cpu_snapshot(const std::string_view& cpu_line);
 
     Logger& m_logger;
     data::DataStore& m_datastore;
+    std::unique_ptr<ProcSource> m_source;
+    ThreadCollector m_thread_collector;
+    CgroupCollector m_cgroup_collector;
+    std::atomic<bool> m_running{true};
 };
 
 } // namespace filesystem
\ No newline at end of file
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+
+namespace filesystem
+{
+
+/// @brief Given the string "123456 kB", returns 123456
+std::optional<uint32_t> parse_kb_value(const std::string& value_with_kb_units);
+
+/// @brief For files in the /proc filesystem that contain data formatted as a series of `key: value`
+/// lines - this function reads the file data into an in-memory map.
+std::unordered_map<std::string, std::string> parse_dictionary_file(std::istream& input);
+
+/// @brief For files that contain data formatted as a series of `key value` lines with integer values, such as the
+/// cgroup cpu.stat and memory.stat files - reads the file data into an in-memory map.
+std::unordered_map<std::string, uint64_t> parse_flat_keyed_file(std::istream& input);
+
+/// @brief Fields of interest from a /proc/[pid]/stat or /proc/[pid]/task/[tid]/stat line
+struct StatFields
+{
+    std::string comm; // Executable name, may contain spaces and parentheses
+    int32_t ppid{0};
+    uint32_t utime{0u};
+    uint32_t stime{0u};
+};
+
+/// @brief Parses a stat line, e.g. "1234 (some name) S 1 ..."
+std::optional<StatFields> parse_stat_line(const std::string& line);
+
+} // namespace filesystem
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "api_server/data/datastore.h"
+#include "api_server/data/types.h"
+#include "api_server/filesystem/types.h"
+#include "api_server/logger.h"
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <istream>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace filesystem
+{
+
+/// @brief Background worker that samples PSS/USS/swap from /proc/[pid]/smaps_rollup into the datastore.
+/// Reading smaps_rollup makes the kernel walk the page tables of the process, which is far too slow to do for every
+/// process on every poll. Instead the worker runs at low priority in short time slices under a per-second time
+/// budget, visiting processes with the largest RSS (weighted by how long ago they were last sampled) first.
+class SmapsCollector
+{
+public:
+    static constexpr std::chrono::milliseconds SLICE_INTERVAL{100};   // The delay between time slices
+    static constexpr std::chrono::milliseconds BUDGET_PER_SECOND{50}; // Time spent reading smaps per second
+    static constexpr std::chrono::milliseconds REPLAN_INTERVAL{1000}; // How often the visiting order is updated
+    static constexpr int NICENESS{19};                               // Scheduling priority of the worker thread
+
+    using Clock = std::chrono::steady_clock;
+    using VisitTimes = std::unordered_map<int32_t, Clock::time_point>;
+
+    SmapsCollector(Logger& logger, data::DataStore& datastore, const std::filesystem::path& proc_root = dir::proc);
+
+    /// @brief Starts the sampling loop (blocking)
+    void start();
+
+    /// @brief Makes start() return after the current time slice
+    void stop();
+
+    /// @brief Parses the contents of a smaps_rollup file
+    static std::optional<data::SmapsSample> parse_smaps_rollup(std::istream& input);
+
+    /// @brief Orders processes by priority for sampling: RSS weighted by the time since they were last visited
+    /// @param last_visited When processes were last visited, pruned to the given processes
+    /// @return Pids to visit, highest priority at the back. Kernel threads are left out
+    static std::vector<int32_t> plan(const std::vector<data::ProcSnapshot>& procs, VisitTimes& last_visited,
+                                     const Clock::time_point now);
+
+    /// @brief Returns how long a time slice may spend sampling, after repaying earlier overruns out of its budget
+    /// @param overrun Time spent beyond previous slices' budgets, reduced by what this slice repays
+    static Clock::duration slice_allowance(Clock::duration& overrun);
+
+private:
+    /// @brief Samples processes in priority order until the time slice's budget is spent
+    void run_slice();
+
+    /// @brief Reads /proc/[pid]/smaps_rollup, which is only readable with permission to inspect the process
+    std::optional<data::SmapsSample> read_smaps_rollup(const int32_t pid) const;
+
+    Logger& m_logger;
+    data::DataStore& m_datastore;
+    const std::filesystem::path m_proc_root;
+    std::vector<int32_t> m_queue; // Planned visiting order, highest priority at the back
+    Clock::time_point m_planned_at{};
+    Clock::duration m_overrun{0}; // Time spent beyond previous slices' budgets, repaid by later slices
+    VisitTimes m_last_visited;
+    std::atomic<bool> m_running{true};
+};
+
+} // namespace filesystem
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "api_server/filesystem/capture.h"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace filesystem
+{
+
+/// @brief Where the Monitor reads its proc files from: the live filesystem, or a capture of it.
+/// Paths are relative to the proc root, e.g. "meminfo" or "42/status".
+class ProcSource
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    virtual ~ProcSource() = default;
+
+    /// @brief Returns how long to wait before the next poll, given the live polling interval
+    virtual Clock::duration poll_interval(const Clock::duration live_interval) const
+    {
+        return live_interval;
+    }
+
+    /// @brief Starts a poll, returning false if there are no more, i.e. the end of a replayed capture
+    virtual bool begin_poll()
+    {
+        return true;
+    }
+
+    /// @brief Ends a poll
+    /// @throw std::runtime_error if the poll couldn't be recorded, which doesn't affect what was read
+    virtual void end_poll()
+    {
+    }
+
+    /// @brief Returns true if the source is the live proc tree, so that its other files (threads, cgroups) can be
+    /// read directly
+    virtual bool is_live() const
+    {
+        return true;
+    }
+
+    /// @brief Returns the PIDs of the current processes
+    virtual std::vector<int32_t> list_pids() = 0;
+
+    /// @brief Returns a file's contents, or nullopt if it doesn't exist, e.g. its process has exited
+    virtual std::optional<std::string> read_file(const std::string& path) = 0;
+};
+
+/// @brief Reads a proc tree on the filesystem, /proc by default
+class LiveProcSource : public ProcSource
+{
+public:
+    explicit LiveProcSource(const std::filesystem::path& proc_root);
+
+    std::vector<int32_t> list_pids() override;
+
+    std::optional<std::string> read_file(const std::string& path) override;
+
+private:
+    /// @brief Returns true if a sub-directory of the proc root represents a process
+    bool is_proc_dir(const std::filesystem::directory_entry& entry) const;
+
+    const std::filesystem::path m_proc_root;
+};
+
+/// @brief Passes reads through to another source, capturing everything read by each poll to a file
+class RecordingProcSource : public ProcSource
+{
+public:
+    /// @throw std::runtime_error if the capture file can't be created
+    RecordingProcSource(std::unique_ptr<ProcSource> source, const std::string& capture_path);
+
+    bool begin_poll() override;
+
+    void end_poll() override;
+
+    bool is_live() const override
+    {
+        return m_source->is_live();
+    }
+
+    std::vector<int32_t> list_pids() override;
+
+    std::optional<std::string> read_file(const std::string& path) override;
+
+private:
+    std::unique_ptr<ProcSource> m_source;
+    CaptureWriter m_writer;
+    std::optional<Clock::time_point> m_start;
+};
+
+/// @brief Replays the polls of a capture file, at the pace they were recorded or faster. Files that weren't read by
+/// the recorded poll don't exist.
+class ReplayProcSource : public ProcSource
+{
+public:
+    /// @param speed How many times faster than recorded to replay, or 0 to replay each poll as soon as the previous
+    /// one has finished
+    /// @throw std::runtime_error if the capture file can't be read
+    ReplayProcSource(const std::string& capture_path, const double speed);
+
+    Clock::duration poll_interval(const Clock::duration live_interval) const override;
+
+    bool begin_poll() override;
+
+    bool is_live() const override
+    {
+        return false;
+    }
+
+    std::vector<int32_t> list_pids() override;
+
+    std::optional<std::string> read_file(const std::string& path) override;
+
+private:
+    CaptureReader m_reader;
+    const double m_speed;
+    std::optional<CapturedPoll> m_poll; // Being replayed
+    std::optional<CapturedPoll> m_next; // Read ahead, for the time until it
+};
+
+} // namespace filesystem
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "api_server/data/datastore.h"
+#include "api_server/data/types.h"
+#include "api_server/filesystem/types.h"
+#include "api_server/logger.h"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace filesystem
+{
+
+/// @brief Opt-in monitoring of individual threads from /proc/[pid]/task/[tid]/stat.
+/// Threads are monitored for processes whose threads were requested through the datastore, and optionally for all
+/// processes above a CPU usage threshold. The number of thread stat files read per poll is bounded: processes with
+/// more threads than their share of the budget are sampled a rotating window at a time.
+class ThreadCollector
+{
+public:
+    static constexpr uint32_t MAX_THREADS_PER_PROC{256};   // Thread stat files read per process per poll
+    static constexpr uint32_t MAX_THREADS_PER_POLL{2048};  // Thread stat files read across all processes per poll
+    static constexpr std::chrono::seconds REQUEST_TTL{30}; // How long threads are monitored after being requested
+
+    ThreadCollector(Logger& logger, data::DataStore& datastore, const std::optional<float> cpu_threshold_percent,
+                    const uint32_t clk_tck, const std::filesystem::path& proc_root = dir::proc);
+
+    /// @brief Samples the threads of the selected processes into the datastore
+    /// @param procs The latest process snapshots
+    void collect(const std::vector<data::ProcSnapshot>& procs, const double snapshot_time);
+
+private:
+    /// @brief Threads of a process carried over between polls
+    struct ProcState
+    {
+        int32_t cursor{0}; // Last thread read, the next window starts after it
+        std::unordered_map<int32_t, data::ThreadSnapshot> threads;
+    };
+
+    /// @brief Returns the PIDs to monitor, in priority order
+    std::vector<int32_t> select_procs(const std::vector<data::ProcSnapshot>& procs);
+
+    /// @brief Reads up to `budget` thread stat files of a process
+    std::optional<data::ProcThreads> collect_proc(const int32_t pid, ProcState& state, const uint32_t budget,
+                                                  const double snapshot_time) const;
+
+    /// @brief Returns the thread IDs of a process in ascending order
+    std::vector<int32_t> list_threads(const std::filesystem::path& task_dir) const;
+
+    Logger& m_logger;
+    data::DataStore& m_datastore;
+    const std::optional<float> m_cpu_threshold_percent;
+    const uint32_t m_clk_tck;
+    const std::filesystem::path m_proc_root;
+    std::unordered_map<int32_t, ProcState> m_procs;
+};
+
+} // namespace filesystem
@@ -8,13 +8,15 @@ namespace filesystem
 namespace dir
 {
 static const std::string proc{"/proc"};
-}
+static const std::string cgroup{"/sys/fs/cgroup"};
+} // namespace dir
 
+/// @brief System-wide files, relative to the proc root
 namespace file
 {
-static const std::string uptime{"/proc/uptime"};
-static const std::string stat{"/proc/stat"};
-static const std::string meminfo{"/proc/meminfo"};
+static const std::string uptime{"uptime"};
+static const std::string stat{"stat"};
+static const std::string meminfo{"meminfo"};
 } // namespace file
 
 } // namespace filesystem
\ No newline at end of file
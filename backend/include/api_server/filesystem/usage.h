@@ -0,0 +1,25 @@
+#pragma once
+
+#include <boost/algorithm/clamp.hpp>
+#include <cstdint>
+
+namespace filesystem
+{
+
+/// @brief Calculates the percentage of a CPU used by a process or thread between two samples of its scheduled time
+/// @param prev_time_s, time_s System uptime when each sample was taken
+/// @param prev_ticks, ticks Scheduled time (utime + stime) in clock ticks at each sample
+inline float cpu_usage_percent(const double prev_time_s, const uint64_t prev_ticks, const double time_s,
+                               const uint64_t ticks, const uint32_t clk_tck)
+{
+    const double uptime_delta_s = time_s - prev_time_s;
+    if (uptime_delta_s <= 0.0)
+        return 0.0f;
+    const double prev_scheduled_time_s = static_cast<double>(prev_ticks) / clk_tck;
+    const double latest_scheduled_time_s = static_cast<double>(ticks) / clk_tck;
+    const double scheduled_time_delta_s = latest_scheduled_time_s - prev_scheduled_time_s;
+    const float usage_percent = (100.0 * scheduled_time_delta_s) / uptime_delta_s;
+    return boost::algorithm::clamp(usage_percent, 0.0f, 100.0f);
+}
+
+} // namespace filesystem
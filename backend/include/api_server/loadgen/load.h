@@ -0,0 +1,68 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace loadgen
+{
+
+using Clock = std::chrono::steady_clock;
+
+/// @brief A target requested with a share of the requests proportional to its weight
+struct Target
+{
+    std::string path;
+    uint32_t weight{1u};
+};
+
+/// @brief Parses a `[<weight>:]<path>` argument, throwing std::runtime_error if the weight is 0 or too large
+Target parse_target(const std::string& arg);
+
+/// @brief Latency percentiles of a set of measurements
+struct Percentiles
+{
+    double p50_ms{0.0};
+    double p90_ms{0.0};
+    double p99_ms{0.0};
+    double p999_ms{0.0};
+    double max_ms{0.0};
+    double mean_ms{0.0};
+};
+
+/// @brief Returns the percentiles of nanosecond measurements, each the smallest measurement that at least that share
+/// of them is no greater than. Sorts the measurements.
+Percentiles percentiles(std::vector<uint64_t>& values_ns);
+
+/// @brief When each request of one connection is due to be sent.
+/// At a fixed rate, the connections' schedules are staggered over the interval, and requests stay on the schedule
+/// however late the previous response was. Latency measured from when a request was due then counts the time it spent
+/// waiting to be sent, correcting for coordinated omission. Closed-loop, each request is due once the connection is
+/// free.
+class Schedule
+{
+public:
+    static constexpr std::chrono::milliseconds RETRY_DELAY{10}; // Closed-loop, between a failure and the next request
+
+    /// @param rate Requests per second across all connections, or 0 for closed-loop
+    /// @param index Of the connection, from 0 to `connections` - 1
+    Schedule(const double rate, const std::size_t connections, const std::size_t index, const Clock::time_point start);
+
+    /// @brief Returns when the current request is due, for a connection that is free to send it from `now`
+    Clock::time_point due(const Clock::time_point now);
+
+    /// @brief Moves on to the next request after a response
+    void next();
+
+    /// @brief Moves on to the next request after a failure. Closed-loop, it is due after RETRY_DELAY, so that a server
+    /// that is down isn't hammered.
+    void next_after_failure(const Clock::time_point now);
+
+private:
+    const bool m_open_loop;
+    Clock::duration m_interval{0}; // Between requests of the connection
+    Clock::time_point m_due;
+};
+
+} // namespace loadgen
@@ -1,8 +1,13 @@
 #pragma once
 
+#include <atomic>
 #include <cstdint>
+#include <fmt/format.h>
 #include <iostream>
+#include <iterator>
 #include <string>
+#include <string_view>
+#include <utility>
 
 enum class LogLevel : std::uint8_t
 {
@@ -12,58 +17,85 @@ enum class LogLevel : std::uint8_t
     Error
 };
 
-/// @brief Logger interface
+/// @brief Logger interface. Messages are fmt format strings with their arguments, which are only formatted if the
+/// message's level is enabled.
 class Logger
 {
 public:
+    explicit Logger(const LogLevel level) : m_level{level}
+    {
+    }
     virtual ~Logger() = default;
 
-    virtual void debug(const std::string& message) const = 0;
-    virtual void info(const std::string& message) const = 0;
-    virtual void warning(const std::string& message) const = 0;
-    virtual void error(const std::string& message) const = 0;
-};
+    void set_level(const LogLevel level)
+    {
+        m_level.store(level, std::memory_order_relaxed);
+    }
 
-class StdStreamLogger : public Logger
-{
-public:
-    explicit StdStreamLogger(const LogLevel level) : m_level{level}
+    /// @brief Returns true if messages of the level are logged, for skipping work only done for logging
+    bool enabled(const LogLevel level) const
     {
+        return static_cast<std::uint8_t>(level) >= static_cast<std::uint8_t>(m_level.load(std::memory_order_relaxed));
     }
 
-    void set_level(const LogLevel level)
+    template <typename... Args> void debug(fmt::format_string<Args...> format, Args&&... args) const
     {
-        m_level = level;
+        log(LogLevel::Debug, format, std::forward<Args>(args)...);
     }
 
-    void debug(const std::string& message) const override
+    template <typename... Args> void info(fmt::format_string<Args...> format, Args&&... args) const
     {
-        if (static_cast<std::uint8_t>(LogLevel::Debug) < static_cast<std::uint8_t>(m_level))
-            return;
-        std::cout << message << "\n";
+        log(LogLevel::Info, format, std::forward<Args>(args)...);
     }
 
-    void info(const std::string& message) const override
+    template <typename... Args> void warning(fmt::format_string<Args...> format, Args&&... args) const
     {
-        if (static_cast<std::uint8_t>(LogLevel::Info) < static_cast<std::uint8_t>(m_level))
-            return;
-        std::cout << message << "\n";
+        log(LogLevel::Warning, format, std::forward<Args>(args)...);
     }
 
-    void warning(const std::string& message) const override
+    template <typename... Args> void error(fmt::format_string<Args...> format, Args&&... args) const
     {
-        if (static_cast<std::uint8_t>(LogLevel::Warning) < static_cast<std::uint8_t>(m_level))
-            return;
-        std::cout << message << "\n";
+        log(LogLevel::Error, format, std::forward<Args>(args)...);
     }
 
-    void error(const std::string& message) const override
+protected:
+    /// @brief Writes a formatted message of an enabled level. The message is only valid for the duration of the call.
+    /// [Concurrent execution]
+    virtual void write(const LogLevel level, const std::string_view message) const = 0;
+
+private:
+    template <typename... Args> void log(const LogLevel level, fmt::format_string<Args...> format, Args&&... args) const
     {
-        if (static_cast<std::uint8_t>(LogLevel::Error) < static_cast<std::uint8_t>(m_level))
+        if (!enabled(level))
             return;
-        std::cerr << message << "\n";
+        auto& buffer = thread_buffer();
+        buffer.clear();
+        fmt::vformat_to(std::back_inserter(buffer), format, fmt::make_format_args(args...));
+        write(level, std::string_view{buffer.data(), buffer.size()});
     }
 
-private:
-    LogLevel m_level;
+    /// @brief Messages are formatted into a buffer per thread, so that logging doesn't allocate once it has grown
+    static fmt::memory_buffer& thread_buffer()
+    {
+        thread_local fmt::memory_buffer buffer;
+        return buffer;
+    }
+
+    std::atomic<LogLevel> m_level;
+};
+
+/// @brief Writes messages to stdout, or stderr for errors, on the calling thread
+class StdStreamLogger : public Logger
+{
+public:
+    explicit StdStreamLogger(const LogLevel level) : Logger{level}
+    {
+    }
+
+protected:
+    void write(const LogLevel level, const std::string_view message) const override
+    {
+        auto& stream = level == LogLevel::Error ? std::cerr : std::cout;
+        stream << message << "\n";
+    }
 };
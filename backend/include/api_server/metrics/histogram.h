@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+namespace metrics
+{
+
+/// @brief Counts of a Histogram's values at one point in time
+struct HistogramSnapshot
+{
+    /// @brief Values below this are counted exactly, and above it in buckets 1/SUB_BUCKETS of their magnitude wide
+    static constexpr std::size_t SUB_BUCKETS{8u};
+    /// @brief Values are clamped to below 2^MAX_BITS nanoseconds, about 68 seconds
+    static constexpr std::size_t MAX_BITS{36u};
+    static constexpr std::size_t BUCKETS{(MAX_BITS - 2u) * SUB_BUCKETS};
+
+    std::array<uint64_t, BUCKETS> counts{};
+    uint64_t count{0u}; // Total of the counts
+    uint64_t sum{0u};   // Of the values, before they were clamped
+
+    /// @brief Returns the bucket a value is counted in
+    static std::size_t bucket(uint64_t value);
+
+    /// @brief Returns the smallest value counted in a bucket
+    static uint64_t bucket_lower_bound(const std::size_t bucket);
+
+    /// @brief Returns the largest value counted in a bucket
+    static uint64_t bucket_upper_bound(const std::size_t bucket);
+
+    /// @brief Returns the number of values no greater than `value`. Exact if `value` is a bucket's upper bound,
+    /// otherwise the values in the bucket containing `value` are only counted if they all are.
+    uint64_t count_at_most(const uint64_t value) const;
+
+    /// @brief Returns the upper bound of the bucket containing the quantile, e.g. 0.99 for the 99th percentile
+    uint64_t value_at_quantile(const double quantile) const;
+};
+
+/// @brief Log-linear histogram of durations in nanoseconds (in the style of HdrHistogram), accurate to within 1/8
+/// of each value. Recording is lock-free: each thread counts into one of a fixed number of shards, so threads rarely
+/// share cache lines, and the shards are only added together when a snapshot is taken.
+class Histogram
+{
+public:
+    Histogram();
+
+    /// @brief Counts a value [Concurrent execution]
+    void record(const uint64_t value);
+
+    /// @brief Counts a duration in nanoseconds [Concurrent execution]
+    template <typename Rep, typename Period> void record(const std::chrono::duration<Rep, Period> duration)
+    {
+        const auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+        record(nanoseconds > 0 ? static_cast<uint64_t>(nanoseconds) : 0u);
+    }
+
+    /// @brief Returns the values counted so far [Concurrent execution]
+    HistogramSnapshot snapshot() const;
+
+private:
+    /// @brief Threads beyond this many share shards
+    static constexpr std::size_t SHARDS{16u};
+
+    struct alignas(64) Shard
+    {
+        std::array<std::atomic<uint64_t>, HistogramSnapshot::BUCKETS> counts{};
+        std::atomic<uint64_t> sum{0u};
+    };
+
+    std::unique_ptr<Shard[]> m_shards;
+};
+
+} // namespace metrics
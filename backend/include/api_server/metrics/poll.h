@@ -0,0 +1,26 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "histogram.h"
+
+namespace metrics
+{
+
+/// @brief Instrumentation of the Monitor's polls, in nanoseconds per poll for each phase
+struct PollMetrics
+{
+    Histogram system;     // Reading /proc/uptime, /proc/stat and /proc/meminfo
+    Histogram discovery;  // Listing the process directories of /proc
+    Histogram status;     // Reading /proc/[pid]/status, for every process
+    Histogram stat;       // Reading /proc/[pid]/stat, for every process
+    Histogram cmdline;    // Reading /proc/[pid]/cmdline, for every process
+    Histogram store;      // Storing the processes in the datastore, which also indexes them
+    Histogram collectors; // Collecting threads and cgroups of the processes
+    Histogram publish;    // Publishing the generation's snapshot
+    Histogram total;
+    std::atomic<uint64_t> processes{0u}; // Scanned by the last poll
+};
+
+} // namespace metrics
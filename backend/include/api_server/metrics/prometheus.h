@@ -0,0 +1,54 @@
+#pragma once
+
+#include <array>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "histogram.h"
+
+namespace metrics
+{
+
+/// @brief Media type of the Prometheus text exposition format
+constexpr std::string_view PROMETHEUS_MEDIA_TYPE{"text/plain; version=0.0.4; charset=utf-8"};
+
+/// @brief Label names and values of a sample
+using Labels = std::initializer_list<std::pair<std::string_view, std::string_view>>;
+
+/// @brief Writes metrics in the Prometheus text exposition format
+class PrometheusWriter
+{
+public:
+    /// @brief Upper bounds in seconds of the buckets that duration histograms are exposed with
+    static constexpr std::array<double, 16> DURATION_BUCKETS{0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005,
+                                                             0.01,   0.025,   0.05,   0.1,   0.25,   0.5,
+                                                             1.0,    2.5,     5.0,    10.0};
+
+    explicit PrometheusWriter(std::string& out) : m_out{out}
+    {
+    }
+
+    /// @brief Starts a metric family, which all of its samples must follow
+    /// @param type "counter", "gauge" or "histogram"
+    void family(const std::string_view name, const std::string_view type, const std::string_view help);
+
+    void sample(const std::string_view name, const Labels labels, const double value);
+
+    /// @brief Writes the bucket, sum and count samples of a histogram of durations in nanoseconds, converted to
+    /// seconds. Each bucket counts the values whose histogram bucket lies entirely within it, so is accurate to the
+    /// histogram's resolution.
+    void duration_histogram(const std::string_view name, const Labels labels, const HistogramSnapshot& snapshot);
+
+private:
+    /// @brief Writes the labels in braces, with an extra "le" label for histogram buckets if given
+    void write_labels(const Labels labels, const std::string_view le = {});
+
+    /// @brief Writes a label value, escaping backslashes, quotes and newlines
+    void write_escaped(const std::string_view value);
+
+    std::string& m_out;
+};
+
+} // namespace metrics
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace metrics
+{
+
+/// @brief A timed section of work, e.g. a phase of a monitor poll
+struct TraceSpan
+{
+    using Clock = std::chrono::steady_clock;
+
+    const char* category{""}; // Static strings, so that recording a span doesn't allocate
+    const char* name{""};
+    Clock::time_point start{};
+    Clock::duration duration{};
+    uint32_t thread_id{0u};
+    uint64_t generation{0u};          // Monitor poll the span was recorded during
+    int32_t pid{-1};                  // Process whose file was read, if any
+    std::array<char, 64> detail{'\0'}; // e.g. the path of a slow read, truncated if longer
+};
+
+/// @brief Always-on record of the most recent spans, for finding out after the fact why a poll was slow.
+/// Spans are kept in a fixed size ring, overwriting the oldest, so recording never allocates. Phases of every poll
+/// are recorded, whereas individual operations (file reads, lock waits) are only recorded if they took longer than
+/// the slow threshold.
+class FlightRecorder
+{
+public:
+    static constexpr std::size_t DEFAULT_CAPACITY{4096u};
+    static constexpr std::chrono::milliseconds DEFAULT_SLOW_THRESHOLD{10};
+
+    explicit FlightRecorder(const std::size_t capacity = DEFAULT_CAPACITY,
+                            const TraceSpan::Clock::duration slow_threshold = DEFAULT_SLOW_THRESHOLD);
+
+    void set_slow_threshold(const TraceSpan::Clock::duration threshold)
+    {
+        m_slow_threshold.store(threshold.count(), std::memory_order_relaxed);
+    }
+
+    /// @brief Returns true if an operation took long enough to be recorded [Concurrent execution]
+    bool is_slow(const TraceSpan::Clock::duration duration) const
+    {
+        return duration.count() >= m_slow_threshold.load(std::memory_order_relaxed);
+    }
+
+    /// @brief Records a span on the calling thread [Concurrent execution]
+    void record(const char* category, const char* name, const TraceSpan::Clock::time_point start,
+                const TraceSpan::Clock::time_point end, const uint64_t generation, const int32_t pid = -1,
+                const std::string_view detail = {});
+
+    /// @brief Returns the recorded spans, oldest first [Concurrent execution]
+    std::vector<TraceSpan> spans() const;
+
+    /// @brief Writes the recorded spans as a Chrome trace_event JSON object, as viewed by Perfetto or
+    /// chrome://tracing [Concurrent execution]
+    void write_chrome_trace(std::string& out) const;
+
+private:
+    mutable std::mutex m_mutex;
+    std::vector<TraceSpan> m_spans;
+    std::size_t m_next{0u};    // Index the next span is written to
+    uint64_t m_recorded{0u};   // Spans recorded in total, including those overwritten
+    std::atomic<TraceSpan::Clock::rep> m_slow_threshold;
+};
+
+} // namespace metrics
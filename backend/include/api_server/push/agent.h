@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atomic>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <string>
+
+#include "api_server/data/datastore.h"
+#include "api_server/logger.h"
+#include "api_server/push/protocol.h"
+
+namespace push
+{
+
+/// @brief Where and how a PushAgent sends its generations
+struct PushConfig
+{
+    std::string host;
+    std::string port;
+    std::string node;                              // Sent in the Hello frame, the hostname if empty
+    std::size_t queue_capacity{4u};                // Generations waiting to be sent, the oldest dropped beyond it
+    std::size_t full_interval{30u};                // Generations sent between full frames, the others being deltas
+    std::chrono::milliseconds min_backoff{100};    // Before the first reconnection attempt
+    std::chrono::milliseconds max_backoff{30000};  // Doubled from min_backoff after each failed attempt, up to this
+    std::chrono::milliseconds timeout{5000};       // For connecting and for each frame to be sent
+};
+
+/// @brief Counters of a PushAgent since it was created
+struct PushStats
+{
+    uint64_t frames_sent{0u};         // Full and delta frames
+    uint64_t full_frames{0u};
+    uint64_t bytes_sent{0u};
+    uint64_t dropped_generations{0u}; // Published but never sent, because newer ones replaced them in the queue
+    uint64_t connections{0u};         // Successful connections to the collector
+};
+
+/// @brief Pushes each generation published by the datastore to an upstream collector, over one persistent TCP
+/// connection in the binary protocol of push/protocol.h.
+/// Generations are queued by the monitor's thread and sent by the agent's own, so a slow or unreachable collector
+/// never delays a poll. While the queue is full the oldest generation is dropped, as a delta is always computed
+/// against the last generation actually sent. On every (re)connection the agent sends a Hello frame and the latest
+/// generation in full, and the connection is retried with exponential backoff and jitter after it fails.
+class PushAgent
+{
+public:
+    /// @brief The agent must outlive the datastore's publishing
+    PushAgent(const Logger& logger, data::DataStore& datastore, PushConfig config);
+
+    /// @brief Connects and sends generations as they are published until stop() is called (blocking)
+    void start();
+
+    /// @brief Makes start() return, abandoning the frame being sent if any. Can be called from any thread.
+    void stop();
+
+    /// @brief [Concurrent execution]
+    PushStats stats() const;
+
+private:
+    using tcp = boost::asio::ip::tcp;
+
+    /// @brief Queues the latest generation to be sent. Called by the monitor's thread.
+    void enqueue();
+
+    void resolve();
+    void connect();
+    void on_connected();
+
+    /// @brief Sends the oldest queued generation, unless a frame is already being sent
+    void send_next();
+    void write(std::string frame, const FrameType type);
+
+    /// @brief Waits for the collector to close the connection, which it otherwise never writes to
+    void watch_for_close();
+
+    /// @brief Closes the connection and schedules the next attempt
+    void on_error(const boost::system::error_code& error, const char* step);
+
+    /// @brief Returns true if a handler is for the current connection attempt rather than a failed earlier one
+    bool current(const uint64_t attempt) const
+    {
+        return attempt == m_attempt;
+    }
+
+    const Logger& m_logger;
+    data::DataStore& m_datastore;
+    const PushConfig m_config;
+
+    // Only used by the thread in start(), so need no locking
+    boost::asio::io_context m_context;
+    tcp::resolver m_resolver;
+    tcp::socket m_socket;
+    boost::asio::steady_timer m_deadline; // Of the connection or frame in progress
+    boost::asio::steady_timer m_retry_timer;
+    std::optional<tcp::resolver::results_type> m_endpoints;
+    uint64_t m_attempt{0u};
+    bool m_connected{false};
+    bool m_writing{false};
+    bool m_failed{false}; // The last attempt failed, so further failures are only logged at debug level
+    std::chrono::milliseconds m_backoff;
+    std::mt19937 m_random{std::random_device{}()};
+    FrameEncoder m_encoder;
+    std::size_t m_since_full{0u}; // Generations sent since the last full frame
+    std::string m_frame;          // Being sent
+    char m_read_byte{0};
+
+    std::mutex m_queue_mutex;
+    std::deque<std::shared_ptr<const data::Snapshot>> m_queue;
+
+    std::atomic<uint64_t> m_frames_sent{0u};
+    std::atomic<uint64_t> m_full_frames{0u};
+    std::atomic<uint64_t> m_bytes_sent{0u};
+    std::atomic<uint64_t> m_dropped_generations{0u};
+    std::atomic<uint64_t> m_connections{0u};
+};
+
+} // namespace push
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "api_server/data/snapshot.h"
+
+namespace push
+{
+
+/// @brief Binary protocol of a push-mode agent's connection to a collector.
+/// The agent sends a stream of frames, each a uint32 size of the rest of the frame, a type byte and its payload. All
+/// integers are little-endian, and strings are a uint32 length followed by UTF-8 bytes.
+///
+///   Hello (once, first)
+///     char[4]  magic "TMPS", uint16 version, string node
+///   Full / Delta (one per generation sent)
+///     uint64   generation
+///     uint64   base_generation           Delta only, the generation it is relative to
+///     uint32   count, count * (uint32 id, string)   Strings interned by this frame
+///     float64  uptime_seconds
+///     uint32   total_memory_kB, uint32 free_memory_kB, float32 mem_usage_percent
+///     uint16   count, count * (uint32 id_string, float32 usage_percent)   CPUs
+///     uint32   count, count * int32 pid   Delta only, processes removed since the base
+///     uint32   count, count * row         Full: every process. Delta: processes added or changed since the base.
+///   Row
+///     int32    pid, int32 ppid
+///     uint32   name_string, uint32 command_string, uint32 cgroup_string
+///     float32  cpu_usage_percent, float32 mem_usage_percent
+///     uint32   mem_usage_kB, uint32 utime, uint32 stime
+///     uint8    flags                     Bit 0: followed by smaps
+///     [uint32  pss_kB, uint32 uss_kB, uint32 swap_kB, float64 sample_time]
+///
+/// Strings (names, commands, cgroups and CPU ids) are sent once per connection and referred to by id afterwards. Ids
+/// count up from 0 in the order strings are interned. A Full frame starts a new table, so that the strings of exited
+/// processes are eventually forgotten, and a receiver can start from any Full frame.
+enum class FrameType : uint8_t
+{
+    Hello = 1,
+    Full = 2,
+    Delta = 3,
+};
+
+constexpr std::string_view MAGIC{"TMPS"};
+constexpr uint16_t VERSION{1u};
+
+/// @brief Size of the frame size prefix
+constexpr std::size_t FRAME_HEADER_SIZE{4u};
+
+/// @brief Frames larger than this are rejected as malformed
+constexpr uint32_t MAX_FRAME_SIZE{256u * 1024u * 1024u};
+
+/// @brief Encodes the frames of one connection, remembering what the receiver already has
+class FrameEncoder
+{
+public:
+    static std::string hello(const std::string& node);
+
+    /// @brief Encodes a generation, in full or as a delta against the last one encoded. A delta is only possible once
+    /// a generation has been encoded.
+    std::string encode(const std::shared_ptr<const data::Snapshot>& snapshot, const bool full);
+
+    /// @brief Returns true if the next generation can be encoded as a delta
+    bool has_base() const
+    {
+        return m_base != nullptr;
+    }
+
+private:
+    /// @brief Returns the string's id, interning it in the frame being encoded if it is new
+    uint32_t intern(const std::string& value);
+
+    std::unordered_map<std::string, uint32_t> m_strings;
+    std::string m_definitions; // Strings interned by the frame being encoded
+    uint32_t m_definition_count{0u};
+    std::shared_ptr<const data::Snapshot> m_base; // The last generation encoded
+};
+
+/// @brief Reconstructs the generations of one connection from its frames
+class FrameDecoder
+{
+public:
+    /// @brief Applies a frame, without its size prefix
+    /// @return The generation it completes, or nullopt for a Hello frame
+    /// @throw std::runtime_error if the frame is malformed, of an unsupported version, not preceded by a Hello frame,
+    ///        or a delta that doesn't apply
+    std::optional<data::Snapshot> apply(const std::string_view frame);
+
+    /// @brief Returns the node named by the Hello frame
+    const std::string& node() const
+    {
+        return m_node;
+    }
+
+    /// @brief Returns the type of the last frame applied
+    FrameType last_type() const
+    {
+        return m_last_type;
+    }
+
+private:
+    const std::string& string(const uint32_t id) const;
+
+    bool m_greeted{false}; // Whether the Hello frame was applied
+    std::string m_node;
+    FrameType m_last_type{FrameType::Hello};
+    std::vector<std::string> m_strings; // By id
+    std::optional<uint64_t> m_generation;
+    std::map<int32_t, data::ProcSnapshot> m_procs; // Of the last generation, by PID
+};
+
+} // namespace push
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "api_server/data/snapshot.h"
+#include "api_server/logger.h"
+#include "api_server/push/protocol.h"
+
+namespace push
+{
+
+/// @brief A minimal collector of push-mode agents, reconstructing each agent's generations from its frames. The
+/// reference for the protocol's receiving side, used by the tests and the push_receiver tool.
+/// Connections are read on one thread. A connection sending a malformed frame is closed, as its later deltas can no
+/// longer be applied, and so is one that sends nothing for the read timeout, e.g. a peer that stalls mid-frame. Frames
+/// are buffered as their bytes arrive, so a peer can't make the receiver allocate more than it actually sends.
+class PushReceiver
+{
+public:
+    /// @brief Agents send a frame per generation, so a connection quiet for this long is taken to be dead
+    static constexpr std::chrono::milliseconds DEFAULT_READ_TIMEOUT{60000};
+
+    /// @brief Most bytes of a frame read at once, and so buffered ahead of what the peer has sent
+    static constexpr std::size_t FRAME_READ_SIZE{64u * 1024u};
+
+    /// @brief Called with each generation received, the node being named by its connection's Hello frame
+    using Handler = std::function<void(const std::string& node, const data::Snapshot& snapshot, FrameType type,
+                                       std::size_t frame_size)>;
+
+    PushReceiver(const Logger& logger, const std::string& ip_address, const uint16_t port, Handler handler,
+                 const std::chrono::milliseconds read_timeout = DEFAULT_READ_TIMEOUT);
+
+    /// @brief Accepts and reads connections until stop() is called (blocking)
+    void start();
+
+    /// @brief Makes start() return. Connections are closed once the receiver is destroyed. Can be called from any
+    /// thread.
+    void stop();
+
+    /// @brief Returns the port being listened on, which is chosen by the system if the receiver was given port 0
+    uint16_t port() const
+    {
+        return m_port;
+    }
+
+private:
+    class Session;
+
+    void do_accept();
+
+    const Logger& m_logger;
+    const Handler m_handler;
+    const std::chrono::milliseconds m_read_timeout; // Of each read of a connection
+    boost::asio::io_context m_context;
+    boost::asio::ip::tcp::acceptor m_acceptor;
+    uint16_t m_port;
+};
+
+} // namespace push
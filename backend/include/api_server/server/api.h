@@ -1,64 +1,504 @@
 #pragma once
 
+#include <boost/algorithm/string.hpp>
 #include <fmt/format.h>
 
 #include "api_server/data/datastore.h"
+#include "api_server/data/encoding.h"
+#include "api_server/filesystem/details.h"
+#include "api_server/metrics/prometheus.h"
+#include "api_server/server/broadcast.h"
+#include "api_server/server/responder.h"
 #include "api_server/server/responses.h"
 #include "api_server/server/router.h"
 #include "api_server/server/server.h"
+#include "api_server/server/streaming.h"
 #include "api_server/server/types.h"
 
 namespace server
 {
 
-#define BIND_ENDPOINT(verb, resource, func)                                                                            \
-    router.add_route(verb, resource, [this](const HttpRequest& req) { return this->func(req); })
-
-/// @brief API Endpoints
+/// @brief API Endpoints.
+/// Responses are JSON unless the request's Accept header prefers MessagePack or CBOR, which carry the same document.
+/// The process list can also be served as a binary process table (see data/proctable.h). Larger bodies are compressed
+/// if the request's Accept-Encoding allows.
 class ApiController
 {
 public:
-    ApiController(const Logger& logger, RouteHolder& router, data::DataStore& datastore)
-        : m_logger{logger}, m_datastore{datastore}
+    /// @brief Uncompressed JSON process lists at least this long are streamed rather than produced whole, if they are
+    /// of a generation that was superseded while being served and so can't be cached (see CachedResponder::respond)
+    static constexpr std::size_t STREAM_MIN_PROCS{1000u};
+
+    /// @brief Processes exposed by /metrics unless the request sets `top`
+    static constexpr std::size_t DEFAULT_METRICS_TOP_PROCS{10u};
+
+    /// @param details_collector Reads extended metrics for /api/procs/{pid}, or nullptr if the monitored processes
+    /// aren't the live ones under /proc (e.g. during a replay), in which case that endpoint isn't served
+    ApiController(const Logger& logger, Router& router, data::DataStore& datastore,
+                  filesystem::ProcDetailsCollector* details_collector)
+        : m_logger{logger}, m_router{router}, m_datastore{datastore}, m_details_collector{details_collector},
+          m_responder{[&datastore] { return datastore.generation(); }}
     {
         BIND_ENDPOINT(bb::http::verb::get, "/api/uptime", get_uptime);
         BIND_ENDPOINT(bb::http::verb::get, "/api/cpus", get_cpus);
         BIND_ENDPOINT(bb::http::verb::get, "/api/procs", get_procs);
+        if (m_details_collector)
+            BIND_ENDPOINT(bb::http::verb::get, "/api/procs/{pid}", get_proc);
+        BIND_ENDPOINT(bb::http::verb::get, "/api/procs/{pid}/threads", get_proc_threads);
         BIND_ENDPOINT(bb::http::verb::get, "/api/mem", get_mem);
+        BIND_ENDPOINT(bb::http::verb::get, "/api/proctree", get_proctree);
+        BIND_ENDPOINT(bb::http::verb::get, "/api/cgroups", get_cgroups);
+        BIND_ENDPOINT(bb::http::verb::get, "/api/stats", get_stats);
+        BIND_ENDPOINT(bb::http::verb::get, "/api/snapshot", get_snapshot);
+        BIND_ENDPOINT(bb::http::verb::get, "/api/stream", get_stream);
+        BIND_ENDPOINT(bb::http::verb::get, "/metrics", get_metrics);
+        BIND_ENDPOINT(bb::http::verb::get, "/api/debug/trace", get_debug_trace);
+
+        datastore.on_publish([this](const uint64_t) {
+            if (m_events.subscriber_count() > 0)
+                publish_snapshot_event();
+        });
     };
 
     /// @brief GET /uptime
     HttpResponse get_uptime(const HttpRequest& request)
     {
-        auto uptime = m_datastore.get_uptime();
-        uptime.formatted = fmt::format("{:02}:{:02}:{:02}", uptime.hours, uptime.minutes, uptime.seconds);
-        return responses::Ok(request.version(), request.keep_alive(), data::to_json_string(uptime));
+        const auto snapshot = m_datastore.get_snapshot();
+        return m_responder.respond(request, snapshot->generation, [snapshot](const data::Encoding encoding) {
+            auto uptime = snapshot->uptime.value_or(data::Uptime{});
+            format_uptime(uptime);
+            return data::encode(uptime, encoding);
+        });
     }
 
     /// @brief GET /cpus
     HttpResponse get_cpus(const HttpRequest& request)
     {
-        auto cpus = m_datastore.get_cpu_snapshots();
-        return responses::Ok(request.version(), request.keep_alive(), data::to_json_string(cpus));
+        const auto snapshot = m_datastore.get_snapshot();
+        return m_responder.respond(request, snapshot->generation, [snapshot](const data::Encoding encoding) {
+            return data::encode(snapshot->cpus.value_or(std::vector<data::CpuSnapshot>{}), encoding);
+        });
     }
 
-    /// @brief GET /procs
+    /// @brief GET /procs?since={generation}&cpu_threshold={percent}&mem_threshold={percent}
+    /// With `since`, returns only the processes that were added, removed or changed since that generation (see
+    /// data::ProcListDelta), or the full list if the generation is too old. The thresholds are the minimum changes in
+    /// CPU and memory usage for a process to count as changed.
     HttpResponse get_procs(const HttpRequest& request)
     {
-        auto procs = m_datastore.get_proc_snapshots();
-        return responses::Ok(request.version(), request.keep_alive(), data::to_json_string(procs));
+        std::optional<uint64_t> since;
+        data::ProcDeltaThresholds thresholds;
+        if (!read_query_number(request, "since", since) ||
+            !read_query_threshold(request, "cpu_threshold", thresholds.cpu_usage_percent) ||
+            !read_query_threshold(request, "mem_threshold", thresholds.mem_usage_percent))
+        {
+            return responses::BadRequest(request.version(), request.keep_alive());
+        }
+        const auto snapshot = m_datastore.get_snapshot();
+        if (since)
+        {
+            return m_responder.respond(
+                request, snapshot->generation, [this, snapshot, since, thresholds](const data::Encoding encoding) {
+                    return data::encode(m_datastore.get_proc_delta(since.value(), thresholds, *snapshot), encoding);
+                });
+        }
+
+        const auto procs = snapshot_procs(*snapshot);
+        const auto produce = [procs](const data::Encoding encoding) { return data::encode(*procs, encoding); };
+        const auto stream = [procs](const data::Encoding encoding) -> std::optional<ChunkSource> {
+            if (encoding != data::Encoding::Json || procs->size() < STREAM_MIN_PROCS)
+            {
+                return std::nullopt;
+            }
+            return json_array_chunks(procs);
+        };
+        return m_responder.respond(request, snapshot->generation, produce, PROC_LIST_ENCODINGS, stream);
+    }
+
+    /// @brief GET /procs/{pid}
+    /// Extended metrics are collected on demand for this process only
+    HttpResponse get_proc(const HttpRequest& request)
+    {
+        std::optional<int32_t> pid;
+        if (!read_path_number(request, "pid", pid))
+        {
+            return responses::BadRequest(request.version(), request.keep_alive());
+        }
+        const auto details = m_details_collector->get(pid.value());
+        if (!details)
+        {
+            return responses::NotFound(request.version(), request.keep_alive(), std::string{request.target()});
+        }
+        auto json = data::to_json(details.value());
+        if (const auto snapshot = m_datastore.get_proc_snapshot(pid.value()); snapshot)
+        {
+            json["process"] = data::to_json(snapshot.value());
+        }
+        return encoded_response(request, json);
+    }
+
+    /// @brief GET /procs/{pid}/threads
+    /// Requesting the threads of a process (re)starts monitoring them for ThreadCollector::REQUEST_TTL, so the
+    /// first request returns no threads until the next poll
+    HttpResponse get_proc_threads(const HttpRequest& request)
+    {
+        std::optional<int32_t> pid;
+        if (!read_path_number(request, "pid", pid))
+        {
+            return responses::BadRequest(request.version(), request.keep_alive());
+        }
+        if (!m_datastore.get_proc_snapshot(pid.value()))
+        {
+            return responses::NotFound(request.version(), request.keep_alive(), std::string{request.target()});
+        }
+        m_datastore.request_thread_monitoring(pid.value());
+
+        const auto snapshot = m_datastore.get_snapshot();
+        return m_responder.respond(
+            request, snapshot->generation, [snapshot, pid = pid.value()](const data::Encoding encoding) {
+                if (snapshot->threads)
+                {
+                    if (const auto iter = snapshot->threads->find(pid); iter != snapshot->threads->end())
+                        return data::encode(iter->second, encoding);
+                }
+                data::ProcThreads threads;
+                threads.pid = pid;
+                return data::encode(threads, encoding);
+            });
     }
 
     /// @brief GET /mem
     HttpResponse get_mem(const HttpRequest& request)
     {
-        auto mem = m_datastore.get_mem_snapshot();
-        return responses::Ok(request.version(), request.keep_alive(), data::to_json_string(mem));
+        const auto snapshot = m_datastore.get_snapshot();
+        return m_responder.respond(request, snapshot->generation, [snapshot](const data::Encoding encoding) {
+            return data::encode(snapshot->mem.value_or(data::MemSnapshot{}), encoding);
+        });
+    }
+
+    /// @brief GET /proctree?root={pid}&depth={levels}
+    /// Without a root, returns the trees of all processes that have no parent
+    HttpResponse get_proctree(const HttpRequest& request)
+    {
+        std::optional<int32_t> root;
+        std::optional<uint32_t> depth;
+        if (!read_query_number(request, "root", root) || !read_query_number(request, "depth", depth))
+        {
+            return responses::BadRequest(request.version(), request.keep_alive());
+        }
+
+        const auto snapshot = m_datastore.get_snapshot();
+        const auto produce = [snapshot, root, depth](const data::Encoding encoding) -> std::optional<std::string> {
+            // Before the first poll, there are no processes to build trees of
+            const auto procs = snapshot_procs(*snapshot);
+            if (!root)
+            {
+                if (!snapshot->proc_tree)
+                    return data::encode(std::vector<data::ProcTreeNode>{}, encoding);
+                return data::encode(snapshot->proc_tree->forest(*procs, depth), encoding);
+            }
+            if (!snapshot->proc_tree)
+            {
+                return std::nullopt;
+            }
+            const auto tree = snapshot->proc_tree->subtree(*procs, root.value(), depth);
+            if (!tree)
+            {
+                return std::nullopt;
+            }
+            return data::encode(tree.value(), encoding);
+        };
+        return m_responder.respond(request, snapshot->generation, produce);
+    }
+
+    /// @brief GET /cgroups
+    HttpResponse get_cgroups(const HttpRequest& request)
+    {
+        const auto snapshot = m_datastore.get_snapshot();
+        return m_responder.respond(request, snapshot->generation, [snapshot](const data::Encoding encoding) {
+            if (!snapshot->cgroups)
+                return data::encode(std::vector<data::CgroupSnapshot>{}, encoding);
+            return data::encode(*snapshot->cgroups, encoding);
+        });
+    }
+
+    /// @brief GET /stats
+    HttpResponse get_stats(const HttpRequest& request)
+    {
+        const auto cache_stats = m_responder.cache_stats();
+        const auto lookups = cache_stats.hits + cache_stats.misses;
+        const nlohmann::json stats{
+            {"generation", m_datastore.generation()},
+            {"response_cache",
+             {{"hits", cache_stats.hits},
+              {"misses", cache_stats.misses},
+              {"hit_rate", lookups > 0 ? static_cast<double>(cache_stats.hits) / lookups : 0.0},
+              {"entries", cache_stats.entries},
+              {"not_modified", m_responder.not_modified()}}}};
+        return encoded_response(request, stats);
+    }
+
+    /// @brief GET /metrics?top={count}
+    /// Prometheus text format: the host's CPU and memory usage, the `top` processes using the most CPU, the duration of
+    /// each phase of the monitor's polls, and the latency of each route's responses.
+    HttpResponse get_metrics(const HttpRequest& request)
+    {
+        std::optional<std::size_t> top;
+        if (!read_query_number(request, "top", top))
+        {
+            return responses::BadRequest(request.version(), request.keep_alive());
+        }
+
+        std::string body;
+        metrics::PrometheusWriter writer{body};
+        write_host_metrics(writer, top.value_or(DEFAULT_METRICS_TOP_PROCS));
+        write_poll_metrics(writer);
+
+        writer.family("api_server_request_duration_seconds", "histogram",
+                      "Time from receiving a request to sending the last of its response, per route");
+        for (const auto& route : m_router.route_latencies())
+        {
+            const auto method = bb::http::to_string(route.verb);
+            writer.duration_histogram("api_server_request_duration_seconds",
+                                      {{"method", {method.data(), method.size()}}, {"route", route.resource}},
+                                      route.latency.snapshot());
+        }
+        writer.duration_histogram("api_server_request_duration_seconds", {{"method", ""}, {"route", "unmatched"}},
+                                  m_router.unmatched_latency().snapshot());
+
+        const auto cache_stats = m_responder.cache_stats();
+        writer.family("api_server_response_cache_hits_total", "counter", "Responses served from the response cache");
+        writer.sample("api_server_response_cache_hits_total", {}, static_cast<double>(cache_stats.hits));
+        writer.family("api_server_response_cache_misses_total", "counter", "Responses produced for the response cache");
+        writer.sample("api_server_response_cache_misses_total", {}, static_cast<double>(cache_stats.misses));
+
+        return compressed_response(request, std::move(body), metrics::PROMETHEUS_MEDIA_TYPE);
+    }
+
+    /// @brief GET /api/debug/trace
+    /// The flight recorder's recent spans of the monitor's polls (phases, slow file reads and slow lock waits), as
+    /// Chrome trace_event JSON for Perfetto or chrome://tracing.
+    HttpResponse get_debug_trace(const HttpRequest& request)
+    {
+        std::string body;
+        m_datastore.flight_recorder().write_chrome_trace(body);
+        return compressed_response(request, std::move(body), "application/json");
+    }
+
+    /// @brief GET /snapshot?fields={datasets}&limit={count}
+    /// The uptime, CPUs, memory and processes all from the same generation, so that they are consistent with each
+    /// other. `fields` is a comma-separated subset of "uptime", "cpus", "mem" and "procs" to include, and `limit` keeps
+    /// only that many processes, those using the most CPU.
+    HttpResponse get_snapshot(const HttpRequest& request)
+    {
+        std::optional<std::size_t> limit;
+        if (!read_query_number(request, "limit", limit))
+        {
+            return responses::BadRequest(request.version(), request.keep_alive());
+        }
+        std::vector<std::string> fields{"uptime", "cpus", "mem", "procs"};
+        if (const auto param = request.lookup_query_parameter("fields"); param)
+        {
+            boost::split(fields, param.value(), boost::is_any_of(","));
+            const auto is_dataset = [](const std::string& field) {
+                return field == "uptime" || field == "cpus" || field == "mem" || field == "procs";
+            };
+            if (!std::all_of(fields.begin(), fields.end(), is_dataset))
+            {
+                return responses::BadRequest(request.version(), request.keep_alive());
+            }
+        }
+
+        const auto published = m_datastore.get_snapshot();
+        const auto produce = [published, fields, limit](const data::Encoding encoding) {
+            const auto has_field = [&fields](const std::string& name) {
+                return std::find(fields.begin(), fields.end(), name) != fields.end();
+            };
+            // Before the first poll, the snapshot has none of the datasets
+            auto snapshot = *published;
+            if (!has_field("uptime"))
+                snapshot.uptime.reset();
+            else if (snapshot.uptime)
+                format_uptime(snapshot.uptime.value());
+            if (!has_field("cpus"))
+                snapshot.cpus.reset();
+            if (!has_field("mem"))
+                snapshot.mem.reset();
+            if (!has_field("procs"))
+                snapshot.procs.reset();
+            else if (limit && snapshot.procs && limit.value() < snapshot.procs.value()->size())
+                snapshot.procs = top_cpu_procs(*snapshot.procs.value(), limit.value());
+            return data::encode(snapshot, encoding);
+        };
+        return m_responder.respond(request, published->generation, produce);
+    }
+
+    /// @brief GET /stream
+    /// Server-Sent Events, pushing a "snapshot" event with the uptime, CPUs, memory and processes of each generation
+    /// as it is published. The event is serialized once and shared by every subscriber; subscribers that fall behind
+    /// skip to the latest generation.
+    HttpResponse get_stream(const HttpRequest& request)
+    {
+        // Events are only produced while there are subscribers, so catch up for the first one
+        publish_snapshot_event();
+        auto response = responses::Ok(request.version(), request.keep_alive(), std::string{});
+        response.set(bb::http::field::content_type, "text/event-stream");
+        response.set(bb::http::field::cache_control, "no-cache");
+        response.event_stream(m_events.subscribe());
+        return response;
     }
 
 private:
+    static inline const std::vector<data::Encoding> PROC_LIST_ENCODINGS{
+        data::Encoding::Json, data::Encoding::MsgPack, data::Encoding::Cbor, data::Encoding::ProcTable};
+
+    /// @brief Writes the latest snapshot's datasets as metrics, with the `top` processes using the most CPU
+    void write_host_metrics(metrics::PrometheusWriter& writer, const std::size_t top) const
+    {
+        const auto snapshot = m_datastore.get_snapshot();
+        writer.family("api_server_polls_total", "counter", "Monitor polls completed, i.e. the datastore generation");
+        writer.sample("api_server_polls_total", {}, static_cast<double>(snapshot->generation));
+        writer.family("host_uptime_seconds", "gauge", "Time since the host booted");
+        writer.sample("host_uptime_seconds", {}, snapshot->uptime ? snapshot->uptime->total_seconds : 0.0);
+
+        writer.family("host_cpu_usage_percent", "gauge", "CPU usage over the last poll, of all CPUs and of each CPU");
+        for (const auto& cpu : snapshot->cpus.value_or(std::vector<data::CpuSnapshot>{}))
+            writer.sample("host_cpu_usage_percent", {{"cpu", cpu.id}}, cpu.usage_percent);
+
+        const auto mem = snapshot->mem.value_or(data::MemSnapshot{});
+        writer.family("host_memory_total_bytes", "gauge", "Total usable memory");
+        writer.sample("host_memory_total_bytes", {}, 1024.0 * mem.total_memory_kB);
+        writer.family("host_memory_available_bytes", "gauge",
+                      "Memory available to start new applications without swapping (MemAvailable)");
+        writer.sample("host_memory_available_bytes", {}, 1024.0 * mem.free_memory_kB);
+        writer.family("host_memory_usage_percent", "gauge", "Memory in use");
+        writer.sample("host_memory_usage_percent", {}, mem.usage_percent);
+
+        const auto procs = snapshot_procs(*snapshot);
+        writer.family("host_processes", "gauge", "Processes running");
+        writer.sample("host_processes", {}, static_cast<double>(procs->size()));
+        const auto top_procs = top_cpu_procs(*procs, std::min(top, procs->size()));
+        writer.family("host_process_cpu_usage_percent", "gauge", "CPU usage of the processes using the most CPU");
+        for (const auto& proc : *top_procs)
+        {
+            const auto pid = std::to_string(proc.pid);
+            writer.sample("host_process_cpu_usage_percent", {{"pid", pid}, {"name", proc.name}},
+                          proc.cpu_usage_percent);
+        }
+        writer.family("host_process_memory_bytes", "gauge", "Resident memory of the processes using the most CPU");
+        for (const auto& proc : *top_procs)
+        {
+            const auto pid = std::to_string(proc.pid);
+            writer.sample("host_process_memory_bytes", {{"pid", pid}, {"name", proc.name}}, 1024.0 * proc.mem_usage_kB);
+        }
+    }
+
+    /// @brief Writes the instrumentation of the monitor's polls as metrics
+    void write_poll_metrics(metrics::PrometheusWriter& writer) const
+    {
+        auto& poll = m_datastore.poll_metrics();
+        writer.family("api_server_poll_processes", "gauge", "Processes scanned by the last monitor poll");
+        writer.sample("api_server_poll_processes", {}, static_cast<double>(poll.processes.load()));
+        writer.family("api_server_poll_phase_duration_seconds", "histogram",
+                      "Time taken by each phase of the monitor's polls, summed over processes for per-process files");
+        const std::pair<std::string_view, const metrics::Histogram&> phases[]{
+            {"system", poll.system}, {"discovery", poll.discovery},   {"status", poll.status},
+            {"stat", poll.stat},     {"cmdline", poll.cmdline},       {"store", poll.store},
+            {"collectors", poll.collectors}, {"publish", poll.publish}, {"total", poll.total}};
+        for (const auto& [phase, histogram] : phases)
+        {
+            writer.duration_histogram("api_server_poll_phase_duration_seconds", {{"phase", phase}},
+                                      histogram.snapshot());
+        }
+    }
+
+    /// @brief Returns the process list of a snapshot, which is empty before the first poll
+    static std::shared_ptr<const std::vector<data::ProcSnapshot>> snapshot_procs(const data::Snapshot& snapshot)
+    {
+        return snapshot.procs.value_or(std::make_shared<const std::vector<data::ProcSnapshot>>());
+    }
+
+    /// @brief Returns the processes using the most CPU, in descending order of CPU usage
+    static std::shared_ptr<const std::vector<data::ProcSnapshot>> top_cpu_procs(
+        const std::vector<data::ProcSnapshot>& procs, const std::size_t count)
+    {
+        auto top = std::make_shared<std::vector<data::ProcSnapshot>>(procs);
+        const auto by_cpu = [](const data::ProcSnapshot& a, const data::ProcSnapshot& b) {
+            if (a.cpu_usage_percent != b.cpu_usage_percent)
+                return a.cpu_usage_percent > b.cpu_usage_percent;
+            return a.pid < b.pid;
+        };
+        std::partial_sort(top->begin(), top->begin() + static_cast<std::ptrdiff_t>(count), top->end(), by_cpu);
+        top->resize(count);
+        return top;
+    }
+
+    static void format_uptime(data::Uptime& uptime)
+    {
+        uptime.formatted = fmt::format("{:02}:{:02}:{:02}", uptime.hours, uptime.minutes, uptime.seconds);
+    }
+
+    /// @brief Publishes the snapshot event for the current generation to /stream subscribers, unless it already has
+    /// been. [Concurrent execution]
+    void publish_snapshot_event()
+    {
+        const std::lock_guard lock{m_event_mutex};
+        auto snapshot = *m_datastore.get_snapshot();
+        if (m_event_generation == snapshot.generation)
+            return;
+        m_event_generation = snapshot.generation;
+        if (snapshot.uptime)
+            format_uptime(snapshot.uptime.value());
+
+        auto event = fmt::format("id: {}\nevent: snapshot\ndata: ", snapshot.generation);
+        data::JsonWriter writer{event};
+        data::write_json(writer, snapshot);
+        event.append("\n\n");
+        m_events.publish(std::make_shared<const std::string>(std::move(event)));
+    }
+
+    /// @brief Reads an optional numeric query parameter
+    /// @return False if the parameter is present but is not a valid number
+    template <typename Number>
+    static bool read_query_number(const HttpRequest& request, const std::string& name, std::optional<Number>& value)
+    {
+        const auto param = request.lookup_query_parameter(name);
+        return !param || parse_number(param.value(), value);
+    }
+
+    /// @brief Reads an optional usage threshold in percent
+    /// @return False if the parameter is present but is not a valid percentage
+    static bool read_query_threshold(const HttpRequest& request, const std::string& name, float& threshold)
+    {
+        std::optional<float> value;
+        if (!read_query_number(request, name, value))
+            return false;
+        if (value)
+        {
+            if (!(value.value() >= 0.0f && value.value() <= 100.0f))
+                return false;
+            threshold = value.value();
+        }
+        return true;
+    }
+
+    /// @brief Reads a numeric path parameter
+    /// @return False if the parameter is missing or is not a valid number
+    template <typename Number>
+    static bool read_path_number(const HttpRequest& request, const std::string& name, std::optional<Number>& value)
+    {
+        const auto param = request.path_parameters().find(name);
+        return param && parse_number(param.value(), value);
+    }
+
     const Logger& m_logger;
+    const Router& m_router;
     data::DataStore& m_datastore;
+    filesystem::ProcDetailsCollector* const m_details_collector;
+    CachedResponder m_responder;
+    Broadcaster m_events; // Subscribers of /stream
+    std::mutex m_event_mutex;
+    std::optional<uint64_t> m_event_generation; // Of the latest event published
 };
 
 } // namespace server
\ No newline at end of file
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace server
+{
+
+/// @brief One subscriber's view of a Broadcaster. It holds at most the latest message not yet received, so a
+/// subscriber that takes longer to handle a message than the publisher takes to publish the next one skips the
+/// messages in between rather than queueing them.
+class Subscription
+{
+public:
+    using Message = std::shared_ptr<const std::string>;
+    using Handler = std::function<void(Message message)>; // Called with nullptr once the subscription is closed
+
+    /// @brief Calls the handler with the next message as soon as there is one. It is called either from within this
+    /// call or on the publishing thread, so should only hand the message over to the subscriber's own executor.
+    /// [Concurrent execution]
+    void async_next(Handler handler);
+
+    /// @brief Ends the subscription, calling any waiting handler with nullptr. [Concurrent execution]
+    void close();
+
+private:
+    friend class Broadcaster;
+
+    void deliver(Message message);
+
+    std::mutex m_mutex;
+    Message m_message; // Latest message not yet handed to a handler
+    Handler m_handler; // Waiting for the next message
+    bool m_closed{false};
+};
+
+/// @brief Fans messages out to any number of subscribers. Every subscriber shares the same immutable message, so each
+/// is produced once however many subscribers there are.
+class Broadcaster
+{
+public:
+    /// @brief Returns a new subscription, whose first message is the latest one published. [Concurrent execution]
+    std::shared_ptr<Subscription> subscribe();
+
+    /// @brief Sends the message to every subscriber. [Concurrent execution]
+    void publish(Subscription::Message message);
+
+    /// @brief Closes every subscription, e.g. on shutdown. [Concurrent execution]
+    void close();
+
+    /// @brief Returns the number of subscriptions that are still held by a subscriber
+    std::size_t subscriber_count();
+
+private:
+    /// @brief Returns the live subscriptions, forgetting those that were released
+    std::vector<std::shared_ptr<Subscription>> live_subscriptions();
+
+    std::mutex m_mutex;
+    Subscription::Message m_latest;
+    std::vector<std::weak_ptr<Subscription>> m_subscriptions;
+};
+
+} // namespace server
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+namespace server
+{
+
+/// @brief Caches serialized response bodies for the current datastore generation, so that every request arriving
+/// between two monitor polls shares a single immutable body rather than re-serializing the same data.
+class ResponseCache
+{
+public:
+    using Body = std::shared_ptr<const std::string>;
+    using Producer = std::function<std::optional<std::string>()>; // Returns nullopt if there is nothing to serve
+    using GenerationSource = std::function<uint64_t()>;
+
+    static constexpr std::size_t MAX_ENTRIES{256}; // Bodies cached at once, across all keys
+
+    struct Stats
+    {
+        uint64_t hits{0u};
+        uint64_t misses{0u};
+        std::size_t entries{0u};
+    };
+
+    /// @param generation Returns the current datastore generation
+    explicit ResponseCache(GenerationSource generation);
+
+    /// @brief Returns the body cached under `key` for the generation, calling `produce` to create it if there is
+    /// none, or nullptr if `produce` had nothing to serve. [Concurrent execution]
+    /// The body is not cached if the generation changed while it was being produced, so an entry is never filed
+    /// under a generation that had already been superseded. `produce` must derive the body from the data of that
+    /// generation (its data::Snapshot) rather than the latest stored datasets: the monitor stores a poll's datasets
+    /// before publishing its generation, so those may already be of the next poll.
+    Body get(const std::string& key, const uint64_t generation, const Producer& produce);
+
+    /// @brief Returns the body cached under `key` for the generation, or nullptr without producing it if there is
+    /// none [Concurrent execution]
+    Body peek(const std::string& key, const uint64_t generation);
+
+    Stats stats() const;
+
+private:
+    struct Entry
+    {
+        uint64_t generation{0u};
+        Body body;
+    };
+
+    /// @brief Removes entries from generations before `generation` [Must hold m_mutex]
+    void evict(const uint64_t generation);
+
+    const GenerationSource m_generation;
+    mutable std::mutex m_mutex;
+    std::unordered_map<std::string, Entry> m_entries;
+    std::atomic<uint64_t> m_hits{0u};
+    std::atomic<uint64_t> m_misses{0u};
+};
+
+} // namespace server
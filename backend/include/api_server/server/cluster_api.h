@@ -0,0 +1,100 @@
+#pragma once
+
+#include <chrono>
+#include <fmt/format.h>
+
+#include "api_server/cluster/store.h"
+#include "api_server/data/encoding.h"
+#include "api_server/server/responder.h"
+#include "api_server/server/responses.h"
+#include "api_server/server/router.h"
+#include "api_server/server/types.h"
+
+namespace server
+{
+
+/// @brief Endpoints of the aggregator, served in place of the ApiController's.
+/// Responses are JSON unless the request's Accept header prefers MessagePack or CBOR, and are compressed if the
+/// request's Accept-Encoding allows. Merged results are produced once per change of the cluster store and shared
+/// through the response cache, with the store's generation as their ETag.
+class ClusterController
+{
+public:
+    /// @brief Processes returned by /api/procs unless the request sets `limit`
+    static constexpr std::size_t DEFAULT_TOP_PROCS{100u};
+
+    ClusterController(const Logger& logger, Router& router, const cluster::ClusterStore& store)
+        : m_logger{logger}, m_store{store}, m_responder{[&store] { return store.generation(); }}
+    {
+        BIND_ENDPOINT(bb::http::verb::get, "/api/procs", get_procs);
+        BIND_ENDPOINT(bb::http::verb::get, "/api/nodes", get_nodes);
+        BIND_ENDPOINT(bb::http::verb::get, "/api/summary", get_summary);
+    }
+
+    /// @brief GET /procs?limit={count}&sort={cpu|mem}
+    /// The processes of every reachable node using the most CPU (by default) or memory, each labelled with its node
+    HttpResponse get_procs(const HttpRequest& request)
+    {
+        std::optional<std::size_t> limit;
+        auto order = cluster::ProcOrder::Cpu;
+        if (const auto param = request.lookup_query_parameter("limit"); param && !parse_number(param.value(), limit))
+        {
+            return responses::BadRequest(request.version(), request.keep_alive());
+        }
+        if (const auto param = request.lookup_query_parameter("sort"); param)
+        {
+            if (param.value() == "mem")
+                order = cluster::ProcOrder::Mem;
+            else if (param.value() != "cpu")
+                return responses::BadRequest(request.version(), request.keep_alive());
+        }
+        return m_responder.respond(request, [this, limit, order](const data::Encoding encoding) {
+            return data::encode(m_store.top_procs(limit.value_or(DEFAULT_TOP_PROCS), order), encoding);
+        });
+    }
+
+    /// @brief GET /nodes
+    /// The status of each agent: whether its last fetch succeeded, how long ago the last successful one was, and the
+    /// totals of its latest snapshot
+    HttpResponse get_nodes(const HttpRequest& request)
+    {
+        // Not cached, as the ages change without the store changing
+        const auto now = std::chrono::steady_clock::now();
+        nlohmann::json nodes = nlohmann::json::array();
+        for (const auto& node : m_store.nodes())
+        {
+            const auto& snapshot = node->snapshot;
+            nodes.push_back(
+                {{"node", node->agent.node},
+                 {"endpoint", fmt::format("{}:{}", node->agent.host, node->agent.port)},
+                 {"reachable", node->reachable},
+                 {"error", node->error},
+                 {"failures", node->failures},
+                 {"age_seconds",
+                  node->updated ? nlohmann::json(std::chrono::duration<double>(now - node->updated.value()).count())
+                                : nlohmann::json(nullptr)},
+                 {"fetch_seconds", std::chrono::duration<double>(node->fetch_duration).count()},
+                 {"generation", snapshot.generation},
+                 {"uptime_seconds", snapshot.uptime ? snapshot.uptime->total_seconds : 0.0},
+                 {"processes", snapshot.procs ? snapshot.procs.value()->size() : 0u},
+                 {"mem", snapshot.mem ? data::to_json(snapshot.mem.value()) : nlohmann::json(nullptr)}});
+        }
+        return encoded_response(request, nodes);
+    }
+
+    /// @brief GET /summary
+    /// Totals of the reachable nodes' CPUs, memory and processes
+    HttpResponse get_summary(const HttpRequest& request)
+    {
+        return m_responder.respond(request, [this](const data::Encoding encoding) {
+            return data::encode_document(cluster::to_json(m_store.summary()), encoding);
+        });
+    }
+
+private:
+    const Logger& m_logger;
+    const cluster::ClusterStore& m_store;
+    CachedResponder m_responder;
+};
+
+} // namespace server
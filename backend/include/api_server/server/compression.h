@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace server
+{
+
+/// @brief Content codings a response body can be compressed with
+enum class ContentCoding
+{
+    Identity,
+    Gzip,
+    Deflate, // zlib format, as HTTP's "deflate" coding is defined
+};
+
+/// @brief Bodies smaller than this are sent uncompressed, as compression would save little or make them larger
+constexpr std::size_t MIN_COMPRESSED_SIZE{1024u};
+
+/// @brief Returns the coding's name, as used in the Accept-Encoding and Content-Encoding headers
+std::string_view content_coding_name(const ContentCoding coding);
+
+/// @brief Chooses a content coding from the request's Accept-Encoding header, preferring gzip to deflate if both are
+/// equally acceptable. Falls back to identity if no compression is acceptable, even if identity is excluded.
+/// @param accept_encoding Value of the Accept-Encoding header, empty if the request has none
+ContentCoding negotiate_content_coding(const std::string_view accept_encoding);
+
+/// @brief Compresses data with zlib
+/// @throws std::runtime_error if zlib fails
+std::string compress(const std::string_view data, const ContentCoding coding);
+
+} // namespace server
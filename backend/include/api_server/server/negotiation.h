@@ -0,0 +1,21 @@
+#pragma once
+
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "api_server/data/encoding.h"
+
+namespace server
+{
+
+/// @brief Chooses the encoding of a response from the request's Accept header.
+/// Media ranges are weighted by their q parameter, and the most specific range that matches an encoding decides its
+/// weight (e.g. "application/cbor" over "application/*" over "*/*"). Ties go to the encoding listed first.
+/// @param accept Value of the Accept header, empty if the request has none
+/// @param supported Encodings the endpoint can produce, in order of preference
+/// @return The encoding to respond with, or nullopt if none is acceptable (406)
+std::optional<data::Encoding> negotiate_encoding(const std::string_view accept,
+                                                 const std::vector<data::Encoding>& supported);
+
+} // namespace server
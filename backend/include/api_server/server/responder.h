@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <charconv>
+#include <cstdint>
+#include <functional>
+#include <nlohmann/json.hpp>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "api_server/data/encoding.h"
+#include "api_server/server/cache.h"
+#include "api_server/server/types.h"
+
+namespace server
+{
+
+/// @brief Encodings that carry any JSON document
+inline const std::vector<data::Encoding> DOCUMENT_ENCODINGS{data::Encoding::Json, data::Encoding::MsgPack,
+                                                             data::Encoding::Cbor};
+
+/// @brief Parses the whole of a request parameter as a number
+/// @return False if it is not a valid number
+template <typename Number> bool parse_number(const std::string_view text, std::optional<Number>& value)
+{
+    Number number{};
+    const auto last = text.data() + text.size();
+    const auto [ptr, error] = std::from_chars(text.data(), last, number);
+    if (error != std::errc{} || ptr != last)
+        return false;
+    value = number;
+    return true;
+}
+
+/// @brief Returns true if the request's If-None-Match header contains the ETag (weak comparison)
+bool etag_matches(const HttpRequest& request, const std::string& etag);
+
+/// @brief Returns true if the request's If-None-Match header is "*", which matches any existing representation
+bool etag_matches_any(const HttpRequest& request);
+
+/// @brief Responds with a body that is not cached, compressed if the client accepts it
+HttpResponse compressed_response(const HttpRequest& request, std::string body, const std::string_view media_type);
+
+/// @brief Responds with a document that is not cached, in the encoding negotiated with the client
+HttpResponse encoded_response(const HttpRequest& request, const nlohmann::json& document);
+
+/// @brief Responds with bodies derived from the current generation of a controller's data. Each body is produced (and
+/// compressed) once per generation, encoding and content coding, and shared with every other request for the same
+/// target through a response cache. Requests whose If-None-Match has the generation's ETag get a bodyless 304
+/// instead. ETags start with a random nonce of the responder, as generations start over when the server restarts, so
+/// that an ETag from before a restart can't match a different body of the same generation.
+class CachedResponder
+{
+public:
+    /// @brief Produces a response body in the given encoding, or nullopt if there is nothing to serve
+    using EncodingProducer = std::function<std::optional<std::string>(data::Encoding)>;
+
+    /// @brief Streams a response body in the given encoding, or returns nullopt if it should be produced whole instead
+    using StreamProducer = std::function<std::optional<ChunkSource>(data::Encoding)>;
+
+    /// @param generation Returns the current generation of the data that bodies are derived from
+    explicit CachedResponder(ResponseCache::GenerationSource generation);
+
+    /// @brief Responds with the body `produce` makes for the request's target, or 404 if it has nothing to serve.
+    /// [Concurrent execution]
+    /// Bodies that `stream` offers to stream are sent with chunked transfer encoding when they are to be sent
+    /// uncompressed and couldn't be cached, as their generation is no longer the current one. This bounds the memory a
+    /// large body that isn't shared takes per connection.
+    HttpResponse respond(const HttpRequest& request, const EncodingProducer& produce,
+                         const std::vector<data::Encoding>& supported = DOCUMENT_ENCODINGS,
+                         const StreamProducer& stream = nullptr);
+
+    /// @brief Responds with the body `produce` makes of the given generation's data, rather than the current one's.
+    /// [Concurrent execution]
+    /// Pass the generation of the data::Snapshot the body is derived from, which may be behind the current generation
+    /// if a poll was published since it was taken.
+    HttpResponse respond(const HttpRequest& request, const uint64_t generation, const EncodingProducer& produce,
+                         const std::vector<data::Encoding>& supported = DOCUMENT_ENCODINGS,
+                         const StreamProducer& stream = nullptr);
+
+    ResponseCache::Stats cache_stats() const
+    {
+        return m_cache.stats();
+    }
+
+    /// @brief Returns the number of requests answered with 304
+    uint64_t not_modified() const
+    {
+        return m_not_modified.load(std::memory_order_relaxed);
+    }
+
+private:
+    const ResponseCache::GenerationSource m_generation;
+    const std::string m_etag_prefix; // Opening quote and nonce of every ETag
+    ResponseCache m_cache;
+    std::atomic<uint64_t> m_not_modified{0u};
+};
+
+} // namespace server
@@ -26,6 +26,34 @@ inline server::HttpResponse Ok(const unsigned version, const bool keep_alive, co
     return resp;
 }
 
+/// @brief Ok response with a body shared with other responses
+inline server::HttpResponse Ok(const unsigned version, const bool keep_alive,
+                               std::shared_ptr<const std::string> shared_body)
+{
+    HttpResponse resp{bb::http::status::ok, version};
+    resp.keep_alive(keep_alive);
+    resp.set(bb::http::field::content_type, "application/json");
+    resp.shared_body(std::move(shared_body));
+    return resp;
+}
+
+inline server::HttpResponse NotModified(const unsigned version, const bool keep_alive, const std::string& etag)
+{
+    HttpResponse resp{bb::http::status::not_modified, version};
+    resp.keep_alive(keep_alive);
+    resp.set(bb::http::field::etag, etag);
+    return resp;
+}
+
+inline server::HttpResponse NotAcceptable(const unsigned version, const bool keep_alive)
+{
+    HttpResponse resp{bb::http::status::not_acceptable, version};
+    resp.keep_alive(keep_alive);
+    resp.set(bb::http::field::content_type, "text/html");
+    resp.body() = "None of the accepted media types can be served.";
+    return resp;
+}
+
 inline server::HttpResponse NotFound(const unsigned version, const bool keep_alive, const std::string& target)
 {
     HttpResponse resp{bb::http::status::not_found, version};
@@ -35,6 +63,18 @@ inline server::HttpResponse NotFound(const unsigned version, const bool keep_ali
     return resp;
 }
 
+/// @brief Response for a resource that exists but has no endpoint for the request's method
+/// @param allow Comma separated methods the resource does have endpoints for
+inline server::HttpResponse MethodNotAllowed(const unsigned version, const bool keep_alive, const std::string& allow)
+{
+    HttpResponse resp{bb::http::status::method_not_allowed, version};
+    resp.keep_alive(keep_alive);
+    resp.set(bb::http::field::allow, allow);
+    resp.set(bb::http::field::content_type, "text/html");
+    resp.body() = "Method not allowed";
+    return resp;
+}
+
 inline server::HttpResponse ServerError(const unsigned version, const bool keep_alive)
 {
     HttpResponse resp{bb::http::status::internal_server_error, version};
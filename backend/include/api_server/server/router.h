@@ -1,18 +1,26 @@
 #pragma once
 
+#include <array>
 #include <boost/algorithm/string.hpp>
 #include <boost/beast.hpp>
 #include <cstdint>
+#include <memory>
 #include <optional>
-#include <unordered_map>
+#include <string_view>
+#include <vector>
 
 #include "api_server/logger.h"
+#include "api_server/metrics/histogram.h"
 #include "api_server/server/responses.h"
 #include "api_server/server/types.h"
 
 namespace server
 {
 
+/// @brief Routes requests for the resource to a member function of the controller being constructed
+#define BIND_ENDPOINT(verb, resource, func)                                                                            \
+    router.add_route(verb, resource, [this](const HttpRequest& req) { return this->func(req); })
+
 /// @brief Interface for adding routes to Router
 class RouteHolder
 {
@@ -22,45 +30,102 @@ public:
 };
 
 /// @brief Responsible for routing HTTP requests to endpoint controllers, translating from URI strings
-/// to mapped function objects
+/// to mapped function objects.
+/// Routes are held in a trie of path segments, which requests are matched against case-insensitively and without
+/// allocating.
 class Router : public RouteHolder
 {
 public:
+    /// @brief Most path parameters a route may have
+    static constexpr std::size_t MAX_PATH_PARAMETERS{8u};
+
+    /// @brief Latencies of the responses to a route's requests, in nanoseconds
+    struct RouteLatency
+    {
+        bb::http::verb verb;
+        std::string_view resource; // As the route was added, e.g. "/api/procs/{pid}"
+        const metrics::Histogram& latency;
+    };
+
     explicit Router(const Logger& logger);
 
-    /// @brief Adds a route to an endpoint for the given HTTP method and resource name
+    /// @brief Adds a route to an endpoint for the given HTTP method and resource name.
+    /// Resource names may contain path parameters, e.g. "/api/procs/{pid}", which are captured into
+    /// HttpRequest::path_parameters()
     void add_route(const bb::http::verb verb, const std::string& resource, const Endpoint endpoint) override;
 
     /// @brief Attempt to route the request to an endpoint for handling
-    /// @return Response generated by endpoint, or bad request if endpoint not found
+    /// @return Response generated by endpoint, not found if no route matches the resource, method not allowed if
+    /// routes match the resource but not the method, or bad request if the request is malformed
     HttpResponse process_http_request(const BoostHttpRequest& boost_request);
 
     /// @brief Perform initial validation checking of a received request
-    bool validate_request(const BoostHttpRequest& boost_request, const std::string& request_id) const;
+    bool validate_request(const BoostHttpRequest& boost_request) const;
+
+    /// @brief Returns the latency histograms of every route. Responses are given the histogram of their route, which
+    /// the Server records the time taken to respond in.
+    std::vector<RouteLatency> route_latencies() const;
+
+    /// @brief Returns the latency histogram of requests that didn't match a route, or were malformed
+    const metrics::Histogram& unmatched_latency() const
+    {
+        return m_unmatched_latency;
+    }
 
 private:
-    /// @brief Generates a route key from a HTTP method and resource name, in the form {verb}:{resource}.
-    /// Resource names are case insensitive.
-    std::string route_key(const bb::http::verb verb, const std::string& resource) const;
+    /// @brief An endpoint for one method of a resource
+    struct Route
+    {
+        bb::http::verb verb;
+        Endpoint endpoint;
+        std::vector<std::string> parameter_names; // In the order they appear in the resource name
+        std::string resource;
+        std::unique_ptr<metrics::Histogram> latency;
+    };
 
-    /// @brief  Returns Endpoint for verb and resource name if found, otherwise nullopt
-    std::optional<Endpoint> lookup_endpoint(const bb::http::verb verb, const std::string& resource) const;
+    /// @brief A path segment of the resource names of routes
+    struct Node
+    {
+        std::vector<std::pair<std::string, std::unique_ptr<Node>>> children; // Literal segments, lower case
+        std::unique_ptr<Node> parameter_child;                                 // Any segment, i.e. a path parameter
+        std::vector<Route> routes; // Of the resource name ending at this segment
+    };
+
+    /// @brief Values of the path parameters captured while matching, viewing the request's resource path
+    struct ParameterValues
+    {
+        std::array<std::string_view, MAX_PATH_PARAMETERS> values{};
+        std::size_t count{0u};
+    };
 
     /// @brief Given a domain-less URI string e.g. "/some/resource?key1=value1#fragment", extracts
-    /// and stores the separate fields
-    void parse_request_target(HttpRequest& request) const;
+    /// and stores the separate fields, percent-decoding the path segments and query parameters
+    /// @return False if the target has a malformed percent-encoding
+    bool parse_request_target(HttpRequest& request) const;
 
     /// @brief For a string of query parameters, e.g. "key1=value1&key2=value2..", extracts all key-value pairs
-    /// and returns as a map
-    QueryParameters parse_query_parameters(const std::string& encoded_parameters) const;
+    /// into the request
+    /// @return False if a parameter has a malformed percent-encoding
+    bool parse_query_parameters(HttpRequest& request, std::string_view encoded_parameters) const;
+
+    /// @brief Finds the node for the path segments from `index` with at least one route, preferring literal
+    /// segments to path parameters at each level
+    /// @return The node, or nullptr if no routes match the path
+    static const Node* match(const Node& node, const PathSegments& segments, std::size_t index,
+                             ParameterValues& parameters);
+
+    /// @brief Appends the latencies of the routes of the node and its descendants
+    static void collect_latencies(const Node& node, std::vector<RouteLatency>& latencies);
+
+    /// @brief Returns true if a path segment of a route pattern is a parameter, e.g. "{pid}"
+    static bool is_path_parameter(const std::string& segment);
 
-    /// @brief Attempts to find and return an endpoint for the request, using the resource and HTTP method.
-    std::optional<Endpoint> resolve_route(const bb::http::verb verb, const HttpRequest& request) const;
+    /// @brief Splits a resource path into its non-empty segments
+    static std::vector<std::string> split_path(const std::string& resource);
 
     const Logger& m_logger;
-    std::unordered_map<std::string, Endpoint> m_routes{};
-    std::atomic<uint8_t> m_request_count{
-        0}; // Rolling identifier for requests, mostly to distinguish log messages from different threads
+    Node m_root{};
+    metrics::Histogram m_unmatched_latency;
 };
 
 } // namespace server
\ No newline at end of file
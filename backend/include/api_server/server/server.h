@@ -1,6 +1,13 @@
 #pragma once
 
+#include <atomic>
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/signal_set.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 
 #include "api_server/logger.h"
 #include "api_server/server/router.h"
@@ -9,29 +16,64 @@
 namespace server
 {
 
-/// @brief Listens for incoming HTTP requests, forwards to the request router and returns the response
+/// @brief Tuning of the Server
+struct ServerConfig
+{
+    std::size_t threads{0u};                      // Threads serving connections, 0 for one per core
+    std::chrono::seconds idle_timeout{30};        // Connections are closed after this long waiting on the client
+    std::chrono::seconds shutdown_grace_period{5}; // How long in-flight responses may take to finish on shutdown
+};
+
+/// @brief Listens for incoming HTTP requests, forwards to the request router and returns the response.
+/// Connections are accepted, read and written asynchronously on a fixed pool of threads sharing one io_context.
 class Server
 {
 public:
-    Server(const Logger& logger, Router& router, const std::string& ip_address, const std::uint16_t port);
+    Server(const Logger& logger, Router& router, const std::string& ip_address, const std::uint16_t port,
+           const ServerConfig& config = {});
 
-    /// @brief Waits (blocking) for incoming TCP connections and spins up a new
-    /// thread to handle each session
+    /// @brief Serves connections until stop() is called or SIGTERM/SIGINT is received (blocking)
     void start();
 
+    /// @brief Stops accepting connections, closes idle ones and lets in-flight responses finish within the grace
+    /// period, after which start() returns. Can be called from any thread.
+    void stop();
+
+    /// @brief Returns the port being listened on, which is chosen by the system if the server was given port 0
+    uint16_t port() const
+    {
+        return m_port;
+    }
+
 private:
-    /// @brief Attempts to read and decode HTTP requests received on the socket.
-    /// Decoded requests are forwarded to the router and the response is written back to the socket.
-    /// [Concurrent execution]
-    void process_tcp_session(boost::asio::ip::tcp::socket& socket, const uint8_t session_id);
+    class Session;
+
+    /// @brief Accepts the next connection
+    void do_accept();
+
+    /// @brief Starts a session for an accepted connection and waits for the next one
+    void on_accept(const bb::error_code& error, boost::asio::ip::tcp::socket socket);
+
+    /// @brief Runs on the acceptor's strand once stop() is called
+    void begin_shutdown();
+
+    /// @brief Forgets a closed session, finishing the shutdown once the last one closes
+    void remove_session(const uint64_t session_id);
 
     const Logger& m_logger;
     Router& m_router;
-    boost::asio::io_context m_context{1};
+    const ServerConfig m_config;
+    const std::size_t m_thread_count;
+    boost::asio::io_context m_context;
     boost::asio::ip::address m_address;
-    const uint16_t m_port;
-    boost::asio::ip::tcp::acceptor m_acceptor;
-    uint8_t m_session_id{0u};
+    uint16_t m_port;
+    boost::asio::ip::tcp::acceptor m_acceptor; // Runs on a strand, as do the signal set and shutdown timer
+    boost::asio::signal_set m_signals;
+    boost::asio::steady_timer m_shutdown_timer;
+    uint64_t m_session_id{0u};
+    std::atomic<bool> m_stopping{false};
+    std::mutex m_sessions_mutex;
+    std::unordered_map<uint64_t, std::weak_ptr<Session>> m_sessions; // Open sessions, to be closed on shutdown
 };
 
-} // namespace server
\ No newline at end of file
+} // namespace server
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "api_server/data/json_writer.h"
+#include "api_server/server/types.h"
+
+namespace server
+{
+
+/// @brief Approximate size of each chunk of a streamed body
+constexpr std::size_t STREAM_CHUNK_SIZE{64u * 1024u};
+
+/// @brief Streams a JSON array of items, serialized a chunk at a time with write_json.
+/// The items are shared rather than copied, so the memory held by a stream is bounded by the chunk size rather than
+/// the size of the body. The output is identical to data::to_json_string(*items).
+template <typename Item>
+ChunkSource json_array_chunks(std::shared_ptr<const std::vector<Item>> items,
+                              const std::size_t chunk_size = STREAM_CHUNK_SIZE)
+{
+    return [items = std::move(items), chunk_size, next = std::size_t{0u}](std::string& chunk) mutable {
+        const auto chunk_start = chunk.size();
+        if (next == 0u)
+            chunk.push_back('[');
+        while (next < items->size() && chunk.size() - chunk_start < chunk_size)
+        {
+            if (next > 0u)
+                chunk.push_back(',');
+            data::JsonWriter writer{chunk};
+            write_json(writer, (*items)[next++]);
+        }
+        if (next < items->size())
+            return true;
+        chunk.push_back(']');
+        return false;
+    };
+}
+
+} // namespace server
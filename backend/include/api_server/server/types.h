@@ -1,39 +1,144 @@
 #pragma once
 
+#include <algorithm>
 #include <boost/beast.hpp>
+#include <boost/container/small_vector.hpp>
+#include <functional>
+#include <memory>
 #include <optional>
+#include <stdexcept>
 #include <string>
-#include <unordered_map>
+#include <string_view>
 #include <vector>
 
+#include "api_server/metrics/histogram.h"
+#include "broadcast.h"
+
 namespace server
 {
 
 namespace bb = boost::beast;
 using BoostHttpRequest = bb::http::request<bb::http::string_body>;
 using BoostHttpResponse = bb::http::response<bb::http::string_body>;
-using QueryParameters = std::unordered_map<std::string, std::string>;
-using PathParameters = std::unordered_map<std::string, std::string>;
 
-class HttpRequest : public BoostHttpRequest
+/// @brief Name-value pairs of a request's query or path parameters, held inline for up to INLINE_CAPACITY pairs.
+/// Views of the request target, or of the request's decoded text where the target was percent-encoded.
+class RequestParameters
 {
-    using BoostHttpRequest::BoostHttpRequest;
+public:
+    static constexpr std::size_t INLINE_CAPACITY{8u};
+    using Parameter = std::pair<std::string_view, std::string_view>;
+    using const_iterator = boost::container::small_vector<Parameter, INLINE_CAPACITY>::const_iterator;
+
+    /// @brief Sets the parameter's value, replacing any earlier value of the same name
+    void set(const std::string_view name, const std::string_view value)
+    {
+        const auto iter = std::find_if(m_parameters.begin(), m_parameters.end(),
+                                       [name](const Parameter& parameter) { return parameter.first == name; });
+        if (iter != m_parameters.end())
+            iter->second = value;
+        else
+            m_parameters.emplace_back(name, value);
+    }
+
+    std::optional<std::string_view> find(const std::string_view name) const
+    {
+        for (const auto& [parameter_name, value] : m_parameters)
+        {
+            if (parameter_name == name)
+                return value;
+        }
+        return std::nullopt;
+    }
+
+    /// @throws std::out_of_range if there is no parameter of the name
+    std::string_view at(const std::string_view name) const
+    {
+        const auto value = find(name);
+        if (!value)
+            throw std::out_of_range{"No parameter " + std::string{name}};
+        return value.value();
+    }
+
+    std::size_t size() const
+    {
+        return m_parameters.size();
+    }
+    bool empty() const
+    {
+        return m_parameters.empty();
+    }
+    const_iterator begin() const
+    {
+        return m_parameters.begin();
+    }
+    const_iterator end() const
+    {
+        return m_parameters.end();
+    }
+
+private:
+    boost::container::small_vector<Parameter, INLINE_CAPACITY> m_parameters{};
+};
+
+using QueryParameters = RequestParameters;
+using PathParameters = RequestParameters;
+using PathSegments = boost::container::small_vector<std::string_view, 8>;
 
+/// @brief A request as routed to an endpoint: the received Beast request, with its target parsed by the Router.
+/// The parsed fields are views of the Beast request, which must outlive this request and any copies of it.
+class HttpRequest
+{
 public:
-    const std::string& resource_path() const
+    explicit HttpRequest(const BoostHttpRequest& request) : m_request{&request}
+    {
+    }
+
+    const BoostHttpRequest& base() const
+    {
+        return *m_request;
+    }
+    bb::http::verb method() const
+    {
+        return m_request->method();
+    }
+    unsigned version() const
+    {
+        return m_request->version();
+    }
+    bool keep_alive() const
+    {
+        return m_request->keep_alive();
+    }
+    std::string_view target() const
+    {
+        const auto target = m_request->target();
+        return {target.data(), target.size()};
+    }
+
+    /// @brief Returns the value of a header field, which is empty if the request does not have the field
+    std::string_view operator[](const bb::http::field field) const
+    {
+        const auto value = (*m_request)[field];
+        return {value.data(), value.size()};
+    }
+
+    /// @brief The path of the target, excluding the query and fragment, as received i.e. percent-encoded
+    std::string_view resource_path() const
     {
         return m_resource_path;
     }
-    void resource_path(const std::string& path)
+    void resource_path(const std::string_view path)
     {
         m_resource_path = path;
     }
 
-    const std::vector<std::string>& path_segments() const
+    /// @brief The non-empty segments of the resource path, percent-decoded
+    const PathSegments& path_segments() const
     {
         return m_path_segments;
     }
-    void path_segments(const std::vector<std::string>& path_segments)
+    void path_segments(const PathSegments& path_segments)
     {
         m_path_segments = path_segments;
     }
@@ -56,35 +161,125 @@ public:
         m_query_parameters = query_parameters;
     }
 
-    const std::string_view fragment() const
+    std::string_view fragment() const
     {
         return m_fragment;
     }
-    void fragment(const std::string& fragment)
+    void fragment(const std::string_view fragment)
     {
         m_fragment = fragment;
     }
 
-    std::optional<std::string> lookup_query_parameter(const std::string& name) const
+    std::optional<std::string_view> lookup_query_parameter(const std::string_view name) const
     {
-        if (m_query_parameters.find(name) != m_query_parameters.end())
-        {
-            return m_query_parameters.at(name);
-        }
-        return std::nullopt;
+        return m_query_parameters.find(name);
+    }
+
+    /// @brief Returns space to write `size` characters of text decoded from the target, which lives as long as the
+    /// request and its copies. Decoding never lengthens text, so at most target().size() characters are available.
+    char* decoded_storage(const std::size_t size)
+    {
+        if (!m_decoded)
+            m_decoded = std::make_shared<std::string>(m_request->target().size(), '\0');
+        if (m_decoded_size + size > m_decoded->size())
+            throw std::length_error{"Decoded text is longer than the request target"};
+        const auto storage = m_decoded->data() + m_decoded_size;
+        m_decoded_size += size;
+        return storage;
     }
 
 private:
-    std::string m_resource_path{};
-    std::vector<std::string> m_path_segments{};
+    const BoostHttpRequest* m_request;
+    std::string_view m_resource_path{};
+    PathSegments m_path_segments{};
     PathParameters m_path_parameters{};
     QueryParameters m_query_parameters{};
-    std::string m_fragment{""};
+    std::string_view m_fragment{};
+    std::shared_ptr<std::string> m_decoded{}; // Only allocated for percent-encoded targets, and shared by copies
+    std::size_t m_decoded_size{0u};
 };
 
+/// @brief Appends the next part of a streamed body to `chunk`, returning false once the body is complete
+using ChunkSource = std::function<bool(std::string& chunk)>;
+
 class HttpResponse : public BoostHttpResponse
 {
     using BoostHttpResponse::BoostHttpResponse;
+
+public:
+    /// @brief A body shared with other responses, e.g. from the response cache. If set, it is sent instead of body().
+    const std::shared_ptr<const std::string>& shared_body() const
+    {
+        return m_shared_body;
+    }
+    void shared_body(std::shared_ptr<const std::string> shared_body)
+    {
+        m_shared_body = std::move(shared_body);
+    }
+
+    /// @brief A body produced a chunk at a time as it is sent, with chunked transfer encoding. If set, it is sent
+    /// instead of body().
+    const ChunkSource& chunk_source() const
+    {
+        return m_chunk_source;
+    }
+    void chunk_source(ChunkSource chunk_source)
+    {
+        m_chunk_source = std::move(chunk_source);
+        chunked(true);
+    }
+
+    /// @brief Produces the whole of a streamed body into body(), e.g. for HTTP/1.0 clients that can't receive
+    /// chunked transfer encoding
+    void collect_chunks()
+    {
+        if (!m_chunk_source)
+            return;
+        auto source = std::move(m_chunk_source);
+        m_chunk_source = nullptr;
+        chunked(false);
+        auto& collected = body();
+        collected.clear();
+        while (source(collected))
+        {
+        }
+        prepare_payload();
+    }
+
+    /// @brief A subscription whose messages are sent as the body, one after another, until it is closed. If set, it is
+    /// sent instead of body(), e.g. for Server-Sent Events.
+    const std::shared_ptr<Subscription>& event_stream() const
+    {
+        return m_event_stream;
+    }
+    void event_stream(std::shared_ptr<Subscription> event_stream)
+    {
+        m_event_stream = std::move(event_stream);
+        chunked(true);
+    }
+
+    /// @brief Where the server records the time taken to respond, from receiving the request to sending the last of
+    /// the response. Set by the Router to the histogram of the request's route.
+    metrics::Histogram* latency_histogram() const
+    {
+        return m_latency_histogram;
+    }
+    void latency_histogram(metrics::Histogram* latency_histogram)
+    {
+        m_latency_histogram = latency_histogram;
+    }
+
+    /// @brief Returns the body that will be sent, which is empty for a streamed body
+    std::string_view payload() const
+    {
+        return m_shared_body ? std::string_view{*m_shared_body} : std::string_view{body()};
+    }
+
+private:
+    std::shared_ptr<const std::string> m_shared_body{};
+    ChunkSource m_chunk_source{};
+    std::shared_ptr<Subscription> m_event_stream{};
+    metrics::Histogram* m_latency_histogram{nullptr};
 };
 
 using Endpoint = std::function<HttpResponse(const HttpRequest&)>;
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "api_server/data/datastore.h"
+#include "api_server/logger.h"
+#include "api_server/shm/segment.h"
+
+namespace shm
+{
+
+/// @brief Writes each generation published by the datastore to a POSIX shared memory segment, in the layout of
+/// shm/segment.h, for ShmReader to read.
+/// The segment is created when the exporter is, and unlinked when it is destroyed, although readers that still have it
+/// mapped can go on reading the last generation. The exporter holds a lock on the segment meanwhile, so that a second
+/// exporter of the same name fails rather than taking it over, while one left by an exporter that crashed is replaced.
+/// Generations are written on the monitor's thread once published; only copying them into the segment is inside the
+/// seqlock.
+class ShmExporter
+{
+public:
+    /// @brief The exporter must outlive the datastore's publishing
+    /// @param name Of the segment, e.g. "/task-manager"
+    /// @throw std::runtime_error if the segment can't be created, or another exporter is using it
+    ShmExporter(const Logger& logger, data::DataStore& datastore, const std::string& name,
+                const std::size_t segment_size = DEFAULT_SEGMENT_SIZE);
+    ~ShmExporter();
+
+    ShmExporter(const ShmExporter&) = delete;
+    ShmExporter& operator=(const ShmExporter&) = delete;
+
+    /// @brief Writes the latest generation to the segment. Called by the monitor's thread.
+    void export_snapshot(const data::Snapshot& snapshot);
+
+private:
+    /// @brief Returns the process table of the snapshot, or of the processes using the most CPU that fit in `size`
+    /// bytes, setting `truncated` if some were left out
+    std::string encode_procs(const data::Snapshot& snapshot, const std::size_t size, bool& truncated) const;
+
+    const Logger& m_logger;
+    const std::string m_name;
+    const std::size_t m_segment_size;
+    int m_fd{-1}; // Of the segment, kept open for its lock
+    SegmentHeader* m_header{nullptr}; // Start of the mapping
+    bool m_warned_truncated{false};
+};
+
+} // namespace shm
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "api_server/data/proctable.h"
+#include "api_server/data/types.h"
+#include "api_server/shm/segment.h"
+
+namespace shm
+{
+
+/// @brief One generation read from the segment
+struct ShmSnapshot
+{
+    uint64_t generation{0u};
+    double uptime_seconds{0.0};
+    data::MemSnapshot mem;
+    float cpu_usage_percent{0.0f};          // Of all CPUs together
+    std::vector<float> core_usage_percent;  // By core number
+    std::vector<data::ProcSnapshot> procs;
+    bool truncated{false};                  // Only the processes using the most CPU fit in the segment
+};
+
+/// @brief Reads the generations that an ShmExporter writes to a shared memory segment, for local consumers such as
+/// sidecars. The segment is mapped once, when the reader is created, after which reads take no locks or system calls
+/// unless they catch the writer mid-generation, so they are cheap enough for every tick of a consumer's loop.
+/// generation() is cheaper still, for checking whether there is anything new.
+/// A reader keeps the segment it opened mapped, so it has to be recreated if the exporting api_server restarts.
+class ShmReader
+{
+public:
+    /// @brief How long reads wait for the writer to finish a generation before giving up
+    static constexpr std::chrono::milliseconds MAX_WAIT{1000};
+
+    /// @throw std::runtime_error if there is no segment of that name, or it isn't of a supported version
+    explicit ShmReader(const std::string& name);
+    ~ShmReader();
+
+    ShmReader(const ShmReader&) = delete;
+    ShmReader& operator=(const ShmReader&) = delete;
+
+    /// @brief Returns the generation last written, 0 if none yet or the writer was always mid-generation
+    uint64_t generation() const;
+
+    /// @brief Copies out the generation last written
+    /// @return nullopt if none has been yet, or the writer was always mid-generation (e.g. it died while writing)
+    std::optional<ShmSnapshot> read();
+
+private:
+    const SegmentHeader* m_header{nullptr}; // Start of the mapping
+    std::size_t m_segment_size{0u};
+    std::string m_buffer; // Of the last read, reused to avoid allocating on every read
+};
+
+} // namespace shm
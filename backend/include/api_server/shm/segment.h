@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace shm
+{
+
+/// @brief Layout of the POSIX shared memory segment that each generation is exported to, for local consumers that
+/// would rather mmap it than request /api/procs. Fields are in the host's byte order, as the segment never leaves it.
+///
+///   Header (64 bytes)
+///     char[4]   magic               "TMSH"
+///     uint16    version             Changes only when the layout changes incompatibly
+///     uint16    header_size         Fields may be appended to the header without a version change
+///     uint64    segment_size        Size of the whole mapping, fixed when the segment is created
+///     uint64    sequence            Seqlock: odd while a generation is being written, 0 until the first
+///     uint64    generation
+///     float64   uptime_seconds
+///     uint32    total_memory_kB
+///     uint32    free_memory_kB
+///     float32   mem_usage_percent
+///     float32   cpu_usage_percent   Of all CPUs together
+///     uint16    core_count
+///     uint16    flags               Bit 0: not every process fit, so the table has those using the most CPU
+///     uint32    table_size
+///   Core usage (core_count * float32), by core number
+///   Process table (table_size bytes), in the layout of data/proctable.h
+///
+/// The writer increments the sequence before and after writing a generation. A reader copies what it needs between
+/// two loads of the sequence and keeps the copy only if both loads were the same even number, otherwise the writer
+/// was in the middle of a generation and it reads again. Reads take no locks or system calls, so a reader can never
+/// block the monitor.
+/// The fields after the sequence are atomics, stored and loaded with relaxed ordering between the sequence's fences, so
+/// that a reader catching the writer mid-generation loads values it then discards rather than racing with it. The
+/// fields before the sequence are written once, when the segment is created.
+struct SegmentHeader
+{
+    char magic[4];
+    uint16_t version;
+    uint16_t header_size;
+    uint64_t segment_size;
+    std::atomic<uint64_t> sequence;
+    std::atomic<uint64_t> generation;
+    std::atomic<double> uptime_seconds;
+    std::atomic<uint32_t> total_memory_kB;
+    std::atomic<uint32_t> free_memory_kB;
+    std::atomic<float> mem_usage_percent;
+    std::atomic<float> cpu_usage_percent;
+    std::atomic<uint16_t> core_count;
+    std::atomic<uint16_t> flags;
+    std::atomic<uint32_t> table_size;
+};
+
+constexpr std::string_view MAGIC{"TMSH"};
+constexpr uint16_t VERSION{1u};
+constexpr uint16_t FLAG_TRUNCATED{1u << 0};
+
+/// @brief Default size of a segment, enough for the process table of about 60 000 processes. Pages of the segment
+/// that are never written aren't allocated.
+constexpr std::size_t DEFAULT_SEGMENT_SIZE{16u * 1024u * 1024u};
+
+static_assert(sizeof(SegmentHeader) == 64u, "The segment header is part of the exported layout");
+static_assert(offsetof(SegmentHeader, sequence) == 16u, "The segment header is part of the exported layout");
+static_assert(offsetof(SegmentHeader, table_size) == 60u, "The segment header is part of the exported layout");
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free &&
+                  std::atomic<uint16_t>::is_always_lock_free && std::atomic<double>::is_always_lock_free &&
+                  std::atomic<float>::is_always_lock_free,
+              "The header's atomics are shared between processes");
+
+} // namespace shm
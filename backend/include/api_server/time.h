@@ -1,19 +1,43 @@
 #pragma once
 
 #include <chrono>
-#include <iomanip>
-#include <sstream>
+#include <ctime>
 #include <string>
+#include <string_view>
+#include <time.h>
 
-inline std::string timestamp(const std::chrono::system_clock::time_point& tp)
+/// @brief Formats the time to the second in local time, reusing the thread's last result while the second is the same
+/// @return A view that is valid until the thread's next call
+inline std::string_view cached_timestamp(const std::chrono::system_clock::time_point& tp)
 {
+    thread_local std::time_t cached_time{-1};
+    thread_local char formatted[32];
+    thread_local std::size_t formatted_size{0u};
     const std::time_t tt = std::chrono::system_clock::to_time_t(tp);
-    std::stringstream ss;
-    ss << std::put_time(std::localtime(&tt), "%Y-%m-%d %X");
-    return ss.str();
+    if (tt != cached_time)
+    {
+        std::tm local_time{};
+        localtime_r(&tt, &local_time);
+        formatted_size = std::strftime(formatted, sizeof(formatted), "%Y-%m-%d %X", &local_time);
+        cached_time = tt;
+    }
+    return {formatted, formatted_size};
+}
+
+inline std::string timestamp(const std::chrono::system_clock::time_point& tp)
+{
+    return std::string{cached_timestamp(tp)};
 }
 
 inline std::string timestamp()
 {
     return timestamp(std::chrono::system_clock::now());
 }
+
+/// @brief Returns the time since boot in seconds, on the same clock as /proc/uptime
+inline double uptime_seconds()
+{
+    timespec ts{};
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) / 1e9;
+}
@@ -0,0 +1,191 @@
+#include "api_server/async_logger.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fmt/format.h>
+
+namespace
+{
+
+/// @brief Messages moved into the batches before they are written
+constexpr std::size_t MAX_BATCH_RECORDS{1024u};
+
+std::size_t round_up_to_power_of_two(const std::size_t value)
+{
+    std::size_t power{1u};
+    while (power < value)
+        power <<= 1;
+    return power;
+}
+
+void write_stream(std::FILE* stream, const std::string& batch)
+{
+    if (batch.empty())
+        return;
+    std::fwrite(batch.data(), 1, batch.size(), stream);
+    std::fflush(stream);
+}
+
+} // namespace
+
+AsyncLogger::AsyncLogger(const LogLevel level, const AsyncLoggerConfig& config)
+    : Logger{level}, m_config{config},
+      m_mask{round_up_to_power_of_two(std::max<std::size_t>(config.capacity, 2u)) - 1},
+      m_slots{std::make_unique<Slot[]>(m_mask + 1)}
+{
+    for (std::size_t i = 0; i <= m_mask; ++i)
+        m_slots[i].sequence.store(i, std::memory_order_relaxed);
+    if (!m_config.file_path.empty())
+        open_file();
+    m_writer = std::thread{&AsyncLogger::run, this};
+}
+
+AsyncLogger::~AsyncLogger()
+{
+    m_running.store(false);
+    m_writer.join();
+    if (m_file)
+        std::fclose(m_file);
+}
+
+void AsyncLogger::flush() const
+{
+    const auto position = m_enqueue_position.load();
+    while (m_written_position.load() < position)
+        std::this_thread::sleep_for(std::chrono::milliseconds{1});
+}
+
+void AsyncLogger::write(const LogLevel level, const std::string_view message) const
+{
+    // Bounded MPMC queue (D. Vyukov), with a single consumer: a slot is free to write at position p when its
+    // sequence is p, and readable once the producer has set it to p + 1
+    auto position = m_enqueue_position.load(std::memory_order_relaxed);
+    Slot* slot;
+    while (true)
+    {
+        slot = &m_slots[position & m_mask];
+        const auto sequence = slot->sequence.load(std::memory_order_acquire);
+        const auto difference = static_cast<int64_t>(sequence) - static_cast<int64_t>(position);
+        if (difference == 0)
+        {
+            if (m_enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (difference < 0)
+        {
+            // The writer hasn't freed this slot since the last lap, i.e. the ring is full
+            m_dropped.fetch_add(1u, std::memory_order_relaxed);
+            return;
+        }
+        else
+        {
+            position = m_enqueue_position.load(std::memory_order_relaxed);
+        }
+    }
+    slot->level = level;
+    slot->message.assign(message);
+    slot->sequence.store(position + 1, std::memory_order_release);
+}
+
+void AsyncLogger::run()
+{
+    while (true)
+    {
+        // Read the flag before draining, so that messages logged before it was cleared are written before exiting
+        const auto running = m_running.load();
+        const auto drained = drain();
+        write_batches();
+        m_written_position.store(m_dequeue_position);
+        if (!running && !drained)
+            return;
+        if (!drained)
+            std::this_thread::sleep_for(m_config.poll_interval);
+    }
+}
+
+bool AsyncLogger::drain()
+{
+    auto& position = m_dequeue_position;
+    std::size_t records{0u};
+    for (; records < MAX_BATCH_RECORDS; ++records)
+    {
+        auto& slot = m_slots[position & m_mask];
+        if (slot.sequence.load(std::memory_order_acquire) != position + 1)
+            break;
+        auto& batch = slot.level == LogLevel::Error && !m_file ? m_error_batch : m_batch;
+        batch.append(slot.message);
+        batch.push_back('\n');
+        slot.sequence.store(position + m_mask + 1, std::memory_order_release);
+        ++position;
+    }
+
+    const auto dropped = m_dropped.load(std::memory_order_relaxed);
+    if (dropped != m_dropped_reported)
+    {
+        auto& batch = m_file ? m_batch : m_error_batch;
+        batch.append(fmt::format("AsyncLogger - dropped {} messages, the writer fell behind\n",
+                                 dropped - m_dropped_reported));
+        m_dropped_reported = dropped;
+    }
+    return records > 0u;
+}
+
+void AsyncLogger::write_batches()
+{
+    if (m_file)
+    {
+        if (m_config.rotate_size > 0u && m_file_size > 0u && m_file_size + m_batch.size() > m_config.rotate_size)
+            rotate_file();
+        if (m_file)
+        {
+            write_stream(m_file, m_batch);
+            m_file_size += m_batch.size();
+        }
+        else
+        {
+            write_stream(stdout, m_batch);
+        }
+    }
+    else
+    {
+        write_stream(stdout, m_batch);
+        write_stream(stderr, m_error_batch);
+    }
+    m_batch.clear();
+    m_error_batch.clear();
+}
+
+void AsyncLogger::open_file()
+{
+    m_file = std::fopen(m_config.file_path.c_str(), "a");
+    if (!m_file)
+    {
+        std::fprintf(stderr, "AsyncLogger - unable to open %s, logging to stdout\n", m_config.file_path.c_str());
+        return;
+    }
+    std::fseek(m_file, 0, SEEK_END);
+    m_file_size = static_cast<std::size_t>(std::max(0L, std::ftell(m_file)));
+}
+
+void AsyncLogger::rotate_file()
+{
+    std::fclose(m_file);
+    m_file = nullptr;
+    std::error_code error;
+    const auto rotated_path = [this](const std::size_t index) {
+        return fmt::format("{}.{}", m_config.file_path, index);
+    };
+    if (m_config.rotated_files == 0u)
+    {
+        std::filesystem::remove(m_config.file_path, error);
+    }
+    else
+    {
+        std::filesystem::remove(rotated_path(m_config.rotated_files), error);
+        for (auto index = m_config.rotated_files - 1; index > 0u; --index)
+            std::filesystem::rename(rotated_path(index), rotated_path(index + 1), error);
+        std::filesystem::rename(m_config.file_path, rotated_path(1), error);
+    }
+    open_file();
+}
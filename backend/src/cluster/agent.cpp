@@ -0,0 +1,239 @@
+#include <api_server/cluster/agent.h>
+
+#include <fmt/format.h>
+
+namespace cluster
+{
+namespace asio = boost::asio;
+using asio::ip::tcp;
+
+namespace
+{
+
+/// @brief The datasets fetched from each agent, as one consistent snapshot
+constexpr char SNAPSHOT_TARGET[]{"/api/snapshot?fields=uptime,cpus,mem,procs"};
+
+data::ProcSnapshot decode_proc(const nlohmann::json& json, const double snapshot_time)
+{
+    data::ProcSnapshot proc;
+    proc.snapshot_time = snapshot_time;
+    proc.pid = json.at("pid").get<int32_t>();
+    proc.ppid = json.at("ppid").get<int32_t>();
+    proc.name = json.at("name").get<std::string>();
+    proc.command = json.at("command").get<std::string>();
+    proc.cpu_usage_percent = json.at("cpu_usage_percent").get<float>();
+    proc.mem_usage_percent = json.at("mem_usage_percent").get<float>();
+    proc.cgroup = json.value("cgroup", "");
+    if (const auto smaps = json.find("smaps"); smaps != json.end() && smaps->is_object())
+    {
+        data::SmapsSample sample;
+        sample.pss_kB = smaps->at("pss_kB").get<uint32_t>();
+        sample.uss_kB = smaps->at("uss_kB").get<uint32_t>();
+        sample.swap_kB = smaps->at("swap_kB").get<uint32_t>();
+        sample.sample_time = snapshot_time - smaps->at("age_seconds").get<double>();
+        proc.smaps = sample;
+    }
+    return proc;
+}
+
+} // namespace
+
+data::Snapshot decode_agent_snapshot(const std::string_view msgpack)
+{
+    const auto json = nlohmann::json::from_msgpack(msgpack.begin(), msgpack.end());
+    data::Snapshot snapshot;
+    snapshot.generation = json.at("generation").get<uint64_t>();
+    if (const auto iter = json.find("uptime"); iter != json.end())
+    {
+        data::Uptime uptime;
+        uptime.hours = iter->at("hours").get<uint32_t>();
+        uptime.minutes = iter->at("minutes").get<uint8_t>();
+        uptime.seconds = iter->at("seconds").get<uint8_t>();
+        uptime.total_seconds = iter->at("total_seconds").get<double>();
+        uptime.formatted = iter->value("formatted", "");
+        snapshot.uptime = uptime;
+    }
+    if (const auto iter = json.find("cpus"); iter != json.end())
+    {
+        auto& cpus = snapshot.cpus.emplace();
+        for (const auto& cpu_json : *iter)
+        {
+            data::CpuSnapshot cpu;
+            cpu.id = cpu_json.at("id").get<std::string>();
+            cpu.usage_percent = cpu_json.at("usage_percent").get<float>();
+            cpus.push_back(std::move(cpu));
+        }
+    }
+    if (const auto iter = json.find("mem"); iter != json.end())
+    {
+        data::MemSnapshot mem;
+        mem.total_memory_kB = iter->at("total_memory_kB").get<uint32_t>();
+        mem.free_memory_kB = iter->at("free_memory_kB").get<uint32_t>();
+        mem.usage_percent = iter->at("usage_percent").get<float>();
+        snapshot.mem = mem;
+    }
+    if (const auto iter = json.find("procs"); iter != json.end())
+    {
+        const auto snapshot_time = snapshot.uptime ? snapshot.uptime->total_seconds : 0.0;
+        auto procs = std::make_shared<std::vector<data::ProcSnapshot>>();
+        procs->reserve(iter->size());
+        for (const auto& proc_json : *iter)
+            procs->push_back(decode_proc(proc_json, snapshot_time));
+        snapshot.procs = std::move(procs);
+    }
+    return snapshot;
+}
+
+AgentClient::AgentClient(asio::io_context& context, AgentEndpoint agent, const std::chrono::milliseconds timeout)
+    : m_agent{std::move(agent)}, m_timeout{timeout}, m_resolver{context}, m_stream{context}
+{
+    m_request = {bb::http::verb::get, SNAPSHOT_TARGET, 11};
+    m_request.set(bb::http::field::host, m_agent.host);
+    m_request.set(bb::http::field::accept, "application/msgpack");
+    m_request.keep_alive(true);
+}
+
+void AgentClient::fetch(Handler handler)
+{
+    m_handler = std::move(handler);
+    m_start = std::chrono::steady_clock::now();
+    m_reused = m_connected;
+    if (m_etag.empty())
+        m_request.erase(bb::http::field::if_none_match);
+    else
+        m_request.set(bb::http::field::if_none_match, m_etag);
+
+    if (m_connected)
+        write();
+    else if (m_endpoints)
+        connect();
+    else
+        resolve();
+}
+
+void AgentClient::close()
+{
+    m_resolver.cancel();
+    bb::error_code ignored;
+    m_stream.socket().shutdown(tcp::socket::shutdown_both, ignored);
+    m_stream.close();
+    m_connected = false;
+}
+
+void AgentClient::resolve()
+{
+    m_resolver.async_resolve(m_agent.host, m_agent.port,
+                             [self = shared_from_this()](const bb::error_code& error,
+                                                         tcp::resolver::results_type results) {
+                                 if (error)
+                                 {
+                                     self->on_error(error, "resolve");
+                                     return;
+                                 }
+                                 self->m_endpoints = std::move(results);
+                                 self->connect();
+                             });
+}
+
+void AgentClient::connect()
+{
+    m_stream.expires_after(m_timeout);
+    m_stream.async_connect(m_endpoints.value(),
+                           [self = shared_from_this()](const bb::error_code& error, const tcp::endpoint&) {
+                               if (error)
+                               {
+                                   self->on_error(error, "connect");
+                                   return;
+                               }
+                               self->m_connected = true;
+                               self->m_buffer.clear();
+                               self->write();
+                           });
+}
+
+void AgentClient::write()
+{
+    m_stream.expires_after(m_timeout);
+    bb::http::async_write(m_stream, m_request,
+                          [self = shared_from_this()](const bb::error_code& error, const std::size_t) {
+                              if (error)
+                              {
+                                  self->on_error(error, "send");
+                                  return;
+                              }
+                              self->read();
+                          });
+}
+
+void AgentClient::read()
+{
+    m_parser.emplace();
+    m_parser->body_limit(MAX_BODY_SIZE);
+    bb::http::async_read(m_stream, m_buffer, *m_parser,
+                         [self = shared_from_this()](const bb::error_code& error, const std::size_t) {
+                             self->on_response(error);
+                         });
+}
+
+void AgentClient::on_response(const bb::error_code& error)
+{
+    if (error)
+    {
+        on_error(error, "receive");
+        return;
+    }
+    auto response = m_parser->release();
+    if (!response.keep_alive())
+        close();
+
+    FetchResult result;
+    if (response.result() == bb::http::status::not_modified)
+    {
+        result.status = FetchResult::Status::Unchanged;
+    }
+    else if (response.result() != bb::http::status::ok)
+    {
+        result.error = fmt::format("HTTP {}", response.result_int());
+    }
+    else
+    {
+        try
+        {
+            result.snapshot = decode_agent_snapshot(response.body());
+            result.status = FetchResult::Status::Updated;
+            m_etag = std::string{response[bb::http::field::etag]};
+        }
+        catch (const nlohmann::json::exception& exception)
+        {
+            result.error = fmt::format("Invalid snapshot: {}", exception.what());
+        }
+    }
+    finish(std::move(result));
+}
+
+void AgentClient::on_error(const bb::error_code& error, const std::string_view step)
+{
+    const auto was_reused = m_reused;
+    close();
+    // An agent closes connections that were idle too long, which is only noticed once a request is sent on it
+    if (was_reused && error != bb::error::timeout && error != asio::error::operation_aborted && m_handler)
+    {
+        m_reused = false;
+        connect();
+        return;
+    }
+    FetchResult result;
+    result.error = fmt::format("Failed to {}: {}", step, error.message());
+    finish(std::move(result));
+}
+
+void AgentClient::finish(FetchResult result)
+{
+    result.duration = std::chrono::steady_clock::now() - m_start;
+    auto handler = std::move(m_handler);
+    m_handler = nullptr;
+    if (handler)
+        handler(std::move(result));
+}
+
+} // namespace cluster
@@ -0,0 +1,99 @@
+#include <api_server/cluster/aggregator.h>
+
+#include <algorithm>
+#include <boost/asio/post.hpp>
+
+namespace cluster
+{
+
+Aggregator::Aggregator(const Logger& logger, ClusterStore& store, const AggregatorConfig& config)
+    : m_logger{logger}, m_store{store}, m_config{config}, m_timer{m_context}
+{
+    // In the store's order, so that a client's index is also its node's
+    for (const auto& node : store.nodes())
+        m_clients.push_back(std::make_shared<AgentClient>(m_context, node->agent, config.timeout));
+}
+
+void Aggregator::start()
+{
+    m_logger.debug("Aggregator::start - polling {} agents", m_clients.size());
+    m_next_poll = std::chrono::steady_clock::now();
+    boost::asio::post(m_context, [this] { begin_poll(true); });
+    m_context.run();
+}
+
+void Aggregator::stop()
+{
+    m_context.stop();
+}
+
+void Aggregator::poll_once()
+{
+    m_context.restart();
+    boost::asio::post(m_context, [this] { begin_poll(false); });
+    // Kept-alive connections don't keep the context running, so this returns once the last fetch finishes
+    m_context.run();
+}
+
+void Aggregator::begin_poll(const bool schedule_next)
+{
+    for (std::size_t i = 0; i < m_clients.size(); ++i)
+    {
+        const auto queued = std::find(m_queue.begin(), m_queue.end(), i) != m_queue.end();
+        if (m_clients[i]->busy() || queued)
+        {
+            m_logger.debug("Aggregator::begin_poll - skipping {}, still fetching", m_clients[i]->agent().node);
+            continue;
+        }
+        m_queue.push_back(i);
+    }
+    fetch_queued();
+
+    if (!schedule_next)
+        return;
+    // Polls start at a fixed rate, unless one took so long that the next is already due
+    m_next_poll = std::max(m_next_poll + m_config.poll_interval, std::chrono::steady_clock::now());
+    m_timer.expires_at(m_next_poll);
+    m_timer.async_wait([this](const boost::system::error_code& error) {
+        if (!error)
+            begin_poll(true);
+    });
+}
+
+void Aggregator::fetch_queued()
+{
+    while (m_in_flight < std::max<std::size_t>(m_config.max_concurrency, 1u) && !m_queue.empty())
+    {
+        const auto index = m_queue.front();
+        m_queue.pop_front();
+        ++m_in_flight;
+        m_clients[index]->fetch([this, index](FetchResult result) { on_fetched(index, std::move(result)); });
+    }
+}
+
+void Aggregator::on_fetched(const std::size_t index, FetchResult result)
+{
+    --m_in_flight;
+    const auto& node = m_clients[index]->agent().node;
+    // Changes of reachability are logged, rather than every failure of an agent that is down
+    const auto failures = m_store.nodes()[index]->failures;
+    switch (result.status)
+    {
+    case FetchResult::Status::Updated:
+        if (failures > 0u)
+            m_logger.info("Aggregator::on_fetched - {} is reachable again", node);
+        m_store.update(node, std::move(result.snapshot), result.duration);
+        break;
+    case FetchResult::Status::Unchanged:
+        m_store.mark_unchanged(node, result.duration);
+        break;
+    case FetchResult::Status::Failed:
+        if (failures == 0u)
+            m_logger.warning("Aggregator::on_fetched - {} is unreachable: {}", node, result.error);
+        m_store.mark_failed(node, result.error, result.duration);
+        break;
+    }
+    fetch_queued();
+}
+
+} // namespace cluster
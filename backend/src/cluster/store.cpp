@@ -0,0 +1,230 @@
+#include <api_server/cluster/store.h>
+
+#include <algorithm>
+#include <numeric>
+#include <queue>
+#include <stdexcept>
+
+namespace cluster
+{
+
+namespace
+{
+
+float order_value(const data::ProcSnapshot& proc, const ProcOrder order)
+{
+    return order == ProcOrder::Cpu ? proc.cpu_usage_percent : proc.mem_usage_percent;
+}
+
+/// @brief Returns the indices of the processes sorted in the order, ties broken by PID
+std::vector<uint32_t> sorted_indices(const std::vector<data::ProcSnapshot>& procs, const ProcOrder order)
+{
+    std::vector<uint32_t> indices(procs.size());
+    std::iota(indices.begin(), indices.end(), 0u);
+    std::sort(indices.begin(), indices.end(), [&procs, order](const uint32_t a, const uint32_t b) {
+        const auto value_a = order_value(procs[a], order);
+        const auto value_b = order_value(procs[b], order);
+        if (value_a != value_b)
+            return value_a > value_b;
+        return procs[a].pid < procs[b].pid;
+    });
+    return indices;
+}
+
+} // namespace
+
+AgentEndpoint parse_agent_endpoint(const std::string_view spec)
+{
+    AgentEndpoint agent;
+    auto address = spec;
+    if (const auto equals = spec.find('='); equals != std::string_view::npos)
+    {
+        agent.node = std::string{spec.substr(0, equals)};
+        address = spec.substr(equals + 1u);
+    }
+    const auto colon = address.rfind(':');
+    if (colon == std::string_view::npos || colon == 0u || colon + 1u == address.size())
+        throw std::runtime_error{"Agent " + std::string{spec} + " is not [node=]host:port"};
+    agent.host = std::string{address.substr(0, colon)};
+    agent.port = std::string{address.substr(colon + 1u)};
+    if (agent.node.empty())
+        agent.node = std::string{address};
+    return agent;
+}
+
+ClusterStore::ClusterStore(const std::vector<AgentEndpoint>& agents)
+{
+    for (const auto& agent : agents)
+    {
+        if (!m_node_indices.emplace(agent.node, m_nodes.size()).second)
+            throw std::runtime_error{"Agent node " + agent.node + " is given more than once"};
+        auto state = std::make_shared<NodeState>();
+        state->agent = agent;
+        state->error = "Not fetched yet";
+        m_nodes.push_back(std::move(state));
+    }
+}
+
+template <typename Change>
+void ClusterStore::modify(const std::string& node, const bool changes_results, Change change)
+{
+    const auto index = m_node_indices.at(node);
+    std::shared_ptr<const NodeState> current;
+    {
+        const std::lock_guard lock{m_mutex};
+        current = m_nodes[index];
+    }
+    // Only the aggregator modifies a node, one fetch at a time, so nothing replaces it while the copy is changed
+    auto state = std::make_shared<NodeState>(*current);
+    change(*state);
+    {
+        const std::lock_guard lock{m_mutex};
+        m_nodes[index] = std::move(state);
+    }
+    if (changes_results)
+        m_generation.fetch_add(1u, std::memory_order_acq_rel);
+}
+
+void ClusterStore::update(const std::string& node, data::Snapshot snapshot,
+                          const std::chrono::nanoseconds fetch_duration)
+{
+    const auto& procs = *snapshot.procs.value_or(std::make_shared<const std::vector<data::ProcSnapshot>>());
+    auto by_cpu = sorted_indices(procs, ProcOrder::Cpu);
+    auto by_mem = sorted_indices(procs, ProcOrder::Mem);
+    modify(node, true, [&](NodeState& state) {
+        state.reachable = true;
+        state.error.clear();
+        state.updated = std::chrono::steady_clock::now();
+        state.fetch_duration = fetch_duration;
+        state.failures = 0u;
+        state.snapshot = std::move(snapshot);
+        state.by_cpu = std::move(by_cpu);
+        state.by_mem = std::move(by_mem);
+    });
+}
+
+void ClusterStore::mark_unchanged(const std::string& node, const std::chrono::nanoseconds fetch_duration)
+{
+    modify(node, false, [&](NodeState& state) {
+        state.updated = std::chrono::steady_clock::now();
+        state.fetch_duration = fetch_duration;
+    });
+}
+
+void ClusterStore::mark_failed(const std::string& node, const std::string& error,
+                               const std::chrono::nanoseconds fetch_duration)
+{
+    const auto index = m_node_indices.at(node);
+    bool was_reachable;
+    {
+        const std::lock_guard lock{m_mutex};
+        was_reachable = m_nodes[index]->reachable;
+    }
+    modify(node, was_reachable, [&](NodeState& state) {
+        state.reachable = false;
+        state.error = error;
+        state.fetch_duration = fetch_duration;
+        ++state.failures;
+    });
+}
+
+std::vector<std::shared_ptr<const NodeState>> ClusterStore::nodes() const
+{
+    const std::lock_guard lock{m_mutex};
+    return m_nodes;
+}
+
+std::vector<ClusterProc> ClusterStore::top_procs(const std::size_t count, const ProcOrder order) const
+{
+    // Each node's processes are already sorted, so the top of the cluster is a merge of the top of each node
+    struct Cursor
+    {
+        const NodeState* node;
+        const std::vector<data::ProcSnapshot>* procs;
+        const std::vector<uint32_t>* indices;
+        std::size_t position;
+
+        const data::ProcSnapshot& proc() const
+        {
+            return (*procs)[(*indices)[position]];
+        }
+    };
+    const auto after = [order](const Cursor& a, const Cursor& b) {
+        const auto value_a = order_value(a.proc(), order);
+        const auto value_b = order_value(b.proc(), order);
+        if (value_a != value_b)
+            return value_a < value_b;
+        if (a.node->agent.node != b.node->agent.node)
+            return a.node->agent.node > b.node->agent.node;
+        return a.proc().pid > b.proc().pid;
+    };
+
+    const auto nodes = this->nodes();
+    std::priority_queue<Cursor, std::vector<Cursor>, decltype(after)> heads{after};
+    std::size_t procs{0u};
+    for (const auto& node : nodes)
+    {
+        if (!node->reachable || !node->snapshot.procs || node->snapshot.procs.value()->empty())
+            continue;
+        heads.push({node.get(), node->snapshot.procs.value().get(),
+                    order == ProcOrder::Cpu ? &node->by_cpu : &node->by_mem, 0u});
+        procs += node->snapshot.procs.value()->size();
+    }
+
+    // The count comes from the request, so it can be far more than there are processes
+    std::vector<ClusterProc> top;
+    top.reserve(std::min(count, procs));
+    while (top.size() < count && !heads.empty())
+    {
+        auto head = heads.top();
+        heads.pop();
+        top.push_back({head.node->agent.node, head.proc()});
+        if (++head.position < head.indices->size())
+            heads.push(head);
+    }
+    return top;
+}
+
+ClusterSummary ClusterStore::summary() const
+{
+    ClusterSummary summary;
+    summary.generation = generation();
+    const auto nodes = this->nodes();
+    summary.nodes = static_cast<uint32_t>(nodes.size());
+    double cpu_usage_sum{0.0}; // Of each node's usage of all its CPUs, weighted by their count
+    for (const auto& node : nodes)
+    {
+        if (!node->reachable)
+            continue;
+        const auto& snapshot = node->snapshot;
+        ++summary.nodes_reachable;
+        if (snapshot.procs)
+            summary.processes += snapshot.procs.value()->size();
+        if (snapshot.cpus)
+        {
+            // /proc/stat's first row is the total of all CPUs, followed by a row per CPU
+            const auto& cpus = snapshot.cpus.value();
+            const auto total = std::find_if(cpus.begin(), cpus.end(),
+                                            [](const data::CpuSnapshot& cpu) { return cpu.id == "cpu"; });
+            const auto cpu_count = static_cast<uint32_t>(cpus.size() - (total != cpus.end() ? 1u : 0u));
+            summary.cpus += cpu_count;
+            if (total != cpus.end())
+                cpu_usage_sum += static_cast<double>(total->usage_percent) * cpu_count;
+        }
+        if (snapshot.mem)
+        {
+            summary.total_memory_kB += snapshot.mem->total_memory_kB;
+            summary.free_memory_kB += snapshot.mem->free_memory_kB;
+        }
+    }
+    if (summary.cpus > 0u)
+        summary.cpu_usage_percent = static_cast<float>(cpu_usage_sum / summary.cpus);
+    if (summary.total_memory_kB > 0u)
+    {
+        const auto used_kB = summary.total_memory_kB - std::min(summary.free_memory_kB, summary.total_memory_kB);
+        summary.mem_usage_percent = static_cast<float>(100.0 * used_kB / summary.total_memory_kB);
+    }
+    return summary;
+}
+
+} // namespace cluster
@@ -0,0 +1,221 @@
+#include "api_server/data/json_writer.h"
+
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <limits>
+
+namespace data
+{
+
+namespace
+{
+
+constexpr std::string_view REPLACEMENT_CHARACTER{"\xEF\xBF\xBD"};
+
+/// @brief Returns the length of the valid UTF-8 sequence at the start of `value`, or 0 if it is invalid.
+/// `invalid_length` is set to the number of bytes to replace if the sequence is invalid: the lead byte and any
+/// continuation bytes that were valid before the sequence broke off, as for nlohmann's error_handler_t::replace.
+std::size_t utf8_sequence_length(const std::string_view value, std::size_t& invalid_length)
+{
+    const auto lead = static_cast<uint8_t>(value[0]);
+    std::size_t length = 0;
+    uint8_t second_min = 0x80;
+    uint8_t second_max = 0xBF;
+    if (lead >= 0xC2 && lead <= 0xDF)
+        length = 2;
+    else if (lead >= 0xE0 && lead <= 0xEF)
+    {
+        length = 3;
+        if (lead == 0xE0)
+            second_min = 0xA0; // Overlong
+        else if (lead == 0xED)
+            second_max = 0x9F; // Surrogates
+    }
+    else if (lead >= 0xF0 && lead <= 0xF4)
+    {
+        length = 4;
+        if (lead == 0xF0)
+            second_min = 0x90; // Overlong
+        else if (lead == 0xF4)
+            second_max = 0x8F; // Beyond U+10FFFF
+    }
+    else
+    {
+        invalid_length = 1;
+        return 0;
+    }
+
+    for (std::size_t i = 1; i < length; ++i)
+    {
+        const auto min = i == 1 ? second_min : uint8_t{0x80};
+        const auto max = i == 1 ? second_max : uint8_t{0xBF};
+        if (i >= value.size() || static_cast<uint8_t>(value[i]) < min || static_cast<uint8_t>(value[i]) > max)
+        {
+            invalid_length = i;
+            return 0;
+        }
+    }
+    return length;
+}
+
+/// @brief Returns true if the byte can be copied as-is: printable ASCII (and DEL, which nlohmann does not escape)
+/// other than the quote and backslash
+constexpr bool is_verbatim(const uint8_t byte)
+{
+    return byte >= 0x20 && byte < 0x80 && byte != '"' && byte != '\\';
+}
+
+} // namespace
+
+void JsonWriter::value(const double value)
+{
+    separate();
+    if (!std::isfinite(value))
+    {
+        m_out.append("null", 4);
+    }
+    else
+    {
+        append_double(value);
+    }
+    m_needs_comma = true;
+}
+
+void JsonWriter::append_double(const double value)
+{
+    // The shortest digits that round-trip, as [-]d.ddde+XX
+    std::array<char, 32> buffer;
+    const auto result =
+        std::to_chars(buffer.data(), buffer.data() + buffer.size(), value, std::chars_format::scientific);
+    const std::string_view scientific{buffer.data(), static_cast<std::size_t>(result.ptr - buffer.data())};
+
+    auto mantissa = scientific.substr(0, scientific.find('e'));
+    const auto exponent = scientific.substr(mantissa.size()); // e+XX or e-XX, at least two digits as nlohmann has
+    if (mantissa.front() == '-')
+    {
+        m_out.push_back('-');
+        mantissa.remove_prefix(1);
+    }
+    std::array<char, 24> digits;
+    std::size_t digit_count = 0;
+    for (const auto c : mantissa)
+    {
+        if (c != '.')
+            digits[digit_count++] = c;
+    }
+    int decimal_exponent = 0;
+    std::from_chars(exponent.data() + 2, exponent.data() + exponent.size(), decimal_exponent);
+    const auto point = (exponent[1] == '-' ? -decimal_exponent : decimal_exponent) + 1; // Digits before the point
+
+    // Laid out like nlohmann's printf("%g")-style format, which always reads back as a floating point number
+    constexpr int MIN_POINT = -4;
+    constexpr int MAX_POINT = std::numeric_limits<double>::digits10;
+    const auto count = static_cast<int>(digit_count);
+    if (count <= point && point <= MAX_POINT)
+    {
+        // digits[000].0
+        m_out.append(digits.data(), digit_count);
+        m_out.append(static_cast<std::size_t>(point - count), '0');
+        m_out.append(".0", 2);
+    }
+    else if (0 < point && point <= MAX_POINT)
+    {
+        // dig.its
+        m_out.append(digits.data(), static_cast<std::size_t>(point));
+        m_out.push_back('.');
+        m_out.append(digits.data() + point, static_cast<std::size_t>(count - point));
+    }
+    else if (MIN_POINT < point && point <= 0)
+    {
+        // 0.[000]digits
+        m_out.append("0.", 2);
+        m_out.append(static_cast<std::size_t>(-point), '0');
+        m_out.append(digits.data(), digit_count);
+    }
+    else
+    {
+        // d.igitse+XX
+        m_out.append(mantissa.data(), mantissa.size());
+        m_out.append(exponent.data(), exponent.size());
+    }
+}
+
+void JsonWriter::value(const std::string_view value)
+{
+    separate();
+    m_out.push_back('"');
+    append_escaped(value);
+    m_out.push_back('"');
+    m_needs_comma = true;
+}
+
+void JsonWriter::append_escaped(const std::string_view value)
+{
+    static constexpr char HEX_DIGITS[] = "0123456789abcdef";
+
+    std::size_t pos = 0;
+    while (pos < value.size())
+    {
+        // Copy runs of characters that need no escaping in one go, this is nearly every character in practice
+        auto run_end = pos;
+        while (run_end < value.size() && is_verbatim(static_cast<uint8_t>(value[run_end])))
+        {
+            ++run_end;
+        }
+        m_out.append(value.data() + pos, run_end - pos);
+        pos = run_end;
+        if (pos == value.size())
+            break;
+
+        const auto byte = static_cast<uint8_t>(value[pos]);
+        if (byte >= 0x80)
+        {
+            std::size_t invalid_length = 0;
+            const auto length = utf8_sequence_length(value.substr(pos), invalid_length);
+            if (length > 0)
+            {
+                m_out.append(value.data() + pos, length);
+                pos += length;
+            }
+            else
+            {
+                m_out.append(REPLACEMENT_CHARACTER);
+                pos += invalid_length;
+            }
+            continue;
+        }
+
+        switch (byte)
+        {
+        case '"':
+            m_out.append("\\\"", 2);
+            break;
+        case '\\':
+            m_out.append("\\\\", 2);
+            break;
+        case '\b':
+            m_out.append("\\b", 2);
+            break;
+        case '\f':
+            m_out.append("\\f", 2);
+            break;
+        case '\n':
+            m_out.append("\\n", 2);
+            break;
+        case '\r':
+            m_out.append("\\r", 2);
+            break;
+        case '\t':
+            m_out.append("\\t", 2);
+            break;
+        default:
+            const char escaped[] = {'\\', 'u', '0', '0', HEX_DIGITS[byte >> 4], HEX_DIGITS[byte & 0xF]};
+            m_out.append(escaped, sizeof(escaped));
+            break;
+        }
+        ++pos;
+    }
+}
+
+} // namespace data
@@ -0,0 +1,171 @@
+#include "api_server/data/prochistory.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+namespace data
+{
+
+namespace
+{
+
+bool same_smaps(const std::optional<SmapsSample>& a, const std::optional<SmapsSample>& b)
+{
+    if (!a || !b)
+        return !a && !b;
+    return a->pss_kB == b->pss_kB && a->uss_kB == b->uss_kB && a->swap_kB == b->swap_kB;
+}
+
+/// @brief Returns true if a usage value moved by at least the threshold, or at all without one
+bool usage_changed(const float previous, const float current, const float threshold)
+{
+    return threshold > 0.0f ? std::fabs(current - previous) >= threshold : current != previous;
+}
+
+} // namespace
+
+void ProcHistory::record(const uint64_t generation, ProcList procs)
+{
+    if (generation == m_generation + 1u)
+    {
+        m_changes.push_back(diff(generation, *m_procs, *procs));
+        if (m_changes.size() > WINDOW)
+            m_changes.pop_front();
+    }
+    else
+    {
+        // Changes can only be composed over consecutive generations
+        m_changes.clear();
+    }
+    m_generation = generation;
+    m_procs = std::move(procs);
+}
+
+ProcListDelta ProcHistory::delta_since(const uint64_t since, const ProcDeltaThresholds& thresholds) const
+{
+    return delta(since, m_generation, *m_procs, thresholds);
+}
+
+ProcListDelta ProcHistory::delta(const uint64_t since, const uint64_t until, const std::vector<ProcSnapshot>& procs,
+                                 const ProcDeltaThresholds& thresholds) const
+{
+    ProcListDelta delta;
+    delta.since = since;
+    delta.generation = until;
+    const auto oldest = m_changes.empty() ? m_generation : m_changes.front().generation - 1u;
+    if (since < oldest || since > until || until > m_generation)
+    {
+        delta.full = true;
+        delta.added = procs;
+        return delta;
+    }
+
+    // What each process that changed was like in generation `since`, taken from the first change to it after that
+    struct Origin
+    {
+        bool running{false};
+        bool other_fields_changed{false};
+        float cpu_usage_percent{0.0f};
+        float mem_usage_percent{0.0f};
+        uint32_t mem_usage_kB{0u};
+    };
+    std::unordered_map<int32_t, Origin> origins;
+    const auto last = m_changes.end() - static_cast<std::ptrdiff_t>(m_generation - until);
+    for (auto iter = m_changes.begin() + static_cast<std::ptrdiff_t>(since - oldest); iter != last; ++iter)
+    {
+        for (const auto pid : iter->added)
+        {
+            origins.emplace(pid, Origin{});
+        }
+        for (const auto pid : iter->removed)
+        {
+            // A PID that is re-used later in the window is a different process
+            auto [origin, inserted] = origins.emplace(pid, Origin{true});
+            origin->second.other_fields_changed = true;
+        }
+        for (const auto& change : iter->changed)
+        {
+            const Origin before{true, false, change.cpu_usage_percent, change.mem_usage_percent, change.mem_usage_kB};
+            auto [origin, inserted] = origins.emplace(change.pid, before);
+            origin->second.other_fields_changed |= change.other_fields_changed;
+        }
+    }
+
+    std::unordered_map<int32_t, const ProcSnapshot*> current;
+    current.reserve(origins.size());
+    for (const auto& proc : procs)
+    {
+        if (origins.count(proc.pid) > 0)
+            current.emplace(proc.pid, &proc);
+    }
+    for (const auto& [pid, origin] : origins)
+    {
+        const auto iter = current.find(pid);
+        if (iter == current.end())
+        {
+            if (origin.running)
+                delta.removed.push_back(pid);
+            continue;
+        }
+        const auto& proc = *iter->second;
+        if (!origin.running)
+        {
+            delta.added.push_back(proc);
+        }
+        else if (origin.other_fields_changed ||
+                 usage_changed(origin.cpu_usage_percent, proc.cpu_usage_percent, thresholds.cpu_usage_percent) ||
+                 usage_changed(origin.mem_usage_percent, proc.mem_usage_percent, thresholds.mem_usage_percent) ||
+                 (thresholds.mem_usage_percent <= 0.0f && origin.mem_usage_kB != proc.mem_usage_kB))
+        {
+            delta.changed.push_back(proc);
+        }
+    }
+
+    const auto by_pid = [](const ProcSnapshot& a, const ProcSnapshot& b) { return a.pid < b.pid; };
+    std::sort(delta.added.begin(), delta.added.end(), by_pid);
+    std::sort(delta.changed.begin(), delta.changed.end(), by_pid);
+    std::sort(delta.removed.begin(), delta.removed.end());
+    return delta;
+}
+
+ProcHistory::GenerationChanges ProcHistory::diff(const uint64_t generation, const std::vector<ProcSnapshot>& previous,
+                                                 const std::vector<ProcSnapshot>& current)
+{
+    GenerationChanges changes;
+    changes.generation = generation;
+    // Both lists are ordered by PID, so they can be merged in one pass
+    auto prev = previous.begin();
+    auto curr = current.begin();
+    while (prev != previous.end() || curr != current.end())
+    {
+        if (curr == current.end() || (prev != previous.end() && prev->pid < curr->pid))
+        {
+            changes.removed.push_back(prev->pid);
+            ++prev;
+        }
+        else if (prev == previous.end() || curr->pid < prev->pid)
+        {
+            changes.added.push_back(curr->pid);
+            ++curr;
+        }
+        else
+        {
+            // The snapshot time changes on every poll, so it isn't compared
+            const auto other_fields_changed = prev->ppid != curr->ppid || prev->name != curr->name ||
+                                              prev->command != curr->command || prev->cgroup != curr->cgroup ||
+                                              !same_smaps(prev->smaps, curr->smaps);
+            if (other_fields_changed || prev->cpu_usage_percent != curr->cpu_usage_percent ||
+                prev->mem_usage_percent != curr->mem_usage_percent || prev->mem_usage_kB != curr->mem_usage_kB)
+            {
+                changes.changed.push_back({prev->pid, prev->cpu_usage_percent, prev->mem_usage_percent,
+                                           prev->mem_usage_kB, other_fields_changed});
+            }
+            ++prev;
+            ++curr;
+        }
+    }
+    return changes;
+}
+
+} // namespace data
@@ -0,0 +1,172 @@
+#include "api_server/data/proctable.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+namespace data
+{
+
+namespace
+{
+
+constexpr char MAGIC[] = {'P', 'T', 'B', 'L'};
+
+template <typename Unsigned> void put_unsigned(char* out, const Unsigned value)
+{
+    for (std::size_t i = 0; i < sizeof(Unsigned); ++i)
+    {
+        out[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+    }
+}
+
+template <typename Unsigned> Unsigned get_unsigned(const char* in)
+{
+    Unsigned value{0u};
+    for (std::size_t i = 0; i < sizeof(Unsigned); ++i)
+    {
+        value |= static_cast<Unsigned>(static_cast<uint8_t>(in[i])) << (8 * i);
+    }
+    return value;
+}
+
+void put_float(char* out, const float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    put_unsigned(out, bits);
+}
+
+float get_float(const char* in)
+{
+    const auto bits = get_unsigned<uint32_t>(in);
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/// @brief Appends strings to the string table, storing each distinct string once
+class StringTable
+{
+public:
+    /// @brief Writes the offset and size of the string, relative to the start of the table
+    void put(char* record_field, const std::string& value)
+    {
+        const auto [iter, inserted] = m_offsets.emplace(value, static_cast<uint32_t>(m_strings.size()));
+        if (inserted)
+            m_strings.append(value);
+        put_unsigned(record_field, iter->second);
+        put_unsigned(record_field + 4, static_cast<uint32_t>(value.size()));
+    }
+
+    const std::string& strings() const
+    {
+        return m_strings;
+    }
+
+private:
+    std::string m_strings;
+    std::unordered_map<std::string_view, uint32_t> m_offsets; // Views of the snapshots' strings
+};
+
+} // namespace
+
+std::string encode_proc_table(const std::vector<ProcSnapshot>& procs)
+{
+    std::string encoded(ProcTable::HEADER_SIZE + procs.size() * ProcTable::RECORD_SIZE, '\0');
+    StringTable strings;
+
+    for (std::size_t i = 0; i < procs.size(); ++i)
+    {
+        const auto& proc = procs[i];
+        auto record = &encoded[ProcTable::HEADER_SIZE + i * ProcTable::RECORD_SIZE];
+        put_unsigned(record + 0, static_cast<uint32_t>(proc.pid));
+        put_unsigned(record + 4, static_cast<uint32_t>(proc.ppid));
+        put_float(record + 8, proc.cpu_usage_percent);
+        put_float(record + 12, proc.mem_usage_percent);
+        put_unsigned(record + 16, proc.mem_usage_kB);
+        if (proc.smaps)
+        {
+            const auto& smaps = proc.smaps.value();
+            put_unsigned(record + 20, ProcTable::FLAG_SMAPS);
+            put_unsigned(record + 24, smaps.pss_kB);
+            put_unsigned(record + 28, smaps.uss_kB);
+            put_unsigned(record + 32, smaps.swap_kB);
+            put_float(record + 36, static_cast<float>(std::max(0.0, proc.snapshot_time - smaps.sample_time)));
+        }
+        strings.put(record + 40, proc.name);
+        strings.put(record + 48, proc.command);
+        strings.put(record + 56, proc.cgroup);
+    }
+
+    auto header = &encoded[0];
+    std::memcpy(header, MAGIC, sizeof(MAGIC));
+    put_unsigned(header + 4, ProcTable::VERSION);
+    put_unsigned(header + 6, ProcTable::RECORD_SIZE);
+    put_unsigned(header + 8, static_cast<uint32_t>(procs.size()));
+    put_unsigned(header + 12, static_cast<uint32_t>(strings.strings().size()));
+    uint64_t snapshot_time_bits{0u};
+    if (!procs.empty())
+        std::memcpy(&snapshot_time_bits, &procs.front().snapshot_time, sizeof(snapshot_time_bits));
+    put_unsigned(header + 16, snapshot_time_bits);
+    encoded.append(strings.strings());
+    return encoded;
+}
+
+std::optional<ProcTable> decode_proc_table(const std::string_view encoded)
+{
+    if (encoded.size() < ProcTable::HEADER_SIZE || std::memcmp(encoded.data(), MAGIC, sizeof(MAGIC)) != 0)
+        return std::nullopt;
+    const auto header = encoded.data();
+    const auto version = get_unsigned<uint16_t>(header + 4);
+    const auto record_size = get_unsigned<uint16_t>(header + 6);
+    const auto record_count = get_unsigned<uint32_t>(header + 8);
+    const auto strings_size = get_unsigned<uint32_t>(header + 12);
+    if (version != ProcTable::VERSION || record_size < ProcTable::RECORD_SIZE)
+        return std::nullopt;
+    const auto strings_begin = ProcTable::HEADER_SIZE + uint64_t{record_count} * record_size;
+    if (encoded.size() != strings_begin + strings_size)
+        return std::nullopt;
+    const auto strings = encoded.substr(strings_begin);
+
+    ProcTable table;
+    const auto snapshot_time_bits = get_unsigned<uint64_t>(header + 16);
+    std::memcpy(&table.snapshot_time, &snapshot_time_bits, sizeof(table.snapshot_time));
+
+    const auto get_string = [&strings](const char* record_field, std::string& value) {
+        const auto offset = get_unsigned<uint32_t>(record_field);
+        const auto size = get_unsigned<uint32_t>(record_field + 4);
+        if (uint64_t{offset} + size > strings.size())
+            return false;
+        value.assign(strings.substr(offset, size));
+        return true;
+    };
+
+    table.procs.resize(record_count);
+    for (uint32_t i = 0; i < record_count; ++i)
+    {
+        auto& proc = table.procs[i];
+        const auto record = header + ProcTable::HEADER_SIZE + uint64_t{i} * record_size;
+        proc.snapshot_time = table.snapshot_time;
+        proc.pid = static_cast<int32_t>(get_unsigned<uint32_t>(record + 0));
+        proc.ppid = static_cast<int32_t>(get_unsigned<uint32_t>(record + 4));
+        proc.cpu_usage_percent = get_float(record + 8);
+        proc.mem_usage_percent = get_float(record + 12);
+        proc.mem_usage_kB = get_unsigned<uint32_t>(record + 16);
+        if (get_unsigned<uint32_t>(record + 20) & ProcTable::FLAG_SMAPS)
+        {
+            SmapsSample smaps;
+            smaps.pss_kB = get_unsigned<uint32_t>(record + 24);
+            smaps.uss_kB = get_unsigned<uint32_t>(record + 28);
+            smaps.swap_kB = get_unsigned<uint32_t>(record + 32);
+            smaps.sample_time = table.snapshot_time - get_float(record + 36);
+            proc.smaps = smaps;
+        }
+        if (!get_string(record + 40, proc.name) || !get_string(record + 48, proc.command) ||
+            !get_string(record + 56, proc.cgroup))
+            return std::nullopt;
+    }
+    return table;
+}
+
+} // namespace data
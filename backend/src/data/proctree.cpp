@@ -0,0 +1,346 @@
+#include "api_server/data/proctree.h"
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <tuple>
+
+namespace data
+{
+
+namespace
+{
+
+/// @brief Returns the snapshot of a process in the tree, from a list ordered by PID
+const ProcSnapshot& find_proc(const std::vector<ProcSnapshot>& procs, const int32_t pid)
+{
+    const auto iter = std::lower_bound(procs.begin(), procs.end(), pid,
+                                       [](const ProcSnapshot& proc, const int32_t value) { return proc.pid < value; });
+    if (iter == procs.end() || iter->pid != pid)
+        throw std::out_of_range{"Process " + std::to_string(pid) + " is not in the tree's generation"};
+    return *iter;
+}
+
+/// @brief Writes the members of a node that sort after "children"
+void write_json_tail(JsonWriter& writer, const ProcTreeNode& node)
+{
+    const auto& process = node.process;
+    writer.member("command", process.command);
+    writer.member("cpu_usage_percent", process.cpu_usage_percent);
+    writer.member("descendant_count", node.descendant_count);
+    writer.member("mem_usage_percent", process.mem_usage_percent);
+    writer.member("name", process.name);
+    writer.member("pid", process.pid);
+    writer.member("ppid", process.ppid);
+    writer.key("smaps");
+    if (process.smaps)
+        write_json(writer, process.smaps.value(), process.snapshot_time);
+    else
+        writer.null();
+    writer.member("subtree_cpu_usage_percent", node.subtree_cpu_usage_percent);
+    writer.member("subtree_mem_usage_kB", node.subtree_mem_usage_kB);
+    writer.member("subtree_mem_usage_percent", node.subtree_mem_usage_percent);
+    writer.end_object();
+}
+
+} // namespace
+
+ProcTreeNode::~ProcTreeNode()
+{
+    // Descendants are moved out before they are destroyed, so that none of them has children left to recurse into
+    std::vector<ProcTreeNode> pending = std::move(children);
+    while (!pending.empty())
+    {
+        auto node = std::move(pending.back());
+        pending.pop_back();
+        std::move(node.children.begin(), node.children.end(), std::back_inserter(pending));
+        node.children.clear();
+    }
+}
+
+nlohmann::json to_json(const ProcTreeNode& node)
+{
+    nlohmann::json json;
+    // Each node is converted into its place in its parent's children, which are sized before any of them is
+    std::vector<std::pair<const ProcTreeNode*, nlohmann::json*>> stack{{&node, &json}};
+    while (!stack.empty())
+    {
+        const auto [current, out] = stack.back();
+        stack.pop_back();
+        *out = to_json(current->process);
+        (*out)["subtree_cpu_usage_percent"] = current->subtree_cpu_usage_percent;
+        (*out)["subtree_mem_usage_percent"] = current->subtree_mem_usage_percent;
+        (*out)["subtree_mem_usage_kB"] = current->subtree_mem_usage_kB;
+        (*out)["descendant_count"] = current->descendant_count;
+        (*out)["child_count"] = current->child_count;
+        if (!current->expanded)
+            continue;
+        auto& children = (*out)["children"];
+        children = nlohmann::json::array();
+        children.get_ref<nlohmann::json::array_t&>().resize(current->children.size());
+        for (std::size_t i = 0u; i < current->children.size(); ++i)
+        {
+            stack.emplace_back(&current->children[i], &children[i]);
+        }
+    }
+    return json;
+}
+
+void write_json(JsonWriter& writer, const ProcTreeNode& node)
+{
+    // Members in the order to_json's document dumps them in. A node's members after its children are written once
+    // all of its children have been, so the stack holds each node being written and its next child.
+    std::vector<std::pair<const ProcTreeNode*, std::size_t>> stack;
+    const auto begin = [&writer, &stack](const ProcTreeNode& current) {
+        writer.begin_object();
+        writer.member("cgroup", current.process.cgroup);
+        writer.member("child_count", current.child_count);
+        if (!current.expanded)
+            return write_json_tail(writer, current);
+        writer.key("children");
+        writer.begin_array();
+        stack.emplace_back(&current, 0u);
+    };
+    begin(node);
+    while (!stack.empty())
+    {
+        auto& [current, next_child] = stack.back();
+        if (next_child < current->children.size())
+        {
+            begin(current->children[next_child++]);
+            continue;
+        }
+        const auto finished = current;
+        stack.pop_back();
+        writer.end_array();
+        write_json_tail(writer, *finished);
+    }
+}
+
+void ProcTree::update(const Procs& procs)
+{
+    // Remove exited processes first, so that re-used PIDs are re-added with their new parent
+    std::vector<int32_t> exited;
+    for (const auto& [pid, node] : m_nodes)
+    {
+        if (procs.find(pid) == procs.end())
+            exited.push_back(pid);
+    }
+    for (const auto pid : exited)
+    {
+        remove_node(pid);
+    }
+
+    for (const auto& [pid, snapshot] : procs)
+    {
+        const auto iter = m_nodes.find(snapshot.pid);
+        if (iter == m_nodes.end())
+        {
+            add_node(snapshot.pid, snapshot.ppid);
+        }
+        else if (iter->second.ppid != snapshot.ppid)
+        {
+            // Re-parented, e.g. to init or a subreaper after its parent exited
+            detach(iter->first, iter->second);
+            iter->second.ppid = snapshot.ppid;
+            attach(iter->first, iter->second);
+        }
+    }
+
+    update_rollups(procs);
+}
+
+std::vector<int32_t> ProcTree::roots() const
+{
+    return {m_roots.cbegin(), m_roots.cend()};
+}
+
+std::vector<int32_t> ProcTree::children(const int32_t pid) const
+{
+    if (const auto iter = m_nodes.find(pid); iter != m_nodes.end())
+        return iter->second.children;
+    return {};
+}
+
+std::optional<ProcTreeNode> ProcTree::subtree(const std::vector<ProcSnapshot>& procs, const int32_t pid,
+                                              const std::optional<uint32_t> depth) const
+{
+    if (m_nodes.find(pid) == m_nodes.end())
+        return std::nullopt;
+    ProcTreeNode node;
+    build_node(procs, pid, depth, node);
+    return node;
+}
+
+std::vector<ProcTreeNode> ProcTree::forest(const std::vector<ProcSnapshot>& procs,
+                                           const std::optional<uint32_t> depth) const
+{
+    std::vector<ProcTreeNode> nodes(m_roots.size());
+    auto out = nodes.begin();
+    for (const auto pid : m_roots)
+    {
+        build_node(procs, pid, depth, *out++);
+    }
+    return nodes;
+}
+
+void ProcTree::add_node(const int32_t pid, const int32_t ppid)
+{
+    auto& node = m_nodes[pid];
+    node.ppid = ppid;
+    attach(pid, node);
+
+    // Adopt any processes that were added before their parent, e.g. after PID wrap-around
+    const auto orphans = m_roots_by_ppid.find(pid);
+    if (orphans == m_roots_by_ppid.end())
+        return;
+    const auto adopted = orphans->second;
+    for (const auto child_pid : adopted)
+    {
+        if (child_pid == pid)
+            continue;
+        auto& child = m_nodes.at(child_pid);
+        detach(child_pid, child);
+        attach(child_pid, child);
+    }
+}
+
+void ProcTree::remove_node(const int32_t pid)
+{
+    auto iter = m_nodes.find(pid);
+    detach(pid, iter->second);
+    const auto orphans = std::move(iter->second.children);
+    m_nodes.erase(iter);
+
+    // Until the next generation tells us who adopted them, orphans are roots
+    for (const auto orphan_pid : orphans)
+    {
+        make_root(orphan_pid, m_nodes.at(orphan_pid));
+    }
+}
+
+void ProcTree::make_root(const int32_t pid, Node& node)
+{
+    node.is_root = true;
+    m_roots.insert(pid);
+    m_roots_by_ppid[node.ppid].push_back(pid);
+}
+
+void ProcTree::attach(const int32_t pid, Node& node)
+{
+    const auto parent = m_nodes.find(node.ppid);
+    // A process whose parent is unknown is a root. So is one that would close a cycle, which can only
+    // happen if the PID/PPID pairs were read at different times, around a PID being re-used. Only a process with
+    // children can be an ancestor of its parent, so new processes are attached without walking up the tree.
+    if (node.ppid == pid || parent == m_nodes.end() || (!node.children.empty() && is_ancestor(pid, node.ppid)))
+    {
+        make_root(pid, node);
+        return;
+    }
+    node.is_root = false;
+    auto& siblings = parent->second.children;
+    siblings.insert(std::lower_bound(siblings.begin(), siblings.end(), pid), pid);
+}
+
+void ProcTree::detach(const int32_t pid, Node& node)
+{
+    if (node.is_root)
+    {
+        m_roots.erase(pid);
+        const auto siblings = m_roots_by_ppid.find(node.ppid);
+        siblings->second.erase(std::find(siblings->second.begin(), siblings->second.end(), pid));
+        if (siblings->second.empty())
+            m_roots_by_ppid.erase(siblings);
+        return;
+    }
+    auto& siblings = m_nodes.at(node.ppid).children;
+    const auto iter = std::lower_bound(siblings.begin(), siblings.end(), pid);
+    if (iter != siblings.end() && *iter == pid)
+        siblings.erase(iter);
+}
+
+bool ProcTree::is_ancestor(const int32_t ancestor, int32_t pid) const
+{
+    // Bounded by the number of nodes in case of an existing cycle
+    for (std::size_t steps = 0; steps <= m_nodes.size(); ++steps)
+    {
+        if (pid == ancestor)
+            return true;
+        const auto iter = m_nodes.find(pid);
+        if (iter == m_nodes.end() || iter->second.is_root)
+            return false;
+        pid = iter->second.ppid;
+    }
+    return true;
+}
+
+void ProcTree::update_rollups(const Procs& procs)
+{
+    // Iterative post-order traversal, children are totalled before their parents
+    std::vector<std::pair<int32_t, bool>> stack;
+    for (const auto root : m_roots)
+    {
+        stack.emplace_back(root, false);
+    }
+    while (!stack.empty())
+    {
+        auto [pid, visited] = stack.back();
+        stack.pop_back();
+        auto& node = m_nodes.at(pid);
+        if (!visited)
+        {
+            stack.emplace_back(pid, true);
+            for (const auto child : node.children)
+            {
+                stack.emplace_back(child, false);
+            }
+            continue;
+        }
+
+        const auto& snapshot = procs.at(pid);
+        node.subtree_cpu_usage_percent = snapshot.cpu_usage_percent;
+        node.subtree_mem_usage_percent = snapshot.mem_usage_percent;
+        node.subtree_mem_usage_kB = snapshot.mem_usage_kB;
+        node.descendant_count = 0u;
+        for (const auto child_pid : node.children)
+        {
+            const auto& child = m_nodes.at(child_pid);
+            node.subtree_cpu_usage_percent += child.subtree_cpu_usage_percent;
+            node.subtree_mem_usage_percent += child.subtree_mem_usage_percent;
+            node.subtree_mem_usage_kB += child.subtree_mem_usage_kB;
+            node.descendant_count += child.descendant_count + 1;
+        }
+    }
+}
+
+void ProcTree::build_node(const std::vector<ProcSnapshot>& procs, const int32_t pid,
+                          const std::optional<uint32_t> depth, ProcTreeNode& out) const
+{
+    // Each node is built into its place in its parent's children, which are sized before any of them is
+    std::vector<std::tuple<int32_t, std::optional<uint32_t>, ProcTreeNode*>> stack{{pid, depth, &out}};
+    while (!stack.empty())
+    {
+        const auto [current_pid, current_depth, current] = stack.back();
+        stack.pop_back();
+        const auto& node = m_nodes.at(current_pid);
+        current->process = find_proc(procs, current_pid);
+        current->subtree_cpu_usage_percent = node.subtree_cpu_usage_percent;
+        current->subtree_mem_usage_percent = node.subtree_mem_usage_percent;
+        current->subtree_mem_usage_kB = node.subtree_mem_usage_kB;
+        current->descendant_count = node.descendant_count;
+        current->child_count = static_cast<uint32_t>(node.children.size());
+        current->expanded = !current_depth.has_value() || current_depth.value() > 0;
+        if (!current->expanded)
+            continue;
+
+        const auto child_depth =
+            current_depth ? std::optional<uint32_t>{current_depth.value() - 1} : std::nullopt;
+        current->children.resize(node.children.size());
+        for (std::size_t i = 0; i < node.children.size(); ++i)
+        {
+            stack.emplace_back(node.children[i], child_depth, &current->children[i]);
+        }
+    }
+}
+
+} // namespace data
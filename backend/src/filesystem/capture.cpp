@@ -0,0 +1,217 @@
+#include <api_server/filesystem/capture.h>
+
+#include <limits>
+#include <stdexcept>
+
+namespace filesystem
+{
+
+namespace
+{
+
+constexpr std::string_view MAGIC{"PROCCAP1"};
+
+constexpr char TAG_POLL{'P'};
+constexpr char TAG_PIDS{'L'};
+constexpr char TAG_FILE{'F'};
+constexpr char TAG_END{'E'};
+
+// Bounds on the sizes read from a capture, past which it is taken to be corrupt rather than allocated for
+constexpr uint32_t MAX_PIDS{4u * 1024u * 1024u};          // The kernel's limit on pid_max
+constexpr uint32_t MAX_STRING_SIZE{64u * 1024u * 1024u}; // Paths and file contents
+
+} // namespace
+
+CaptureWriter::CaptureWriter(const std::string& path) : m_file{gzopen(path.c_str(), "wb6")}
+{
+    if (!m_file)
+        throw std::runtime_error{"Unable to create capture file " + path};
+    if (gzwrite(m_file, MAGIC.data(), static_cast<unsigned>(MAGIC.size())) != static_cast<int>(MAGIC.size()))
+    {
+        gzclose(m_file);
+        throw std::runtime_error{"Unable to write capture file " + path};
+    }
+}
+
+CaptureWriter::~CaptureWriter()
+{
+    gzclose(m_file);
+}
+
+void CaptureWriter::begin_poll(const std::chrono::nanoseconds time)
+{
+    m_buffer.clear();
+    write_u8(TAG_POLL);
+    write_u64(static_cast<uint64_t>(time.count()));
+}
+
+void CaptureWriter::pids(const std::vector<int32_t>& pids)
+{
+    write_u8(TAG_PIDS);
+    write_u32(static_cast<uint32_t>(pids.size()));
+    for (const auto pid : pids)
+        write_u32(static_cast<uint32_t>(pid));
+}
+
+void CaptureWriter::file(const std::string_view path, const std::optional<std::string>& contents)
+{
+    write_u8(TAG_FILE);
+    write_string(path);
+    write_u8(contents ? 1u : 0u);
+    if (contents)
+        write_string(contents.value());
+}
+
+void CaptureWriter::end_poll()
+{
+    if (m_failed)
+        return;
+    write_u8(TAG_END);
+    if (gzwrite(m_file, m_buffer.data(), static_cast<unsigned>(m_buffer.size())) != static_cast<int>(m_buffer.size()) ||
+        gzflush(m_file, Z_SYNC_FLUSH) != Z_OK)
+    {
+        m_failed = true;
+        int error;
+        throw std::runtime_error{std::string{"Unable to write capture, recording stopped: "} + gzerror(m_file, &error)};
+    }
+}
+
+void CaptureWriter::write_u8(const uint8_t value)
+{
+    m_buffer.push_back(static_cast<char>(value));
+}
+
+void CaptureWriter::write_u32(const uint32_t value)
+{
+    for (int shift = 0; shift < 32; shift += 8)
+        m_buffer.push_back(static_cast<char>((value >> shift) & 0xffu));
+}
+
+void CaptureWriter::write_u64(const uint64_t value)
+{
+    for (int shift = 0; shift < 64; shift += 8)
+        m_buffer.push_back(static_cast<char>((value >> shift) & 0xffu));
+}
+
+void CaptureWriter::write_string(const std::string_view value)
+{
+    write_u32(static_cast<uint32_t>(value.size()));
+    m_buffer.append(value);
+}
+
+CaptureReader::CaptureReader(const std::string& path) : m_file{gzopen(path.c_str(), "rb")}
+{
+    if (!m_file)
+        throw std::runtime_error{"Unable to open capture file " + path};
+    std::string magic(MAGIC.size(), '\0');
+    if (!read(magic.data(), magic.size()) || magic != MAGIC)
+    {
+        gzclose(m_file);
+        throw std::runtime_error{path + " is not a capture file"};
+    }
+}
+
+CaptureReader::~CaptureReader()
+{
+    gzclose(m_file);
+}
+
+std::optional<CapturedPoll> CaptureReader::next_poll()
+{
+    char tag;
+    uint64_t time;
+    if (!read(&tag, 1u))
+        return std::nullopt;
+    if (tag != TAG_POLL)
+        throw std::runtime_error{"Corrupt capture, expected the start of a poll"};
+    if (!read_u64(time))
+        return std::nullopt;
+
+    CapturedPoll poll;
+    poll.time = std::chrono::nanoseconds{static_cast<int64_t>(time)};
+    while (true)
+    {
+        if (!read(&tag, 1u))
+            return std::nullopt;
+        if (tag == TAG_END)
+            return poll;
+        if (tag == TAG_PIDS)
+        {
+            uint32_t count;
+            if (!read_u32(count))
+                return std::nullopt;
+            if (count > MAX_PIDS)
+                throw std::runtime_error{"Corrupt capture, record too large"};
+            poll.pids.resize(count);
+            for (auto& pid : poll.pids)
+            {
+                uint32_t value;
+                if (!read_u32(value))
+                    return std::nullopt;
+                pid = static_cast<int32_t>(value);
+            }
+        }
+        else if (tag == TAG_FILE)
+        {
+            std::string path;
+            char exists;
+            if (!read_string(path) || !read(&exists, 1u))
+                return std::nullopt;
+            auto& contents = poll.files[path];
+            if (exists)
+            {
+                contents.emplace();
+                if (!read_string(contents.value()))
+                    return std::nullopt;
+            }
+        }
+        else
+        {
+            throw std::runtime_error{"Corrupt capture, unknown record " + std::to_string(static_cast<int>(tag))};
+        }
+    }
+}
+
+bool CaptureReader::read(void* data, const std::size_t size)
+{
+    if (size == 0u)
+        return true;
+    if (size > static_cast<std::size_t>(std::numeric_limits<int>::max()))
+        throw std::runtime_error{"Corrupt capture, record too large"};
+    return gzread(m_file, data, static_cast<unsigned>(size)) == static_cast<int>(size);
+}
+
+bool CaptureReader::read_u32(uint32_t& value)
+{
+    unsigned char bytes[4];
+    if (!read(bytes, sizeof(bytes)))
+        return false;
+    value = 0u;
+    for (int i = 3; i >= 0; --i)
+        value = (value << 8) | bytes[i];
+    return true;
+}
+
+bool CaptureReader::read_u64(uint64_t& value)
+{
+    unsigned char bytes[8];
+    if (!read(bytes, sizeof(bytes)))
+        return false;
+    value = 0u;
+    for (int i = 7; i >= 0; --i)
+        value = (value << 8) | bytes[i];
+    return true;
+}
+
+bool CaptureReader::read_string(std::string& value)
+{
+    uint32_t size;
+    if (!read_u32(size))
+        return false;
+    if (size > MAX_STRING_SIZE)
+        throw std::runtime_error{"Corrupt capture, record too large"};
+    value.resize(size);
+    return read(value.data(), size);
+}
+
+} // namespace filesystem
@@ -0,0 +1,156 @@
+#include <api_server/filesystem/cgroups.h>
+#include <api_server/filesystem/parsers.h>
+
+#include <boost/algorithm/clamp.hpp>
+#include <boost/algorithm/string.hpp>
+#include <fmt/format.h>
+#include <fstream>
+#include <unistd.h>
+#include <unordered_set>
+
+namespace filesystem
+{
+using namespace data;
+namespace fs = std::filesystem;
+
+CgroupCollector::CgroupCollector(Logger& logger, data::DataStore& datastore, const fs::path& cgroup_root,
+                                 const fs::path& proc_root)
+    : m_logger{logger}, m_datastore{datastore}, m_proc_root{proc_root}, m_root{find_unified_root(cgroup_root)},
+      m_cpu_count{static_cast<uint32_t>(std::max(1L, sysconf(_SC_NPROCESSORS_ONLN)))}
+{
+    if (!m_root)
+    {
+        m_logger.info("No cgroup v2 hierarchy found in {}, cgroups will not be monitored", cgroup_root.string());
+    }
+}
+
+std::optional<fs::path> CgroupCollector::find_unified_root(const fs::path& cgroup_root) const
+{
+    for (const auto& candidate : {cgroup_root, cgroup_root / "unified"})
+    {
+        std::error_code error;
+        if (fs::exists(candidate / "cgroup.controllers", error))
+            return candidate;
+    }
+    return std::nullopt;
+}
+
+const std::string& CgroupCollector::proc_cgroup(const int32_t pid)
+{
+    if (const auto iter = m_proc_cgroups.find(pid); iter != m_proc_cgroups.end())
+    {
+        return iter->second;
+    }
+
+    // The unified hierarchy's entry is the one with hierarchy ID 0, e.g. "0::/system.slice/foo.service"
+    auto& cgroup = m_proc_cgroups[pid];
+    std::ifstream input{m_proc_root / std::to_string(pid) / "cgroup"};
+    std::string line;
+    while (std::getline(input, line))
+    {
+        if (boost::starts_with(line, "0::"))
+        {
+            cgroup = line.substr(3);
+            break;
+        }
+    }
+    return cgroup;
+}
+
+void CgroupCollector::retain_procs(const std::vector<int32_t>& pids)
+{
+    const std::unordered_set<int32_t> live{pids.cbegin(), pids.cend()};
+    for (auto iter = m_proc_cgroups.begin(); iter != m_proc_cgroups.end();)
+    {
+        if (live.count(iter->first) == 0)
+            iter = m_proc_cgroups.erase(iter);
+        else
+            ++iter;
+    }
+}
+
+void CgroupCollector::collect(const std::vector<ProcSnapshot>& procs, const double snapshot_time)
+{
+    if (!m_root)
+        return;
+
+    std::unordered_map<std::string, uint32_t> proc_counts;
+    for (const auto& proc : procs)
+    {
+        if (!proc.cgroup.empty())
+            ++proc_counts[proc.cgroup];
+    }
+    const uint64_t total_memory_bytes = m_datastore.get_mem_snapshot().total_memory_kB * 1024ull;
+
+    std::vector<CgroupSnapshot> snapshots;
+    std::unordered_map<std::string, CgroupSnapshot> prev_snapshots;
+    const auto add_cgroup = [&](const fs::path& dir, const std::string& path) {
+        auto snapshot = read_cgroup(dir, path);
+        snapshot.snapshot_time = snapshot_time;
+        if (const auto iter = proc_counts.find(path); iter != proc_counts.end())
+            snapshot.proc_count = iter->second;
+        if (total_memory_bytes > 0)
+        {
+            const float mem_usage_percent = (100.0 * snapshot.mem_usage_bytes) / total_memory_bytes;
+            snapshot.mem_usage_percent = boost::algorithm::clamp(mem_usage_percent, 0.0f, 100.0f);
+        }
+        if (const auto prev = m_prev_snapshots.find(path); prev != m_prev_snapshots.end())
+        {
+            const double uptime_delta_us = (snapshot.snapshot_time - prev->second.snapshot_time) * 1e6;
+            if (uptime_delta_us > 0.0 && snapshot.usage_usec >= prev->second.usage_usec)
+            {
+                const float cpu_usage_percent =
+                    (100.0 * (snapshot.usage_usec - prev->second.usage_usec)) / (uptime_delta_us * m_cpu_count);
+                snapshot.cpu_usage_percent = boost::algorithm::clamp(cpu_usage_percent, 0.0f, 100.0f);
+            }
+        }
+        prev_snapshots[path] = snapshot;
+        snapshots.emplace_back(std::move(snapshot));
+    };
+
+    add_cgroup(m_root.value(), "/");
+    std::error_code error;
+    for (auto iter = fs::recursive_directory_iterator(m_root.value(), fs::directory_options::skip_permission_denied,
+                                                      error);
+         !error && iter != fs::recursive_directory_iterator(); iter.increment(error))
+    {
+        if (!iter->is_directory(error) || error)
+            continue;
+        add_cgroup(iter->path(), "/" + fs::relative(iter->path(), m_root.value()).string());
+    }
+    if (error)
+    {
+        m_logger.warning("CgroupCollector::collect - failed to walk hierarchy: {}", error.message());
+    }
+
+    m_prev_snapshots = std::move(prev_snapshots);
+    m_datastore.store_cgroup_snapshots(snapshots);
+}
+
+CgroupSnapshot CgroupCollector::read_cgroup(const fs::path& dir, const std::string& path) const
+{
+    CgroupSnapshot snapshot;
+    snapshot.path = path;
+
+    std::ifstream cpu_input{dir / "cpu.stat"};
+    const auto cpu_stat = parse_flat_keyed_file(cpu_input);
+    const auto lookup = [](const auto& values, const std::string& key) -> uint64_t {
+        const auto iter = values.find(key);
+        return iter == values.end() ? 0u : iter->second;
+    };
+    snapshot.usage_usec = lookup(cpu_stat, "usage_usec");
+    snapshot.user_usec = lookup(cpu_stat, "user_usec");
+    snapshot.system_usec = lookup(cpu_stat, "system_usec");
+
+    // The root cgroup has no memory.current
+    std::ifstream current_input{dir / "memory.current"};
+    current_input >> snapshot.mem_usage_bytes;
+
+    std::ifstream mem_input{dir / "memory.stat"};
+    const auto mem_stat = parse_flat_keyed_file(mem_input);
+    snapshot.mem_anon_bytes = lookup(mem_stat, "anon");
+    snapshot.mem_file_bytes = lookup(mem_stat, "file");
+    return snapshot;
+}
+
+} // namespace filesystem
@@ -0,0 +1,154 @@
+#include <api_server/filesystem/details.h>
+#include <api_server/filesystem/parsers.h>
+#include <api_server/filesystem/types.h>
+
+#include <fmt/format.h>
+#include <fstream>
+
+namespace filesystem
+{
+using namespace data;
+namespace fs = std::filesystem;
+
+namespace
+{
+
+/// @brief Looks up an unsigned integer value in a map of `key: value` pairs, returning 0 if absent or malformed
+uint64_t lookup_u64(const std::unordered_map<std::string, std::string>& values, const std::string& key)
+{
+    const auto iter = values.find(key);
+    if (iter == values.end())
+        return 0u;
+    try
+    {
+        return std::stoull(iter->second);
+    }
+    catch (const std::exception&)
+    {
+        return 0u;
+    }
+}
+
+bool is_ready(const std::shared_future<std::optional<ProcDetails>>& result)
+{
+    return result.wait_for(std::chrono::seconds{0}) == std::future_status::ready;
+}
+
+} // namespace
+
+ProcDetailsCollector::ProcDetailsCollector(const Logger& logger, const fs::path& proc_root)
+    : m_logger{logger}, m_proc_root{proc_root}
+{
+}
+
+std::optional<ProcDetails> ProcDetailsCollector::get(const int32_t pid)
+{
+    std::promise<std::optional<ProcDetails>> promise;
+    Result result = promise.get_future().share();
+    bool collect_here = true;
+    {
+        const std::unique_lock lock{m_cache_mutex};
+        const auto now = std::chrono::steady_clock::now();
+        prune_cache(now);
+        if (const auto iter = m_cache.find(pid); iter != m_cache.end())
+        {
+            // Either fresh, or still being collected by another request
+            result = iter->second.result;
+            collect_here = false;
+        }
+        else
+        {
+            m_cache[pid] = CacheEntry{now, result};
+        }
+    }
+
+    if (collect_here)
+    {
+        try
+        {
+            promise.set_value(collect(pid));
+        }
+        catch (const std::exception& e)
+        {
+            m_logger.warning("ProcDetailsCollector::get - failed to collect pid {}: {}", pid, e.what());
+            promise.set_value(std::nullopt);
+        }
+        catch (...)
+        {
+            // Hand anything else to the coalesced requests too, rather than breaking their promise
+            promise.set_exception(std::current_exception());
+        }
+    }
+    return result.get();
+}
+
+void ProcDetailsCollector::prune_cache(const std::chrono::steady_clock::time_point now)
+{
+    for (auto iter = m_cache.begin(); iter != m_cache.end();)
+    {
+        if (now - iter->second.collected_at >= CACHE_TTL && is_ready(iter->second.result))
+            iter = m_cache.erase(iter);
+        else
+            ++iter;
+    }
+}
+
+std::optional<ProcDetails> ProcDetailsCollector::collect(const int32_t pid) const
+{
+    const auto proc_dir = m_proc_root / std::to_string(pid);
+    std::ifstream status_input{proc_dir / "status"};
+    if (!status_input)
+    {
+        // Expected if proc has been removed
+        return std::nullopt;
+    }
+    const auto status_map = parse_dictionary_file(status_input);
+
+    ProcDetails details;
+    details.pid = pid;
+    details.status = {status_map.cbegin(), status_map.cend()};
+    details.threads = static_cast<uint32_t>(lookup_u64(status_map, "Threads"));
+    details.voluntary_ctxt_switches = lookup_u64(status_map, "voluntary_ctxt_switches");
+    details.nonvoluntary_ctxt_switches = lookup_u64(status_map, "nonvoluntary_ctxt_switches");
+    details.io = read_proc_io(proc_dir);
+    details.fd_count = count_proc_fds(proc_dir);
+    return details;
+}
+
+std::optional<ProcIoCounters> ProcDetailsCollector::read_proc_io(const fs::path& proc_dir) const
+{
+    std::ifstream input{proc_dir / "io"};
+    if (!input)
+        return std::nullopt;
+    const auto io_map = parse_dictionary_file(input);
+    if (io_map.empty())
+        return std::nullopt;
+
+    ProcIoCounters io;
+    io.rchar = lookup_u64(io_map, "rchar");
+    io.wchar = lookup_u64(io_map, "wchar");
+    io.syscr = lookup_u64(io_map, "syscr");
+    io.syscw = lookup_u64(io_map, "syscw");
+    io.read_bytes = lookup_u64(io_map, "read_bytes");
+    io.write_bytes = lookup_u64(io_map, "write_bytes");
+    io.cancelled_write_bytes = lookup_u64(io_map, "cancelled_write_bytes");
+    return io;
+}
+
+std::optional<uint32_t> ProcDetailsCollector::count_proc_fds(const fs::path& proc_dir) const
+{
+    std::error_code error;
+    auto dir_iter = fs::directory_iterator(proc_dir / "fd", error);
+    if (error)
+        return std::nullopt;
+    uint32_t count = 0u;
+    for (auto iter = fs::begin(dir_iter); iter != fs::end(dir_iter); iter.increment(error))
+    {
+        if (error)
+            return std::nullopt;
+        ++count;
+    }
+    return count;
+}
+
+} // namespace filesystem
@@ -1,59 +1,105 @@
 #include <api_server/filesystem/monitor.h>
+#include <api_server/filesystem/parsers.h>
 #include <api_server/filesystem/types.h>
+#include <api_server/filesystem/usage.h>
 
 #include <boost/algorithm/clamp.hpp>
 #include <boost/algorithm/string.hpp>
 #include <chrono>
 #include <fmt/format.h>
-#include <fstream>
 #include <math.h>
-#include <regex>
+#include <sstream>
+#include <stdexcept>
 #include <thread>
 
 namespace filesystem
 {
 using namespace data;
-namespace fs = std::filesystem;
 
-/// @brief Given the string "123456 kB", returns 123456
-std::optional<uint32_t> parse_kb_value(const std::string& value_with_kb_units)
-{
-    static std::regex regex{"([0-9]+) kB"};
-    std::smatch match;
-    std::regex_search(value_with_kb_units, match, regex);
-    if (match.size() > 1)
-    {
-        return std::stoul(match.str(1));
-    }
-    return std::nullopt;
-}
-
-Monitor::Monitor(Logger& logger, data::DataStore& datastore) : m_logger{logger}, m_datastore{datastore}
+Monitor::Monitor(Logger& logger, data::DataStore& datastore, const MonitorConfig& config,
+                 std::unique_ptr<ProcSource> source)
+    : m_logger{logger}, m_datastore{datastore},
+      m_source{source ? std::move(source) : std::make_unique<LiveProcSource>(config.proc_root)},
+      m_thread_collector{logger, datastore, config.thread_cpu_threshold_percent, CLK_TCK, config.proc_root},
+      m_cgroup_collector{logger, datastore, config.cgroup_root, config.proc_root}
 {
 }
 
 void Monitor::start()
 {
     m_logger.debug("Monitor::start");
-    auto monitor = true;
-    while (monitor)
+    while (m_running)
     {
-        std::this_thread::sleep_for(POLL_INTERVAL);
-        check_filesystem_changes();
+        std::this_thread::sleep_for(m_source->poll_interval(POLL_INTERVAL));
+        if (!check_filesystem_changes())
+        {
+            m_logger.info("Monitor::start - no more polls to replay");
+            break;
+        }
     }
 }
 
-void Monitor::check_filesystem_changes()
+void Monitor::stop()
+{
+    m_running = false;
+}
+
+bool Monitor::check_filesystem_changes()
 {
+    if (!m_source->begin_poll())
+        return false;
+    auto& metrics = m_datastore.poll_metrics();
+    const auto poll_start = std::chrono::steady_clock::now();
     read_system_uptime();
     read_system_stat();
     read_system_meminfo();
+    const auto system_end = std::chrono::steady_clock::now();
+    record_phase(metrics.system, "system", poll_start, system_end);
     read_proc_files();
+    try
+    {
+        m_source->end_poll();
+    }
+    catch (const std::runtime_error& exception)
+    {
+        m_logger.error("Monitor::check_filesystem_changes - {}", exception.what());
+    }
+    const auto publish_start = std::chrono::steady_clock::now();
+    // The generation is only incremented by publishing, so the poll's spans are recorded with the one it publishes
+    const auto generation = m_datastore.generation() + 1u;
+    m_datastore.publish_generation();
+    const auto poll_end = std::chrono::steady_clock::now();
+    metrics.publish.record(poll_end - publish_start);
+    metrics.total.record(poll_end - poll_start);
+    auto& recorder = m_datastore.flight_recorder();
+    recorder.record("poll", "publish", publish_start, poll_end, generation);
+    recorder.record("poll", "poll", poll_start, poll_end, generation);
+    return true;
+}
+
+void Monitor::record_phase(metrics::Histogram& histogram, const char* name,
+                           const std::chrono::steady_clock::time_point start,
+                           const std::chrono::steady_clock::time_point end)
+{
+    histogram.record(end - start);
+    m_datastore.flight_recorder().record("poll", name, start, end, m_datastore.generation() + 1u);
+}
+
+void Monitor::trace_slow_read(const std::string& proc_dir, const char* name, const int32_t pid,
+                              const std::chrono::steady_clock::time_point start,
+                              const std::chrono::steady_clock::time_point end)
+{
+    auto& recorder = m_datastore.flight_recorder();
+    if (recorder.is_slow(end - start))
+        recorder.record("read", "slow read", start, end, m_datastore.generation() + 1u, pid, proc_dir + name);
 }
 
 void Monitor::read_system_uptime()
 {
-    std::ifstream input(file::uptime);
+    const auto contents = m_source->read_file(file::uptime);
+    if (!contents)
+        return;
+    std::istringstream input{contents.value()};
     std::string seconds_str;
     input >> seconds_str;
 
@@ -73,7 +119,7 @@ void Monitor::read_system_uptime()
 
 void Monitor::read_system_meminfo()
 {
-    std::ifstream input{file::meminfo};
+    std::istringstream input{m_source->read_file(file::meminfo).value_or("")};
     const auto params = parse_dictionary_file(input);
 
     MemSnapshot snapshot;
@@ -100,7 +146,7 @@ void Monitor::read_system_meminfo()
 
 void Monitor::read_system_stat()
 {
-    std::ifstream input(file::stat);
+    std::istringstream input{m_source->read_file(file::stat).value_or("")};
     std::string line;
     std::vector<CpuSnapshot> cpu_snapshots;
     while (std::getline(input, line))
@@ -116,18 +162,9 @@ void Monitor::read_system_stat()
     m_datastore.store_cpu_snapshots(cpu_snapshots);
 }
 
-std::vector<int32_t> Monitor::discover_current_procs() const
+std::vector<int32_t> Monitor::discover_current_procs()
 {
-    std::vector<int32_t> pids;
-    auto dir_iter = fs::directory_iterator(dir::proc, fs::directory_options::skip_permission_denied);
-    for (const auto& entry : dir_iter)
-    {
-        if (!is_proc_dir(entry))
-            continue;
-
-        pids.push_back(std::stoi(entry.path().filename().string()));
-    }
-    return pids;
+    return m_source->list_pids();
 }
 
 std::optional<CpuSnapshot> Monitor::parse_cpu_snapshot(const std::string_view& cpu_line)
@@ -139,7 +176,7 @@ std::optional<CpuSnapshot> Monitor::parse_cpu_snapshot(const std::string_view& c
     // Columns can exceed 8, but we'll only read the first 8
     if (columns.size() < 8)
     {
-        m_logger.warning(fmt::format("Monitor::update_cpu - unexpected columns: {}", cpu_line));
+        m_logger.warning("Monitor::update_cpu - unexpected columns: {}", cpu_line);
         return std::nullopt;
     }
 
@@ -168,52 +205,81 @@ std::optional<CpuSnapshot> Monitor::parse_cpu_snapshot(const std::string_view& c
 
 void Monitor::read_proc_files()
 {
+    using Clock = std::chrono::steady_clock;
+    auto& metrics = m_datastore.poll_metrics();
+    auto phase_start = Clock::now();
     const auto pids = discover_current_procs();
-
+    auto now = Clock::now();
+    record_phase(metrics.discovery, "discovery", phase_start, now);
+    metrics.processes.store(pids.size(), std::memory_order_relaxed);
+
+    m_datastore.prune_smaps_samples(pids);
+    m_cgroup_collector.retain_procs(pids);
+    const auto smaps_samples = m_datastore.get_smaps_samples();
+    const auto snapshot_time = m_datastore.get_uptime().total_seconds;
+
+    // Each file's read time is summed over the processes, then recorded once for the poll. Individual reads are
+    // only traced if they were slow.
+    Clock::duration status_time{}, stat_time{}, cmdline_time{};
+    const auto reads_start = Clock::now();
     std::vector<ProcSnapshot> snapshots;
     for (const auto pid : pids)
     {
         ProcSnapshot snapshot;
-        snapshot.snapshot_time = m_datastore.get_uptime().total_seconds;
+        snapshot.snapshot_time = snapshot_time;
         snapshot.pid = pid;
-        const auto proc_dir = fs::path(dir::proc) / std::to_string(pid);
+        const auto proc_dir = std::to_string(pid) + '/';
+        phase_start = Clock::now();
         read_proc_status(proc_dir, snapshot);
+        now = Clock::now();
+        status_time += now - phase_start;
+        trace_slow_read(proc_dir, "status", pid, phase_start, now);
         read_proc_stat(proc_dir, snapshot);
+        phase_start = Clock::now();
+        stat_time += phase_start - now;
+        trace_slow_read(proc_dir, "stat", pid, now, phase_start);
         read_proc_cmdline(proc_dir, snapshot);
+        now = Clock::now();
+        cmdline_time += now - phase_start;
+        trace_slow_read(proc_dir, "cmdline", pid, phase_start, now);
+        if (const auto iter = smaps_samples.find(pid); iter != smaps_samples.end())
+        {
+            snapshot.smaps = iter->second;
+        }
+        if (m_source->is_live())
+            snapshot.cgroup = m_cgroup_collector.proc_cgroup(pid);
         snapshots.emplace_back(snapshot);
     }
+    metrics.status.record(status_time);
+    metrics.stat.record(stat_time);
+    metrics.cmdline.record(cmdline_time);
+    phase_start = Clock::now();
+    m_datastore.flight_recorder().record("poll", "read procs", reads_start, phase_start,
+                                         m_datastore.generation() + 1u);
+
     m_datastore.store_proc_snapshots(snapshots);
-}
+    now = Clock::now();
+    record_phase(metrics.store, "store", phase_start, now);
 
-bool Monitor::is_proc_dir(const fs::directory_entry& entry) const
-{
-    if (!entry.is_directory())
+    // Thread and cgroup files aren't captured, so they're only collected from the live proc tree
+    if (m_source->is_live())
     {
-        return false;
+        m_thread_collector.collect(snapshots, snapshot_time);
+        m_cgroup_collector.collect(snapshots, snapshot_time);
     }
-    std::regex pid_regex{"^[0-9]+$"};
-    std::smatch match;
-    const auto dirname = entry.path().filename().string();
-    std::regex_match(dirname, match, pid_regex);
-    if (match.empty())
-    {
-        return false;
-    }
-
-    const auto stat_path = entry.path() / "status";
-    return fs::exists(stat_path);
+    record_phase(metrics.collectors, "collectors", now, Clock::now());
 }
 
-void Monitor::read_proc_status(const fs::path& proc_dir, ProcSnapshot& snapshot)
+void Monitor::read_proc_status(const std::string& proc_dir, ProcSnapshot& snapshot)
 {
-    const auto status_file = proc_dir / "status";
-    if (!fs::exists(status_file))
+    const auto contents = m_source->read_file(proc_dir + "status");
+    if (!contents)
     {
         // Expected if proc has been removed
         return;
     }
 
-    std::ifstream input(status_file);
+    std::istringstream input{contents.value()};
     const auto status_map = parse_dictionary_file(input);
     if (const auto iter = status_map.find("Pid"); iter != status_map.end())
     {
@@ -243,75 +309,45 @@ void Monitor::read_proc_status(const fs::path& proc_dir, ProcSnapshot& snapshot)
     }
 }
 
-void Monitor::read_proc_stat(const fs::path& proc_dir, ProcSnapshot& snapshot)
+void Monitor::read_proc_stat(const std::string& proc_dir, ProcSnapshot& snapshot)
 {
-    const auto stat_file = proc_dir / "stat";
-    if (!fs::exists(stat_file))
+    const auto contents = m_source->read_file(proc_dir + "stat");
+    if (!contents)
     {
         // Expected if proc has been removed
         return;
     }
 
-    std::ifstream input(stat_file);
-
-    std::string column;
-    // Read utime (column 14) and stime (column 15), skip anything else
-    for (auto i = 1; i <= 15; ++i)
+    std::istringstream input{contents.value()};
+    std::string line;
+    std::getline(input, line);
+    const auto fields = parse_stat_line(line);
+    if (!fields)
     {
-        input >> column;
-        if (i == 14)
-        {
-            snapshot.utime = std::stoul(column);
-        }
-        else if (i == 15)
-        {
-            snapshot.stime = std::stoul(column);
-        }
+        return;
     }
+    snapshot.utime = fields->utime;
+    snapshot.stime = fields->stime;
 
     const auto prev_snapshot = m_datastore.get_proc_snapshot(snapshot.pid);
     if (prev_snapshot.has_value())
     {
-        const double uptime_delta_s = snapshot.snapshot_time - prev_snapshot->snapshot_time;
-        const double prev_scheduled_time_s = static_cast<double>(prev_snapshot->utime + prev_snapshot->stime) / CLK_TCK;
-        const double latest_scheduled_time_s = static_cast<double>(snapshot.utime + snapshot.stime) / CLK_TCK;
-        const double scheduled_time_delta_s = latest_scheduled_time_s - prev_scheduled_time_s;
-        const float cpu_usage_percent = (100.0 * scheduled_time_delta_s) / uptime_delta_s;
-        snapshot.cpu_usage_percent = boost::algorithm::clamp(cpu_usage_percent, 0.0f, 100.0f);
+        snapshot.cpu_usage_percent =
+            cpu_usage_percent(prev_snapshot->snapshot_time, prev_snapshot->utime + prev_snapshot->stime,
+                              snapshot.snapshot_time, snapshot.utime + snapshot.stime, CLK_TCK);
     }
 }
 
-void Monitor::read_proc_cmdline(const std::filesystem::path& proc_dir, data::ProcSnapshot& snapshot)
+void Monitor::read_proc_cmdline(const std::string& proc_dir, data::ProcSnapshot& snapshot)
 {
-    const auto cmdline_file = proc_dir / "cmdline";
-    if (!fs::exists(cmdline_file))
+    const auto contents = m_source->read_file(proc_dir + "cmdline");
+    if (!contents)
     {
         // Expected if proc has been removed
         return;
     }
-    std::ifstream input{cmdline_file};
+    std::istringstream input{contents.value()};
     input >> snapshot.command;
 }
 
-std::unordered_map<std::string, std::string> Monitor::parse_dictionary_file(std::ifstream& input) const
-{
-    std::unordered_map<std::string, std::string> status_map;
-    std::string line;
-    while (std::getline(input, line))
-    {
-        if (line.empty())
-            continue;
-        const auto colon_pos = line.find(":");
-        if (colon_pos == std::string::npos)
-            continue;
-
-        std::string key = line.substr(0, colon_pos);
-        boost::trim(key);
-        std::string value = line.substr(colon_pos + 1, line.size() - colon_pos);
-        boost::trim(value);
-        status_map[key] = value;
-    }
-    return status_map;
-}
-
 } // namespace filesystem
\ No newline at end of file
@@ -0,0 +1,83 @@
+#include <api_server/filesystem/parsers.h>
+
+#include <boost/algorithm/string.hpp>
+#include <regex>
+
+namespace filesystem
+{
+
+std::optional<uint32_t> parse_kb_value(const std::string& value_with_kb_units)
+{
+    static const std::regex regex{"([0-9]+) kB"};
+    std::smatch match;
+    std::regex_search(value_with_kb_units, match, regex);
+    if (match.size() > 1)
+    {
+        return std::stoul(match.str(1));
+    }
+    return std::nullopt;
+}
+
+std::unordered_map<std::string, std::string> parse_dictionary_file(std::istream& input)
+{
+    std::unordered_map<std::string, std::string> status_map;
+    std::string line;
+    while (std::getline(input, line))
+    {
+        if (line.empty())
+            continue;
+        const auto colon_pos = line.find(":");
+        if (colon_pos == std::string::npos)
+            continue;
+
+        std::string key = line.substr(0, colon_pos);
+        boost::trim(key);
+        std::string value = line.substr(colon_pos + 1, line.size() - colon_pos);
+        boost::trim(value);
+        status_map[key] = value;
+    }
+    return status_map;
+}
+
+std::unordered_map<std::string, uint64_t> parse_flat_keyed_file(std::istream& input)
+{
+    std::unordered_map<std::string, uint64_t> values;
+    std::string key;
+    uint64_t value;
+    while (input >> key >> value)
+    {
+        values[key] = value;
+    }
+    return values;
+}
+
+std::optional<StatFields> parse_stat_line(const std::string& line)
+{
+    // The comm field is wrapped in parentheses but is not escaped, so find the last closing one
+    const auto comm_start = line.find('(');
+    const auto comm_end = line.rfind(')');
+    if (comm_start == std::string::npos || comm_end == std::string::npos || comm_end < comm_start)
+        return std::nullopt;
+
+    StatFields fields;
+    fields.comm = line.substr(comm_start + 1, comm_end - comm_start - 1);
+
+    // Remaining columns start at column 3 (state)
+    std::istringstream columns{line.substr(comm_end + 1)};
+    std::string column;
+    for (auto i = 3; i <= 15 && columns >> column; ++i)
+    {
+        if (i == 4)
+            fields.ppid = std::stoi(column);
+        else if (i == 14)
+            fields.utime = std::stoul(column);
+        else if (i == 15)
+        {
+            fields.stime = std::stoul(column);
+            return fields;
+        }
+    }
+    return std::nullopt;
+}
+
+} // namespace filesystem
@@ -0,0 +1,153 @@
+#include <api_server/filesystem/parsers.h>
+#include <api_server/filesystem/smaps.h>
+#include <api_server/filesystem/types.h>
+#include <api_server/time.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fmt/format.h>
+#include <fstream>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+
+namespace filesystem
+{
+using namespace data;
+namespace fs = std::filesystem;
+
+SmapsCollector::SmapsCollector(Logger& logger, data::DataStore& datastore, const fs::path& proc_root)
+    : m_logger{logger}, m_datastore{datastore}, m_proc_root{proc_root}
+{
+}
+
+void SmapsCollector::start()
+{
+    m_logger.debug("SmapsCollector::start");
+    // On Linux the nice value is per-thread, so this leaves the rest of the server untouched
+    if (setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), NICENESS) != 0)
+    {
+        m_logger.warning("SmapsCollector::start - unable to lower thread priority");
+    }
+
+    while (m_running)
+    {
+        std::this_thread::sleep_for(SLICE_INTERVAL);
+        run_slice();
+    }
+}
+
+void SmapsCollector::stop()
+{
+    m_running = false;
+}
+
+void SmapsCollector::run_slice()
+{
+    const auto slice_start = Clock::now();
+    if (m_queue.empty() || slice_start - m_planned_at >= REPLAN_INTERVAL)
+    {
+        m_queue = plan(m_datastore.get_proc_snapshots(), m_last_visited, slice_start);
+        m_planned_at = slice_start;
+    }
+
+    const auto allowance = slice_allowance(m_overrun);
+    if (allowance == Clock::duration::zero())
+        return;
+    const auto deadline = slice_start + allowance;
+    while (!m_queue.empty() && Clock::now() < deadline)
+    {
+        const auto pid = m_queue.back();
+        m_queue.pop_back();
+        m_last_visited[pid] = Clock::now();
+        if (const auto sample = read_smaps_rollup(pid); sample)
+        {
+            m_datastore.store_smaps_sample(pid, sample.value());
+        }
+    }
+    m_overrun = std::max(Clock::duration{0}, Clock::now() - deadline);
+}
+
+std::vector<int32_t> SmapsCollector::plan(const std::vector<ProcSnapshot>& procs, VisitTimes& last_visited,
+                                          const Clock::time_point now)
+{
+    VisitTimes still_running;
+    std::vector<std::pair<double, int32_t>> priorities;
+    for (const auto& proc : procs)
+    {
+        // Kernel threads have no user address space to sample
+        if (proc.mem_usage_kB == 0)
+            continue;
+
+        auto staleness_s = 3600.0; // Never sampled
+        if (const auto iter = last_visited.find(proc.pid); iter != last_visited.end())
+        {
+            still_running.insert(*iter);
+            staleness_s = std::chrono::duration<double>(now - iter->second).count();
+        }
+        priorities.emplace_back(proc.mem_usage_kB * staleness_s, proc.pid);
+    }
+    std::sort(priorities.begin(), priorities.end());
+
+    last_visited = std::move(still_running);
+    std::vector<int32_t> queue;
+    queue.reserve(priorities.size());
+    std::transform(priorities.cbegin(), priorities.cend(), std::back_inserter(queue),
+                   [](const auto& priority) { return priority.second; });
+    return queue;
+}
+
+SmapsCollector::Clock::duration SmapsCollector::slice_allowance(Clock::duration& overrun)
+{
+    const Clock::duration slice_budget = BUDGET_PER_SECOND * SLICE_INTERVAL.count() / 1000;
+    if (overrun >= slice_budget)
+    {
+        // A single slow read (e.g. a process with a huge address space) can exceed the budget, skip slices to repay it
+        overrun -= slice_budget;
+        return Clock::duration::zero();
+    }
+    const auto allowance = slice_budget - overrun;
+    overrun = Clock::duration::zero();
+    return allowance;
+}
+
+std::optional<SmapsSample> SmapsCollector::read_smaps_rollup(const int32_t pid) const
+{
+    std::ifstream input{m_proc_root / std::to_string(pid) / "smaps_rollup"};
+    if (!input)
+    {
+        // Expected if proc has been removed, or we lack permission to inspect it
+        return std::nullopt;
+    }
+    auto sample = parse_smaps_rollup(input);
+    if (sample)
+    {
+        sample->sample_time = uptime_seconds();
+    }
+    return sample;
+}
+
+std::optional<SmapsSample> SmapsCollector::parse_smaps_rollup(std::istream& input)
+{
+    const auto values = parse_dictionary_file(input);
+    const auto lookup_kb = [&values](const std::string& key) -> std::optional<uint32_t> {
+        const auto iter = values.find(key);
+        if (iter == values.end())
+            return std::nullopt;
+        return parse_kb_value(iter->second);
+    };
+
+    const auto pss_kB = lookup_kb("Pss");
+    if (!pss_kB)
+        return std::nullopt;
+
+    SmapsSample sample;
+    sample.pss_kB = pss_kB.value();
+    sample.uss_kB = lookup_kb("Private_Clean").value_or(0u) + lookup_kb("Private_Dirty").value_or(0u) +
+                    lookup_kb("Private_Hugetlb").value_or(0u);
+    sample.swap_kB = lookup_kb("Swap").value_or(0u);
+    return sample;
+}
+
+} // namespace filesystem
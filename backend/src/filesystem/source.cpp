@@ -0,0 +1,134 @@
+#include <api_server/filesystem/source.h>
+
+#include <fcntl.h>
+#include <regex>
+#include <unistd.h>
+
+namespace filesystem
+{
+namespace fs = std::filesystem;
+
+LiveProcSource::LiveProcSource(const fs::path& proc_root) : m_proc_root{proc_root}
+{
+}
+
+std::vector<int32_t> LiveProcSource::list_pids()
+{
+    std::vector<int32_t> pids;
+    auto dir_iter = fs::directory_iterator(m_proc_root, fs::directory_options::skip_permission_denied);
+    for (const auto& entry : dir_iter)
+    {
+        if (!is_proc_dir(entry))
+            continue;
+
+        pids.push_back(std::stoi(entry.path().filename().string()));
+    }
+    return pids;
+}
+
+std::optional<std::string> LiveProcSource::read_file(const std::string& path)
+{
+    // Proc files report a size of 0, so they are read until the end rather than by their size
+    const auto fd = open((m_proc_root / path).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return std::nullopt;
+    std::string contents;
+    char buffer[4096];
+    ssize_t count;
+    while ((count = ::read(fd, buffer, sizeof(buffer))) > 0)
+        contents.append(buffer, static_cast<std::size_t>(count));
+    close(fd);
+    return contents;
+}
+
+bool LiveProcSource::is_proc_dir(const fs::directory_entry& entry) const
+{
+    if (!entry.is_directory())
+    {
+        return false;
+    }
+    std::regex pid_regex{"^[0-9]+$"};
+    std::smatch match;
+    const auto dirname = entry.path().filename().string();
+    std::regex_match(dirname, match, pid_regex);
+    if (match.empty())
+    {
+        return false;
+    }
+
+    const auto stat_path = entry.path() / "status";
+    return fs::exists(stat_path);
+}
+
+RecordingProcSource::RecordingProcSource(std::unique_ptr<ProcSource> source, const std::string& capture_path)
+    : m_source{std::move(source)}, m_writer{capture_path}
+{
+}
+
+bool RecordingProcSource::begin_poll()
+{
+    if (!m_source->begin_poll())
+        return false;
+    const auto now = Clock::now();
+    if (!m_start)
+        m_start = now;
+    m_writer.begin_poll(std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_start.value()));
+    return true;
+}
+
+void RecordingProcSource::end_poll()
+{
+    m_source->end_poll();
+    m_writer.end_poll();
+}
+
+std::vector<int32_t> RecordingProcSource::list_pids()
+{
+    auto pids = m_source->list_pids();
+    m_writer.pids(pids);
+    return pids;
+}
+
+std::optional<std::string> RecordingProcSource::read_file(const std::string& path)
+{
+    auto contents = m_source->read_file(path);
+    m_writer.file(path, contents);
+    return contents;
+}
+
+ReplayProcSource::ReplayProcSource(const std::string& capture_path, const double speed)
+    : m_reader{capture_path}, m_speed{speed}, m_next{m_reader.next_poll()}
+{
+}
+
+ProcSource::Clock::duration ReplayProcSource::poll_interval(const Clock::duration) const
+{
+    if (!m_poll || !m_next || m_speed <= 0.0)
+        return Clock::duration::zero();
+    const auto recorded = std::chrono::duration<double>(m_next->time - m_poll->time) / m_speed;
+    return std::chrono::duration_cast<Clock::duration>(recorded);
+}
+
+bool ReplayProcSource::begin_poll()
+{
+    if (!m_next)
+        return false;
+    m_poll = std::move(m_next);
+    m_next = m_reader.next_poll();
+    return true;
+}
+
+std::vector<int32_t> ReplayProcSource::list_pids()
+{
+    return m_poll ? m_poll->pids : std::vector<int32_t>{};
+}
+
+std::optional<std::string> ReplayProcSource::read_file(const std::string& path)
+{
+    if (!m_poll)
+        return std::nullopt;
+    const auto iter = m_poll->files.find(path);
+    return iter != m_poll->files.end() ? iter->second : std::nullopt;
+}
+
+} // namespace filesystem
@@ -0,0 +1,158 @@
+#include <api_server/filesystem/parsers.h>
+#include <api_server/filesystem/threads.h>
+#include <api_server/filesystem/types.h>
+#include <api_server/filesystem/usage.h>
+
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <unordered_set>
+
+namespace filesystem
+{
+using namespace data;
+namespace fs = std::filesystem;
+
+ThreadCollector::ThreadCollector(Logger& logger, data::DataStore& datastore,
+                                 const std::optional<float> cpu_threshold_percent, const uint32_t clk_tck,
+                                 const fs::path& proc_root)
+    : m_logger{logger}, m_datastore{datastore}, m_cpu_threshold_percent{cpu_threshold_percent}, m_clk_tck{clk_tck},
+      m_proc_root{proc_root}
+{
+}
+
+void ThreadCollector::collect(const std::vector<ProcSnapshot>& procs, const double snapshot_time)
+{
+    const auto pids = select_procs(procs);
+
+    std::unordered_map<int32_t, ProcState> states;
+    std::vector<ProcThreads> snapshots;
+    uint32_t budget = MAX_THREADS_PER_POLL;
+    for (const auto pid : pids)
+    {
+        if (budget == 0)
+            break;
+        auto& state = states[pid];
+        if (const auto iter = m_procs.find(pid); iter != m_procs.end())
+        {
+            state = std::move(iter->second);
+        }
+        auto proc_threads = collect_proc(pid, state, std::min(budget, MAX_THREADS_PER_PROC), snapshot_time);
+        if (!proc_threads)
+        {
+            states.erase(pid);
+            continue;
+        }
+        budget -= proc_threads->sampled_count;
+        snapshots.emplace_back(std::move(proc_threads.value()));
+    }
+    // Forget processes that are no longer selected, or that exited
+    m_procs = std::move(states);
+    m_datastore.store_thread_snapshots(snapshots);
+}
+
+std::vector<int32_t> ThreadCollector::select_procs(const std::vector<ProcSnapshot>& procs)
+{
+    // Explicit requests first, then the busiest processes above the threshold
+    auto pids = m_datastore.get_thread_monitoring_requests(REQUEST_TTL);
+    if (!m_cpu_threshold_percent)
+        return pids;
+
+    std::vector<const ProcSnapshot*> busy;
+    for (const auto& proc : procs)
+    {
+        if (proc.cpu_usage_percent >= m_cpu_threshold_percent.value())
+            busy.push_back(&proc);
+    }
+    std::sort(busy.begin(), busy.end(),
+              [](const auto* a, const auto* b) { return a->cpu_usage_percent > b->cpu_usage_percent; });
+    const std::unordered_set<int32_t> requested{pids.cbegin(), pids.cend()};
+    for (const auto* proc : busy)
+    {
+        if (requested.count(proc->pid) == 0)
+            pids.push_back(proc->pid);
+    }
+    return pids;
+}
+
+std::optional<ProcThreads> ThreadCollector::collect_proc(const int32_t pid, ProcState& state, const uint32_t budget,
+                                                         const double snapshot_time) const
+{
+    const auto task_dir = m_proc_root / std::to_string(pid) / "task";
+    const auto tids = list_threads(task_dir);
+    if (tids.empty())
+    {
+        // Expected if proc has been removed
+        return std::nullopt;
+    }
+
+    ProcThreads proc_threads;
+    proc_threads.pid = pid;
+    proc_threads.thread_count = static_cast<uint32_t>(tids.size());
+
+    // Continue from where the previous window ended, wrapping around
+    const auto window_size = std::min<std::size_t>(budget, tids.size());
+    auto next = static_cast<std::size_t>(std::upper_bound(tids.cbegin(), tids.cend(), state.cursor) - tids.cbegin());
+    for (std::size_t i = 0; i < window_size; ++i, ++next)
+    {
+        const auto tid = tids[next % tids.size()];
+        state.cursor = tid;
+
+        std::ifstream input{task_dir / std::to_string(tid) / "stat"};
+        std::string line;
+        if (!std::getline(input, line))
+            continue; // Thread exited
+        const auto fields = parse_stat_line(line);
+        if (!fields)
+            continue;
+
+        ThreadSnapshot snapshot;
+        snapshot.snapshot_time = snapshot_time;
+        snapshot.tid = tid;
+        snapshot.name = fields->comm;
+        snapshot.utime = fields->utime;
+        snapshot.stime = fields->stime;
+        if (const auto prev = state.threads.find(tid); prev != state.threads.end())
+        {
+            snapshot.cpu_usage_percent =
+                cpu_usage_percent(prev->second.snapshot_time, prev->second.utime + prev->second.stime,
+                                  snapshot.snapshot_time, snapshot.utime + snapshot.stime, m_clk_tck);
+        }
+        state.threads[tid] = snapshot;
+        ++proc_threads.sampled_count;
+    }
+
+    // Drop threads that have exited, report the rest (including any outside this poll's window)
+    for (auto iter = state.threads.begin(); iter != state.threads.end();)
+    {
+        if (!std::binary_search(tids.cbegin(), tids.cend(), iter->first))
+        {
+            iter = state.threads.erase(iter);
+            continue;
+        }
+        proc_threads.threads.push_back(iter->second);
+        ++iter;
+    }
+    std::sort(proc_threads.threads.begin(), proc_threads.threads.end(),
+              [](const auto& a, const auto& b) { return a.cpu_usage_percent > b.cpu_usage_percent; });
+    return proc_threads;
+}
+
+std::vector<int32_t> ThreadCollector::list_threads(const fs::path& task_dir) const
+{
+    std::vector<int32_t> tids;
+    std::error_code error;
+    for (auto iter = fs::directory_iterator(task_dir, error); !error && iter != fs::directory_iterator();
+         iter.increment(error))
+    {
+        const auto name = iter->path().filename().string();
+        int32_t tid = 0;
+        const auto [ptr, parse_error] = std::from_chars(name.data(), name.data() + name.size(), tid);
+        if (parse_error == std::errc{} && ptr == name.data() + name.size())
+            tids.push_back(tid);
+    }
+    std::sort(tids.begin(), tids.end());
+    return tids;
+}
+
+} // namespace filesystem
@@ -0,0 +1,519 @@
+// HTTP load generator for api_server: keeps a number of connections busy with a weighted mix of requests, open-loop
+// at a fixed rate or closed-loop as fast as the server answers, and reports the throughput and latency percentiles.
+// It can also start its own api_server, reading a generated /proc tree, so that runs are comparable between builds.
+
+#include <algorithm>
+#include <atomic>
+#include <boost/asio/connect.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/beast.hpp>
+#include <chrono>
+#include <csignal>
+#include <fcntl.h>
+#include <fmt/format.h>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "api_server/loadgen/load.h"
+#include "testing/fake_proc.h"
+
+namespace asio = boost::asio;
+namespace bb = boost::beast;
+using asio::ip::tcp;
+using namespace loadgen;
+
+namespace
+{
+
+struct LoadConfig
+{
+    std::string host{"127.0.0.1"};
+    std::string port{};
+    std::vector<Target> targets{};
+    std::size_t connections{64u};
+    std::size_t threads{std::max(1u, std::thread::hardware_concurrency())};
+    std::chrono::seconds duration{10};
+    std::chrono::milliseconds timeout{5000}; // For each request, including connecting
+    double rate{0.0}; // Requests per second across all connections, or 0 for closed-loop
+    bool keep_alive{true};
+    bool json{false};
+    std::optional<std::string> spawn{}; // api_server executable to start against a fake /proc tree
+    std::size_t procs{10000u};          // Processes in the fake /proc tree
+};
+
+/// @brief Measurements of the connections run by one thread
+struct Results
+{
+    std::vector<uint64_t> latencies_ns;    // From when each request was due to be sent, see Connection
+    std::vector<uint64_t> service_times_ns; // From when each request was actually sent
+    std::vector<uint64_t> target_requests;  // Completed requests per target
+    uint64_t errors{0u};   // Including timeouts
+    uint64_t timeouts{0u}; // Requests that took longer than the timeout
+    uint64_t bytes{0u};
+};
+
+/// @brief Sends requests over one connection until the deadline, one at a time.
+/// At a fixed rate, each request is due at a point of the connection's schedule, and its latency is measured from
+/// then rather than from when it was sent. A slow response delays the requests after it, and that time spent waiting
+/// to be sent is counted in their latency, as it would be for clients that don't wait for each other. Without this
+/// correction for coordinated omission, a stall would only count against the one request it delayed (see Schedule).
+/// A request that takes longer than the timeout fails, and one still outstanding at the deadline is cancelled without
+/// being counted, so that a stalled server can't keep the run going.
+class Connection : public std::enable_shared_from_this<Connection>
+{
+public:
+    Connection(asio::io_context& context, const LoadConfig& config, const tcp::resolver::results_type& endpoints,
+               const std::vector<uint32_t>& cumulative_weights, const std::size_t index,
+               const Clock::time_point start, const Clock::time_point deadline, Results& results)
+        : m_config{config}, m_endpoints{endpoints}, m_cumulative_weights{cumulative_weights}, m_stream{context},
+          m_timer{context}, m_random{static_cast<uint32_t>(index)}, m_deadline{deadline}, m_results{results},
+          m_schedule{config.rate, config.connections, index, start}
+    {
+    }
+
+    void start()
+    {
+        send_when_due();
+    }
+
+private:
+    void send_when_due()
+    {
+        m_due = m_schedule.due(Clock::now());
+        if (m_due >= m_deadline)
+        {
+            close();
+            return;
+        }
+        m_timer.expires_at(m_due);
+        m_timer.async_wait([self = shared_from_this()](const bb::error_code&) { self->send(); });
+    }
+
+    void send()
+    {
+        const auto choice = std::uniform_int_distribution<uint32_t>{0u, m_cumulative_weights.back() - 1u}(m_random);
+        m_target = static_cast<std::size_t>(
+            std::upper_bound(m_cumulative_weights.cbegin(), m_cumulative_weights.cend(), choice) -
+            m_cumulative_weights.cbegin());
+        m_request = {bb::http::verb::get, m_config.targets[m_target].path, 11};
+        m_request.set(bb::http::field::host, m_config.host);
+        m_request.set(bb::http::field::accept_encoding, "gzip");
+        m_request.keep_alive(m_config.keep_alive);
+        m_sent = Clock::now();
+        m_stream.expires_at(std::min(m_sent + m_config.timeout, m_deadline));
+
+        if (m_connected)
+        {
+            write();
+            return;
+        }
+        m_stream.async_connect(m_endpoints, [self = shared_from_this()](const bb::error_code& error,
+                                                                        const tcp::endpoint&) {
+            if (error)
+            {
+                self->fail(error);
+                return;
+            }
+            self->m_connected = true;
+            self->write();
+        });
+    }
+
+    void write()
+    {
+        bb::http::async_write(m_stream, m_request,
+                              [self = shared_from_this()](const bb::error_code& error, const std::size_t) {
+                                  if (error)
+                                  {
+                                      self->fail(error);
+                                      return;
+                                  }
+                                  self->read();
+                              });
+    }
+
+    void read()
+    {
+        m_parser.emplace();
+        m_parser->body_limit(std::numeric_limits<std::uint64_t>::max());
+        bb::http::async_read(m_stream, m_buffer, *m_parser,
+                             [self = shared_from_this()](const bb::error_code& error, const std::size_t bytes) {
+                                 self->on_response(error, bytes);
+                             });
+    }
+
+    void on_response(const bb::error_code& error, const std::size_t bytes)
+    {
+        const auto now = Clock::now();
+        const auto& response = m_parser->get();
+        if (error || (response.result_int() >= 400u))
+        {
+            fail(error);
+            return;
+        }
+        m_results.latencies_ns.push_back(nanoseconds(now - m_due));
+        m_results.service_times_ns.push_back(nanoseconds(now - m_sent));
+        ++m_results.target_requests[m_target];
+        m_results.bytes += bytes;
+        if (!m_config.keep_alive || !response.keep_alive())
+            close();
+        m_schedule.next();
+        send_when_due();
+    }
+
+    /// @brief Counts a failed request and starts the next one on a new connection, unless the deadline cut it off
+    void fail(const bb::error_code& error)
+    {
+        close();
+        if (error == bb::error::timeout && Clock::now() >= m_deadline)
+            return;
+        ++m_results.errors;
+        if (error == bb::error::timeout)
+            ++m_results.timeouts;
+        m_schedule.next_after_failure(Clock::now());
+        send_when_due();
+    }
+
+    void close()
+    {
+        if (!m_connected)
+            return;
+        bb::error_code error;
+        m_stream.socket().shutdown(tcp::socket::shutdown_both, error);
+        m_stream.close();
+        m_buffer.clear();
+        m_connected = false;
+    }
+
+    static uint64_t nanoseconds(const Clock::duration duration)
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+    }
+
+    const LoadConfig& m_config;
+    const tcp::resolver::results_type& m_endpoints;
+    const std::vector<uint32_t>& m_cumulative_weights;
+    bb::tcp_stream m_stream;
+    asio::steady_timer m_timer;
+    std::minstd_rand m_random;
+    const Clock::time_point m_deadline;
+    Results& m_results;
+    Schedule m_schedule;
+    Clock::time_point m_due;  // When the current request was due to be sent
+    Clock::time_point m_sent; // When it was sent
+    bool m_connected{false};
+    std::size_t m_target{0u};
+    bb::flat_buffer m_buffer;
+    bb::http::request<bb::http::empty_body> m_request;
+    std::optional<bb::http::response_parser<bb::http::string_body>> m_parser;
+};
+
+nlohmann::json to_json(const Percentiles& percentiles)
+{
+    return {{"p50", percentiles.p50_ms},   {"p90", percentiles.p90_ms}, {"p99", percentiles.p99_ms},
+            {"p999", percentiles.p999_ms}, {"max", percentiles.max_ms}, {"mean", percentiles.mean_ms}};
+}
+
+/// @brief Returns the response to a GET, or nullopt if it couldn't be made within the timeout
+std::optional<bb::http::response<bb::http::string_body>> get(const LoadConfig& config, const std::string& target)
+{
+    asio::io_context context;
+    bb::error_code error;
+    const auto endpoints = tcp::resolver{context}.resolve(config.host, config.port, error);
+    if (error)
+        return std::nullopt;
+    bb::http::request<bb::http::empty_body> request{bb::http::verb::get, target, 11};
+    request.set(bb::http::field::host, config.host);
+    bb::flat_buffer buffer;
+    bb::http::response<bb::http::string_body> response;
+
+    // Asynchronous, as only asynchronous operations on the stream time out
+    bb::tcp_stream stream{context};
+    stream.expires_after(config.timeout);
+    stream.async_connect(endpoints, [&](const bb::error_code& connect_error, const tcp::endpoint&) {
+        if ((error = connect_error))
+            return;
+        bb::http::async_write(stream, request, [&](const bb::error_code& write_error, const std::size_t) {
+            if ((error = write_error))
+                return;
+            bb::http::async_read(stream, buffer, response,
+                                 [&](const bb::error_code& read_error, const std::size_t) { error = read_error; });
+        });
+    });
+    context.run();
+    if (error)
+        return std::nullopt;
+    return response;
+}
+
+/// @brief Returns a port that is free to listen on
+uint16_t free_port()
+{
+    asio::io_context context;
+    tcp::acceptor acceptor{context, {asio::ip::make_address("127.0.0.1"), 0}};
+    return acceptor.local_endpoint().port();
+}
+
+/// @brief Starts api_server reading a fake /proc tree, with its output discarded
+pid_t spawn_server(const std::string& executable, const std::string& port, const std::string& proc_root)
+{
+    const auto pid = fork();
+    if (pid == 0)
+    {
+        const auto null = open("/dev/null", O_WRONLY);
+        dup2(null, STDOUT_FILENO);
+        dup2(null, STDERR_FILENO);
+        execl(executable.c_str(), executable.c_str(), "127.0.0.1", port.c_str(), "--proc-root", proc_root.c_str(),
+              static_cast<char*>(nullptr));
+        _exit(127);
+    }
+    return pid;
+}
+
+/// @brief Waits until the server has published its first monitor poll, i.e. the uptime's ETag is past generation 0
+bool wait_until_ready(const LoadConfig& config, const pid_t server)
+{
+    const auto deadline = Clock::now() + std::chrono::seconds{30};
+    while (Clock::now() < deadline)
+    {
+        if (server > 0 && waitpid(server, nullptr, WNOHANG) == server)
+            return false;
+        const auto response = get(config, "/api/uptime");
+        if (response && response->result() == bb::http::status::ok)
+        {
+            // ETags are "<nonce>-<generation>"
+            const auto etag = (*response)[bb::http::field::etag];
+            if (etag.size() < 3u || etag.substr(etag.size() - 3u) != "-0\"")
+                return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds{100});
+    }
+    return false;
+}
+
+[[noreturn]] void print_usage_and_exit()
+{
+    std::cout << "Usage: loadgen [options] <host> <port>\n"
+                 "       loadgen [options] --spawn <api_server>\n"
+                 "Options:\n"
+                 "  --target [<weight>:]<path>  Request this target, repeat for a weighted mix (default: /api/procs)\n"
+                 "  --connections <count>       Concurrent connections (default: 64)\n"
+                 "  --threads <count>           Threads running the connections (default: one per core)\n"
+                 "  --duration <seconds>        How long to send requests for (default: 10)\n"
+                 "  --timeout <milliseconds>    Fail requests that take longer than this (default: 5000)\n"
+                 "  --rate <requests/s>         Send at this total rate, measuring latency from when each request\n"
+                 "                              was due (default: as fast as responses arrive)\n"
+                 "  --no-keep-alive             Open a new connection for every request\n"
+                 "  --json                      Print the summary as JSON\n"
+                 "  --spawn <api_server>        Start this api_server on a free port, reading a generated /proc\n"
+                 "  --procs <count>             Processes in the generated /proc (default: 10000)\n";
+    exit(1);
+}
+
+LoadConfig parse_args(const int argc, char** argv)
+{
+    std::vector<std::string> args(argv, argv + argc);
+    LoadConfig config;
+    std::vector<std::string> positional;
+    for (std::size_t i = 1; i < args.size(); ++i)
+    {
+        const bool has_value = i + 1 < args.size();
+        if (args[i] == "--target" && has_value)
+        {
+            try
+            {
+                config.targets.push_back(parse_target(args[++i]));
+            }
+            catch (const std::runtime_error&)
+            {
+                print_usage_and_exit();
+            }
+        }
+        else if (args[i] == "--connections" && has_value)
+            config.connections = std::max(1ul, std::stoul(args[++i]));
+        else if (args[i] == "--threads" && has_value)
+            config.threads = std::max(1ul, std::stoul(args[++i]));
+        else if (args[i] == "--duration" && has_value)
+            config.duration = std::chrono::seconds{std::stoul(args[++i])};
+        else if (args[i] == "--timeout" && has_value)
+            config.timeout = std::chrono::milliseconds{std::max(1ul, std::stoul(args[++i]))};
+        else if (args[i] == "--rate" && has_value)
+            config.rate = std::stod(args[++i]);
+        else if (args[i] == "--no-keep-alive")
+            config.keep_alive = false;
+        else if (args[i] == "--json")
+            config.json = true;
+        else if (args[i] == "--spawn" && has_value)
+            config.spawn = args[++i];
+        else if (args[i] == "--procs" && has_value)
+            config.procs = std::stoul(args[++i]);
+        else if (args[i].rfind("--", 0) == 0)
+            print_usage_and_exit();
+        else
+            positional.push_back(args[i]);
+    }
+    if (config.spawn ? !positional.empty() : positional.size() != 2u)
+        print_usage_and_exit();
+    if (!config.spawn)
+    {
+        config.host = positional[0];
+        config.port = positional[1];
+    }
+    if (config.targets.empty())
+        config.targets.push_back({"/api/procs", 1u});
+    config.threads = std::min(config.threads, config.connections);
+    return config;
+}
+
+/// @brief Runs the connections until the deadline, returning the combined results and the time taken
+std::pair<Results, double> run_load(const LoadConfig& config)
+{
+    std::vector<uint32_t> cumulative_weights;
+    for (const auto& target : config.targets)
+        cumulative_weights.push_back((cumulative_weights.empty() ? 0u : cumulative_weights.back()) + target.weight);
+
+    std::vector<std::unique_ptr<asio::io_context>> contexts;
+    std::vector<Results> results(config.threads);
+    for (auto& result : results)
+        result.target_requests.resize(config.targets.size());
+    asio::io_context resolve_context;
+    const auto endpoints = tcp::resolver{resolve_context}.resolve(config.host, config.port);
+
+    const auto start = Clock::now();
+    const auto deadline = start + config.duration;
+    for (std::size_t i = 0; i < config.threads; ++i)
+        contexts.push_back(std::make_unique<asio::io_context>(1));
+    for (std::size_t i = 0; i < config.connections; ++i)
+    {
+        const auto thread = i % config.threads;
+        std::make_shared<Connection>(*contexts[thread], config, endpoints, cumulative_weights, i, start, deadline,
+                                     results[thread])
+            ->start();
+    }
+    std::vector<std::thread> threads;
+    for (auto& context : contexts)
+        threads.emplace_back([&context]() { context->run(); });
+    for (auto& thread : threads)
+        thread.join();
+    const auto elapsed_s = std::chrono::duration<double>(Clock::now() - start).count();
+
+    Results total;
+    total.target_requests.resize(config.targets.size());
+    for (const auto& result : results)
+    {
+        total.latencies_ns.insert(total.latencies_ns.end(), result.latencies_ns.cbegin(), result.latencies_ns.cend());
+        total.service_times_ns.insert(total.service_times_ns.end(), result.service_times_ns.cbegin(),
+                                      result.service_times_ns.cend());
+        for (std::size_t i = 0; i < config.targets.size(); ++i)
+            total.target_requests[i] += result.target_requests[i];
+        total.errors += result.errors;
+        total.timeouts += result.timeouts;
+        total.bytes += result.bytes;
+    }
+    return {std::move(total), elapsed_s};
+}
+
+void print_summary(const LoadConfig& config, Results& results, const double elapsed_s)
+{
+    const auto requests = results.latencies_ns.size();
+    const auto latency = percentiles(results.latencies_ns);
+    const auto service_time = percentiles(results.service_times_ns);
+    const auto requests_per_second = static_cast<double>(requests) / elapsed_s;
+    if (config.json)
+    {
+        nlohmann::json targets = nlohmann::json::array();
+        for (std::size_t i = 0; i < config.targets.size(); ++i)
+        {
+            targets.push_back({{"path", config.targets[i].path},
+                               {"weight", config.targets[i].weight},
+                               {"requests", results.target_requests[i]}});
+        }
+        const nlohmann::json summary{{"connections", config.connections},
+                                     {"duration_s", elapsed_s},
+                                     {"rate", config.rate},
+                                     {"keep_alive", config.keep_alive},
+                                     {"procs", config.spawn ? nlohmann::json(config.procs) : nlohmann::json()},
+                                     {"targets", targets},
+                                     {"requests", requests},
+                                     {"errors", results.errors},
+                                     {"timeouts", results.timeouts},
+                                     {"requests_per_second", requests_per_second},
+                                     {"bytes_per_second", static_cast<double>(results.bytes) / elapsed_s},
+                                     {"coordinated_omission_corrected", config.rate > 0.0},
+                                     {"latency_ms", to_json(latency)},
+                                     {"service_time_ms", to_json(service_time)}};
+        std::cout << summary.dump() << "\n";
+        return;
+    }
+    std::cout << fmt::format("connections={} requests={} errors={} timeouts={} requests_per_second={:.1f} "
+                             "MiB_per_second={:.2f}\n",
+                             config.connections, requests, results.errors, results.timeouts, requests_per_second,
+                             static_cast<double>(results.bytes) / elapsed_s / (1024.0 * 1024.0));
+    for (const auto& [name, values] : {std::pair{config.rate > 0.0 ? "latency" : "latency (uncorrected)", latency},
+                                       std::pair{"service time", service_time}})
+    {
+        std::cout << fmt::format("{:<22} p50={:.3f}ms p90={:.3f}ms p99={:.3f}ms p999={:.3f}ms max={:.3f}ms\n", name,
+                                 values.p50_ms, values.p90_ms, values.p99_ms, values.p999_ms, values.max_ms);
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    auto config = parse_args(argc, argv);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    std::unique_ptr<filesystem::FakeProcTree> tree;
+    std::atomic<bool> churning{true};
+    std::thread churn_thread;
+    pid_t server{-1};
+    if (config.spawn)
+    {
+        tree = std::make_unique<filesystem::FakeProcTree>(config.procs);
+        config.port = std::to_string(free_port());
+        server = spawn_server(config.spawn.value(), config.port, tree->proc_root().string());
+        // Replace 1% of the processes every second, as on a busy host
+        churn_thread = std::thread{[&tree, &churning, procs = config.procs]() {
+            while (churning.load())
+            {
+                std::this_thread::sleep_for(std::chrono::seconds{1});
+                tree->churn(procs / 100u);
+                tree->advance();
+            }
+        }};
+    }
+
+    int status{0};
+    if (wait_until_ready(config, server))
+    {
+        auto [results, elapsed_s] = run_load(config);
+        print_summary(config, results, elapsed_s);
+    }
+    else
+    {
+        std::cerr << "loadgen: the server at " << config.host << ":" << config.port << " didn't become ready\n";
+        status = 1;
+    }
+
+    if (server > 0)
+    {
+        kill(server, SIGTERM);
+        waitpid(server, nullptr, 0);
+        churning.store(false);
+        churn_thread.join();
+    }
+    return status;
+}
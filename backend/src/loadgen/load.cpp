@@ -0,0 +1,81 @@
+#include "api_server/loadgen/load.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <stdexcept>
+
+namespace loadgen
+{
+
+Target parse_target(const std::string& arg)
+{
+    const auto colon = arg.find(':');
+    if (colon != std::string::npos && colon > 0u &&
+        std::all_of(arg.cbegin(), arg.cbegin() + static_cast<std::ptrdiff_t>(colon), ::isdigit))
+    {
+        uint32_t weight{0u};
+        const auto result = std::from_chars(arg.data(), arg.data() + colon, weight);
+        if (result.ec != std::errc{} || weight == 0u)
+            throw std::runtime_error("Invalid weight for target " + arg);
+        return {arg.substr(colon + 1), weight};
+    }
+    return {arg, 1u};
+}
+
+Percentiles percentiles(std::vector<uint64_t>& values_ns)
+{
+    Percentiles result;
+    if (values_ns.empty())
+        return result;
+    std::sort(values_ns.begin(), values_ns.end());
+    const auto at = [&values_ns](const double quantile) {
+        const auto index = static_cast<std::size_t>(std::ceil(quantile * static_cast<double>(values_ns.size()))) - 1u;
+        return static_cast<double>(values_ns[std::min(index, values_ns.size() - 1u)]) / 1e6;
+    };
+    result.p50_ms = at(0.5);
+    result.p90_ms = at(0.9);
+    result.p99_ms = at(0.99);
+    result.p999_ms = at(0.999);
+    result.max_ms = static_cast<double>(values_ns.back()) / 1e6;
+    double sum{0.0};
+    for (const auto value : values_ns)
+        sum += static_cast<double>(value);
+    result.mean_ms = sum / static_cast<double>(values_ns.size()) / 1e6;
+    return result;
+}
+
+Schedule::Schedule(const double rate, const std::size_t connections, const std::size_t index,
+                   const Clock::time_point start)
+    : m_open_loop{rate > 0.0}, m_due{start}
+{
+    if (m_open_loop)
+    {
+        // Stagger the connections' schedules, so that their requests are spread evenly over each interval
+        m_interval = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(static_cast<double>(connections) / rate));
+        m_due += m_interval * index / connections;
+    }
+}
+
+Clock::time_point Schedule::due(const Clock::time_point now)
+{
+    if (!m_open_loop)
+        m_due = std::max(m_due, now);
+    return m_due;
+}
+
+void Schedule::next()
+{
+    m_due += m_interval;
+}
+
+void Schedule::next_after_failure(const Clock::time_point now)
+{
+    if (m_open_loop)
+        m_due += m_interval;
+    else
+        m_due = now + RETRY_DELAY;
+}
+
+} // namespace loadgen
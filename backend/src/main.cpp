@@ -1,16 +1,28 @@
+#include <boost/algorithm/string.hpp>
 #include <chrono>
+#include <fstream>
 #include <functional>
 #include <iostream>
 #include <memory>
+#include <optional>
+#include <stdexcept>
 #include <string>
 #include <thread>
 #include <vector>
 
+#include "api_server/async_logger.h"
+#include "api_server/cluster/aggregator.h"
+#include "api_server/cluster/store.h"
 #include "api_server/data/datastore.h"
+#include "api_server/filesystem/details.h"
 #include "api_server/filesystem/monitor.h"
-#include "api_server/logger.h"
+#include "api_server/filesystem/smaps.h"
+#include "api_server/filesystem/source.h"
+#include "api_server/push/agent.h"
 #include "api_server/server/api.h"
+#include "api_server/server/cluster_api.h"
 #include "api_server/server/server.h"
+#include "api_server/shm/exporter.h"
 
 using namespace std::chrono_literals;
 
@@ -18,33 +30,297 @@ struct ProgramArgs
 {
     std::string server_ip{"0.0.0.0"};
     uint16_t server_port{8080};
+    filesystem::MonitorConfig monitor_config{};
+    server::ServerConfig server_config{};
+    AsyncLoggerConfig logger_config{};
+    std::chrono::milliseconds trace_threshold{metrics::FlightRecorder::DEFAULT_SLOW_THRESHOLD};
+    std::optional<std::string> record_path;
+    std::optional<std::string> replay_path;
+    double replay_speed{1.0};
+    std::vector<std::string> agents;        // "[node=]host:port" of each agent, in aggregator mode
+    std::optional<std::string> agents_file; // With one agent per line
+    cluster::AggregatorConfig aggregator_config{};
+    std::optional<push::PushConfig> push_config; // Set by --push
+    std::string push_node;
+    std::optional<std::string> shm_name;
+    std::size_t shm_size{shm::DEFAULT_SEGMENT_SIZE};
 };
 
+[[noreturn]] void print_usage_and_exit()
+{
+    std::cout << "Usage: api_server <ip address> <port> [options]\n"
+                 "Options:\n"
+                 "  --thread-cpu-threshold <percent>  Monitor the threads of processes above this CPU usage\n"
+                 "  --proc-root <path>                Read processes from this copy of /proc (default: /proc)\n"
+                 "  --threads <count>                 Threads serving connections (default: one per core)\n"
+                 "  --idle-timeout <seconds>          Close connections idle for this long (default: 30)\n"
+                 "  --log-file <path>                 Log to this file instead of stdout/stderr\n"
+                 "  --log-rotate-size <MiB>           Rotate the log file once it reaches this size (default: never)\n"
+                 "  --trace-threshold <ms>            Trace file reads and lock waits slower than this (default: 10)\n"
+                 "  --record <file>                   Capture the proc files read by each poll to this file\n"
+                 "  --replay <file>                   Serve the polls of a capture instead of reading /proc\n"
+                 "  --replay-speed <factor>           Replay this many times faster than recorded, 0 for as fast as\n"
+                 "                                    possible (default: 1)\n"
+                 "  --push <host:port>                Also push each generation to this collector\n"
+                 "  --push-node <name>                Name this host in pushed frames (default: its hostname)\n"
+                 "  --shm <name>                      Also export each generation to this shared memory segment\n"
+                 "  --shm-size <MiB>                  Size of the shared memory segment (default: 16)\n"
+                 "Aggregator mode, serving the processes of other api_servers instead of this host's:\n"
+                 "  --agent [node=]host:port           Poll this agent, labelling its processes with the node name\n"
+                 "                                    (default: host:port). Can be given more than once.\n"
+                 "  --agents <file>                   Poll the agents listed in this file, one per line\n"
+                 "  --agent-timeout <ms>              Fail fetches from an agent taking longer (default: 2000)\n"
+                 "  --agent-concurrency <count>       Fetch from at most this many agents at once (default: 32)\n";
+    exit(1);
+}
+
 ProgramArgs parse_args(const int argc, char **argv)
 {
     std::vector<std::string> args(argv, argv + argc);
-    if (args.size() != 3)
+    if (args.size() < 3)
     {
-        std::cout << "Usage: api_server <ip address> <port>\n";
-        exit(1);
+        print_usage_and_exit();
     }
     ProgramArgs parsed_args;
     parsed_args.server_ip = args[1];
     parsed_args.server_port = static_cast<uint16_t>(std::stoul(args[2]));
+    for (std::size_t i = 3; i < args.size(); ++i)
+    {
+        const bool has_value = i + 1 < args.size();
+        if (args[i] == "--thread-cpu-threshold" && has_value)
+        {
+            parsed_args.monitor_config.thread_cpu_threshold_percent = std::stof(args[++i]);
+        }
+        else if (args[i] == "--proc-root" && has_value)
+        {
+            parsed_args.monitor_config.proc_root = args[++i];
+        }
+        else if (args[i] == "--threads" && has_value)
+        {
+            parsed_args.server_config.threads = std::stoul(args[++i]);
+        }
+        else if (args[i] == "--idle-timeout" && has_value)
+        {
+            parsed_args.server_config.idle_timeout = std::chrono::seconds{std::stoul(args[++i])};
+        }
+        else if (args[i] == "--log-file" && has_value)
+        {
+            parsed_args.logger_config.file_path = args[++i];
+        }
+        else if (args[i] == "--log-rotate-size" && has_value)
+        {
+            parsed_args.logger_config.rotate_size = std::stoul(args[++i]) * 1024u * 1024u;
+        }
+        else if (args[i] == "--trace-threshold" && has_value)
+        {
+            parsed_args.trace_threshold = std::chrono::milliseconds{std::stoul(args[++i])};
+        }
+        else if (args[i] == "--record" && has_value)
+        {
+            parsed_args.record_path = args[++i];
+        }
+        else if (args[i] == "--replay" && has_value)
+        {
+            parsed_args.replay_path = args[++i];
+        }
+        else if (args[i] == "--replay-speed" && has_value)
+        {
+            parsed_args.replay_speed = std::stod(args[++i]);
+        }
+        else if (args[i] == "--push" && has_value)
+        {
+            const auto& endpoint = args[++i];
+            const auto separator = endpoint.rfind(':');
+            if (separator == std::string::npos || separator == 0u || separator + 1u == endpoint.size())
+                print_usage_and_exit();
+            auto& config = parsed_args.push_config.emplace();
+            config.host = endpoint.substr(0u, separator);
+            config.port = endpoint.substr(separator + 1u);
+        }
+        else if (args[i] == "--push-node" && has_value)
+        {
+            parsed_args.push_node = args[++i];
+        }
+        else if (args[i] == "--shm" && has_value)
+        {
+            parsed_args.shm_name = args[++i];
+        }
+        else if (args[i] == "--shm-size" && has_value)
+        {
+            parsed_args.shm_size = std::stoul(args[++i]) * 1024u * 1024u;
+        }
+        else if (args[i] == "--agent" && has_value)
+        {
+            parsed_args.agents.push_back(args[++i]);
+        }
+        else if (args[i] == "--agents" && has_value)
+        {
+            parsed_args.agents_file = args[++i];
+        }
+        else if (args[i] == "--agent-timeout" && has_value)
+        {
+            parsed_args.aggregator_config.timeout = std::chrono::milliseconds{std::stoul(args[++i])};
+        }
+        else if (args[i] == "--agent-concurrency" && has_value)
+        {
+            parsed_args.aggregator_config.max_concurrency = std::stoul(args[++i]);
+        }
+        else
+        {
+            print_usage_and_exit();
+        }
+    }
+    if (parsed_args.record_path && parsed_args.replay_path)
+    {
+        print_usage_and_exit();
+    }
     return parsed_args;
 }
 
+/// @brief Returns where the monitor reads proc files from, given the record and replay options
+std::unique_ptr<filesystem::ProcSource> make_proc_source(const ProgramArgs& args)
+{
+    if (args.replay_path)
+    {
+        return std::make_unique<filesystem::ReplayProcSource>(args.replay_path.value(), args.replay_speed);
+    }
+    auto source = std::make_unique<filesystem::LiveProcSource>(args.monitor_config.proc_root);
+    if (args.record_path)
+    {
+        return std::make_unique<filesystem::RecordingProcSource>(std::move(source), args.record_path.value());
+    }
+    return source;
+}
+
+/// @brief Returns the agents to aggregate, none unless in aggregator mode
+/// @throw std::runtime_error if the agents file can't be read or an agent is malformed
+std::vector<cluster::AgentEndpoint> read_agents(const ProgramArgs& args)
+{
+    auto specs = args.agents;
+    if (args.agents_file)
+    {
+        std::ifstream input{args.agents_file.value()};
+        if (!input)
+            throw std::runtime_error{"Unable to read agents file " + args.agents_file.value()};
+        std::string line;
+        while (std::getline(input, line))
+        {
+            boost::trim(line);
+            if (!line.empty() && line.front() != '#')
+                specs.push_back(line);
+        }
+    }
+    std::vector<cluster::AgentEndpoint> agents;
+    for (const auto& spec : specs)
+        agents.push_back(cluster::parse_agent_endpoint(spec));
+    return agents;
+}
+
+/// @brief Serves the merged processes of the agents, polling them until the server is stopped
+int run_aggregator(const ProgramArgs& args, const std::vector<cluster::AgentEndpoint>& agents)
+{
+    std::unique_ptr<cluster::ClusterStore> store;
+    try
+    {
+        store = std::make_unique<cluster::ClusterStore>(agents);
+    }
+    catch (const std::runtime_error& error)
+    {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+    AsyncLogger logger{LogLevel::Info, args.logger_config};
+    server::Router router{logger};
+    server::Server server{logger, router, args.server_ip, args.server_port, args.server_config};
+    server::ClusterController cluster_controller{logger, router, *store};
+    cluster::Aggregator aggregator{logger, *store, args.aggregator_config};
+
+    std::thread aggregator_thread([&]() { aggregator.start(); });
+    server.start();
+
+    aggregator.stop();
+    aggregator_thread.join();
+    return 0;
+}
+
 int main(int argc, char **argv)
 {
     const ProgramArgs args = parse_args(argc, argv);
-    StdStreamLogger logger{LogLevel::Info};
+    std::vector<cluster::AgentEndpoint> agents;
+    try
+    {
+        agents = read_agents(args);
+    }
+    catch (const std::runtime_error& error)
+    {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+    if (!agents.empty())
+    {
+        return run_aggregator(args, agents);
+    }
+
+    std::unique_ptr<filesystem::ProcSource> proc_source;
+    try
+    {
+        proc_source = make_proc_source(args);
+    }
+    catch (const std::runtime_error& error)
+    {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+    AsyncLogger logger{LogLevel::Info, args.logger_config};
     data::DataStore datastore{};
+    datastore.flight_recorder().set_slow_threshold(args.trace_threshold);
     server::Router router{logger};
-    server::Server server{logger, router, args.server_ip, args.server_port};
-    server::ApiController node_controller{logger, router, datastore};
-    filesystem::Monitor file_monitor{logger, datastore};
+    server::Server server{logger, router, args.server_ip, args.server_port, args.server_config};
+    filesystem::ProcDetailsCollector details_collector{logger, args.monitor_config.proc_root};
+    // The replayed processes aren't the ones under /proc, so there are no details to collect for them
+    server::ApiController node_controller{logger, router, datastore,
+                                          args.replay_path ? nullptr : &details_collector};
+    filesystem::Monitor file_monitor{logger, datastore, args.monitor_config, std::move(proc_source)};
+    filesystem::SmapsCollector smaps_collector{logger, datastore, args.monitor_config.proc_root};
+    std::unique_ptr<shm::ShmExporter> shm_exporter;
+    if (args.shm_name)
+    {
+        try
+        {
+            shm_exporter = std::make_unique<shm::ShmExporter>(logger, datastore, args.shm_name.value(), args.shm_size);
+        }
+        catch (const std::runtime_error& error)
+        {
+            std::cerr << error.what() << std::endl;
+            return 1;
+        }
+    }
+    std::unique_ptr<push::PushAgent> push_agent;
+    std::thread push_thread;
+    if (args.push_config)
+    {
+        auto push_config = args.push_config.value();
+        push_config.node = args.push_node;
+        push_agent = std::make_unique<push::PushAgent>(logger, datastore, std::move(push_config));
+        push_thread = std::thread([&]() { push_agent->start(); });
+    }
 
     std::thread filemon_thread([&]() { file_monitor.start(); });
+    // Smaps aren't captured, so a replay would only mix in samples of the live processes
+    std::thread smaps_thread;
+    if (!args.replay_path)
+        smaps_thread = std::thread([&]() { smaps_collector.start(); });
     server.start();
+
+    file_monitor.stop();
+    smaps_collector.stop();
+    filemon_thread.join();
+    if (smaps_thread.joinable())
+        smaps_thread.join();
+    if (push_agent)
+    {
+        push_agent->stop();
+        push_thread.join();
+    }
     return 0;
 }
@@ -0,0 +1,107 @@
+#include "api_server/metrics/histogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace metrics
+{
+
+namespace
+{
+
+constexpr uint64_t MAX_VALUE{(uint64_t{1} << HistogramSnapshot::MAX_BITS) - 1u};
+
+/// @brief Position of the highest set bit
+std::size_t magnitude(const uint64_t value)
+{
+    return 63u - static_cast<std::size_t>(__builtin_clzll(value));
+}
+
+/// @brief Returns the shard of the calling thread, assigning shards to threads in turn
+std::size_t thread_shard(const std::size_t shards)
+{
+    static std::atomic<std::size_t> next_shard{0u};
+    thread_local const auto shard = next_shard.fetch_add(1u, std::memory_order_relaxed);
+    return shard % shards;
+}
+
+} // namespace
+
+std::size_t HistogramSnapshot::bucket(uint64_t value)
+{
+    value = std::min(value, MAX_VALUE);
+    if (value < SUB_BUCKETS)
+        return static_cast<std::size_t>(value);
+    const auto bits = magnitude(value);
+    const auto shift = bits - 3u;
+    return (bits - 2u) * SUB_BUCKETS + static_cast<std::size_t>((value >> shift) & (SUB_BUCKETS - 1u));
+}
+
+uint64_t HistogramSnapshot::bucket_lower_bound(const std::size_t bucket)
+{
+    if (bucket < SUB_BUCKETS)
+        return bucket;
+    const auto shift = bucket / SUB_BUCKETS - 1u;
+    return (SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+}
+
+uint64_t HistogramSnapshot::bucket_upper_bound(const std::size_t bucket)
+{
+    if (bucket < SUB_BUCKETS)
+        return bucket;
+    const auto shift = bucket / SUB_BUCKETS - 1u;
+    return ((SUB_BUCKETS + bucket % SUB_BUCKETS + 1u) << shift) - 1u;
+}
+
+uint64_t HistogramSnapshot::count_at_most(const uint64_t value) const
+{
+    uint64_t total{0u};
+    for (std::size_t bucket = 0; bucket < BUCKETS && bucket_upper_bound(bucket) <= value; ++bucket)
+        total += counts[bucket];
+    return total;
+}
+
+uint64_t HistogramSnapshot::value_at_quantile(const double quantile) const
+{
+    if (count == 0u)
+        return 0u;
+    const auto rank = std::max<uint64_t>(1u, static_cast<uint64_t>(std::ceil(quantile * static_cast<double>(count))));
+    uint64_t total{0u};
+    for (std::size_t bucket = 0; bucket < BUCKETS; ++bucket)
+    {
+        total += counts[bucket];
+        if (total >= rank)
+            return bucket_upper_bound(bucket);
+    }
+    return MAX_VALUE;
+}
+
+Histogram::Histogram() : m_shards{std::make_unique<Shard[]>(SHARDS)}
+{
+}
+
+void Histogram::record(const uint64_t value)
+{
+    auto& shard = m_shards[thread_shard(SHARDS)];
+    shard.counts[HistogramSnapshot::bucket(value)].fetch_add(1u, std::memory_order_relaxed);
+    shard.sum.fetch_add(value, std::memory_order_relaxed);
+}
+
+HistogramSnapshot Histogram::snapshot() const
+{
+    HistogramSnapshot snapshot;
+    for (std::size_t i = 0; i < SHARDS; ++i)
+    {
+        const auto& shard = m_shards[i];
+        for (std::size_t bucket = 0; bucket < HistogramSnapshot::BUCKETS; ++bucket)
+        {
+            const auto count = shard.counts[bucket].load(std::memory_order_relaxed);
+            snapshot.counts[bucket] += count;
+            snapshot.count += count;
+        }
+        snapshot.sum += shard.sum.load(std::memory_order_relaxed);
+    }
+    return snapshot;
+}
+
+} // namespace metrics
@@ -0,0 +1,91 @@
+#include "api_server/metrics/prometheus.h"
+
+#include <cmath>
+#include <fmt/format.h>
+#include <iterator>
+
+namespace metrics
+{
+
+void PrometheusWriter::family(const std::string_view name, const std::string_view type, const std::string_view help)
+{
+    fmt::format_to(std::back_inserter(m_out), "# HELP {} {}\n# TYPE {} {}\n", name, help, name, type);
+}
+
+void PrometheusWriter::sample(const std::string_view name, const Labels labels, const double value)
+{
+    m_out.append(name);
+    write_labels(labels);
+    if (std::isnan(value))
+        m_out.append(" NaN\n");
+    else if (std::isinf(value))
+        m_out.append(value > 0 ? " +Inf\n" : " -Inf\n");
+    else
+        fmt::format_to(std::back_inserter(m_out), " {}\n", value);
+}
+
+void PrometheusWriter::duration_histogram(const std::string_view name, const Labels labels,
+                                          const HistogramSnapshot& snapshot)
+{
+    for (const auto le : DURATION_BUCKETS)
+    {
+        const auto count = snapshot.count_at_most(static_cast<uint64_t>(std::llround(le * 1e9)));
+        fmt::format_to(std::back_inserter(m_out), "{}_bucket", name);
+        write_labels(labels, fmt::format("{}", le));
+        fmt::format_to(std::back_inserter(m_out), " {}\n", count);
+    }
+    fmt::format_to(std::back_inserter(m_out), "{}_bucket", name);
+    write_labels(labels, "+Inf");
+    fmt::format_to(std::back_inserter(m_out), " {}\n", snapshot.count);
+
+    fmt::format_to(std::back_inserter(m_out), "{}_sum", name);
+    write_labels(labels);
+    fmt::format_to(std::back_inserter(m_out), " {}\n", static_cast<double>(snapshot.sum) / 1e9);
+    fmt::format_to(std::back_inserter(m_out), "{}_count", name);
+    write_labels(labels);
+    fmt::format_to(std::back_inserter(m_out), " {}\n", snapshot.count);
+}
+
+void PrometheusWriter::write_labels(const Labels labels, const std::string_view le)
+{
+    if (labels.size() == 0u && le.empty())
+        return;
+    m_out.push_back('{');
+    bool first = true;
+    for (const auto& [name, value] : labels)
+    {
+        if (!first)
+            m_out.push_back(',');
+        first = false;
+        m_out.append(name);
+        m_out.append("=\"");
+        write_escaped(value);
+        m_out.push_back('"');
+    }
+    if (!le.empty())
+    {
+        if (!first)
+            m_out.push_back(',');
+        m_out.append("le=\"");
+        m_out.append(le);
+        m_out.push_back('"');
+    }
+    m_out.push_back('}');
+}
+
+void PrometheusWriter::write_escaped(const std::string_view value)
+{
+    for (const auto c : value)
+    {
+        if (c == '\\')
+            m_out.append("\\\\");
+        else if (c == '"')
+            m_out.append("\\\"");
+        else if (c == '\n')
+            m_out.append("\\n");
+        else
+            m_out.push_back(c);
+    }
+}
+
+} // namespace metrics
@@ -0,0 +1,102 @@
+#include "api_server/metrics/trace.h"
+
+#include "api_server/data/json_writer.h"
+
+#include <algorithm>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace metrics
+{
+
+namespace
+{
+
+/// @brief Returns the kernel's ID of the calling thread, which trace viewers show each thread's spans under
+uint32_t current_thread_id()
+{
+    thread_local const auto thread_id = static_cast<uint32_t>(syscall(SYS_gettid));
+    return thread_id;
+}
+
+double to_microseconds(const TraceSpan::Clock::duration duration)
+{
+    return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+} // namespace
+
+FlightRecorder::FlightRecorder(const std::size_t capacity, const TraceSpan::Clock::duration slow_threshold)
+    : m_spans(std::max<std::size_t>(capacity, 1u)), m_slow_threshold{slow_threshold.count()}
+{
+}
+
+void FlightRecorder::record(const char* category, const char* name, const TraceSpan::Clock::time_point start,
+                            const TraceSpan::Clock::time_point end, const uint64_t generation, const int32_t pid,
+                            const std::string_view detail)
+{
+    const auto thread_id = current_thread_id();
+    const std::unique_lock lock{m_mutex};
+    auto& span = m_spans[m_next];
+    span.category = category;
+    span.name = name;
+    span.start = start;
+    span.duration = end - start;
+    span.thread_id = thread_id;
+    span.generation = generation;
+    span.pid = pid;
+    const auto length = std::min(detail.size(), span.detail.size() - 1);
+    std::copy_n(detail.data(), length, span.detail.data());
+    span.detail[length] = '\0';
+    m_next = (m_next + 1) % m_spans.size();
+    ++m_recorded;
+}
+
+std::vector<TraceSpan> FlightRecorder::spans() const
+{
+    const std::unique_lock lock{m_mutex};
+    if (m_recorded < m_spans.size())
+        return {m_spans.cbegin(), m_spans.cbegin() + static_cast<std::ptrdiff_t>(m_next)};
+    std::vector<TraceSpan> spans;
+    spans.reserve(m_spans.size());
+    spans.insert(spans.end(), m_spans.cbegin() + static_cast<std::ptrdiff_t>(m_next), m_spans.cend());
+    spans.insert(spans.end(), m_spans.cbegin(), m_spans.cbegin() + static_cast<std::ptrdiff_t>(m_next));
+    return spans;
+}
+
+void FlightRecorder::write_chrome_trace(std::string& out) const
+{
+    const auto spans = this->spans();
+    const auto process_id = static_cast<int32_t>(getpid());
+
+    // Complete ("X") events, with timestamps in microseconds
+    data::JsonWriter writer{out};
+    writer.begin_object();
+    writer.member("displayTimeUnit", "ms");
+    writer.key("traceEvents");
+    writer.begin_array();
+    for (const auto& span : spans)
+    {
+        writer.begin_object();
+        writer.key("args");
+        writer.begin_object();
+        if (span.detail[0] != '\0')
+            writer.member("detail", std::string_view{span.detail.data()});
+        writer.member("generation", span.generation);
+        if (span.pid >= 0)
+            writer.member("pid", span.pid);
+        writer.end_object();
+        writer.member("cat", span.category);
+        writer.member("dur", to_microseconds(span.duration));
+        writer.member("name", span.name);
+        writer.member("ph", "X");
+        writer.member("pid", process_id);
+        writer.member("tid", span.thread_id);
+        writer.member("ts", to_microseconds(span.start.time_since_epoch()));
+        writer.end_object();
+    }
+    writer.end_array();
+    writer.end_object();
+}
+
+} // namespace metrics
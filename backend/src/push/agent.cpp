@@ -0,0 +1,245 @@
+#include <api_server/push/agent.h>
+
+#include <algorithm>
+#include <boost/asio/connect.hpp>
+#include <boost/asio/ip/host_name.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/write.hpp>
+
+namespace push
+{
+
+namespace asio = boost::asio;
+
+namespace
+{
+
+PushConfig with_node(PushConfig config)
+{
+    if (config.node.empty())
+        config.node = asio::ip::host_name();
+    return config;
+}
+
+} // namespace
+
+PushAgent::PushAgent(const Logger& logger, data::DataStore& datastore, PushConfig config)
+    : m_logger{logger},
+      m_datastore{datastore},
+      m_config{with_node(std::move(config))},
+      m_resolver{m_context},
+      m_socket{m_context},
+      m_deadline{m_context},
+      m_retry_timer{m_context},
+      m_backoff{m_config.min_backoff}
+{
+    m_datastore.on_publish([this](uint64_t) { enqueue(); });
+}
+
+void PushAgent::start()
+{
+    m_logger.info("PushAgent::start - pushing to {}:{} as {}", m_config.host, m_config.port, m_config.node);
+    asio::post(m_context, [this] { resolve(); });
+    m_context.run();
+}
+
+void PushAgent::stop()
+{
+    m_context.stop();
+}
+
+PushStats PushAgent::stats() const
+{
+    PushStats stats;
+    stats.frames_sent = m_frames_sent.load(std::memory_order_relaxed);
+    stats.full_frames = m_full_frames.load(std::memory_order_relaxed);
+    stats.bytes_sent = m_bytes_sent.load(std::memory_order_relaxed);
+    stats.dropped_generations = m_dropped_generations.load(std::memory_order_relaxed);
+    stats.connections = m_connections.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void PushAgent::enqueue()
+{
+    auto snapshot = m_datastore.get_snapshot();
+    if (!snapshot->procs)
+        return;
+    {
+        const std::unique_lock lock{m_queue_mutex};
+        m_queue.push_back(std::move(snapshot));
+        while (m_queue.size() > std::max<std::size_t>(m_config.queue_capacity, 1u))
+        {
+            m_queue.pop_front();
+            m_dropped_generations.fetch_add(1u, std::memory_order_relaxed);
+        }
+    }
+    asio::post(m_context, [this] { send_next(); });
+}
+
+void PushAgent::resolve()
+{
+    if (m_endpoints)
+    {
+        connect();
+        return;
+    }
+    const auto attempt = m_attempt;
+    m_resolver.async_resolve(
+        m_config.host, m_config.port,
+        [this, attempt](const boost::system::error_code& error, tcp::resolver::results_type results) {
+            if (!current(attempt))
+                return;
+            if (error)
+            {
+                on_error(error, "resolve");
+                return;
+            }
+            m_endpoints = std::move(results);
+            connect();
+        });
+}
+
+void PushAgent::connect()
+{
+    const auto attempt = m_attempt;
+    m_deadline.expires_after(m_config.timeout);
+    m_deadline.async_wait([this, attempt](const boost::system::error_code& error) {
+        if (!error && current(attempt) && m_deadline.expiry() <= std::chrono::steady_clock::now())
+            on_error(asio::error::timed_out, "connect");
+    });
+    asio::async_connect(m_socket, m_endpoints.value(),
+                        [this, attempt](const boost::system::error_code& error, const tcp::endpoint&) {
+                            if (!current(attempt))
+                                return;
+                            m_deadline.cancel();
+                            if (error)
+                            {
+                                on_error(error, "connect");
+                                return;
+                            }
+                            on_connected();
+                        });
+}
+
+void PushAgent::on_connected()
+{
+    m_logger.info("PushAgent::on_connected - connected to {}:{}", m_config.host, m_config.port);
+    m_connections.fetch_add(1u, std::memory_order_relaxed);
+    m_connected = true;
+    m_failed = false;
+    m_backoff = m_config.min_backoff;
+    boost::system::error_code ignored;
+    m_socket.set_option(tcp::no_delay{true}, ignored);
+    watch_for_close();
+
+    // The collector only has what is sent on this connection, so it starts from the latest generation in full
+    m_encoder = FrameEncoder{};
+    m_since_full = 0u;
+    {
+        const std::unique_lock lock{m_queue_mutex};
+        if (m_queue.empty())
+        {
+            if (auto snapshot = m_datastore.get_snapshot(); snapshot->procs)
+                m_queue.push_back(std::move(snapshot));
+        }
+        while (m_queue.size() > 1u)
+        {
+            m_queue.pop_front();
+            m_dropped_generations.fetch_add(1u, std::memory_order_relaxed);
+        }
+    }
+    write(FrameEncoder::hello(m_config.node), FrameType::Hello);
+}
+
+void PushAgent::send_next()
+{
+    if (!m_connected || m_writing)
+        return;
+    std::shared_ptr<const data::Snapshot> snapshot;
+    {
+        const std::unique_lock lock{m_queue_mutex};
+        if (m_queue.empty())
+            return;
+        snapshot = std::move(m_queue.front());
+        m_queue.pop_front();
+    }
+    const auto full = !m_encoder.has_base() || m_since_full >= m_config.full_interval;
+    m_since_full = full ? 0u : m_since_full + 1u;
+    write(m_encoder.encode(snapshot, full), full ? FrameType::Full : FrameType::Delta);
+}
+
+void PushAgent::write(std::string frame, const FrameType type)
+{
+    m_writing = true;
+    m_frame = std::move(frame);
+    const auto attempt = m_attempt;
+    m_deadline.expires_after(m_config.timeout);
+    m_deadline.async_wait([this, attempt](const boost::system::error_code& error) {
+        if (!error && current(attempt) && m_deadline.expiry() <= std::chrono::steady_clock::now())
+            on_error(asio::error::timed_out, "send");
+    });
+    asio::async_write(m_socket, asio::buffer(m_frame),
+                      [this, attempt, type](const boost::system::error_code& error, const std::size_t size) {
+                          if (!current(attempt))
+                              return;
+                          m_deadline.cancel();
+                          if (error)
+                          {
+                              on_error(error, "send");
+                              return;
+                          }
+                          m_writing = false;
+                          m_bytes_sent.fetch_add(size, std::memory_order_relaxed);
+                          if (type != FrameType::Hello)
+                              m_frames_sent.fetch_add(1u, std::memory_order_relaxed);
+                          if (type == FrameType::Full)
+                              m_full_frames.fetch_add(1u, std::memory_order_relaxed);
+                          send_next();
+                      });
+}
+
+void PushAgent::watch_for_close()
+{
+    const auto attempt = m_attempt;
+    m_socket.async_read_some(asio::buffer(&m_read_byte, 1u),
+                             [this, attempt](const boost::system::error_code& error, const std::size_t) {
+                                 if (!current(attempt))
+                                     return;
+                                 // The collector isn't meant to send anything, so data is treated like a close
+                                 on_error(error ? error : asio::error::eof, "keep the connection");
+                             });
+}
+
+void PushAgent::on_error(const boost::system::error_code& error, const char* step)
+{
+    // Handlers of the failed attempt that are still pending see that it's no longer current and return
+    ++m_attempt;
+    boost::system::error_code ignored;
+    m_resolver.cancel();
+    m_deadline.cancel();
+    m_socket.shutdown(tcp::socket::shutdown_both, ignored);
+    m_socket.close(ignored);
+    m_connected = false;
+    m_writing = false;
+
+    // Only the first failure is a warning, rather than every attempt while the collector is down
+    std::uniform_int_distribution<std::chrono::milliseconds::rep> jitter{m_backoff.count() / 2, m_backoff.count()};
+    const std::chrono::milliseconds delay{jitter(m_random)};
+    if (m_failed)
+        m_logger.debug("PushAgent::on_error - failed to {}: {}, retrying in {}ms", step, error.message(),
+                       delay.count());
+    else
+        m_logger.warning("PushAgent::on_error - failed to {}: {}, retrying in {}ms", step, error.message(),
+                         delay.count());
+    m_failed = true;
+    m_backoff = std::min(m_backoff * 2, m_config.max_backoff);
+
+    const auto attempt = m_attempt;
+    m_retry_timer.expires_after(delay);
+    m_retry_timer.async_wait([this, attempt](const boost::system::error_code& error) {
+        if (!error && current(attempt))
+            resolve();
+    });
+}
+
+} // namespace push
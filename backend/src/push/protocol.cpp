@@ -0,0 +1,422 @@
+#include <api_server/push/protocol.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace push
+{
+
+namespace
+{
+
+constexpr uint8_t ROW_HAS_SMAPS{0x01u};
+
+void write_u8(std::string& buffer, const uint8_t value)
+{
+    buffer.push_back(static_cast<char>(value));
+}
+
+void write_u16(std::string& buffer, const uint16_t value)
+{
+    for (int shift = 0; shift < 16; shift += 8)
+        buffer.push_back(static_cast<char>((value >> shift) & 0xffu));
+}
+
+void write_u32(std::string& buffer, const uint32_t value)
+{
+    for (int shift = 0; shift < 32; shift += 8)
+        buffer.push_back(static_cast<char>((value >> shift) & 0xffu));
+}
+
+void write_u64(std::string& buffer, const uint64_t value)
+{
+    for (int shift = 0; shift < 64; shift += 8)
+        buffer.push_back(static_cast<char>((value >> shift) & 0xffu));
+}
+
+void write_f32(std::string& buffer, const float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    write_u32(buffer, bits);
+}
+
+void write_f64(std::string& buffer, const double value)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    write_u64(buffer, bits);
+}
+
+void write_string(std::string& buffer, const std::string_view value)
+{
+    write_u32(buffer, static_cast<uint32_t>(value.size()));
+    buffer.append(value);
+}
+
+/// @brief Reads the fields of a frame in order, throwing if it ends before them
+class FrameReader
+{
+public:
+    explicit FrameReader(const std::string_view frame) : m_frame{frame}
+    {
+    }
+
+    uint8_t u8()
+    {
+        return static_cast<uint8_t>(take(1u)[0]);
+    }
+
+    uint16_t u16()
+    {
+        return static_cast<uint16_t>(little_endian(take(2u)));
+    }
+
+    uint32_t u32()
+    {
+        return static_cast<uint32_t>(little_endian(take(4u)));
+    }
+
+    uint64_t u64()
+    {
+        return little_endian(take(8u));
+    }
+
+    float f32()
+    {
+        const auto bits = u32();
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    double f64()
+    {
+        const auto bits = u64();
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    std::string_view string()
+    {
+        return take(u32());
+    }
+
+    std::string_view bytes(const std::size_t size)
+    {
+        return take(size);
+    }
+
+    void expect_end() const
+    {
+        if (m_position != m_frame.size())
+            throw std::runtime_error{"Malformed push frame, unexpected bytes after its payload"};
+    }
+
+private:
+    std::string_view take(const std::size_t size)
+    {
+        if (size > m_frame.size() - m_position)
+            throw std::runtime_error{"Malformed push frame, truncated payload"};
+        const auto bytes = m_frame.substr(m_position, size);
+        m_position += size;
+        return bytes;
+    }
+
+    static uint64_t little_endian(const std::string_view bytes)
+    {
+        uint64_t value{0u};
+        for (std::size_t i = 0u; i < bytes.size(); ++i)
+            value |= static_cast<uint64_t>(static_cast<uint8_t>(bytes[i])) << (8u * i);
+        return value;
+    }
+
+    std::string_view m_frame;
+    std::size_t m_position{0u};
+};
+
+/// @brief Returns true if the process differs from its previous snapshot in any field that is sent
+bool row_changed(const data::ProcSnapshot& proc, const data::ProcSnapshot& base)
+{
+    if (proc.ppid != base.ppid || proc.cpu_usage_percent != base.cpu_usage_percent ||
+        proc.mem_usage_percent != base.mem_usage_percent || proc.mem_usage_kB != base.mem_usage_kB ||
+        proc.utime != base.utime || proc.stime != base.stime || proc.name != base.name ||
+        proc.command != base.command || proc.cgroup != base.cgroup || proc.smaps.has_value() != base.smaps.has_value())
+    {
+        return true;
+    }
+    return proc.smaps &&
+           (proc.smaps->sample_time != base.smaps->sample_time || proc.smaps->pss_kB != base.smaps->pss_kB ||
+            proc.smaps->uss_kB != base.smaps->uss_kB || proc.smaps->swap_kB != base.smaps->swap_kB);
+}
+
+} // namespace
+
+std::string FrameEncoder::hello(const std::string& node)
+{
+    std::string frame(FRAME_HEADER_SIZE, '\0');
+    write_u8(frame, static_cast<uint8_t>(FrameType::Hello));
+    frame.append(MAGIC);
+    write_u16(frame, VERSION);
+    write_string(frame, node);
+
+    std::string header;
+    write_u32(header, static_cast<uint32_t>(frame.size() - FRAME_HEADER_SIZE));
+    frame.replace(0u, FRAME_HEADER_SIZE, header);
+    return frame;
+}
+
+std::string FrameEncoder::encode(const std::shared_ptr<const data::Snapshot>& snapshot, bool full)
+{
+    full = full || !m_base;
+    if (full)
+        m_strings.clear();
+    m_definitions.clear();
+    m_definition_count = 0u;
+
+    // The payload after the interned strings is encoded first, as encoding it interns the strings
+    std::string body;
+    write_f64(body, snapshot->uptime ? snapshot->uptime->total_seconds : 0.0);
+    const auto mem = snapshot->mem.value_or(data::MemSnapshot{});
+    write_u32(body, mem.total_memory_kB);
+    write_u32(body, mem.free_memory_kB);
+    write_f32(body, mem.usage_percent);
+    static const std::vector<data::CpuSnapshot> no_cpus;
+    const auto& cpus = snapshot->cpus ? snapshot->cpus.value() : no_cpus;
+    write_u16(body, static_cast<uint16_t>(cpus.size()));
+    for (const auto& cpu : cpus)
+    {
+        write_u32(body, intern(cpu.id));
+        write_f32(body, cpu.usage_percent);
+    }
+
+    static const std::vector<data::ProcSnapshot> no_procs;
+    const auto& procs = snapshot->procs ? *snapshot->procs.value() : no_procs;
+    const auto& base_procs = m_base && m_base->procs ? *m_base->procs.value() : no_procs;
+    std::unordered_map<int32_t, const data::ProcSnapshot*> base_by_pid;
+    if (!full)
+    {
+        base_by_pid.reserve(base_procs.size());
+        for (const auto& proc : base_procs)
+            base_by_pid.emplace(proc.pid, &proc);
+
+        std::unordered_set<int32_t> current;
+        current.reserve(procs.size());
+        for (const auto& proc : procs)
+            current.insert(proc.pid);
+        std::string removed;
+        uint32_t removed_count{0u};
+        for (const auto& proc : base_procs)
+        {
+            if (current.count(proc.pid) == 0u)
+            {
+                write_u32(removed, static_cast<uint32_t>(proc.pid));
+                ++removed_count;
+            }
+        }
+        write_u32(body, removed_count);
+        body.append(removed);
+    }
+
+    const auto row_count_offset = body.size();
+    write_u32(body, 0u);
+    uint32_t row_count{0u};
+    for (const auto& proc : procs)
+    {
+        if (!full)
+        {
+            const auto base = base_by_pid.find(proc.pid);
+            if (base != base_by_pid.end() && !row_changed(proc, *base->second))
+                continue;
+        }
+        write_u32(body, static_cast<uint32_t>(proc.pid));
+        write_u32(body, static_cast<uint32_t>(proc.ppid));
+        write_u32(body, intern(proc.name));
+        write_u32(body, intern(proc.command));
+        write_u32(body, intern(proc.cgroup));
+        write_f32(body, proc.cpu_usage_percent);
+        write_f32(body, proc.mem_usage_percent);
+        write_u32(body, proc.mem_usage_kB);
+        write_u32(body, proc.utime);
+        write_u32(body, proc.stime);
+        write_u8(body, proc.smaps ? ROW_HAS_SMAPS : 0u);
+        if (proc.smaps)
+        {
+            write_u32(body, proc.smaps->pss_kB);
+            write_u32(body, proc.smaps->uss_kB);
+            write_u32(body, proc.smaps->swap_kB);
+            write_f64(body, proc.smaps->sample_time);
+        }
+        ++row_count;
+    }
+    std::string count;
+    write_u32(count, row_count);
+    body.replace(row_count_offset, count.size(), count);
+
+    std::string frame(FRAME_HEADER_SIZE, '\0');
+    frame.reserve(FRAME_HEADER_SIZE + sizeof(uint8_t) + 2u * sizeof(uint64_t) + sizeof(uint32_t) +
+                  m_definitions.size() + body.size());
+    write_u8(frame, static_cast<uint8_t>(full ? FrameType::Full : FrameType::Delta));
+    write_u64(frame, snapshot->generation);
+    if (!full)
+        write_u64(frame, m_base->generation);
+    write_u32(frame, m_definition_count);
+    frame.append(m_definitions);
+    frame.append(body);
+
+    std::string header;
+    write_u32(header, static_cast<uint32_t>(frame.size() - FRAME_HEADER_SIZE));
+    frame.replace(0u, FRAME_HEADER_SIZE, header);
+    m_base = snapshot;
+    return frame;
+}
+
+uint32_t FrameEncoder::intern(const std::string& value)
+{
+    const auto [iter, inserted] = m_strings.try_emplace(value, static_cast<uint32_t>(m_strings.size()));
+    if (inserted)
+    {
+        write_u32(m_definitions, iter->second);
+        write_string(m_definitions, value);
+        ++m_definition_count;
+    }
+    return iter->second;
+}
+
+std::optional<data::Snapshot> FrameDecoder::apply(const std::string_view frame)
+{
+    FrameReader reader{frame};
+    const auto type = static_cast<FrameType>(reader.u8());
+    if (type == FrameType::Hello)
+    {
+        if (reader.bytes(MAGIC.size()) != MAGIC)
+            throw std::runtime_error{"Not a push connection, bad magic"};
+        if (const auto version = reader.u16(); version != VERSION)
+            throw std::runtime_error{"Unsupported push protocol version " + std::to_string(version)};
+        m_node = std::string{reader.string()};
+        reader.expect_end();
+        m_greeted = true;
+        m_last_type = type;
+        return std::nullopt;
+    }
+    if (type != FrameType::Full && type != FrameType::Delta)
+        throw std::runtime_error{"Unknown push frame type " + std::to_string(static_cast<int>(type))};
+    if (!m_greeted)
+        throw std::runtime_error{"Push frame before the Hello frame"};
+
+    const auto generation = reader.u64();
+    if (type == FrameType::Full)
+    {
+        m_strings.clear();
+        m_procs.clear();
+    }
+    else
+    {
+        const auto base = reader.u64();
+        if (!m_generation || m_generation.value() != base)
+        {
+            throw std::runtime_error{"Delta against generation " + std::to_string(base) +
+                                     (m_generation ? ", but the last one is " + std::to_string(m_generation.value())
+                                                   : ", but no full generation was received")};
+        }
+    }
+
+    const auto definitions = reader.u32();
+    for (uint32_t i = 0u; i < definitions; ++i)
+    {
+        const auto id = reader.u32();
+        if (id != m_strings.size())
+            throw std::runtime_error{"Malformed push frame, string " + std::to_string(id) + " out of order"};
+        m_strings.emplace_back(reader.string());
+    }
+
+    data::Snapshot snapshot;
+    snapshot.generation = generation;
+    const auto uptime_seconds = reader.f64();
+    if (!std::isfinite(uptime_seconds) || uptime_seconds < 0.0 ||
+        uptime_seconds > static_cast<double>(std::numeric_limits<uint32_t>::max()))
+        throw std::runtime_error{"Malformed push frame, uptime of " + std::to_string(uptime_seconds) + " seconds"};
+    const auto whole_seconds = std::chrono::seconds(static_cast<uint32_t>(uptime_seconds));
+    const auto hours = std::chrono::duration_cast<std::chrono::hours>(whole_seconds);
+    const auto minutes = std::chrono::duration_cast<std::chrono::minutes>(whole_seconds - hours);
+    const auto seconds = std::chrono::duration_cast<std::chrono::seconds>(whole_seconds - hours - minutes);
+    auto& uptime = snapshot.uptime.emplace();
+    uptime.total_seconds = uptime_seconds;
+    uptime.hours = static_cast<uint32_t>(hours.count());
+    uptime.minutes = static_cast<uint8_t>(minutes.count());
+    uptime.seconds = static_cast<uint8_t>(seconds.count());
+
+    auto& mem = snapshot.mem.emplace();
+    mem.total_memory_kB = reader.u32();
+    mem.free_memory_kB = reader.u32();
+    mem.usage_percent = reader.f32();
+
+    auto& cpus = snapshot.cpus.emplace();
+    const auto cpu_count = reader.u16();
+    for (uint16_t i = 0u; i < cpu_count; ++i)
+    {
+        data::CpuSnapshot cpu;
+        cpu.id = string(reader.u32());
+        cpu.usage_percent = reader.f32();
+        cpus.push_back(std::move(cpu));
+    }
+
+    if (type == FrameType::Delta)
+    {
+        const auto removed = reader.u32();
+        for (uint32_t i = 0u; i < removed; ++i)
+            m_procs.erase(static_cast<int32_t>(reader.u32()));
+    }
+    const auto rows = reader.u32();
+    for (uint32_t i = 0u; i < rows; ++i)
+    {
+        data::ProcSnapshot proc;
+        proc.pid = static_cast<int32_t>(reader.u32());
+        proc.ppid = static_cast<int32_t>(reader.u32());
+        proc.name = string(reader.u32());
+        proc.command = string(reader.u32());
+        proc.cgroup = string(reader.u32());
+        proc.cpu_usage_percent = reader.f32();
+        proc.mem_usage_percent = reader.f32();
+        proc.mem_usage_kB = reader.u32();
+        proc.utime = reader.u32();
+        proc.stime = reader.u32();
+        if (reader.u8() & ROW_HAS_SMAPS)
+        {
+            auto& smaps = proc.smaps.emplace();
+            smaps.pss_kB = reader.u32();
+            smaps.uss_kB = reader.u32();
+            smaps.swap_kB = reader.u32();
+            smaps.sample_time = reader.f64();
+        }
+        m_procs[proc.pid] = std::move(proc);
+    }
+    reader.expect_end();
+
+    // Processes are snapshotted at the poll's uptime, so it isn't sent per row
+    auto procs = std::make_shared<std::vector<data::ProcSnapshot>>();
+    procs->reserve(m_procs.size());
+    for (const auto& [pid, proc] : m_procs)
+    {
+        procs->push_back(proc);
+        procs->back().snapshot_time = uptime_seconds;
+    }
+    snapshot.procs = std::move(procs);
+    m_generation = generation;
+    m_last_type = type;
+    return snapshot;
+}
+
+const std::string& FrameDecoder::string(const uint32_t id) const
+{
+    if (id >= m_strings.size())
+        throw std::runtime_error{"Malformed push frame, unknown string " + std::to_string(id)};
+    return m_strings[id];
+}
+
+} // namespace push
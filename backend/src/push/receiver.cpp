@@ -0,0 +1,165 @@
+#include <api_server/push/receiver.h>
+
+#include <algorithm>
+#include <boost/asio/read.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <memory>
+#include <stdexcept>
+
+namespace push
+{
+
+namespace asio = boost::asio;
+using tcp = asio::ip::tcp;
+
+/// @brief Reads the frames of one agent's connection
+class PushReceiver::Session : public std::enable_shared_from_this<PushReceiver::Session>
+{
+public:
+    Session(PushReceiver& receiver, tcp::socket socket)
+        : m_receiver{receiver}, m_socket{std::move(socket)}, m_deadline{m_socket.get_executor()}
+    {
+        boost::system::error_code ignored;
+        const auto endpoint = m_socket.remote_endpoint(ignored);
+        m_peer = endpoint.address().to_string() + ":" + std::to_string(endpoint.port());
+    }
+
+    void read_header()
+    {
+        arm_deadline();
+        asio::async_read(m_socket, asio::buffer(m_header),
+                         [self = shared_from_this()](const boost::system::error_code& error, const std::size_t) {
+                             if (error)
+                             {
+                                 self->close(error.message());
+                                 return;
+                             }
+                             uint32_t size{0u};
+                             for (std::size_t i = 0u; i < FRAME_HEADER_SIZE; ++i)
+                                 size |= static_cast<uint32_t>(static_cast<uint8_t>(self->m_header[i])) << (8u * i);
+                             if (size == 0u || size > MAX_FRAME_SIZE)
+                             {
+                                 self->close("frame of " + std::to_string(size) + " bytes");
+                                 return;
+                             }
+                             self->read_frame(size);
+                         });
+    }
+
+private:
+    void read_frame(const uint32_t size)
+    {
+        m_frame.clear();
+        m_frame_size = size;
+        read_frame_part();
+    }
+
+    /// @brief Reads the next part of the frame, growing the buffer only by what is about to be read
+    void read_frame_part()
+    {
+        const auto offset = m_frame.size();
+        const auto part = std::min(m_frame_size - offset, FRAME_READ_SIZE);
+        m_frame.resize(offset + part);
+        arm_deadline();
+        asio::async_read(m_socket, asio::buffer(m_frame.data() + offset, part),
+                         [self = shared_from_this()](const boost::system::error_code& error, const std::size_t) {
+                             if (error)
+                             {
+                                 self->close(error.message());
+                                 return;
+                             }
+                             if (self->m_frame.size() < self->m_frame_size)
+                                 self->read_frame_part();
+                             else
+                                 self->on_frame();
+                         });
+    }
+
+    /// @brief Closes the connection unless the read about to start completes within the read timeout
+    void arm_deadline()
+    {
+        m_deadline.expires_after(m_receiver.m_read_timeout);
+        m_deadline.async_wait([self = shared_from_this()](const boost::system::error_code& error) {
+            if (!error && self->m_deadline.expiry() <= std::chrono::steady_clock::now())
+                self->close("timed out");
+        });
+    }
+
+    void on_frame()
+    {
+        std::optional<data::Snapshot> snapshot;
+        try
+        {
+            snapshot = m_decoder.apply(m_frame);
+        }
+        catch (const std::runtime_error& exception)
+        {
+            close(exception.what());
+            return;
+        }
+        if (snapshot)
+        {
+            m_receiver.m_handler(m_decoder.node(), snapshot.value(), m_decoder.last_type(),
+                                 FRAME_HEADER_SIZE + m_frame.size());
+        }
+        else
+        {
+            m_receiver.m_logger.info("PushReceiver::Session - {} connected from {}", m_decoder.node(), m_peer);
+        }
+        read_header();
+    }
+
+    void close(const std::string& reason)
+    {
+        if (!m_socket.is_open())
+            return;
+        m_deadline.cancel();
+        m_receiver.m_logger.info("PushReceiver::Session - closing the connection from {}: {}", m_peer, reason);
+        boost::system::error_code ignored;
+        m_socket.close(ignored);
+    }
+
+    PushReceiver& m_receiver;
+    tcp::socket m_socket;
+    std::string m_peer;
+    char m_header[FRAME_HEADER_SIZE];
+    std::string m_frame;
+    std::size_t m_frame_size{0u}; // Of the frame being read, which m_frame grows to as it arrives
+    asio::steady_timer m_deadline; // Of the read in progress
+    FrameDecoder m_decoder;
+};
+
+PushReceiver::PushReceiver(const Logger& logger, const std::string& ip_address, const uint16_t port, Handler handler,
+                           const std::chrono::milliseconds read_timeout)
+    : m_logger{logger}, m_handler{std::move(handler)}, m_read_timeout{read_timeout},
+      m_acceptor{m_context, {asio::ip::make_address(ip_address), port}}
+{
+    m_port = m_acceptor.local_endpoint().port();
+}
+
+void PushReceiver::start()
+{
+    m_logger.info("PushReceiver::start - listening on port {}", m_port);
+    do_accept();
+    m_context.run();
+}
+
+void PushReceiver::stop()
+{
+    m_context.stop();
+}
+
+void PushReceiver::do_accept()
+{
+    m_acceptor.async_accept([this](const boost::system::error_code& error, tcp::socket socket) {
+        if (error)
+        {
+            m_logger.error("PushReceiver::do_accept - {}", error.message());
+            return;
+        }
+        std::make_shared<Session>(*this, std::move(socket))->read_header();
+        do_accept();
+    });
+}
+
+} // namespace push
@@ -0,0 +1,59 @@
+// Reference collector for api_servers started with --push: accepts their connections, reconstructs each generation
+// from the full and delta frames, and prints a line per frame with its size, for checking agents and measuring the
+// bandwidth of the push protocol.
+
+#include <csignal>
+#include <fmt/format.h>
+#include <iostream>
+#include <string>
+
+#include "api_server/logger.h"
+#include "api_server/push/receiver.h"
+
+namespace
+{
+
+push::PushReceiver* running_receiver{nullptr};
+
+const char* frame_type_name(const push::FrameType type)
+{
+    switch (type)
+    {
+    case push::FrameType::Hello:
+        return "hello";
+    case push::FrameType::Full:
+        return "full";
+    case push::FrameType::Delta:
+        return "delta";
+    }
+    return "unknown";
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc != 3)
+    {
+        std::cout << "Usage: push_receiver <ip address> <port>\n";
+        return 1;
+    }
+
+    StdStreamLogger logger{LogLevel::Info};
+    push::PushReceiver receiver{
+        logger, argv[1], static_cast<uint16_t>(std::stoul(argv[2])),
+        [](const std::string& node, const data::Snapshot& snapshot, const push::FrameType type,
+           const std::size_t frame_size) {
+            const auto procs = snapshot.procs ? snapshot.procs.value()->size() : 0u;
+            std::cout << fmt::format("{} generation {} {} {} bytes, {} processes, {:.1f}% memory used\n", node,
+                                     snapshot.generation, frame_type_name(type), frame_size, procs,
+                                     snapshot.mem ? snapshot.mem->usage_percent : 0.0f)
+                      << std::flush;
+        }};
+
+    running_receiver = &receiver;
+    std::signal(SIGINT, [](int) { running_receiver->stop(); });
+    std::signal(SIGTERM, [](int) { running_receiver->stop(); });
+    receiver.start();
+    return 0;
+}
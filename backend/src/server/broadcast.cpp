@@ -0,0 +1,111 @@
+#include "api_server/server/broadcast.h"
+
+#include <algorithm>
+
+namespace server
+{
+
+void Subscription::async_next(Handler handler)
+{
+    std::unique_lock lock{m_mutex};
+    if (m_closed)
+    {
+        lock.unlock();
+        handler(nullptr);
+    }
+    else if (m_message)
+    {
+        auto message = std::move(m_message);
+        m_message = nullptr;
+        lock.unlock();
+        handler(std::move(message));
+    }
+    else
+    {
+        m_handler = std::move(handler);
+    }
+}
+
+void Subscription::close()
+{
+    std::unique_lock lock{m_mutex};
+    if (m_closed)
+        return;
+    m_closed = true;
+    m_message = nullptr;
+    auto handler = std::move(m_handler);
+    m_handler = nullptr;
+    lock.unlock();
+    if (handler)
+        handler(nullptr);
+}
+
+void Subscription::deliver(Message message)
+{
+    std::unique_lock lock{m_mutex};
+    if (m_closed)
+        return;
+    if (!m_handler)
+    {
+        // Replaces any message the subscriber hasn't got round to yet
+        m_message = std::move(message);
+        return;
+    }
+    auto handler = std::move(m_handler);
+    m_handler = nullptr;
+    lock.unlock();
+    handler(std::move(message));
+}
+
+std::shared_ptr<Subscription> Broadcaster::subscribe()
+{
+    auto subscription = std::make_shared<Subscription>();
+    const std::lock_guard lock{m_mutex};
+    subscription->m_message = m_latest;
+    m_subscriptions.push_back(subscription);
+    return subscription;
+}
+
+void Broadcaster::publish(Subscription::Message message)
+{
+    {
+        const std::lock_guard lock{m_mutex};
+        m_latest = message;
+    }
+    for (const auto& subscription : live_subscriptions())
+    {
+        subscription->deliver(message);
+    }
+}
+
+void Broadcaster::close()
+{
+    for (const auto& subscription : live_subscriptions())
+    {
+        subscription->close();
+    }
+}
+
+std::size_t Broadcaster::subscriber_count()
+{
+    return live_subscriptions().size();
+}
+
+std::vector<std::shared_ptr<Subscription>> Broadcaster::live_subscriptions()
+{
+    const std::lock_guard lock{m_mutex};
+    std::vector<std::shared_ptr<Subscription>> live;
+    live.reserve(m_subscriptions.size());
+    m_subscriptions.erase(std::remove_if(m_subscriptions.begin(), m_subscriptions.end(),
+                                         [&live](const std::weak_ptr<Subscription>& weak_subscription) {
+                                             auto subscription = weak_subscription.lock();
+                                             if (!subscription)
+                                                 return true;
+                                             live.push_back(std::move(subscription));
+                                             return false;
+                                         }),
+                          m_subscriptions.end());
+    return live;
+}
+
+} // namespace server
@@ -0,0 +1,81 @@
+#include "api_server/server/cache.h"
+
+namespace server
+{
+
+ResponseCache::ResponseCache(GenerationSource generation) : m_generation{std::move(generation)}
+{
+}
+
+ResponseCache::Body ResponseCache::get(const std::string& key, const uint64_t generation, const Producer& produce)
+{
+    {
+        const std::unique_lock lock{m_mutex};
+        if (const auto iter = m_entries.find(key); iter != m_entries.end() && iter->second.generation == generation)
+        {
+            m_hits.fetch_add(1u, std::memory_order_relaxed);
+            return iter->second.body;
+        }
+    }
+
+    // Produced without holding the lock, so a slow producer does not hold up requests for other keys
+    m_misses.fetch_add(1u, std::memory_order_relaxed);
+    auto produced = produce();
+    if (!produced)
+    {
+        return nullptr;
+    }
+    auto body = std::make_shared<const std::string>(std::move(produced.value()));
+    if (m_generation() != generation)
+    {
+        return body;
+    }
+
+    const std::unique_lock lock{m_mutex};
+    if (m_entries.size() >= MAX_ENTRIES && m_entries.find(key) == m_entries.end())
+    {
+        evict(generation);
+        if (m_entries.size() >= MAX_ENTRIES)
+            return body; // Too many distinct requests within one generation to be worth caching
+    }
+    auto& entry = m_entries[key];
+    if (entry.generation <= generation)
+    {
+        entry = Entry{generation, body};
+    }
+    return body;
+}
+
+ResponseCache::Body ResponseCache::peek(const std::string& key, const uint64_t generation)
+{
+    const std::unique_lock lock{m_mutex};
+    if (const auto iter = m_entries.find(key); iter != m_entries.end() && iter->second.generation == generation)
+    {
+        m_hits.fetch_add(1u, std::memory_order_relaxed);
+        return iter->second.body;
+    }
+    return nullptr;
+}
+
+ResponseCache::Stats ResponseCache::stats() const
+{
+    Stats stats;
+    stats.hits = m_hits.load(std::memory_order_relaxed);
+    stats.misses = m_misses.load(std::memory_order_relaxed);
+    const std::unique_lock lock{m_mutex};
+    stats.entries = m_entries.size();
+    return stats;
+}
+
+void ResponseCache::evict(const uint64_t generation)
+{
+    for (auto iter = m_entries.begin(); iter != m_entries.end();)
+    {
+        if (iter->second.generation < generation)
+            iter = m_entries.erase(iter);
+        else
+            ++iter;
+    }
+}
+
+} // namespace server
@@ -0,0 +1,113 @@
+#include "api_server/server/compression.h"
+
+#include <algorithm>
+#include <array>
+#include <boost/algorithm/string.hpp>
+#include <cctype>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+#include <zlib.h>
+
+namespace server
+{
+
+namespace
+{
+
+constexpr int WINDOW_BITS{15};
+constexpr int GZIP_WINDOW_BITS{WINDOW_BITS + 16}; // Adds a gzip header and trailer instead of zlib's
+constexpr int MEMORY_LEVEL{8};
+
+} // namespace
+
+std::string_view content_coding_name(const ContentCoding coding)
+{
+    switch (coding)
+    {
+    case ContentCoding::Identity:
+        return "identity";
+    case ContentCoding::Gzip:
+        return "gzip";
+    case ContentCoding::Deflate:
+        return "deflate";
+    }
+    return "identity";
+}
+
+ContentCoding negotiate_content_coding(const std::string_view accept_encoding)
+{
+    std::vector<std::string> codings;
+    boost::split(codings, accept_encoding, boost::is_any_of(","));
+
+    // Codings that aren't listed take the weight of "*", if present
+    float wildcard_quality = 0.0f;
+    std::array<std::optional<float>, 3> qualities; // Indexed by ContentCoding
+    for (const auto& coding : codings)
+    {
+        std::vector<std::string> params;
+        boost::split(params, coding, boost::is_any_of(";"));
+        const auto name = boost::trim_copy(boost::to_lower_copy(params[0]));
+        float quality = 1.0f;
+        for (std::size_t i = 1; i < params.size(); ++i)
+        {
+            const auto param = boost::trim_copy(params[i]);
+            if (param.size() < 2 || std::tolower(param[0]) != 'q' || param[1] != '=')
+                continue;
+            try
+            {
+                quality = std::clamp(std::stof(param.substr(2)), 0.0f, 1.0f);
+            }
+            catch (const std::exception&)
+            {
+                quality = 0.0f;
+            }
+        }
+
+        if (name == "*")
+            wildcard_quality = quality;
+        else if (name == "gzip" || name == "x-gzip")
+            qualities[static_cast<std::size_t>(ContentCoding::Gzip)] = quality;
+        else if (name == "deflate")
+            qualities[static_cast<std::size_t>(ContentCoding::Deflate)] = quality;
+    }
+
+    const auto gzip = qualities[static_cast<std::size_t>(ContentCoding::Gzip)].value_or(wildcard_quality);
+    const auto deflate = qualities[static_cast<std::size_t>(ContentCoding::Deflate)].value_or(wildcard_quality);
+    if (gzip > 0.0f && gzip >= deflate)
+        return ContentCoding::Gzip;
+    if (deflate > 0.0f)
+        return ContentCoding::Deflate;
+    return ContentCoding::Identity;
+}
+
+std::string compress(const std::string_view data, const ContentCoding coding)
+{
+    if (coding == ContentCoding::Identity)
+        return std::string{data};
+
+    z_stream stream{};
+    const auto window_bits = coding == ContentCoding::Gzip ? GZIP_WINDOW_BITS : WINDOW_BITS;
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, window_bits, MEMORY_LEVEL, Z_DEFAULT_STRATEGY) !=
+        Z_OK)
+    {
+        throw std::runtime_error{"deflateInit2 failed"};
+    }
+
+    std::string compressed(deflateBound(&stream, static_cast<uLong>(data.size())), '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream.avail_in = static_cast<uInt>(data.size());
+    stream.next_out = reinterpret_cast<Bytef*>(compressed.data());
+    stream.avail_out = static_cast<uInt>(compressed.size());
+    // deflateBound guarantees the output fits, so a single call completes the stream
+    const auto result = deflate(&stream, Z_FINISH);
+    deflateEnd(&stream);
+    if (result != Z_STREAM_END)
+    {
+        throw std::runtime_error{"deflate failed: " + std::to_string(result)};
+    }
+    compressed.resize(stream.total_out);
+    return compressed;
+}
+
+} // namespace server
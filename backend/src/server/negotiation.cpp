@@ -0,0 +1,111 @@
+#include "api_server/server/negotiation.h"
+
+#include <algorithm>
+#include <boost/algorithm/string.hpp>
+#include <cctype>
+#include <string>
+
+namespace server
+{
+
+namespace
+{
+
+struct MediaRange
+{
+    std::string type;    // Lower case, e.g. "application"
+    std::string subtype; // Lower case, e.g. "json"
+    float quality{1.0f};
+};
+
+std::vector<MediaRange> parse_accept(const std::string_view accept)
+{
+    std::vector<std::string> ranges;
+    boost::split(ranges, accept, boost::is_any_of(","));
+    std::vector<MediaRange> media_ranges;
+    for (auto& range : ranges)
+    {
+        std::vector<std::string> params;
+        boost::split(params, range, boost::is_any_of(";"));
+        auto media_type = boost::trim_copy(boost::to_lower_copy(params[0]));
+        const auto slash = media_type.find('/');
+        if (slash == std::string::npos)
+            continue;
+
+        MediaRange media_range{media_type.substr(0, slash), media_type.substr(slash + 1)};
+        for (std::size_t i = 1; i < params.size(); ++i)
+        {
+            const auto param = boost::trim_copy(params[i]);
+            if (param.size() < 2 || std::tolower(param[0]) != 'q' || param[1] != '=')
+                continue;
+            try
+            {
+                media_range.quality = std::clamp(std::stof(param.substr(2)), 0.0f, 1.0f);
+            }
+            catch (const std::exception&)
+            {
+                media_range.quality = 0.0f;
+            }
+        }
+        media_ranges.push_back(std::move(media_range));
+    }
+    return media_ranges;
+}
+
+/// @brief Returns how specifically the range matches the media type: 0 if it doesn't, 1 for "*/*", 2 for "type/*"
+/// and 3 for an exact match
+int match_specificity(const MediaRange& range, const std::string_view media_type)
+{
+    const auto slash = media_type.find('/');
+    const auto type = media_type.substr(0, slash);
+    const auto subtype = media_type.substr(slash + 1);
+    if (range.type == "*")
+        return range.subtype == "*" ? 1 : 0;
+    if (range.type != type)
+        return 0;
+    if (range.subtype == "*")
+        return 2;
+    if (range.subtype == subtype)
+        return 3;
+    // Pre-registration name of MessagePack, still sent by many clients
+    if (subtype == "msgpack" && (range.subtype == "x-msgpack" || range.subtype == "vnd.msgpack"))
+        return 3;
+    return 0;
+}
+
+} // namespace
+
+std::optional<data::Encoding> negotiate_encoding(const std::string_view accept,
+                                                 const std::vector<data::Encoding>& supported)
+{
+    if (supported.empty())
+        return std::nullopt;
+    if (boost::trim_copy(std::string{accept}).empty())
+        return supported.front();
+
+    const auto media_ranges = parse_accept(accept);
+    std::optional<data::Encoding> best;
+    float best_quality = 0.0f;
+    for (const auto encoding : supported)
+    {
+        int specificity = 0;
+        float quality = 0.0f;
+        for (const auto& range : media_ranges)
+        {
+            const auto range_specificity = match_specificity(range, data::media_type(encoding));
+            if (range_specificity > specificity)
+            {
+                specificity = range_specificity;
+                quality = range.quality;
+            }
+        }
+        if (quality > best_quality)
+        {
+            best = encoding;
+            best_quality = quality;
+        }
+    }
+    return best;
+}
+
+} // namespace server
@@ -0,0 +1,176 @@
+#include "api_server/server/responder.h"
+#include "api_server/server/compression.h"
+#include "api_server/server/negotiation.h"
+#include "api_server/server/responses.h"
+
+#include <algorithm>
+#include <boost/algorithm/string.hpp>
+#include <fmt/format.h>
+#include <random>
+
+namespace server
+{
+
+namespace
+{
+
+uint64_t random_nonce()
+{
+    std::random_device device;
+    return (uint64_t{device()} << 32u) | device();
+}
+
+/// @brief Returns the values listed in the request's If-None-Match header, without weak indicators
+std::vector<std::string> if_none_match_values(const HttpRequest& request)
+{
+    std::vector<std::string> values;
+    const auto if_none_match = request[bb::http::field::if_none_match];
+    if (if_none_match.empty())
+        return values;
+    boost::split(values, if_none_match, boost::is_any_of(","));
+    for (auto& value : values)
+    {
+        boost::trim(value);
+        if (boost::starts_with(value, "W/"))
+            value.erase(0, 2);
+    }
+    return values;
+}
+
+void set_cached_response_headers(HttpResponse& response, const std::string_view media_type, const std::string& etag)
+{
+    response.set(bb::http::field::content_type, std::string{media_type});
+    response.set(bb::http::field::etag, etag);
+    response.set(bb::http::field::cache_control, "no-cache");
+    response.set(bb::http::field::vary, "Accept, Accept-Encoding");
+}
+
+} // namespace
+
+bool etag_matches(const HttpRequest& request, const std::string& etag)
+{
+    const auto values = if_none_match_values(request);
+    return std::find(values.begin(), values.end(), etag) != values.end();
+}
+
+bool etag_matches_any(const HttpRequest& request)
+{
+    const auto values = if_none_match_values(request);
+    return std::find(values.begin(), values.end(), "*") != values.end();
+}
+
+HttpResponse compressed_response(const HttpRequest& request, std::string body, const std::string_view media_type)
+{
+    const auto coding = negotiate_content_coding(std::string{request[bb::http::field::accept_encoding]});
+    const auto compressed = coding != ContentCoding::Identity && body.size() >= MIN_COMPRESSED_SIZE;
+    if (compressed)
+        body = compress(body, coding);
+
+    auto response = responses::Ok(request.version(), request.keep_alive(), std::move(body));
+    response.set(bb::http::field::content_type, std::string{media_type});
+    if (compressed)
+        response.set(bb::http::field::content_encoding, std::string{content_coding_name(coding)});
+    response.set(bb::http::field::vary, "Accept-Encoding");
+    return response;
+}
+
+HttpResponse encoded_response(const HttpRequest& request, const nlohmann::json& document)
+{
+    const auto encoding = negotiate_encoding(std::string{request[bb::http::field::accept]}, DOCUMENT_ENCODINGS);
+    if (!encoding)
+    {
+        return responses::NotAcceptable(request.version(), request.keep_alive());
+    }
+    auto response = compressed_response(request, data::encode_document(document, encoding.value()),
+                                        data::media_type(encoding.value()));
+    response.set(bb::http::field::vary, "Accept, Accept-Encoding");
+    return response;
+}
+
+CachedResponder::CachedResponder(ResponseCache::GenerationSource generation)
+    : m_generation{generation}, m_etag_prefix{fmt::format("\"{:016x}-", random_nonce())},
+      m_cache{std::move(generation)}
+{
+}
+
+HttpResponse CachedResponder::respond(const HttpRequest& request, const EncodingProducer& produce,
+                                      const std::vector<data::Encoding>& supported, const StreamProducer& stream)
+{
+    return respond(request, m_generation(), produce, supported, stream);
+}
+
+HttpResponse CachedResponder::respond(const HttpRequest& request, const uint64_t generation,
+                                      const EncodingProducer& produce, const std::vector<data::Encoding>& supported,
+                                      const StreamProducer& stream)
+{
+    const auto encoding = negotiate_encoding(std::string{request[bb::http::field::accept]}, supported);
+    if (!encoding)
+    {
+        return responses::NotAcceptable(request.version(), request.keep_alive());
+    }
+
+    const auto coding = negotiate_content_coding(std::string{request[bb::http::field::accept_encoding]});
+
+    // Each representation of a generation needs its own ETag
+    auto etag = m_etag_prefix + std::to_string(generation);
+    if (encoding != data::Encoding::Json)
+        etag += fmt::format("-{}", static_cast<int>(encoding.value()));
+    if (coding != ContentCoding::Identity)
+        etag += fmt::format("-{}", content_coding_name(coding));
+    etag += '"';
+    if (etag_matches(request, etag))
+    {
+        m_not_modified.fetch_add(1u, std::memory_order_relaxed);
+        return responses::NotModified(request.version(), request.keep_alive(), etag);
+    }
+
+    const auto media_type = data::media_type(encoding.value());
+    auto target = std::string{request.target()};
+    const auto key = fmt::format("{} {}", media_type, target.substr(0, target.find('#')));
+    // "*" matches only if there is a body to serve, which has to be produced to find out
+    const auto match_any = etag_matches_any(request);
+    ResponseCache::Body body;
+    // A body of the current generation is cached and shared by every request for it, so it is only worth streaming
+    // if it wouldn't be, i.e. if a poll was published since the generation's data was taken
+    if (stream && coding == ContentCoding::Identity && !match_any && generation != m_generation())
+    {
+        body = m_cache.peek(key, generation);
+        if (!body)
+        {
+            if (auto chunks = stream(encoding.value()))
+            {
+                auto response = responses::Ok(request.version(), request.keep_alive(), std::string{});
+                response.chunk_source(std::move(chunks.value()));
+                set_cached_response_headers(response, media_type, etag);
+                return response;
+            }
+        }
+    }
+    if (!body)
+    {
+        body = m_cache.get(key, generation, [&produce, &encoding] { return produce(encoding.value()); });
+    }
+    if (!body)
+    {
+        return responses::NotFound(request.version(), request.keep_alive(), std::string{request.target()});
+    }
+    if (match_any)
+    {
+        m_not_modified.fetch_add(1u, std::memory_order_relaxed);
+        return responses::NotModified(request.version(), request.keep_alive(), etag);
+    }
+    const auto compressed = coding != ContentCoding::Identity && body->size() >= MIN_COMPRESSED_SIZE;
+    if (compressed)
+    {
+        const auto compressed_key = fmt::format("{} {}", key, content_coding_name(coding));
+        body = m_cache.get(compressed_key, generation, [&body, coding] { return compress(*body, coding); });
+    }
+
+    auto response = responses::Ok(request.version(), request.keep_alive(), std::move(body));
+    if (compressed)
+        response.set(bb::http::field::content_encoding, std::string{content_coding_name(coding)});
+    set_cached_response_headers(response, media_type, etag);
+    return response;
+}
+
+} // namespace server
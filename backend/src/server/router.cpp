@@ -4,131 +4,295 @@
 
 #include <boost/algorithm/string.hpp>
 #include <cstdint>
+#include <stdexcept>
 
 namespace server
 {
 
+namespace
+{
+
+/// @brief ASCII case-insensitive comparison of a request's path segment to a route's lower case segment
+bool equals_lower(const std::string_view segment, const std::string& lower_segment)
+{
+    if (segment.size() != lower_segment.size())
+        return false;
+    for (std::size_t i = 0; i < segment.size(); ++i)
+    {
+        auto c = segment[i];
+        if (c >= 'A' && c <= 'Z')
+            c = static_cast<char>(c - 'A' + 'a');
+        if (c != lower_segment[i])
+            return false;
+    }
+    return true;
+}
+
+/// @brief Splits off the part of the view up to the first delimiter, leaving the rest after it
+std::string_view split_first(std::string_view& view, const char delimiter)
+{
+    const auto position = view.find(delimiter);
+    const auto first = view.substr(0, position);
+    view = position == std::string_view::npos ? std::string_view{} : view.substr(position + 1);
+    return first;
+}
+
+/// @brief Returns the value of a hex digit, or -1 if the character isn't one
+int hex_value(const char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+/// @brief Decodes "%XX" escapes in part of the request target, and '+' as space if `plus_is_space` (as in queries).
+/// Text without escapes is returned as is, otherwise it is decoded into the request's storage.
+/// @return False if an escape is malformed
+bool percent_decode(HttpRequest& request, const std::string_view encoded, const bool plus_is_space,
+                    std::string_view& decoded)
+{
+    const auto escapes = std::count(encoded.begin(), encoded.end(), '%');
+    if (escapes == 0 && (!plus_is_space || encoded.find('+') == std::string_view::npos))
+    {
+        decoded = encoded;
+        return true;
+    }
+
+    if (encoded.size() < 3 * static_cast<std::size_t>(escapes))
+        return false;
+    const auto storage = request.decoded_storage(encoded.size() - 2 * static_cast<std::size_t>(escapes));
+    std::size_t length = 0u;
+    for (std::size_t i = 0; i < encoded.size(); ++i)
+    {
+        if (encoded[i] == '%')
+        {
+            const auto high = i + 2 < encoded.size() ? hex_value(encoded[i + 1]) : -1;
+            const auto low = high >= 0 ? hex_value(encoded[i + 2]) : -1;
+            if (low < 0)
+                return false;
+            storage[length++] = static_cast<char>(high * 16 + low);
+            i += 2;
+        }
+        else
+        {
+            storage[length++] = plus_is_space && encoded[i] == '+' ? ' ' : encoded[i];
+        }
+    }
+    decoded = std::string_view{storage, length};
+    return true;
+}
+
+} // namespace
+
 Router::Router(const Logger& logger) : m_logger{logger}
 {
 }
 
 void Router::add_route(const bb::http::verb verb, const std::string& resource, const Endpoint endpoint)
 {
-    const auto key = route_key(verb, resource);
-    m_logger.debug("Router::add_route " + key);
-    m_routes[key] = endpoint;
+    const auto verb_name = bb::http::to_string(verb);
+    m_logger.debug("Router::add_route {}:{}", std::string_view{verb_name.data(), verb_name.size()}, resource);
+    Route route{verb, endpoint, {}, resource, std::make_unique<metrics::Histogram>()};
+    auto node = &m_root;
+    for (const auto& segment : split_path(resource))
+    {
+        if (is_path_parameter(segment))
+        {
+            route.parameter_names.push_back(segment.substr(1, segment.size() - 2));
+            if (!node->parameter_child)
+                node->parameter_child = std::make_unique<Node>();
+            node = node->parameter_child.get();
+            continue;
+        }
+        const auto lower_segment = boost::algorithm::to_lower_copy(segment);
+        auto iter = std::find_if(node->children.begin(), node->children.end(),
+                                 [&lower_segment](const auto& child) { return child.first == lower_segment; });
+        if (iter == node->children.end())
+            iter = node->children.emplace(node->children.end(), lower_segment, std::make_unique<Node>());
+        node = iter->second.get();
+    }
+    if (route.parameter_names.size() > MAX_PATH_PARAMETERS)
+        throw std::invalid_argument{"Too many path parameters in route " + resource};
+
+    // A later route for the same method and resource replaces the earlier one
+    auto iter = std::find_if(node->routes.begin(), node->routes.end(),
+                             [verb](const Route& existing) { return existing.verb == verb; });
+    if (iter != node->routes.end())
+        *iter = std::move(route);
+    else
+        node->routes.push_back(std::move(route));
 }
 
 HttpResponse Router::process_http_request(const BoostHttpRequest& boost_request)
 {
-    const auto request_id = std::to_string(++m_request_count);
-    m_logger.debug("Router::process_http_request " + request_id);
-    validate_request(boost_request, request_id);
+    HttpRequest request{boost_request};
+    if (!validate_request(boost_request) || !parse_request_target(request))
+    {
+        auto response = responses::BadRequest(request.version(), request.keep_alive());
+        response.latency_histogram(&m_unmatched_latency);
+        return response;
+    }
 
-    HttpRequest request(boost_request);
-    parse_request_target(request);
-    auto callable_endpoint = resolve_route(request.method(), request);
+    ParameterValues values;
+    const auto node = match(m_root, request.path_segments(), 0u, values);
+    if (!node)
+    {
+        auto response =
+            responses::NotFound(request.version(), request.keep_alive(), std::string{request.resource_path()});
+        response.latency_histogram(&m_unmatched_latency);
+        return response;
+    }
 
-    if (!callable_endpoint)
+    const auto route = std::find_if(node->routes.cbegin(), node->routes.cend(),
+                                    [&request](const Route& route) { return route.verb == request.method(); });
+    if (route == node->routes.cend())
     {
-        // Route not found, return bad request
-        return responses::BadRequest(request.version(), request.keep_alive());
+        std::string allow;
+        for (const auto& allowed : node->routes)
+        {
+            if (!allow.empty())
+                allow += ", ";
+            allow += std::string{bb::http::to_string(allowed.verb)};
+        }
+        auto response = responses::MethodNotAllowed(request.version(), request.keep_alive(), allow);
+        response.latency_histogram(&m_unmatched_latency);
+        return response;
     }
-    return callable_endpoint.value()(request);
+
+    if (!route->parameter_names.empty())
+    {
+        PathParameters parameters;
+        for (std::size_t i = 0; i < route->parameter_names.size(); ++i)
+            parameters.set(route->parameter_names[i], values.values[i]);
+        request.path_parameters(parameters);
+    }
+    auto response = route->endpoint(request);
+    response.latency_histogram(route->latency.get());
+    return response;
+}
+
+std::vector<Router::RouteLatency> Router::route_latencies() const
+{
+    std::vector<RouteLatency> latencies;
+    collect_latencies(m_root, latencies);
+    return latencies;
+}
+
+void Router::collect_latencies(const Node& node, std::vector<RouteLatency>& latencies)
+{
+    for (const auto& route : node.routes)
+        latencies.push_back(RouteLatency{route.verb, route.resource, *route.latency});
+    for (const auto& [segment, child] : node.children)
+        collect_latencies(*child, latencies);
+    if (node.parameter_child)
+        collect_latencies(*node.parameter_child, latencies);
 }
 
-bool Router::validate_request(const BoostHttpRequest& boost_request, const std::string& request_id) const
+bool Router::validate_request(const BoostHttpRequest& boost_request) const
 {
-    const auto log_prefix = "Router::validate_request [" + request_id + "] ";
     if (boost_request.target().empty())
     {
         // We expect target to always start with a "/" at least
-        m_logger.info(log_prefix + "target is empty");
+        m_logger.info("Router::validate_request target is empty");
         return false;
     }
     return true;
 }
 
-std::string Router::route_key(const bb::http::verb verb, const std::string& resource) const
+const Router::Node* Router::match(const Node& node, const PathSegments& segments, const std::size_t index,
+                                  ParameterValues& parameters)
 {
-    auto resource_path = boost::algorithm::to_lower_copy(resource);
-    if (resource_path[resource_path.size() - 1] != '/')
-    {
-        resource_path += "/";
-    }
-    return std::string{bb::http::to_string(verb)} + ":" + boost::algorithm::to_lower_copy(resource_path);
-}
+    if (index == segments.size())
+        return node.routes.empty() ? nullptr : &node;
 
-std::optional<Endpoint> Router::lookup_endpoint(const bb::http::verb verb, const std::string& resource) const
-{
-    const auto key = route_key(verb, resource);
-    const auto iter = m_routes.find(key);
-    if (iter != m_routes.end())
+    const auto segment = segments[index];
+    for (const auto& [child_segment, child] : node.children)
     {
-        m_logger.debug("Router::lookup_endpoint - Matched " + key + " -> " + iter->first);
-        return iter->second;
+        if (!equals_lower(segment, child_segment))
+            continue;
+        if (const auto matched = match(*child, segments, index + 1, parameters))
+            return matched;
+        break;
     }
-    else
+
+    if (node.parameter_child && parameters.count < MAX_PATH_PARAMETERS)
     {
-        m_logger.debug("Router::lookup_endpoint - " + key + " not found");
-        return std::nullopt;
+        parameters.values[parameters.count++] = segment;
+        if (const auto matched = match(*node.parameter_child, segments, index + 1, parameters))
+            return matched;
+        --parameters.count;
     }
+    return nullptr;
 }
 
-void Router::parse_request_target(HttpRequest& request) const
+bool Router::parse_request_target(HttpRequest& request) const
 {
-    auto url = std::string{request.target()};
-    // TODO - Decode HTML escape characters
+    auto url = request.target();
 
-    std::vector<std::string> parts{};
-    boost::split(parts, url, boost::is_any_of("#"));
-    if (parts.size() == 2)
+    if (const auto position = url.find('#'); position != std::string_view::npos)
     {
-        url = parts[0];
-        request.fragment(parts[1]);
+        request.fragment(url.substr(position + 1));
+        url = url.substr(0, position);
     }
 
-    parts.clear();
-    boost::split(parts, url, boost::is_any_of("?"));
-    if (parts.size() == 2)
+    if (const auto position = url.find('?'); position != std::string_view::npos)
     {
-        url = parts[0];
-        request.query_parameters(parse_query_parameters(parts[1]));
+        if (!parse_query_parameters(request, url.substr(position + 1)))
+            return false;
+        url = url.substr(0, position);
     }
 
     request.resource_path(url);
-    parts.clear();
-    boost::split(parts, url, boost::is_any_of("/"));
-    request.path_segments(parts);
+    PathSegments segments;
+    while (!url.empty())
+    {
+        const auto segment = split_first(url, '/');
+        if (segment.empty())
+            continue;
+        std::string_view decoded;
+        if (!percent_decode(request, segment, false, decoded))
+            return false;
+        segments.push_back(decoded);
+    }
+    request.path_segments(segments);
+    return true;
 }
 
-QueryParameters Router::parse_query_parameters(const std::string& encoded_parameters) const
+bool Router::parse_query_parameters(HttpRequest& request, std::string_view encoded_parameters) const
 {
     QueryParameters parameters;
-    std::vector<std::string> key_value_pairs;
-    boost::split(key_value_pairs, encoded_parameters, boost::is_any_of("&"));
-    std::vector<std::string> parts;
-    for (const auto& key_value_pair : key_value_pairs)
+    while (!encoded_parameters.empty())
     {
-        parts.clear();
-        boost::split(parts, key_value_pair, boost::is_any_of("="));
-        if (parts.size() == 2)
-        {
-            parameters[parts[0]] = parts[1];
-        }
+        const auto key_value_pair = split_first(encoded_parameters, '&');
+        const auto position = key_value_pair.find('=');
+        if (position == std::string_view::npos)
+            continue;
+        std::string_view key;
+        std::string_view value;
+        if (!percent_decode(request, key_value_pair.substr(0, position), true, key) ||
+            !percent_decode(request, key_value_pair.substr(position + 1), true, value))
+            return false;
+        parameters.set(key, value);
     }
-    return parameters;
+    request.query_parameters(parameters);
+    return true;
 }
 
-std::optional<Endpoint> Router::resolve_route(const bb::http::verb verb, const HttpRequest& request) const
+bool Router::is_path_parameter(const std::string& segment)
 {
-    // Attempt to find an endpoint matching a static resource path first
-    if (auto endpoint = lookup_endpoint(verb, request.resource_path()); endpoint)
-    {
-        return endpoint;
-    }
-    // TODO - more complex pattern matching
-    return std::nullopt;
+    return segment.size() > 2 && segment.front() == '{' && segment.back() == '}';
+}
+
+std::vector<std::string> Router::split_path(const std::string& resource)
+{
+    std::vector<std::string> segments;
+    boost::split(segments, resource, boost::is_any_of("/"));
+    segments.erase(std::remove(segments.begin(), segments.end(), ""), segments.end());
+    return segments;
 }
 
-} // namespace server
\ No newline at end of file
+} // namespace server
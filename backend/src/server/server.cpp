@@ -2,90 +2,391 @@
 #include "api_server/server/responses.h"
 #include "api_server/time.h"
 
+#include <algorithm>
+#include <boost/asio/dispatch.hpp>
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/strand.hpp>
 #include <boost/beast.hpp>
 #include <chrono>
+#include <csignal>
 #include <fmt/format.h>
+#include <optional>
 #include <string>
 #include <thread>
+#include <vector>
 
 namespace server
 {
 
 using boost::asio::ip::tcp;
 
-/// @brief Listens for incoming HTTP requests, forwards to the request router and returns the response
-Server::Server(const Logger& logger, Router& router, const std::string& ip_address, const std::uint16_t port)
-    : m_logger{logger}, m_router{router}, m_address{boost::asio::ip::make_address(ip_address)}, m_port{port},
-      m_acceptor{m_context, {m_address, port}}
+/// @brief One connection, reading requests and writing responses in turn until either side closes it.
+/// The session's handlers run on its own strand, so only one of them runs at a time.
+class Server::Session : public std::enable_shared_from_this<Session>
 {
-}
+    using Serializer = bb::http::response_serializer<bb::http::string_body>;
 
-/// @brief Waits (blocking) for incoming TCP connections and spins up a new
-/// thread to handle each session
-void Server::start()
-{
-    m_logger.info(fmt::format("Server listening on {}:{}", m_address.to_string(), std::to_string(m_port)));
-    using boost::asio::ip::tcp;
-    // TODO: Add shutdown handling
-    while (true)
-    {
-        tcp::socket socket{m_context};
-        m_acceptor.accept(socket);
-        ++m_session_id;
-        std::thread{[this, id = m_session_id](tcp::socket&& socket) { process_tcp_session(socket, id); },
-                    std::move(socket)}
-            .detach();
+public:
+    Session(Server& server, tcp::socket&& socket, const uint64_t id)
+        : m_server{server}, m_logger{server.m_logger}, m_stream{std::move(socket)}, m_id{id}
+    {
     }
-}
 
-void Server::process_tcp_session(boost::asio::ip::tcp::socket& socket, const uint8_t session_id)
-{
-    m_logger.debug(fmt::format("Session {} started", session_id));
-    bb::error_code error;
-    bb::flat_buffer buffer;
+    void start()
+    {
+        m_logger.debug("Session {} started", m_id);
+        // Headers and bodies are written separately, don't let Nagle's algorithm hold the body back
+        bb::error_code error;
+        m_stream.socket().set_option(tcp::no_delay{true}, error);
+        do_read();
+    }
 
-    bool keep_alive = true;
-    while (keep_alive)
+    /// @brief Closes the session if it is waiting for a request, otherwise once the current response is written.
+    /// Event streams are ended.
+    void shutdown()
     {
-        HttpRequest request;
-        bb::http::read(socket, buffer, request, error);
+        boost::asio::dispatch(m_stream.get_executor(), [self = shared_from_this()]() {
+            self->m_closing = true;
+            if (self->m_response && self->m_response->event_stream())
+                self->m_response->event_stream()->close();
+            // The socket may have been closed already by a timeout
+            bb::error_code error;
+            if (!self->m_busy)
+                self->m_stream.socket().cancel(error);
+        });
+    }
+
+private:
+    void do_read()
+    {
+        m_request = {};
+        m_stream.expires_after(m_server.m_config.idle_timeout);
+        bb::http::async_read(m_stream, m_buffer, m_request,
+                             bb::bind_front_handler(&Session::on_read, shared_from_this()));
+    }
 
+    void on_read(const bb::error_code& error, std::size_t)
+    {
         if (error == bb::http::error::end_of_stream)
         {
-            m_logger.debug(fmt::format("Session {} received end of stream", session_id));
-            break;
+            m_logger.debug("Session {} received end of stream", m_id);
+            return close();
+        }
+        else if (error == bb::error::timeout)
+        {
+            m_logger.debug("Session {} timed out", m_id);
+            return close();
+        }
+        else if (error == boost::asio::error::operation_aborted)
+        {
+            return close();
         }
         else if (error)
         {
-            m_logger.error(error.message());
-            break;
+            m_logger.error("{}", error.message());
+            return close();
         }
 
-        const auto receive_tp = std::chrono::system_clock::now();
-        m_logger.info(fmt::format("{} {} {} {}", timestamp(receive_tp), session_id,
-                                  std::string{request.method_string()}, std::string{request.target()}));
-        auto response = m_router.process_http_request(request);
-
+        m_busy = true;
+        m_receive_tp = std::chrono::steady_clock::now();
+        const auto method = m_request.method_string();
+        const auto target = m_request.target();
+        m_logger.info("{} {} {} {}", cached_timestamp(std::chrono::system_clock::now()), m_id,
+                      std::string_view{method.data(), method.size()}, std::string_view{target.data(), target.size()});
+        try
+        {
+            m_response.emplace(m_server.m_router.process_http_request(m_request));
+        }
+        catch (const std::exception& e)
+        {
+            // An endpoint that throws fails only its request, rather than escaping the io_context and the server
+            m_logger.error("Session {} failed to process {}: {}", m_id,
+                           std::string_view{target.data(), target.size()}, e.what());
+            m_response.emplace(responses::ServerError(m_request.version(), m_request.keep_alive()));
+        }
+        auto& response = *m_response;
         response.set(bb::http::field::access_control_allow_origin, "*");
+        if (m_closing)
+            response.keep_alive(false);
         response.prepare_payload();
-        bb::http::write(socket, response, error);
 
+        if (response.chunk_source())
+        {
+            if (response.version() < 11)
+                response.collect_chunks();
+            else
+                return write_chunked_header();
+        }
+        if (response.event_stream())
+            return write_event_stream_header();
+        if (response.shared_body())
+            return write_shared_body_header();
+        m_stream.expires_after(m_server.m_config.idle_timeout);
+        bb::http::async_write(m_stream, response, bb::bind_front_handler(&Session::on_write, shared_from_this()));
+    }
+
+    /// @brief Sends the shared body straight from its buffer rather than copying it into the response
+    void write_shared_body_header()
+    {
+        m_response->content_length(m_response->shared_body()->size());
+        m_serializer.emplace(*m_response);
+        m_stream.expires_after(m_server.m_config.idle_timeout);
+        bb::http::async_write_header(m_stream, *m_serializer,
+                                     [self = shared_from_this()](const bb::error_code& error, std::size_t) {
+                                         if (error)
+                                             return self->on_write(error, 0u);
+                                         boost::asio::async_write(
+                                             self->m_stream, boost::asio::buffer(*self->m_response->shared_body()),
+                                             bb::bind_front_handler(&Session::on_write, self));
+                                     });
+    }
+
+    void write_chunked_header()
+    {
+        // prepare_payload() sizes the response by its (empty) body, so restore the chunked framing
+        m_response->erase(bb::http::field::content_length);
+        m_response->chunked(true);
+        m_serializer.emplace(*m_response);
+        m_stream.expires_after(m_server.m_config.idle_timeout);
+        bb::http::async_write_header(m_stream, *m_serializer,
+                                     bb::bind_front_handler(&Session::write_next_chunk, shared_from_this()));
+    }
+
+    /// @brief Writes the streamed body a chunk at a time, so only one chunk is held however large the body
+    void write_next_chunk(const bb::error_code& error, std::size_t)
+    {
         if (error)
+            return on_write(error, 0u);
+        if (!m_more_chunks)
         {
-            m_logger.error(error.message());
-            break;
+            m_stream.expires_after(m_server.m_config.idle_timeout);
+            return boost::asio::async_write(m_stream, bb::http::make_chunk_last(),
+                                            bb::bind_front_handler(&Session::on_write, shared_from_this()));
         }
-        const auto response_tp = std::chrono::system_clock::now();
-        const auto response_time = std::chrono::duration_cast<std::chrono::milliseconds>(response_tp - receive_tp);
-        m_logger.info(fmt::format("{} {} Returned {} in {} ms", timestamp(response_tp), session_id,
-                                  std::to_string(static_cast<unsigned>(response.result())),
-                                  std::to_string(response_time.count())));
+        m_chunk.clear();
+        m_more_chunks = m_response->chunk_source()(m_chunk);
+        if (m_chunk.empty())
+            return write_next_chunk({}, 0u);
+        m_stream.expires_after(m_server.m_config.idle_timeout);
+        boost::asio::async_write(m_stream, bb::http::make_chunk(boost::asio::buffer(m_chunk)),
+                                 bb::bind_front_handler(&Session::write_next_chunk, shared_from_this()));
+    }
 
-        keep_alive = response.keep_alive();
+    void write_event_stream_header()
+    {
+        m_response->erase(bb::http::field::content_length);
+        if (m_response->version() < 11)
+        {
+            // Without chunked transfer encoding, events are sent as they are and the end of the connection ends them
+            m_response->chunked(false);
+            m_response->keep_alive(false);
+        }
+        else
+        {
+            m_response->chunked(true);
+        }
+        m_serializer.emplace(*m_response);
+        m_stream.expires_after(m_server.m_config.idle_timeout);
+        bb::http::async_write_header(m_stream, *m_serializer,
+                                     bb::bind_front_handler(&Session::wait_for_event, shared_from_this()));
+    }
+
+    /// @brief Waits for the next message of the event stream. Nothing is written in the meantime, and messages
+    /// published while the previous one was being written are skipped in favour of the latest.
+    void wait_for_event(const bb::error_code& error, std::size_t)
+    {
+        if (error)
+            return on_write(error, 0u);
+        m_event = nullptr;
+        m_response->event_stream()->async_next([self = shared_from_this()](Subscription::Message message) {
+            boost::asio::post(self->m_stream.get_executor(),
+                              [self, message = std::move(message)]() { self->write_event(message); });
+        });
+    }
+
+    void write_event(const Subscription::Message& message)
+    {
+        m_stream.expires_after(m_server.m_config.idle_timeout);
+        if (!message)
+        {
+            // The subscription was closed
+            if (!m_response->chunked())
+                return on_write({}, 0u);
+            return boost::asio::async_write(m_stream, bb::http::make_chunk_last(),
+                                            bb::bind_front_handler(&Session::on_write, shared_from_this()));
+        }
+        m_event = message;
+        if (m_response->chunked())
+        {
+            boost::asio::async_write(m_stream, bb::http::make_chunk(boost::asio::buffer(*m_event)),
+                                     bb::bind_front_handler(&Session::wait_for_event, shared_from_this()));
+        }
+        else
+        {
+            boost::asio::async_write(m_stream, boost::asio::buffer(*m_event),
+                                     bb::bind_front_handler(&Session::wait_for_event, shared_from_this()));
+        }
     }
-    socket.shutdown(boost::asio::ip::tcp::socket::shutdown_send, error);
-    m_logger.debug(fmt::format("Session {} closed", session_id));
+
+    void on_write(const bb::error_code& error, std::size_t)
+    {
+        if (error)
+        {
+            m_logger.error("{}", error.message());
+            return close();
+        }
+        // Latency is measured on the steady clock, so that wall clock adjustments can't skew it
+        const auto response_tp = std::chrono::steady_clock::now();
+        if (const auto latency_histogram = m_response->latency_histogram())
+            latency_histogram->record(response_tp - m_receive_tp);
+        const auto response_time = std::chrono::duration_cast<std::chrono::milliseconds>(response_tp - m_receive_tp);
+        m_logger.info("{} {} Returned {} in {} ms", cached_timestamp(std::chrono::system_clock::now()), m_id,
+                      static_cast<unsigned>(m_response->result()), response_time.count());
+
+        const auto keep_alive = m_response->keep_alive();
+        m_serializer.reset();
+        m_response.reset();
+        m_chunk.clear();
+        m_more_chunks = true;
+        m_event = nullptr;
+        m_busy = false;
+        if (!keep_alive || m_closing)
+            return close();
+        do_read();
+    }
+
+    void close()
+    {
+        bb::error_code error;
+        m_stream.socket().shutdown(tcp::socket::shutdown_send, error);
+        m_logger.debug("Session {} closed", m_id);
+        m_server.remove_session(m_id);
+    }
+
+    Server& m_server;
+    const Logger& m_logger;
+    bb::tcp_stream m_stream;
+    const uint64_t m_id;
+    bb::flat_buffer m_buffer;
+    BoostHttpRequest m_request;
+    std::optional<HttpResponse> m_response;
+    std::optional<Serializer> m_serializer;
+    std::string m_chunk;
+    bool m_more_chunks{true};
+    Subscription::Message m_event; // Being written
+    bool m_busy{false};    // Between reading a request and finishing its response
+    bool m_closing{false}; // The server is shutting down
+    std::chrono::steady_clock::time_point m_receive_tp;
+};
+
+/// @brief Listens for incoming HTTP requests, forwards to the request router and returns the response
+Server::Server(const Logger& logger, Router& router, const std::string& ip_address, const std::uint16_t port,
+               const ServerConfig& config)
+    : m_logger{logger}, m_router{router}, m_config{config},
+      m_thread_count{config.threads > 0u ? config.threads : std::max(1u, std::thread::hardware_concurrency())},
+      m_context{static_cast<int>(m_thread_count)}, m_address{boost::asio::ip::make_address(ip_address)},
+      m_port{port}, m_acceptor{boost::asio::make_strand(m_context), {m_address, port}},
+      m_signals{m_acceptor.get_executor(), SIGINT, SIGTERM}, m_shutdown_timer{m_acceptor.get_executor()}
+{
+    m_port = m_acceptor.local_endpoint().port();
+}
+
+/// @brief Serves connections until stop() is called or SIGTERM/SIGINT is received (blocking)
+void Server::start()
+{
+    m_logger.info("Server listening on {}:{} with {} threads", m_address.to_string(), m_port, m_thread_count);
+    m_signals.async_wait([this](const bb::error_code& error, const int signal) {
+        if (error)
+            return;
+        m_logger.info("Received signal {}, shutting down", signal);
+        begin_shutdown();
+    });
+    do_accept();
+
+    std::vector<std::thread> threads;
+    threads.reserve(m_thread_count - 1u);
+    for (std::size_t i = 1u; i < m_thread_count; ++i)
+    {
+        threads.emplace_back([this]() { m_context.run(); });
+    }
+    m_context.run();
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    m_logger.info("Server stopped");
+}
+
+void Server::stop()
+{
+    boost::asio::post(m_acceptor.get_executor(), [this]() { begin_shutdown(); });
+}
+
+void Server::do_accept()
+{
+    m_acceptor.async_accept(boost::asio::make_strand(m_context), bb::bind_front_handler(&Server::on_accept, this));
+}
+
+void Server::on_accept(const bb::error_code& error, tcp::socket socket)
+{
+    if (error == boost::asio::error::operation_aborted || m_stopping)
+        return;
+    if (error)
+    {
+        m_logger.error("{}", error.message());
+    }
+    else
+    {
+        const auto session_id = ++m_session_id;
+        auto session = std::make_shared<Session>(*this, std::move(socket), session_id);
+        {
+            std::lock_guard lock{m_sessions_mutex};
+            m_sessions.emplace(session_id, session);
+        }
+        session->start();
+    }
+    do_accept();
+}
+
+void Server::begin_shutdown()
+{
+    if (m_stopping.exchange(true))
+        return;
+    bb::error_code error;
+    m_acceptor.close(error);
+    m_signals.cancel(error);
+
+    std::vector<std::shared_ptr<Session>> sessions;
+    {
+        std::lock_guard lock{m_sessions_mutex};
+        for (const auto& [id, weak_session] : m_sessions)
+        {
+            if (auto session = weak_session.lock())
+                sessions.push_back(std::move(session));
+        }
+        if (sessions.empty())
+            return;
+    }
+    m_logger.info("Waiting for {} sessions to close", sessions.size());
+    for (const auto& session : sessions)
+    {
+        session->shutdown();
+    }
+    // Responses still being written when the grace period ends are cut off
+    m_shutdown_timer.expires_after(m_config.shutdown_grace_period);
+    m_shutdown_timer.async_wait([this](const bb::error_code& error) {
+        if (!error)
+            m_context.stop();
+    });
+}
+
+void Server::remove_session(const uint64_t session_id)
+{
+    std::lock_guard lock{m_sessions_mutex};
+    m_sessions.erase(session_id);
+    if (m_stopping && m_sessions.empty())
+        boost::asio::post(m_acceptor.get_executor(), [this]() { m_shutdown_timer.cancel(); });
 }
 
-} // namespace server
\ No newline at end of file
+} // namespace server
@@ -0,0 +1,180 @@
+#include <api_server/shm/exporter.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <stdexcept>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "api_server/data/proctable.h"
+
+namespace shm
+{
+
+namespace
+{
+
+/// @brief Removes the segment of that name if the exporter that created it is gone, which is when no one holds the
+/// lock on it. Returns false if it is still in use.
+bool remove_if_abandoned(const std::string& name)
+{
+    const auto fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        return true;
+    const auto abandoned = flock(fd, LOCK_EX | LOCK_NB) == 0;
+    // One already unlinked was replaced by another exporter meanwhile, whose segment mustn't be removed
+    struct stat status;
+    if (abandoned && fstat(fd, &status) == 0 && status.st_nlink > 0)
+        shm_unlink(name.c_str());
+    close(fd);
+    return abandoned;
+}
+
+} // namespace
+
+ShmExporter::ShmExporter(const Logger& logger, data::DataStore& datastore, const std::string& name,
+                         const std::size_t segment_size)
+    : m_logger{logger}, m_name{name}, m_segment_size{std::max(segment_size, sizeof(SegmentHeader))}
+{
+    // A segment left by an earlier run may still be mapped by its readers, so it is replaced rather than reused
+    m_fd = shm_open(m_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (m_fd < 0 && errno == EEXIST)
+    {
+        if (!remove_if_abandoned(m_name))
+            throw std::runtime_error{"Shared memory segment " + m_name + " is in use by another api_server"};
+        m_logger.warning("ShmExporter - replacing {}, left by an earlier run", m_name);
+        m_fd = shm_open(m_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    }
+    if (m_fd < 0)
+        throw std::runtime_error{"Unable to create shared memory segment " + m_name + ": " + std::strerror(errno)};
+    // Another exporter may have taken the segment for an abandoned one before it was locked, and unlinked it
+    struct stat status;
+    if (flock(m_fd, LOCK_EX | LOCK_NB) != 0 || fstat(m_fd, &status) != 0 || status.st_nlink == 0)
+    {
+        close(m_fd);
+        throw std::runtime_error{"Shared memory segment " + m_name + " was taken by another api_server"};
+    }
+    if (ftruncate(m_fd, static_cast<off_t>(m_segment_size)) != 0)
+    {
+        const auto error = errno;
+        shm_unlink(m_name.c_str());
+        close(m_fd);
+        throw std::runtime_error{"Unable to size shared memory segment " + m_name + ": " + std::strerror(error)};
+    }
+    const auto mapping = mmap(nullptr, m_segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (mapping == MAP_FAILED)
+    {
+        const auto error = errno;
+        shm_unlink(m_name.c_str());
+        close(m_fd);
+        throw std::runtime_error{"Unable to map shared memory segment " + m_name + ": " + std::strerror(error)};
+    }
+
+    m_header = new (mapping) SegmentHeader{};
+    std::memcpy(m_header->magic, MAGIC.data(), MAGIC.size());
+    m_header->version = VERSION;
+    m_header->header_size = sizeof(SegmentHeader);
+    m_header->segment_size = m_segment_size;
+    m_header->sequence.store(0u, std::memory_order_release);
+
+    datastore.on_publish([this, &datastore](uint64_t) { export_snapshot(*datastore.get_snapshot()); });
+    m_logger.info("ShmExporter - exporting generations to {} ({} bytes)", m_name, m_segment_size);
+}
+
+ShmExporter::~ShmExporter()
+{
+    munmap(m_header, m_segment_size);
+    shm_unlink(m_name.c_str());
+    close(m_fd);
+}
+
+void ShmExporter::export_snapshot(const data::Snapshot& snapshot)
+{
+    // Per-core usages are indexed by the number in their id, "cpu" being all of them together
+    float cpu_usage_percent{0.0f};
+    std::vector<float> core_usage_percent;
+    if (snapshot.cpus)
+    {
+        for (const auto& cpu : snapshot.cpus.value())
+        {
+            if (cpu.id == "cpu")
+            {
+                cpu_usage_percent = cpu.usage_percent;
+                continue;
+            }
+            const auto core = static_cast<std::size_t>(std::strtoul(cpu.id.c_str() + 3, nullptr, 10));
+            if (core >= core_usage_percent.size())
+                core_usage_percent.resize(core + 1u);
+            core_usage_percent[core] = cpu.usage_percent;
+        }
+    }
+    bool truncated{false};
+    if (sizeof(SegmentHeader) + core_usage_percent.size() * sizeof(float) > m_segment_size)
+    {
+        core_usage_percent.clear();
+        truncated = true;
+    }
+    const auto cores_size = core_usage_percent.size() * sizeof(float);
+    const auto available = m_segment_size - sizeof(SegmentHeader) - cores_size;
+    auto table = encode_procs(snapshot, available, truncated);
+    if (table.size() > available)
+        table.clear(); // Not even an empty table fits, which readers take as no processes
+    if (truncated && !m_warned_truncated)
+    {
+        m_logger.warning("ShmExporter::export_snapshot - processes don't fit in {}, exporting the busiest", m_name);
+        m_warned_truncated = true;
+    }
+    const auto mem = snapshot.mem.value_or(data::MemSnapshot{});
+    const auto body = reinterpret_cast<char*>(m_header) + sizeof(SegmentHeader);
+
+    // The only writer, so the sequence needs no read-modify-write
+    const auto sequence = m_header->sequence.load(std::memory_order_relaxed);
+    m_header->sequence.store(sequence + 1u, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_header->generation.store(snapshot.generation, std::memory_order_relaxed);
+    m_header->uptime_seconds.store(snapshot.uptime ? snapshot.uptime->total_seconds : 0.0, std::memory_order_relaxed);
+    m_header->total_memory_kB.store(mem.total_memory_kB, std::memory_order_relaxed);
+    m_header->free_memory_kB.store(mem.free_memory_kB, std::memory_order_relaxed);
+    m_header->mem_usage_percent.store(mem.usage_percent, std::memory_order_relaxed);
+    m_header->cpu_usage_percent.store(cpu_usage_percent, std::memory_order_relaxed);
+    m_header->core_count.store(static_cast<uint16_t>(core_usage_percent.size()), std::memory_order_relaxed);
+    m_header->flags.store(truncated ? FLAG_TRUNCATED : uint16_t{0u}, std::memory_order_relaxed);
+    m_header->table_size.store(static_cast<uint32_t>(table.size()), std::memory_order_relaxed);
+    std::memcpy(body, core_usage_percent.data(), cores_size);
+    std::memcpy(body + cores_size, table.data(), table.size());
+    m_header->sequence.store(sequence + 2u, std::memory_order_release);
+}
+
+std::string ShmExporter::encode_procs(const data::Snapshot& snapshot, const std::size_t size, bool& truncated) const
+{
+    if (!snapshot.procs)
+        return data::encode_proc_table({});
+    const auto& procs = *snapshot.procs.value();
+    auto table = data::encode_proc_table(procs);
+    if (table.size() <= size)
+        return table;
+
+    // Estimate how many of the busiest processes fit from their average size, then trim until they do
+    truncated = true;
+    auto busiest = procs;
+    std::sort(busiest.begin(), busiest.end(), [](const data::ProcSnapshot& a, const data::ProcSnapshot& b) {
+        return a.cpu_usage_percent > b.cpu_usage_percent;
+    });
+    auto count = busiest.size() * size / table.size();
+    while (true)
+    {
+        busiest.resize(std::min(count, busiest.size()));
+        table = data::encode_proc_table(busiest);
+        if (table.size() <= size || busiest.empty())
+            return table;
+        count = busiest.size() * 9u / 10u;
+    }
+}
+
+} // namespace shm
@@ -0,0 +1,150 @@
+#include <api_server/shm/reader.h>
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+#if defined(__SANITIZE_THREAD__)
+#define SHM_THREAD_SANITIZER
+#elif defined(__has_feature)
+#if __has_feature(thread_sanitizer)
+#define SHM_THREAD_SANITIZER
+#endif
+#endif
+
+#ifdef SHM_THREAD_SANITIZER
+extern "C" void AnnotateIgnoreReadsBegin(const char* file, int line);
+extern "C" void AnnotateIgnoreReadsEnd(const char* file, int line);
+#endif
+
+namespace shm
+{
+
+namespace
+{
+
+/// @brief Copies the segment's body, which the writer may be writing meanwhile. Unlike the header's fields, the body
+/// is copied with a plain memcpy, so catching the writer mid-generation is a data race; the seqlock makes it harmless,
+/// as the copy is then discarded. The race is deliberate, so ThreadSanitizer is told to ignore it.
+void copy_body(char* destination, const char* body, const std::size_t size)
+{
+#ifdef SHM_THREAD_SANITIZER
+    AnnotateIgnoreReadsBegin(__FILE__, __LINE__);
+#endif
+    std::memcpy(destination, body, size);
+#ifdef SHM_THREAD_SANITIZER
+    AnnotateIgnoreReadsEnd(__FILE__, __LINE__);
+#endif
+}
+
+/// @brief Waits for the writer to make progress, returning false once it has taken too long
+bool wait_for_writer(const std::chrono::steady_clock::time_point deadline)
+{
+    std::this_thread::yield();
+    return std::chrono::steady_clock::now() < deadline;
+}
+
+} // namespace
+
+ShmReader::ShmReader(const std::string& name)
+{
+    const auto fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        throw std::runtime_error{"Unable to open shared memory segment " + name + ": " + std::strerror(errno)};
+    struct stat status;
+    if (fstat(fd, &status) != 0 || static_cast<std::size_t>(status.st_size) < sizeof(SegmentHeader))
+    {
+        close(fd);
+        throw std::runtime_error{name + " is not a snapshot segment"};
+    }
+    m_segment_size = static_cast<std::size_t>(status.st_size);
+    const auto mapping = mmap(nullptr, m_segment_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+        throw std::runtime_error{"Unable to map shared memory segment " + name + ": " + std::strerror(errno)};
+
+    m_header = static_cast<const SegmentHeader*>(mapping);
+    if (std::memcmp(m_header->magic, MAGIC.data(), MAGIC.size()) != 0 || m_header->version != VERSION ||
+        m_header->header_size < sizeof(SegmentHeader) || m_header->segment_size != m_segment_size)
+    {
+        munmap(mapping, m_segment_size);
+        throw std::runtime_error{name + " is not a snapshot segment of version " + std::to_string(VERSION)};
+    }
+}
+
+ShmReader::~ShmReader()
+{
+    munmap(const_cast<SegmentHeader*>(m_header), m_segment_size);
+}
+
+uint64_t ShmReader::generation() const
+{
+    const auto deadline = std::chrono::steady_clock::now() + MAX_WAIT;
+    do
+    {
+        const auto before = m_header->sequence.load(std::memory_order_acquire);
+        if (before % 2u == 1u)
+            continue;
+        const auto generation = m_header->generation.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (m_header->sequence.load(std::memory_order_relaxed) == before)
+            return generation;
+    } while (wait_for_writer(deadline));
+    return 0u;
+}
+
+std::optional<ShmSnapshot> ShmReader::read()
+{
+    const auto deadline = std::chrono::steady_clock::now() + MAX_WAIT;
+    const auto body = reinterpret_cast<const char*>(m_header) + m_header->header_size;
+    const auto body_capacity = m_segment_size - m_header->header_size;
+    do
+    {
+        const auto before = m_header->sequence.load(std::memory_order_acquire);
+        if (before == 0u)
+            return std::nullopt;
+        if (before % 2u == 1u)
+            continue;
+
+        // Fields may be torn by a write that started since, so sizes are bounded before copying by them
+        ShmSnapshot snapshot;
+        snapshot.generation = m_header->generation.load(std::memory_order_relaxed);
+        snapshot.uptime_seconds = m_header->uptime_seconds.load(std::memory_order_relaxed);
+        snapshot.mem = {m_header->total_memory_kB.load(std::memory_order_relaxed),
+                        m_header->free_memory_kB.load(std::memory_order_relaxed),
+                        m_header->mem_usage_percent.load(std::memory_order_relaxed)};
+        snapshot.cpu_usage_percent = m_header->cpu_usage_percent.load(std::memory_order_relaxed);
+        snapshot.truncated = (m_header->flags.load(std::memory_order_relaxed) & FLAG_TRUNCATED) != 0u;
+        const std::size_t cores_size = m_header->core_count.load(std::memory_order_relaxed) * sizeof(float);
+        const std::size_t table_size = m_header->table_size.load(std::memory_order_relaxed);
+        if (cores_size + table_size <= body_capacity)
+        {
+            m_buffer.resize(cores_size + table_size);
+            copy_body(m_buffer.data(), body, m_buffer.size());
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (m_header->sequence.load(std::memory_order_relaxed) != before)
+            continue;
+        if (cores_size + table_size > body_capacity)
+            return std::nullopt;
+
+        snapshot.core_usage_percent.resize(cores_size / sizeof(float));
+        std::memcpy(snapshot.core_usage_percent.data(), m_buffer.data(), cores_size);
+        if (table_size > 0u)
+        {
+            auto table = data::decode_proc_table(std::string_view{m_buffer}.substr(cores_size));
+            if (!table)
+                return std::nullopt;
+            snapshot.procs = std::move(table->procs);
+        }
+        return snapshot;
+    } while (wait_for_writer(deadline));
+    return std::nullopt;
+}
+
+} // namespace shm
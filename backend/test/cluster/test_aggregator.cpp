@@ -0,0 +1,169 @@
+#include <gtest/gtest.h>
+
+#include <api_server/cluster/aggregator.h>
+#include <api_server/data/datastore.h>
+#include <api_server/filesystem/details.h>
+#include <api_server/logger.h>
+#include <api_server/server/api.h>
+#include <api_server/server/cluster_api.h>
+#include <api_server/server/router.h>
+#include <api_server/server/server.h>
+
+#include <thread>
+
+using namespace cluster;
+
+/// @brief An api_server on a port of its own, serving a datastore filled by the test rather than a monitor
+struct Agent
+{
+    explicit Agent(const std::vector<std::pair<int32_t, float>>& procs)
+    {
+        data::MemSnapshot mem;
+        mem.total_memory_kB = 1000u;
+        mem.free_memory_kB = 250u;
+        datastore.set_mem_snapshot(mem);
+        SetProcs(procs);
+        thread = std::thread{[this] { server.start(); }};
+    }
+
+    ~Agent()
+    {
+        server.stop();
+        thread.join();
+    }
+
+    void SetProcs(const std::vector<std::pair<int32_t, float>>& procs)
+    {
+        std::vector<data::ProcSnapshot> snapshots;
+        for (const auto& [pid, cpu] : procs)
+        {
+            data::ProcSnapshot proc;
+            proc.pid = pid;
+            proc.name = "proc" + std::to_string(pid);
+            proc.cpu_usage_percent = cpu;
+            snapshots.push_back(proc);
+        }
+        datastore.store_proc_snapshots(snapshots);
+        datastore.publish_generation();
+    }
+
+    AgentEndpoint Endpoint(const std::string& node) const
+    {
+        return {node, "127.0.0.1", std::to_string(server.port())};
+    }
+
+    StdStreamLogger logger{LogLevel::Error};
+    data::DataStore datastore;
+    server::Router router{logger};
+    filesystem::ProcDetailsCollector details_collector{logger};
+    server::ApiController controller{logger, router, datastore, &details_collector};
+    server::Server server{logger, router, "127.0.0.1", 0, server::ServerConfig{1u, std::chrono::seconds{5}}};
+    std::thread thread;
+};
+
+class AggregatorTest : public ::testing::Test {
+protected:
+    /// @brief Returns a port that nothing listens on
+    static std::string ClosedPort()
+    {
+        boost::asio::io_context context;
+        boost::asio::ip::tcp::acceptor acceptor{context, {boost::asio::ip::make_address("127.0.0.1"), 0}};
+        return std::to_string(acceptor.local_endpoint().port());
+    }
+
+    StdStreamLogger logger{LogLevel::Error};
+    Agent first{{{1, 10.0f}, {2, 60.0f}}};
+    Agent second{{{1, 30.0f}}};
+};
+
+// GIVEN two agents on different ports, and one that is down
+// WHEN the aggregator polls them
+// THEN the store has the processes of both running agents, and the other is unreachable
+TEST_F(AggregatorTest, PollAgents) {
+    ClusterStore store{{first.Endpoint("first"), second.Endpoint("second"), {"down", "127.0.0.1", ClosedPort()}}};
+    AggregatorConfig config;
+    config.max_concurrency = 2u;
+    Aggregator aggregator{logger, store, config};
+
+    aggregator.poll_once();
+
+    const auto top = store.top_procs(10u, ProcOrder::Cpu);
+    ASSERT_EQ(top.size(), 3u);
+    ASSERT_EQ(top[0].node, "first");
+    ASSERT_EQ(top[0].proc.pid, 2);
+    ASSERT_EQ(top[0].proc.name, "proc2");
+    ASSERT_FLOAT_EQ(top[0].proc.cpu_usage_percent, 60.0f);
+    ASSERT_EQ(top[1].node, "second");
+    ASSERT_EQ(top[2].node, "first");
+    const auto nodes = store.nodes();
+    ASSERT_TRUE(nodes[0]->reachable);
+    ASSERT_EQ(nodes[0]->snapshot.mem->total_memory_kB, 1000u);
+    ASSERT_FALSE(nodes[2]->reachable);
+    ASSERT_NE(nodes[2]->error.find("connect"), std::string::npos);
+}
+
+// GIVEN agents already polled once
+// WHEN they are polled again, after one has published a new generation
+// THEN only that one's processes change, the other answering that its snapshot is unchanged
+TEST_F(AggregatorTest, RepeatedPolls) {
+    ClusterStore store{{first.Endpoint("first"), second.Endpoint("second")}};
+    Aggregator aggregator{logger, store};
+    aggregator.poll_once();
+    const auto generation = store.generation();
+    const auto first_updated = store.nodes()[0]->updated;
+
+    second.SetProcs({{1, 30.0f}, {7, 90.0f}});
+    aggregator.poll_once();
+
+    ASSERT_EQ(store.generation(), generation + 1u);
+    const auto nodes = store.nodes();
+    ASSERT_EQ(nodes[0]->snapshot.generation, 1u);
+    ASSERT_GT(nodes[0]->updated, first_updated);
+    ASSERT_EQ(nodes[1]->snapshot.generation, 2u);
+    const auto top = store.top_procs(1u, ProcOrder::Cpu);
+    ASSERT_EQ(top[0].node, "second");
+    ASSERT_EQ(top[0].proc.pid, 7);
+}
+
+// GIVEN a polled cluster
+// WHEN the aggregator's endpoints are requested
+// THEN they serve the merged processes, node statuses and summary
+// AND cached responses can be revalidated with the store's generation
+TEST_F(AggregatorTest, ClusterEndpoints) {
+    ClusterStore store{{first.Endpoint("first"), second.Endpoint("second")}};
+    Aggregator aggregator{logger, store};
+    aggregator.poll_once();
+    server::Router router{logger};
+    server::ClusterController controller{logger, router, store};
+    const auto get = [&router](const std::string& target) {
+        const server::BoostHttpRequest request{server::bb::http::verb::get, target, 11};
+        const auto response = router.process_http_request(request);
+        EXPECT_EQ(response.result(), server::bb::http::status::ok) << target;
+        return nlohmann::json::parse(response.payload());
+    };
+
+    const auto procs = get("/api/procs?limit=2");
+    ASSERT_EQ(procs.size(), 2u);
+    ASSERT_EQ(procs[0]["node"], "first");
+    ASSERT_EQ(procs[0]["pid"], 2);
+    ASSERT_EQ(procs[1]["node"], "second");
+    ASSERT_EQ(get("/api/procs?limit=18446744073709551615").size(), 3u);
+    const auto nodes = get("/api/nodes");
+    ASSERT_EQ(nodes.size(), 2u);
+    ASSERT_EQ(nodes[1]["node"], "second");
+    ASSERT_EQ(nodes[1]["reachable"], true);
+    ASSERT_EQ(nodes[1]["processes"], 1);
+    const auto summary = get("/api/summary");
+    ASSERT_EQ(summary["nodes_reachable"], 2);
+    ASSERT_EQ(summary["processes"], 3);
+    ASSERT_EQ(summary["total_memory_kB"], 2000);
+
+    const server::BoostHttpRequest bad_sort{server::bb::http::verb::get, "/api/procs?sort=name", 11};
+    ASSERT_EQ(router.process_http_request(bad_sort).result(), server::bb::http::status::bad_request);
+
+    server::BoostHttpRequest revalidate{server::bb::http::verb::get, "/api/summary", 11};
+    const auto etag = router.process_http_request(revalidate)[server::bb::http::field::etag];
+    ASSERT_TRUE(boost::ends_with(etag, "-" + std::to_string(store.generation()) + "\""));
+    revalidate.set(server::bb::http::field::if_none_match, etag);
+    ASSERT_EQ(router.process_http_request(revalidate).result(), server::bb::http::status::not_modified);
+}
@@ -0,0 +1,143 @@
+#include <gtest/gtest.h>
+
+#include <api_server/cluster/store.h>
+
+#include <limits>
+
+using namespace cluster;
+
+class ClusterStoreTest : public ::testing::Test {
+protected:
+    /// @brief Returns a snapshot of a host with two CPUs and processes of the given (pid, cpu, mem) usage
+    static data::Snapshot MakeSnapshot(const std::vector<std::tuple<int32_t, float, float>>& procs,
+                                       const float cpu_usage, const uint32_t total_kB, const uint32_t free_kB)
+    {
+        data::Snapshot snapshot;
+        snapshot.generation = 1u;
+        snapshot.cpus = std::vector<data::CpuSnapshot>{{"cpu", 0u, 0u, 0u, cpu_usage},
+                                                       {"cpu0", 0u, 0u, 0u, cpu_usage},
+                                                       {"cpu1", 0u, 0u, 0u, cpu_usage}};
+        snapshot.mem = data::MemSnapshot{total_kB, free_kB, 0.0f};
+        auto proc_list = std::make_shared<std::vector<data::ProcSnapshot>>();
+        for (const auto& [pid, cpu, mem] : procs)
+        {
+            data::ProcSnapshot proc;
+            proc.pid = pid;
+            proc.cpu_usage_percent = cpu;
+            proc.mem_usage_percent = mem;
+            proc_list->push_back(proc);
+        }
+        snapshot.procs = std::move(proc_list);
+        return snapshot;
+    }
+
+    ClusterStore store{{parse_agent_endpoint("a=10.0.0.1:8080"), parse_agent_endpoint("b=10.0.0.2:8080"),
+                        parse_agent_endpoint("10.0.0.3:8080")}};
+};
+
+// GIVEN agents with and without node names
+// WHEN they are parsed
+// THEN unnamed agents are named by their address, and malformed ones are rejected
+TEST_F(ClusterStoreTest, ParseAgentEndpoint) {
+    const auto named = parse_agent_endpoint("web-1=localhost:8081");
+    ASSERT_EQ(named.node, "web-1");
+    ASSERT_EQ(named.host, "localhost");
+    ASSERT_EQ(named.port, "8081");
+    ASSERT_EQ(parse_agent_endpoint("localhost:8082").node, "localhost:8082");
+    ASSERT_THROW(parse_agent_endpoint("localhost"), std::runtime_error);
+    ASSERT_THROW(parse_agent_endpoint("a=:8080"), std::runtime_error);
+    ASSERT_THROW(ClusterStore({named, named}), std::runtime_error);
+}
+
+// GIVEN nodes with processes of various usage
+// WHEN the top processes are requested
+// THEN they are merged from every reachable node in descending order, labelled with their node
+TEST_F(ClusterStoreTest, TopProcs) {
+    store.update("a", MakeSnapshot({{1, 5.0f, 1.0f}, {2, 50.0f, 2.0f}, {3, 20.0f, 30.0f}}, 10.0f, 1000u, 500u), {});
+    store.update("b", MakeSnapshot({{1, 40.0f, 3.0f}, {2, 10.0f, 40.0f}}, 10.0f, 1000u, 500u), {});
+
+    const auto by_cpu = store.top_procs(4u, ProcOrder::Cpu);
+    ASSERT_EQ(by_cpu.size(), 4u);
+    ASSERT_EQ(by_cpu[0].node, "a");
+    ASSERT_EQ(by_cpu[0].proc.pid, 2);
+    ASSERT_EQ(by_cpu[1].node, "b");
+    ASSERT_EQ(by_cpu[1].proc.pid, 1);
+    ASSERT_EQ(by_cpu[2].node, "a");
+    ASSERT_EQ(by_cpu[2].proc.pid, 3);
+    ASSERT_EQ(by_cpu[3].node, "b");
+    ASSERT_EQ(by_cpu[3].proc.pid, 2);
+
+    const auto by_mem = store.top_procs(10u, ProcOrder::Mem);
+    ASSERT_EQ(by_mem.size(), 5u);
+    ASSERT_EQ(by_mem[0].node, "b");
+    ASSERT_EQ(by_mem[0].proc.pid, 2);
+    ASSERT_EQ(by_mem[1].node, "a");
+    ASSERT_EQ(by_mem[1].proc.pid, 3);
+    ASSERT_EQ(to_json(by_mem[0])["node"], "b");
+}
+
+// GIVEN nodes with a few processes
+// WHEN far more top processes are requested than exist, e.g. by a client's ?limit=
+// THEN every process is returned, without reserving room for the requested count
+TEST_F(ClusterStoreTest, TopProcsHugeCount) {
+    store.update("a", MakeSnapshot({{1, 5.0f, 1.0f}, {2, 50.0f, 2.0f}}, 10.0f, 1000u, 500u), {});
+    store.update("b", MakeSnapshot({{1, 40.0f, 3.0f}}, 10.0f, 1000u, 500u), {});
+
+    const auto top = store.top_procs(std::numeric_limits<std::size_t>::max(), ProcOrder::Cpu);
+
+    ASSERT_EQ(top.size(), 3u);
+}
+
+// GIVEN a node whose fetch then fails
+// WHEN the cluster is queried
+// THEN its processes and totals are left out, but its status keeps the error and last snapshot
+TEST_F(ClusterStoreTest, UnreachableNode) {
+    store.update("a", MakeSnapshot({{1, 5.0f, 1.0f}}, 10.0f, 1000u, 500u), {});
+    store.update("b", MakeSnapshot({{1, 40.0f, 3.0f}}, 40.0f, 3000u, 500u), {});
+    const auto generation = store.generation();
+
+    store.mark_failed("b", "Failed to connect: Connection refused", {});
+
+    ASSERT_GT(store.generation(), generation);
+    const auto top = store.top_procs(10u, ProcOrder::Cpu);
+    ASSERT_EQ(top.size(), 1u);
+    ASSERT_EQ(top[0].node, "a");
+    const auto summary = store.summary();
+    ASSERT_EQ(summary.nodes, 3u);
+    ASSERT_EQ(summary.nodes_reachable, 1u);
+    const auto node = store.nodes()[1];
+    ASSERT_FALSE(node->reachable);
+    ASSERT_EQ(node->failures, 1u);
+    ASSERT_EQ(node->error, "Failed to connect: Connection refused");
+    ASSERT_TRUE(node->snapshot.procs.has_value());
+}
+
+// GIVEN reachable nodes of different sizes
+// WHEN the summary is requested
+// THEN it has their totals, with CPU usage weighted by each node's CPU count
+TEST_F(ClusterStoreTest, Summary) {
+    store.update("a", MakeSnapshot({{1, 5.0f, 1.0f}, {2, 5.0f, 1.0f}}, 10.0f, 1000u, 500u), {});
+    store.update("b", MakeSnapshot({{1, 40.0f, 3.0f}}, 40.0f, 3000u, 500u), {});
+
+    const auto summary = store.summary();
+    ASSERT_EQ(summary.nodes_reachable, 2u);
+    ASSERT_EQ(summary.processes, 3u);
+    ASSERT_EQ(summary.cpus, 4u);
+    ASSERT_FLOAT_EQ(summary.cpu_usage_percent, 25.0f);
+    ASSERT_EQ(summary.total_memory_kB, 4000u);
+    ASSERT_EQ(summary.free_memory_kB, 1000u);
+    ASSERT_FLOAT_EQ(summary.mem_usage_percent, 75.0f);
+}
+
+// GIVEN a node's snapshot that hasn't changed
+// WHEN the fetch is recorded
+// THEN merged results are still current, so the generation is unchanged
+TEST_F(ClusterStoreTest, Unchanged) {
+    store.update("a", MakeSnapshot({{1, 5.0f, 1.0f}}, 10.0f, 1000u, 500u), {});
+    const auto generation = store.generation();
+
+    store.mark_unchanged("a", std::chrono::milliseconds{3});
+
+    ASSERT_EQ(store.generation(), generation);
+    ASSERT_EQ(store.nodes()[0]->fetch_duration, std::chrono::milliseconds{3});
+}
@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+
+#include <api_server/data/encoding.h>
+
+using namespace data;
+
+class EncodingTest : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        for (int32_t pid = 1; pid <= 3; ++pid)
+        {
+            ProcSnapshot proc;
+            proc.snapshot_time = 5000.5;
+            proc.pid = pid;
+            proc.ppid = pid - 1;
+            proc.name = "proc" + std::to_string(pid);
+            proc.command = "/usr/bin/proc" + std::to_string(pid) + " --verbose";
+            proc.mem_usage_kB = 1024u * static_cast<uint32_t>(pid);
+            proc.mem_usage_percent = 1.5f * static_cast<float>(pid);
+            proc.cpu_usage_percent = 12.25f;
+            proc.cgroup = "/system.slice/proc.service";
+            procs.push_back(proc);
+        }
+        procs[1].smaps = SmapsSample{4990.5, 300u, 200u, 100u};
+    }
+
+    std::vector<ProcSnapshot> procs;
+};
+
+// GIVEN a list of processes
+// WHEN it is encoded as MessagePack or CBOR
+// THEN decoding it gives the same document as the JSON
+TEST_F(EncodingTest, MsgPackAndCborRoundTrip) {
+    const auto json = to_json(procs);
+
+    const auto msgpack = encode(procs, Encoding::MsgPack);
+    ASSERT_EQ(nlohmann::json::from_msgpack(msgpack), json);
+
+    const auto cbor = encode(procs, Encoding::Cbor);
+    ASSERT_EQ(nlohmann::json::from_cbor(cbor), json);
+
+    ASSERT_EQ(nlohmann::json::parse(encode(procs, Encoding::Json)), json);
+}
+
+// GIVEN a document with a string that isn't valid UTF-8, e.g. a process name read from /proc
+// WHEN it is encoded as JSON
+// THEN the invalid bytes are replaced rather than failing the encoding
+TEST_F(EncodingTest, InvalidUtf8Document) {
+    const nlohmann::json document{{"name", "bad\xff"}};
+
+    ASSERT_EQ(encode_document(document, Encoding::Json), "{\"name\":\"bad\xef\xbf\xbd\"}");
+    ASSERT_EQ(nlohmann::json::from_msgpack(encode_document(document, Encoding::MsgPack)).size(), 1u);
+}
+
+// GIVEN a list of processes
+// WHEN it is encoded as a binary process table
+// THEN decoding it gives the same processes
+TEST_F(EncodingTest, ProcTableRoundTrip) {
+    const auto encoded = encode(procs, Encoding::ProcTable);
+    const auto table = decode_proc_table(encoded);
+
+    ASSERT_TRUE(table.has_value());
+    ASSERT_DOUBLE_EQ(table->snapshot_time, 5000.5);
+    ASSERT_EQ(table->procs.size(), procs.size());
+    for (std::size_t i = 0; i < procs.size(); ++i)
+    {
+        const auto& expected = procs[i];
+        const auto& actual = table->procs[i];
+        ASSERT_EQ(actual.pid, expected.pid);
+        ASSERT_EQ(actual.ppid, expected.ppid);
+        ASSERT_EQ(actual.name, expected.name);
+        ASSERT_EQ(actual.command, expected.command);
+        ASSERT_EQ(actual.cgroup, expected.cgroup);
+        ASSERT_EQ(actual.mem_usage_kB, expected.mem_usage_kB);
+        ASSERT_FLOAT_EQ(actual.mem_usage_percent, expected.mem_usage_percent);
+        ASSERT_FLOAT_EQ(actual.cpu_usage_percent, expected.cpu_usage_percent);
+        ASSERT_EQ(actual.smaps.has_value(), expected.smaps.has_value());
+    }
+    const auto& smaps = table->procs[1].smaps.value();
+    ASSERT_EQ(smaps.pss_kB, 300u);
+    ASSERT_EQ(smaps.uss_kB, 200u);
+    ASSERT_EQ(smaps.swap_kB, 100u);
+    ASSERT_DOUBLE_EQ(smaps.sample_time, 4990.5);
+}
+
+// GIVEN a list of processes sharing a cgroup
+// WHEN it is encoded as a binary process table
+// THEN the cgroup is stored once, and each record has a fixed size
+TEST_F(EncodingTest, ProcTableLayout) {
+    const auto encoded = encode_proc_table(procs);
+    std::size_t strings_size = procs[0].cgroup.size();
+    for (const auto& proc : procs)
+    {
+        strings_size += proc.name.size() + proc.command.size();
+    }
+
+    ASSERT_EQ(encoded.size(), ProcTable::HEADER_SIZE + procs.size() * ProcTable::RECORD_SIZE + strings_size);
+    ASSERT_EQ(encoded.substr(0, 4), "PTBL");
+    ASSERT_EQ(encoded[4], '\x01'); // Version, little-endian
+    ASSERT_EQ(encoded[5], '\x00');
+}
+
+// GIVEN binary process tables that are truncated, of another version or are not tables at all
+// WHEN they are decoded
+// THEN they are rejected
+TEST_F(EncodingTest, MalformedProcTable) {
+    const auto encoded = encode_proc_table(procs);
+    ASSERT_FALSE(decode_proc_table(encoded.substr(0, encoded.size() - 1)).has_value());
+    ASSERT_FALSE(decode_proc_table(encoded.substr(0, 10)).has_value());
+    ASSERT_FALSE(decode_proc_table("[]").has_value());
+
+    auto future_version = encoded;
+    future_version[4] = '\x02';
+    ASSERT_FALSE(decode_proc_table(future_version).has_value());
+
+    const auto empty = decode_proc_table(encode_proc_table({}));
+    ASSERT_TRUE(empty.has_value());
+    ASSERT_TRUE(empty->procs.empty());
+}
+
+// GIVEN a document that is not a process list
+// WHEN it is encoded as a binary process table
+// THEN it is rejected
+TEST_F(EncodingTest, ProcTableOnlyForProcesses) {
+    ASSERT_THROW(encode(MemSnapshot{}, Encoding::ProcTable), std::invalid_argument);
+}
@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+
+#include <api_server/data/types.h>
+
+#include <limits>
+
+using namespace data;
+
+class JsonWriterTest : public ::testing::Test {
+protected:
+    static std::string Write(const std::string& value)
+    {
+        std::string json;
+        JsonWriter writer{json};
+        writer.value(value);
+        return json;
+    }
+
+    static std::string Write(const double value)
+    {
+        std::string json;
+        JsonWriter writer{json};
+        writer.value(value);
+        return json;
+    }
+
+    static std::string Dump(const std::string& value)
+    {
+        return nlohmann::json(value).dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+    }
+
+    static ProcSnapshot MakeProc(const int32_t pid)
+    {
+        ProcSnapshot snapshot;
+        snapshot.snapshot_time = 1234.5;
+        snapshot.pid = pid;
+        snapshot.ppid = 1;
+        snapshot.name = "proc \"" + std::to_string(pid) + "\"";
+        snapshot.command = "/usr/bin/proc --flag=\\path\\\t\xC3\xA9";
+        snapshot.mem_usage_percent = 0.1f;
+        snapshot.cpu_usage_percent = 33.333332f;
+        snapshot.cgroup = "/system.slice/proc.service";
+        return snapshot;
+    }
+};
+
+// GIVEN strings with characters that must be escaped
+// WHEN they are written
+// THEN the output is identical to nlohmann's
+TEST_F(JsonWriterTest, StringEscaping) {
+    const std::vector<std::string> values{"",
+                                          "plain",
+                                          "quote \" backslash \\ slash /",
+                                          "\b\f\n\r\t",
+                                          std::string{"\x00\x01\x1F\x7F", 4},
+                                          "\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80"};
+    for (const auto& value : values)
+    {
+        ASSERT_EQ(Write(value), Dump(value));
+    }
+}
+
+// GIVEN strings that are not valid UTF-8, e.g. from a process's command line
+// WHEN they are written
+// THEN invalid sequences are replaced as nlohmann does with error_handler_t::replace
+TEST_F(JsonWriterTest, InvalidUtf8) {
+    const std::vector<std::string> values{"\xFF",         "a\x80z",        "\xC3",         "\xC3(",
+                                          "\xE2\x82",     "\xE2\x82(",     "\xE0\x80\x80", "\xED\xA0\x80",
+                                          "\xF4\x90\x80\x80", "\xF0\x9F\x98", "\xC0\xAF"};
+    for (const auto& value : values)
+    {
+        ASSERT_EQ(Write(value), Dump(value)) << nlohmann::json(value).dump(-1, ' ', true,
+                                                                           nlohmann::json::error_handler_t::replace);
+    }
+}
+
+// GIVEN floating point numbers of varying magnitude
+// WHEN they are written
+// THEN the output is identical to nlohmann's
+TEST_F(JsonWriterTest, Numbers) {
+    const std::vector<double> values{0.0,   -0.0,  1.0,    0.1,        static_cast<double>(0.1f), 100.0,
+                                     1e-7,  1e21,  -12.5,  123456.789, std::numeric_limits<double>::max(),
+                                     1e15,  1e16,  1e-4,   1e-5,       123456789012345.6,
+                                     0.001, 2.5e-8, -3e100, std::numeric_limits<double>::denorm_min(),
+                                     std::numeric_limits<double>::infinity(), std::numeric_limits<double>::quiet_NaN()};
+    for (const auto value : values)
+    {
+        ASSERT_EQ(Write(value), nlohmann::json(value).dump());
+    }
+}
+
+// GIVEN snapshots of each type served by the hot endpoints
+// WHEN they are serialized
+// THEN the output is identical to serializing them through nlohmann::json
+TEST_F(JsonWriterTest, SnapshotsMatchNlohmann) {
+    Uptime uptime{27u, 46u, 40u, 100000.25, "27:46:40"};
+    ASSERT_EQ(to_json_string(uptime), to_json(uptime).dump());
+
+    MemSnapshot mem{16384000u, 4096000u, 75.0f};
+    ASSERT_EQ(to_json_string(mem), to_json(mem).dump());
+
+    std::vector<CpuSnapshot> cpus{{"cpu", 100u, 50u, 50u, 50.0f}, {"cpu0", 100u, 10u, 90u, 10.0f}};
+    auto cpus_json = nlohmann::json::array();
+    for (const auto& cpu : cpus)
+    {
+        cpus_json.push_back(to_json(cpu));
+    }
+    ASSERT_EQ(to_json_string(cpus), cpus_json.dump());
+
+    std::vector<ProcSnapshot> procs{MakeProc(1), MakeProc(2)};
+    procs[1].smaps = SmapsSample{1230.0, 100u, 50u, 0u};
+    auto procs_json = nlohmann::json::array();
+    for (const auto& proc : procs)
+    {
+        procs_json.push_back(to_json(proc));
+    }
+    ASSERT_EQ(to_json_string(procs), procs_json.dump());
+    ASSERT_EQ(to_json_string(std::vector<ProcSnapshot>{}), "[]");
+}
@@ -0,0 +1,184 @@
+#include <gtest/gtest.h>
+
+#include <api_server/data/prochistory.h>
+
+using namespace data;
+
+class ProcHistoryTest : public ::testing::Test {
+protected:
+    void SetProc(const int32_t pid, const float cpu = 0.0f, const std::string& name = "proc")
+    {
+        ProcSnapshot snapshot;
+        snapshot.pid = pid;
+        snapshot.name = name;
+        snapshot.cpu_usage_percent = cpu;
+        snapshot.snapshot_time = static_cast<double>(generation);
+        procs[pid] = snapshot;
+    }
+
+    /// @brief Records the current processes as the next generation
+    void Publish()
+    {
+        auto list = std::make_shared<std::vector<ProcSnapshot>>();
+        for (auto& [pid, snapshot] : procs)
+        {
+            snapshot.snapshot_time = static_cast<double>(generation + 1u);
+            list->push_back(snapshot);
+        }
+        history.record(++generation, std::move(list));
+    }
+
+    static std::vector<int32_t> Pids(const std::vector<ProcSnapshot>& snapshots)
+    {
+        std::vector<int32_t> pids;
+        for (const auto& snapshot : snapshots)
+        {
+            pids.push_back(snapshot.pid);
+        }
+        return pids;
+    }
+
+    std::map<int32_t, ProcSnapshot> procs;
+    uint64_t generation{0u};
+    ProcHistory history;
+};
+
+// GIVEN a generation of processes
+// WHEN the next generation adds, removes and changes processes
+// THEN the delta since the first generation has only those processes
+TEST_F(ProcHistoryTest, DeltaSincePreviousGeneration) {
+    SetProc(1);
+    SetProc(2);
+    SetProc(3);
+    SetProc(4);
+    Publish();
+
+    procs.erase(2);
+    SetProc(3, 50.0f);
+    SetProc(5);
+    Publish();
+
+    const auto delta = history.delta_since(1u);
+    ASSERT_FALSE(delta.full);
+    ASSERT_EQ(delta.since, 1u);
+    ASSERT_EQ(delta.generation, 2u);
+    ASSERT_EQ(Pids(delta.added), std::vector<int32_t>{5});
+    ASSERT_EQ(Pids(delta.changed), std::vector<int32_t>{3});
+    ASSERT_EQ(delta.changed[0].cpu_usage_percent, 50.0f);
+    ASSERT_EQ(delta.removed, std::vector<int32_t>{2});
+}
+
+// GIVEN changes over several generations
+// WHEN the delta since the first is requested
+// THEN the changes are combined, leaving out processes that came and went in between
+TEST_F(ProcHistoryTest, DeltaOverSeveralGenerations) {
+    SetProc(1);
+    SetProc(2);
+    Publish();
+
+    SetProc(3);
+    SetProc(1, 10.0f);
+    Publish();
+
+    procs.erase(3);
+    procs.erase(2);
+    SetProc(4);
+    Publish();
+
+    const auto delta = history.delta_since(1u);
+    ASSERT_EQ(Pids(delta.added), std::vector<int32_t>{4});
+    ASSERT_EQ(Pids(delta.changed), std::vector<int32_t>{1});
+    ASSERT_EQ(delta.removed, std::vector<int32_t>{2});
+}
+
+// GIVEN a process whose PID was re-used within the window
+// WHEN the delta is requested
+// THEN the new process is a changed row
+TEST_F(ProcHistoryTest, ReusedPid) {
+    SetProc(7, 0.0f, "old");
+    Publish();
+    procs.erase(7);
+    Publish();
+    SetProc(7, 0.0f, "new");
+    Publish();
+
+    const auto delta = history.delta_since(1u);
+    ASSERT_TRUE(delta.added.empty());
+    ASSERT_EQ(Pids(delta.changed), std::vector<int32_t>{7});
+    ASSERT_EQ(delta.changed[0].name, "new");
+    ASSERT_TRUE(delta.removed.empty());
+}
+
+// GIVEN processes whose CPU usage changes a little on every poll
+// WHEN the delta is requested with a CPU threshold
+// THEN only processes whose usage moved by at least the threshold since the client's generation are included
+TEST_F(ProcHistoryTest, Threshold) {
+    SetProc(1, 10.0f);
+    SetProc(2, 10.0f);
+    Publish();
+    SetProc(1, 10.5f);
+    SetProc(2, 11.0f);
+    Publish();
+    SetProc(1, 10.9f);
+    SetProc(2, 12.5f);
+    Publish();
+
+    ASSERT_EQ(Pids(history.delta_since(1u).changed), (std::vector<int32_t>{1, 2}));
+    ProcDeltaThresholds thresholds;
+    thresholds.cpu_usage_percent = 1.0f;
+    ASSERT_EQ(Pids(history.delta_since(1u, thresholds).changed), std::vector<int32_t>{2});
+}
+
+// GIVEN a client up to date with the latest generation
+// WHEN the delta is requested
+// THEN it is empty
+TEST_F(ProcHistoryTest, NoChanges) {
+    SetProc(1);
+    Publish();
+    SetProc(1);
+    Publish();
+
+    const auto delta = history.delta_since(2u);
+    ASSERT_FALSE(delta.full);
+    ASSERT_TRUE(delta.added.empty() && delta.changed.empty() && delta.removed.empty());
+    ASSERT_TRUE(history.delta_since(1u).changed.empty());
+}
+
+// GIVEN a client whose generation is older than the window, or unknown
+// WHEN the delta is requested
+// THEN the full list is returned instead
+TEST_F(ProcHistoryTest, FullListOutsideWindow) {
+    SetProc(1);
+    SetProc(2);
+    for (std::size_t i = 0; i < ProcHistory::WINDOW + 2u; ++i)
+    {
+        Publish();
+    }
+
+    const auto stale = history.delta_since(1u);
+    ASSERT_TRUE(stale.full);
+    ASSERT_EQ(Pids(stale.added), (std::vector<int32_t>{1, 2}));
+    ASSERT_FALSE(history.delta_since(generation - ProcHistory::WINDOW).full);
+    ASSERT_TRUE(history.delta_since(generation + 1u).full);
+}
+
+// GIVEN a generation that is no longer the latest, e.g. that of a snapshot taken before the last poll
+// WHEN the delta up to that generation is requested
+// THEN it doesn't have the changes made after it
+TEST_F(ProcHistoryTest, DeltaUntilGeneration) {
+    SetProc(1);
+    Publish();
+    SetProc(2);
+    Publish();
+    const std::vector<ProcSnapshot> until{procs[1], procs[2]};
+    SetProc(3);
+    Publish();
+
+    const auto delta = history.delta(1u, 2u, until);
+    ASSERT_FALSE(delta.full);
+    ASSERT_EQ(delta.generation, 2u);
+    ASSERT_EQ(Pids(delta.added), std::vector<int32_t>{2});
+    ASSERT_TRUE(delta.changed.empty() && delta.removed.empty());
+    ASSERT_TRUE(history.delta(2u, 1u, until).full);
+    ASSERT_TRUE(history.delta(1u, generation + 1u, until).full);
+}
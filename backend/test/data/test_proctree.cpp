@@ -0,0 +1,164 @@
+#include <gtest/gtest.h>
+
+#include <api_server/data/proctree.h>
+
+using namespace data;
+
+class ProcTreeTest : public ::testing::Test {
+protected:
+    void AddProc(const int32_t pid, const int32_t ppid, const float cpu = 0.0f, const uint32_t mem_kB = 0u)
+    {
+        ProcSnapshot snapshot;
+        snapshot.pid = pid;
+        snapshot.ppid = ppid;
+        snapshot.cpu_usage_percent = cpu;
+        snapshot.mem_usage_kB = mem_kB;
+        procs[pid] = snapshot;
+    }
+
+    /// @brief Returns the processes ordered by PID, as trees are built from
+    std::vector<ProcSnapshot> List() const
+    {
+        std::vector<ProcSnapshot> list;
+        for (const auto& [pid, proc] : procs)
+            list.push_back(proc);
+        return list;
+    }
+
+    ProcTree::Procs procs;
+    ProcTree tree;
+};
+
+// GIVEN a generation of processes with init and kthreadd as roots
+// WHEN the tree is updated
+// THEN children are indexed by their ppid
+TEST_F(ProcTreeTest, BuildsHierarchy) {
+    AddProc(1, 0);
+    AddProc(2, 0);
+    AddProc(10, 1);
+    AddProc(11, 1);
+    AddProc(20, 2);
+    AddProc(100, 10);
+    tree.update(procs);
+
+    ASSERT_EQ(tree.roots(), (std::vector<int32_t>{1, 2}));
+    ASSERT_EQ(tree.children(1), (std::vector<int32_t>{10, 11}));
+    ASSERT_EQ(tree.children(10), (std::vector<int32_t>{100}));
+    ASSERT_TRUE(tree.children(100).empty());
+}
+
+// GIVEN a tree of processes
+// WHEN the next generation adds and removes processes
+// THEN the tree reflects the new generation
+// AND children of exited processes are re-attached to their new parent
+TEST_F(ProcTreeTest, IncrementalUpdate) {
+    AddProc(1, 0);
+    AddProc(10, 1);
+    AddProc(100, 10);
+    tree.update(procs);
+
+    procs.erase(10);
+    AddProc(100, 1); // Re-parented to init
+    AddProc(101, 100);
+    tree.update(procs);
+
+    ASSERT_EQ(tree.size(), 3u);
+    ASSERT_EQ(tree.roots(), (std::vector<int32_t>{1}));
+    ASSERT_EQ(tree.children(1), (std::vector<int32_t>{100}));
+    ASSERT_EQ(tree.children(100), (std::vector<int32_t>{101}));
+}
+
+// GIVEN a child process with a lower PID than its parent (PID wrap-around)
+// WHEN the tree is updated
+// THEN the child is attached to its parent rather than being a root
+TEST_F(ProcTreeTest, ChildBeforeParent) {
+    AddProc(1, 0);
+    AddProc(5, 900);
+    AddProc(900, 1);
+    tree.update(procs);
+
+    ASSERT_EQ(tree.roots(), (std::vector<int32_t>{1}));
+    ASSERT_EQ(tree.children(900), (std::vector<int32_t>{5}));
+}
+
+// GIVEN a tree of processes with CPU and memory usage
+// WHEN a subtree is requested
+// THEN usage is rolled up over all descendants
+// AND children beyond the depth limit are not included
+TEST_F(ProcTreeTest, SubtreeRollupsAndDepth) {
+    AddProc(1, 0, 1.0f, 100);
+    AddProc(10, 1, 2.0f, 200);
+    AddProc(100, 10, 4.0f, 400);
+    AddProc(11, 1, 8.0f, 800);
+    tree.update(procs);
+
+    const auto root = tree.subtree(List(), 1, 1u);
+    ASSERT_TRUE(root.has_value());
+    ASSERT_FLOAT_EQ(root->subtree_cpu_usage_percent, 15.0f);
+    ASSERT_EQ(root->subtree_mem_usage_kB, 1500u);
+    ASSERT_EQ(root->descendant_count, 3u);
+    ASSERT_EQ(root->children.size(), 2u);
+
+    const auto& child = root->children[0];
+    ASSERT_EQ(child.process.pid, 10);
+    ASSERT_FLOAT_EQ(child.subtree_cpu_usage_percent, 6.0f);
+    ASSERT_EQ(child.child_count, 1u);
+    ASSERT_FALSE(child.expanded);
+    ASSERT_TRUE(child.children.empty());
+
+    ASSERT_FALSE(tree.subtree(List(), 999, std::nullopt).has_value());
+}
+
+// GIVEN processes whose PPIDs form a cycle (inconsistent reads around PID re-use)
+// WHEN the tree is updated
+// THEN the cycle is broken and every process is reachable from a root
+TEST_F(ProcTreeTest, CycleIsBroken) {
+    AddProc(7, 8);
+    AddProc(8, 7);
+    tree.update(procs);
+
+    const auto forest = tree.forest(List(), std::nullopt);
+    ASSERT_EQ(forest.size(), 1u);
+    ASSERT_EQ(forest[0].descendant_count, 1u);
+}
+
+// GIVEN a tree with a process whose name isn't valid UTF-8, as any user can set with prctl
+// WHEN it is serialized with the JsonWriter
+// THEN it is the same document as to_json's, with the invalid bytes replaced rather than throwing
+TEST_F(ProcTreeTest, WriteJson) {
+    AddProc(1, 0, 1.0f, 100);
+    AddProc(10, 1, 2.0f, 200);
+    AddProc(11, 1, 3.0f, 300);
+    AddProc(100, 10, 4.0f, 400);
+    procs[11].name = "bad\xff";
+    tree.update(procs);
+    const auto root = tree.subtree(List(), 1, 1u).value();
+
+    std::string json;
+    JsonWriter writer{json};
+    write_json(writer, root);
+
+    ASSERT_EQ(json, to_json(root).dump(-1, ' ', false, nlohmann::json::error_handler_t::replace));
+    ASSERT_NE(json.find("bad\xef\xbf\xbd"), std::string::npos);
+}
+
+// GIVEN a chain of processes each forked by the previous one, far deeper than the stack allows recursing
+// WHEN the tree is updated, built, serialized and destroyed
+// THEN none of it recurses per level
+TEST_F(ProcTreeTest, DeepChain) {
+    constexpr int32_t depth{100000};
+    for (int32_t pid = 1; pid <= depth; ++pid)
+        AddProc(pid, pid - 1, 0.0f, 1u);
+    tree.update(procs);
+
+    auto forest = tree.forest(List(), std::nullopt);
+    std::string json;
+    JsonWriter writer{json};
+    write_json(writer, forest[0]);
+    const auto document = to_json(forest[0]);
+
+    ASSERT_EQ(forest[0].descendant_count, static_cast<uint32_t>(depth - 1));
+    ASSERT_EQ(forest[0].subtree_mem_usage_kB, static_cast<uint64_t>(depth));
+    ASSERT_EQ(json.back(), '}');
+    ASSERT_EQ(document["children"][0]["pid"], 2);
+}
@@ -0,0 +1,212 @@
+#include <gtest/gtest.h>
+
+#include <api_server/data/datastore.h>
+#include <api_server/filesystem/capture.h>
+#include <api_server/filesystem/monitor.h>
+#include <api_server/filesystem/source.h>
+#include <api_server/logger.h>
+
+#include <filesystem>
+#include <fstream>
+#include <unistd.h>
+
+using namespace filesystem;
+namespace fs = std::filesystem;
+
+class CaptureTest : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        root = fs::temp_directory_path() / ("test_capture_" + std::to_string(getpid()));
+        fs::create_directories(root / "proc");
+        WriteFile(root / "proc" / "uptime", "100.50 200.00\n");
+        WriteFile(root / "proc" / "stat", "cpu  100 0 100 800 0 0 0 0 0 0\ncpu0 100 0 100 800 0 0 0 0 0 0\n");
+        WriteFile(root / "proc" / "meminfo", "MemTotal:       1000 kB\nMemAvailable:    250 kB\n");
+        config.proc_root = root / "proc";
+        config.cgroup_root = root / "cgroup";
+        capture_path = (root / "capture.gz").string();
+    }
+
+    void TearDown() override
+    {
+        fs::remove_all(root);
+    }
+
+    void WriteFile(const fs::path& path, const std::string& contents)
+    {
+        std::ofstream{path} << contents;
+    }
+
+    void WriteProc(const int32_t pid, const std::string& name, const uint32_t utime)
+    {
+        const auto dir = root / "proc" / std::to_string(pid);
+        fs::create_directories(dir);
+        WriteFile(dir / "status", "Name:\t" + name + "\nPid:\t" + std::to_string(pid) + "\nPPid:\t1\nVmRSS:\t100 kB\n");
+        WriteFile(dir / "stat", std::to_string(pid) + " (" + name + ") S 1 1 1 0 -1 0 0 0 0 0 " +
+                                    std::to_string(utime) + " 0 0 0 20 0 1 0 0 0 0\n");
+        WriteFile(dir / "cmdline", "/bin/" + name);
+    }
+
+    fs::path root;
+    std::string capture_path;
+    MonitorConfig config;
+    StdStreamLogger logger{LogLevel::Error};
+};
+
+// GIVEN a capture of two polls, including a file that didn't exist
+// WHEN it is read
+// THEN each poll is returned as written, followed by the end of the capture
+TEST_F(CaptureTest, RoundTrip) {
+    {
+        CaptureWriter writer{capture_path};
+        writer.begin_poll(std::chrono::nanoseconds{0});
+        writer.pids({1, 42});
+        writer.file("42/status", std::string{"Name:\tworker\n"});
+        writer.file("42/cmdline", std::string{"a\0b", 3u});
+        writer.file("43/status", std::nullopt);
+        writer.end_poll();
+        writer.begin_poll(std::chrono::seconds{1});
+        writer.pids({1});
+        writer.end_poll();
+    }
+
+    CaptureReader reader{capture_path};
+    const auto first = reader.next_poll();
+    ASSERT_TRUE(first.has_value());
+    ASSERT_EQ(first->time, std::chrono::nanoseconds{0});
+    ASSERT_EQ(first->pids, (std::vector<int32_t>{1, 42}));
+    ASSERT_EQ(first->files.size(), 3u);
+    ASSERT_EQ(first->files.at("42/status"), "Name:\tworker\n");
+    ASSERT_EQ(first->files.at("42/cmdline"), std::string("a\0b", 3u));
+    ASSERT_FALSE(first->files.at("43/status").has_value());
+    const auto second = reader.next_poll();
+    ASSERT_TRUE(second.has_value());
+    ASSERT_EQ(second->time, std::chrono::seconds{1});
+    ASSERT_EQ(second->pids, (std::vector<int32_t>{1}));
+    ASSERT_FALSE(reader.next_poll().has_value());
+}
+
+// GIVEN a capture whose last poll was cut short
+// WHEN it is read
+// THEN the complete polls are returned, then the end of the capture
+TEST_F(CaptureTest, TruncatedPoll) {
+    {
+        CaptureWriter writer{capture_path};
+        writer.begin_poll(std::chrono::nanoseconds{0});
+        writer.pids({1});
+        writer.end_poll();
+    }
+    {
+        // Appends a gzip member holding a poll without its end record, as if the server was killed mid-write
+        const auto file = gzopen(capture_path.c_str(), "ab");
+        const char partial[]{'P', 1, 0, 0, 0, 0, 0, 0, 0, 'L', 1};
+        gzwrite(file, partial, sizeof(partial));
+        gzclose(file);
+    }
+
+    CaptureReader reader{capture_path};
+    ASSERT_TRUE(reader.next_poll().has_value());
+    ASSERT_FALSE(reader.next_poll().has_value());
+}
+
+// GIVEN captures whose records claim more processes, or a longer file, than a capture can have
+// WHEN they are read
+// THEN they are rejected as corrupt rather than allocated for
+TEST_F(CaptureTest, OversizedRecord) {
+    const auto write_capture = [this](const std::string& records) {
+        const auto file = gzopen(capture_path.c_str(), "wb");
+        gzwrite(file, "PROCCAP1", 8u);
+        gzwrite(file, records.data(), static_cast<unsigned>(records.size()));
+        gzclose(file);
+    };
+    const std::string poll{'P', 0, 0, 0, 0, 0, 0, 0, 0};
+
+    write_capture(poll + std::string{'L', '\xff', '\xff', '\xff', '\xff'});
+    ASSERT_THROW(CaptureReader{capture_path}.next_poll(), std::runtime_error);
+    write_capture(poll + std::string{'F', '\xff', '\xff', '\xff', '\x7f'});
+    ASSERT_THROW(CaptureReader{capture_path}.next_poll(), std::runtime_error);
+}
+
+// GIVEN a capture being written to a device that is full
+// WHEN a poll ends
+// THEN the failure is reported once, and the later polls are no longer recorded
+TEST_F(CaptureTest, WriteFailure) {
+    CaptureWriter writer{"/dev/full"};
+    writer.begin_poll(std::chrono::nanoseconds{0});
+    writer.pids({1});
+
+    ASSERT_THROW(writer.end_poll(), std::runtime_error);
+    writer.begin_poll(std::chrono::seconds{1});
+    ASSERT_NO_THROW(writer.end_poll());
+}
+
+// GIVEN a file that isn't a capture
+// WHEN it is opened for replay
+// THEN an error is thrown
+TEST_F(CaptureTest, NotACapture) {
+    WriteFile(capture_path, "not a capture");
+
+    ASSERT_THROW(ReplayProcSource(capture_path, 0.0), std::runtime_error);
+    ASSERT_THROW(ReplayProcSource((root / "missing.gz").string(), 0.0), std::runtime_error);
+}
+
+// GIVEN two polls of a proc root recorded by a monitor, with a process exiting between them
+// WHEN another monitor replays the capture after the proc root has gone
+// THEN it stores the same snapshots as the recording monitor, then reports the end of the capture
+TEST_F(CaptureTest, RecordAndReplay) {
+    WriteProc(1, "init", 10);
+    WriteProc(42, "worker", 20);
+    data::DataStore recorded;
+    {
+        auto source = std::make_unique<RecordingProcSource>(std::make_unique<LiveProcSource>(config.proc_root),
+                                                            capture_path);
+        Monitor monitor{logger, recorded, config, std::move(source)};
+        monitor.check_filesystem_changes();
+        fs::remove_all(root / "proc" / "42");
+        WriteProc(1, "init", 30);
+        monitor.check_filesystem_changes();
+    }
+    fs::remove_all(root / "proc");
+
+    data::DataStore replayed;
+    auto source = std::make_unique<ReplayProcSource>(capture_path, 0.0);
+    ASSERT_EQ(source->poll_interval(std::chrono::seconds{1}), ProcSource::Clock::duration::zero());
+    Monitor monitor{logger, replayed, config, std::move(source)};
+    ASSERT_TRUE(monitor.check_filesystem_changes());
+    ASSERT_TRUE(replayed.get_proc_snapshot(42).has_value());
+    ASSERT_TRUE(monitor.check_filesystem_changes());
+    ASSERT_FALSE(monitor.check_filesystem_changes());
+
+    ASSERT_EQ(replayed.generation(), recorded.generation());
+    ASSERT_EQ(replayed.get_uptime().total_seconds, recorded.get_uptime().total_seconds);
+    ASSERT_EQ(replayed.get_mem_snapshot().total_memory_kB, recorded.get_mem_snapshot().total_memory_kB);
+    ASSERT_EQ(replayed.get_cpu_snapshots().size(), recorded.get_cpu_snapshots().size());
+    ASSERT_FALSE(replayed.get_proc_snapshot(42).has_value());
+    const auto expected = recorded.get_proc_snapshot(1);
+    const auto actual = replayed.get_proc_snapshot(1);
+    ASSERT_TRUE(actual.has_value());
+    ASSERT_EQ(actual->name, expected->name);
+    ASSERT_EQ(actual->utime, expected->utime);
+    ASSERT_EQ(actual->mem_usage_kB, expected->mem_usage_kB);
+    ASSERT_EQ(actual->command, expected->command);
+}
+
+// GIVEN a capture of polls a second apart
+// WHEN it is replayed at 4x speed
+// THEN the monitor waits a quarter of a second between polls
+TEST_F(CaptureTest, ReplaySpeed) {
+    {
+        CaptureWriter writer{capture_path};
+        writer.begin_poll(std::chrono::nanoseconds{0});
+        writer.end_poll();
+        writer.begin_poll(std::chrono::seconds{1});
+        writer.end_poll();
+    }
+
+    ReplayProcSource source{capture_path, 4.0};
+    ASSERT_EQ(source.poll_interval(std::chrono::seconds{1}), ProcSource::Clock::duration::zero());
+    ASSERT_TRUE(source.begin_poll());
+    ASSERT_EQ(source.poll_interval(std::chrono::seconds{1}), std::chrono::milliseconds{250});
+    ASSERT_TRUE(source.begin_poll());
+    ASSERT_FALSE(source.begin_poll());
+}
@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+
+#include <api_server/data/datastore.h>
+#include <api_server/filesystem/cgroups.h>
+#include <api_server/logger.h>
+
+#include <filesystem>
+#include <fstream>
+#include <unistd.h>
+
+using namespace filesystem;
+namespace fs = std::filesystem;
+
+class CgroupCollectorTest : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        root = fs::temp_directory_path() / ("test_cgroups_" + std::to_string(getpid()));
+        fs::create_directories(root / "system.slice" / "app.service");
+        WriteFile(root / "cgroup.controllers", "cpu memory");
+        WriteCgroup("/", 1000, 0);
+        WriteCgroup("/system.slice", 500, 4096);
+        WriteCgroup("/system.slice/app.service", 200, 2048);
+    }
+
+    void TearDown() override
+    {
+        fs::remove_all(root);
+    }
+
+    void WriteFile(const fs::path& path, const std::string& contents)
+    {
+        std::ofstream{path} << contents;
+    }
+
+    void WriteCgroup(const std::string& path, const uint64_t usage_usec, const uint64_t memory_bytes)
+    {
+        const auto dir = root / fs::path(path).relative_path();
+        WriteFile(dir / "cpu.stat", "usage_usec " + std::to_string(usage_usec) + "\nuser_usec 0\nsystem_usec 0\n");
+        if (memory_bytes > 0)
+        {
+            WriteFile(dir / "memory.current", std::to_string(memory_bytes));
+            WriteFile(dir / "memory.stat", "anon " + std::to_string(memory_bytes / 2) + "\nfile 1\n");
+        }
+    }
+
+    const data::CgroupSnapshot* Find(const std::vector<data::CgroupSnapshot>& snapshots, const std::string& path)
+    {
+        const auto iter = std::find_if(snapshots.cbegin(), snapshots.cend(),
+                                       [&path](const auto& snapshot) { return snapshot.path == path; });
+        return iter != snapshots.cend() ? &*iter : nullptr;
+    }
+
+    StdStreamLogger logger{LogLevel::Debug};
+    data::DataStore datastore;
+    fs::path root;
+};
+
+// GIVEN a cgroup v2 hierarchy
+// WHEN it is collected
+// THEN every cgroup is reported with its memory usage
+TEST_F(CgroupCollectorTest, WalksHierarchy) {
+    CgroupCollector collector{logger, datastore, root};
+    collector.collect({}, 1.0);
+
+    const auto snapshots = datastore.get_cgroup_snapshots();
+    ASSERT_EQ(snapshots.size(), 3u);
+    const auto* app = Find(snapshots, "/system.slice/app.service");
+    ASSERT_NE(app, nullptr);
+    ASSERT_EQ(app->mem_usage_bytes, 2048u);
+    ASSERT_EQ(app->mem_anon_bytes, 1024u);
+    ASSERT_EQ(app->mem_file_bytes, 1u);
+}
+
+// GIVEN a cgroup v2 hierarchy collected once
+// WHEN CPU usage has increased by the next collection
+// THEN CPU usage is calculated from the difference
+// AND processes are counted in their cgroup
+TEST_F(CgroupCollectorTest, CpuUsageDelta) {
+    CgroupCollector collector{logger, datastore, root};
+    collector.collect({}, 1.0);
+
+    const auto cpu_count = static_cast<uint64_t>(sysconf(_SC_NPROCESSORS_ONLN));
+    WriteCgroup("/system.slice/app.service", 200 + 500'000 * cpu_count, 2048); // Half of every CPU for 1 s
+    data::ProcSnapshot proc;
+    proc.cgroup = "/system.slice/app.service";
+    collector.collect({proc, proc}, 2.0);
+
+    const auto snapshots = datastore.get_cgroup_snapshots();
+    const auto* app = Find(snapshots, "/system.slice/app.service");
+    ASSERT_NE(app, nullptr);
+    ASSERT_NEAR(app->cpu_usage_percent, 50.0f, 0.01f);
+    ASSERT_EQ(app->proc_count, 2u);
+}
+
+// GIVEN no cgroup v2 hierarchy
+// WHEN it is collected
+// THEN no cgroups are reported
+TEST_F(CgroupCollectorTest, NoUnifiedHierarchy) {
+    fs::remove(root / "cgroup.controllers");
+    CgroupCollector collector{logger, datastore, root};
+    collector.collect({}, 1.0);
+
+    ASSERT_TRUE(datastore.get_cgroup_snapshots().empty());
+}
+
+// GIVEN a running process
+// WHEN its cgroup is requested
+// THEN the path of its cgroup in the unified hierarchy is returned (if the host has one)
+TEST_F(CgroupCollectorTest, ProcCgroup) {
+    CgroupCollector collector{logger, datastore, root};
+    const auto& cgroup = collector.proc_cgroup(getpid());
+    ASSERT_TRUE(cgroup.empty() || cgroup.front() == '/');
+}
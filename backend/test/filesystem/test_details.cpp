@@ -0,0 +1,56 @@
+#include <gtest/gtest.h>
+
+#include <api_server/filesystem/details.h>
+#include <api_server/logger.h>
+
+#include <future>
+#include <unistd.h>
+#include <vector>
+
+using namespace filesystem;
+
+class ProcDetailsCollectorTest : public ::testing::Test {
+protected:
+    StdStreamLogger logger{LogLevel::Debug};
+    ProcDetailsCollector collector{logger};
+};
+
+// GIVEN a running process
+// WHEN its details are requested
+// THEN status fields, thread count and open fds are collected
+TEST_F(ProcDetailsCollectorTest, CollectsOwnProcess) {
+    const auto details = collector.get(getpid());
+
+    ASSERT_TRUE(details.has_value());
+    ASSERT_EQ(details->pid, getpid());
+    ASSERT_GE(details->threads, 1u);
+    ASSERT_TRUE(details->fd_count.has_value());
+    ASSERT_GT(details->fd_count.value(), 0u);
+    ASSERT_EQ(details->status.count("Name"), 1u);
+}
+
+// GIVEN a PID that does not exist
+// WHEN its details are requested
+// THEN nothing is returned
+TEST_F(ProcDetailsCollectorTest, MissingProcess) {
+    ASSERT_FALSE(collector.get(-1).has_value());
+}
+
+// GIVEN concurrent requests for the same process
+// WHEN they arrive within the cache TTL
+// THEN they all receive the same collected details
+TEST_F(ProcDetailsCollectorTest, ConcurrentRequestsShareResult) {
+    std::vector<std::future<std::optional<data::ProcDetails>>> results;
+    for (int i = 0; i < 8; ++i)
+    {
+        results.push_back(std::async(std::launch::async, [this] { return collector.get(getpid()); }));
+    }
+    const auto first = results[0].get();
+    ASSERT_TRUE(first.has_value());
+    for (std::size_t i = 1; i < results.size(); ++i)
+    {
+        const auto details = results[i].get();
+        ASSERT_TRUE(details.has_value());
+        ASSERT_EQ(details->voluntary_ctxt_switches, first->voluntary_ctxt_switches);
+    }
+}
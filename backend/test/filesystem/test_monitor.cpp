@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+
+#include <api_server/data/datastore.h>
+#include <api_server/filesystem/monitor.h>
+#include <api_server/logger.h>
+
+#include <filesystem>
+#include <fstream>
+#include <unistd.h>
+
+using namespace filesystem;
+namespace fs = std::filesystem;
+
+class MonitorTest : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        root = fs::temp_directory_path() / ("test_monitor_" + std::to_string(getpid()));
+        fs::create_directories(root / "proc");
+        WriteFile(root / "proc" / "uptime", "100.50 200.00\n");
+        WriteFile(root / "proc" / "stat", "cpu  100 0 100 800 0 0 0 0 0 0\ncpu0 100 0 100 800 0 0 0 0 0 0\n"
+                                          "intr 1 0\n");
+        WriteFile(root / "proc" / "meminfo", "MemTotal:       1000 kB\nMemFree:         100 kB\n"
+                                             "MemAvailable:    250 kB\n");
+        config.proc_root = root / "proc";
+        config.cgroup_root = root / "cgroup";
+    }
+
+    void TearDown() override
+    {
+        fs::remove_all(root);
+    }
+
+    void WriteFile(const fs::path& path, const std::string& contents)
+    {
+        std::ofstream{path} << contents;
+    }
+
+    void WriteProc(const int32_t pid, const std::string& name, const uint32_t utime)
+    {
+        const auto dir = root / "proc" / std::to_string(pid);
+        fs::create_directories(dir);
+        WriteFile(dir / "status", "Name:\t" + name + "\nPid:\t" + std::to_string(pid) + "\nPPid:\t1\nVmRSS:\t100 kB\n");
+        WriteFile(dir / "stat", std::to_string(pid) + " (" + name + ") S 1 1 1 0 -1 0 0 0 0 0 " +
+                                    std::to_string(utime) + " 0 0 0 20 0 1 0 0 0 0\n");
+        WriteFile(dir / "cmdline", std::string{"/bin/"} + name + '\0' + "--flag" + '\0');
+    }
+
+    fs::path root;
+    MonitorConfig config;
+    StdStreamLogger logger{LogLevel::Error};
+    data::DataStore datastore;
+};
+
+// GIVEN a proc root other than /proc, with two processes
+// WHEN the monitor polls it
+// THEN the datastore has the system and processes of that root, published as a generation
+TEST_F(MonitorTest, ReadsProcRoot) {
+    WriteProc(1, "init", 10);
+    WriteProc(42, "worker", 20);
+    fs::create_directories(root / "proc" / "self");
+    Monitor monitor{logger, datastore, config};
+
+    ASSERT_EQ(monitor.discover_current_procs().size(), 2u);
+    monitor.check_filesystem_changes();
+
+    ASSERT_EQ(datastore.generation(), 1u);
+    ASSERT_EQ(datastore.get_uptime().total_seconds, 100.5);
+    ASSERT_EQ(datastore.get_mem_snapshot().total_memory_kB, 1000u);
+    ASSERT_EQ(datastore.get_mem_snapshot().free_memory_kB, 250u);
+    ASSERT_EQ(datastore.get_cpu_snapshots().size(), 2u);
+    const auto proc = datastore.get_proc_snapshot(42);
+    ASSERT_TRUE(proc.has_value());
+    ASSERT_EQ(proc->name, "worker");
+    ASSERT_EQ(proc->ppid, 1);
+    ASSERT_EQ(proc->mem_usage_kB, 100u);
+    ASSERT_EQ(proc->utime, 20u);
+    ASSERT_EQ(proc->command.rfind("/bin/worker", 0), 0u);
+}
+
+// GIVEN a process that exits between polls
+// WHEN the monitor polls again
+// THEN it is no longer in the datastore
+TEST_F(MonitorTest, RemovesExitedProcs) {
+    WriteProc(1, "init", 10);
+    WriteProc(42, "worker", 20);
+    Monitor monitor{logger, datastore, config};
+    monitor.check_filesystem_changes();
+
+    fs::remove_all(root / "proc" / "42");
+    monitor.check_filesystem_changes();
+
+    ASSERT_EQ(datastore.generation(), 2u);
+    ASSERT_FALSE(datastore.get_proc_snapshot(42).has_value());
+    ASSERT_TRUE(datastore.get_proc_snapshot(1).has_value());
+}
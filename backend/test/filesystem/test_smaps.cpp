@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+
+#include <api_server/filesystem/smaps.h>
+
+#include <sstream>
+
+using namespace filesystem;
+
+// GIVEN the contents of a smaps_rollup file
+// WHEN it is parsed
+// THEN PSS is read directly, USS is the sum of private pages and swap is read directly
+TEST(SmapsCollectorTest, ParseSmapsRollup) {
+    std::istringstream input{"560d5ea3f000-7ffe0e6d7000 ---p 00000000 00:00 0                          [rollup]\n"
+                             "Rss:                1300 kB\n"
+                             "Pss:                 458 kB\n"
+                             "Shared_Clean:       1148 kB\n"
+                             "Private_Clean:        52 kB\n"
+                             "Private_Dirty:       100 kB\n"
+                             "Private_Hugetlb:       0 kB\n"
+                             "Swap:                 12 kB\n"};
+
+    const auto sample = SmapsCollector::parse_smaps_rollup(input);
+
+    ASSERT_TRUE(sample.has_value());
+    ASSERT_EQ(sample->pss_kB, 458u);
+    ASSERT_EQ(sample->uss_kB, 152u);
+    ASSERT_EQ(sample->swap_kB, 12u);
+}
+
+// GIVEN an empty smaps_rollup file (e.g. a kernel thread)
+// WHEN it is parsed
+// THEN there is no sample
+TEST(SmapsCollectorTest, ParseEmptySmapsRollup) {
+    std::istringstream input{""};
+    ASSERT_FALSE(SmapsCollector::parse_smaps_rollup(input).has_value());
+}
+
+namespace
+{
+
+data::ProcSnapshot make_proc(const int32_t pid, const uint32_t mem_usage_kB)
+{
+    data::ProcSnapshot proc;
+    proc.pid = pid;
+    proc.mem_usage_kB = mem_usage_kB;
+    return proc;
+}
+
+} // namespace
+
+// GIVEN processes that have never been sampled, and a kernel thread
+// WHEN the visiting order is planned
+// THEN the largest RSS is visited first and the kernel thread is left out
+TEST(SmapsCollectorTest, PlanOrdersByRss) {
+    const std::vector procs{make_proc(1, 2000u), make_proc(2, 0u), make_proc(3, 8000u), make_proc(4, 500u)};
+    SmapsCollector::VisitTimes last_visited;
+
+    const auto queue = SmapsCollector::plan(procs, last_visited, SmapsCollector::Clock::now());
+
+    ASSERT_EQ(queue, (std::vector<int32_t>{4, 1, 3}));
+}
+
+// GIVEN a large process sampled a moment ago, a smaller one sampled long ago, and one that has exited
+// WHEN the visiting order is planned
+// THEN the stale process is visited first, and the exited process is forgotten
+TEST(SmapsCollectorTest, PlanWeightsByStaleness) {
+    using namespace std::chrono_literals;
+    const auto now = SmapsCollector::Clock::now();
+    const std::vector procs{make_proc(1, 8000u), make_proc(2, 1000u)};
+    SmapsCollector::VisitTimes last_visited{{1, now - 1s}, {2, now - 60s}, {3, now - 1s}};
+
+    const auto queue = SmapsCollector::plan(procs, last_visited, now);
+
+    ASSERT_EQ(queue, (std::vector<int32_t>{1, 2}));
+    ASSERT_EQ(last_visited.size(), 2u);
+    ASSERT_EQ(last_visited.count(3), 0u);
+}
+
+// GIVEN no time spent beyond previous budgets
+// WHEN a time slice is started
+// THEN it may spend its full share of the per-second budget
+TEST(SmapsCollectorTest, SliceAllowanceFullBudget) {
+    const SmapsCollector::Clock::duration slice_budget =
+        SmapsCollector::BUDGET_PER_SECOND * SmapsCollector::SLICE_INTERVAL.count() / 1000;
+    SmapsCollector::Clock::duration overrun{0};
+
+    ASSERT_EQ(SmapsCollector::slice_allowance(overrun), slice_budget);
+    ASSERT_EQ(overrun.count(), 0);
+}
+
+// GIVEN a previous read that overran by two and a half slice budgets
+// WHEN the following time slices are started
+// THEN the first two are skipped, and the third spends what is left of its budget
+TEST(SmapsCollectorTest, SliceAllowanceRepaysOverrun) {
+    const SmapsCollector::Clock::duration slice_budget =
+        SmapsCollector::BUDGET_PER_SECOND * SmapsCollector::SLICE_INTERVAL.count() / 1000;
+    SmapsCollector::Clock::duration overrun = slice_budget * 5 / 2;
+
+    ASSERT_EQ(SmapsCollector::slice_allowance(overrun).count(), 0);
+    ASSERT_EQ(SmapsCollector::slice_allowance(overrun).count(), 0);
+    ASSERT_EQ(SmapsCollector::slice_allowance(overrun), slice_budget / 2);
+    ASSERT_EQ(overrun.count(), 0);
+    ASSERT_EQ(SmapsCollector::slice_allowance(overrun), slice_budget);
+}
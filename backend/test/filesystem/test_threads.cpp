@@ -0,0 +1,109 @@
+#include <gtest/gtest.h>
+
+#include <api_server/data/datastore.h>
+#include <api_server/filesystem/parsers.h>
+#include <api_server/filesystem/threads.h>
+#include <api_server/logger.h>
+
+#include <future>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace filesystem;
+
+class ThreadCollectorTest : public ::testing::Test {
+protected:
+    void TearDown() override
+    {
+        stop.set_value();
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+    }
+
+    /// Starts threads that block until the test ends
+    void StartThreads(const std::size_t count)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            threads.emplace_back([stopped = stopped] { stopped.wait(); });
+        }
+    }
+
+    std::vector<data::ProcSnapshot> OwnProcess() const
+    {
+        data::ProcSnapshot snapshot;
+        snapshot.pid = getpid();
+        return {snapshot};
+    }
+
+    StdStreamLogger logger{LogLevel::Debug};
+    data::DataStore datastore;
+    std::promise<void> stop;
+    std::shared_future<void> stopped{stop.get_future().share()};
+    std::vector<std::thread> threads;
+};
+
+// GIVEN the threads of a process have not been requested
+// AND there is no CPU threshold
+// WHEN threads are collected
+// THEN no threads are read
+TEST_F(ThreadCollectorTest, NotRequested) {
+    ThreadCollector collector{logger, datastore, std::nullopt, 100};
+    collector.collect(OwnProcess(), 1.0);
+
+    ASSERT_FALSE(datastore.get_thread_snapshots(getpid()).has_value());
+}
+
+// GIVEN the threads of a process have been requested
+// WHEN threads are collected
+// THEN every thread of the process is reported
+TEST_F(ThreadCollectorTest, Requested) {
+    StartThreads(3);
+    datastore.request_thread_monitoring(getpid());
+    ThreadCollector collector{logger, datastore, std::nullopt, 100};
+    collector.collect(OwnProcess(), 1.0);
+
+    const auto snapshots = datastore.get_thread_snapshots(getpid());
+    ASSERT_TRUE(snapshots.has_value());
+    ASSERT_EQ(snapshots->thread_count, 4u);
+    ASSERT_EQ(snapshots->sampled_count, 4u);
+    ASSERT_EQ(snapshots->threads.size(), 4u);
+}
+
+// GIVEN a process above the CPU threshold with more threads than the per-process budget
+// WHEN threads are collected over consecutive polls
+// THEN each poll reads at most the budget
+// AND the polls cover every thread between them
+TEST_F(ThreadCollectorTest, BoundedWindow) {
+    StartThreads(ThreadCollector::MAX_THREADS_PER_PROC + 10);
+    auto procs = OwnProcess();
+    procs[0].cpu_usage_percent = 50.0f;
+    ThreadCollector collector{logger, datastore, 10.0f, 100};
+
+    collector.collect(procs, 1.0);
+    auto snapshots = datastore.get_thread_snapshots(getpid());
+    ASSERT_TRUE(snapshots.has_value());
+    ASSERT_EQ(snapshots->sampled_count, ThreadCollector::MAX_THREADS_PER_PROC);
+    ASSERT_EQ(snapshots->threads.size(), ThreadCollector::MAX_THREADS_PER_PROC);
+
+    collector.collect(procs, 2.0);
+    snapshots = datastore.get_thread_snapshots(getpid());
+    ASSERT_EQ(snapshots->sampled_count, ThreadCollector::MAX_THREADS_PER_PROC);
+    ASSERT_EQ(snapshots->threads.size(), snapshots->thread_count);
+}
+
+// GIVEN a stat line whose comm field contains spaces and parentheses
+// WHEN it is parsed
+// THEN the later columns are read from after the comm field
+TEST(ParseStatLineTest, CommWithSpaces) {
+    const auto fields = parse_stat_line("42 (Web (Content) 1) S 7 42 42 0 -1 4194560 100 0 0 0 1234 567 0 0 20 0");
+
+    ASSERT_TRUE(fields.has_value());
+    ASSERT_EQ(fields->comm, "Web (Content) 1");
+    ASSERT_EQ(fields->ppid, 7);
+    ASSERT_EQ(fields->utime, 1234u);
+    ASSERT_EQ(fields->stime, 567u);
+}
@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+
+#include <api_server/loadgen/load.h>
+
+#include <stdexcept>
+#include <vector>
+
+using namespace loadgen;
+using namespace std::chrono_literals;
+
+// GIVEN the latencies 1 to 1000 ms, shuffled
+// WHEN their percentiles are taken
+// THEN each is the smallest latency that at least that share of them is no greater than
+TEST(LoadTest, Percentiles) {
+    std::vector<uint64_t> values_ns;
+    for (uint64_t ms = 1000; ms > 0; --ms)
+        values_ns.push_back((ms * 7919 % 1000 + 1) * 1'000'000);
+
+    const auto result = percentiles(values_ns);
+
+    ASSERT_DOUBLE_EQ(result.p50_ms, 500.0);
+    ASSERT_DOUBLE_EQ(result.p90_ms, 900.0);
+    ASSERT_DOUBLE_EQ(result.p99_ms, 990.0);
+    ASSERT_DOUBLE_EQ(result.p999_ms, 999.0);
+    ASSERT_DOUBLE_EQ(result.max_ms, 1000.0);
+    ASSERT_DOUBLE_EQ(result.mean_ms, 500.5);
+}
+
+// GIVEN fewer measurements than a percentile can tell apart, or none
+// WHEN their percentiles are taken
+// THEN the high percentiles are the largest measurement, and without measurements they are all 0
+TEST(LoadTest, PercentilesOfFewValues) {
+    std::vector<uint64_t> values_ns{3'000'000, 1'000'000};
+    const auto result = percentiles(values_ns);
+    ASSERT_DOUBLE_EQ(result.p50_ms, 1.0);
+    ASSERT_DOUBLE_EQ(result.p999_ms, 3.0);
+    ASSERT_DOUBLE_EQ(result.mean_ms, 2.0);
+
+    std::vector<uint64_t> none;
+    ASSERT_DOUBLE_EQ(percentiles(none).max_ms, 0.0);
+}
+
+// GIVEN target arguments with and without weights
+// WHEN they are parsed
+// THEN the weight is only taken from a number before the first colon, and defaults to 1
+TEST(LoadTest, ParseTarget) {
+    const auto weighted = parse_target("4:/api/procs");
+    ASSERT_EQ(weighted.path, "/api/procs");
+    ASSERT_EQ(weighted.weight, 4u);
+
+    const auto unweighted = parse_target("/api/snapshot?limit=10");
+    ASSERT_EQ(unweighted.path, "/api/snapshot?limit=10");
+    ASSERT_EQ(unweighted.weight, 1u);
+
+    const auto colon_in_path = parse_target("/api/x:y");
+    ASSERT_EQ(colon_in_path.path, "/api/x:y");
+    ASSERT_EQ(colon_in_path.weight, 1u);
+}
+
+// GIVEN a weight of 0, or one too large to count
+// WHEN the target is parsed
+// THEN it is rejected
+TEST(LoadTest, ParseTargetInvalidWeight) {
+    ASSERT_THROW(parse_target("0:/api/procs"), std::runtime_error);
+    ASSERT_THROW(parse_target("99999999999:/api/procs"), std::runtime_error);
+}
+
+// GIVEN 4 connections sending 100 requests per second in total
+// WHEN their schedules start
+// THEN each sends every 40 ms, staggered 10 ms apart
+TEST(LoadTest, OpenLoopScheduleStaggered) {
+    const auto start = Clock::now();
+    for (std::size_t index = 0; index < 4u; ++index)
+    {
+        Schedule schedule{100.0, 4u, index, start};
+        ASSERT_EQ(schedule.due(start), start + 10ms * index);
+        schedule.next();
+        ASSERT_EQ(schedule.due(start), start + 40ms + 10ms * index);
+    }
+}
+
+// GIVEN a connection sending every 100 ms, whose first response takes 350 ms
+// WHEN it moves on to the next requests
+// THEN they stay due on the schedule, so the time they waited behind the slow response counts in their latency
+TEST(LoadTest, OpenLoopScheduleCorrectsCoordinatedOmission) {
+    const auto start = Clock::now();
+    Schedule schedule{10.0, 1u, 0u, start};
+    ASSERT_EQ(schedule.due(start), start);
+
+    const auto response = start + 350ms;
+    schedule.next();
+    ASSERT_EQ(schedule.due(response), start + 100ms);
+    schedule.next();
+    ASSERT_EQ(schedule.due(response), start + 200ms);
+    schedule.next_after_failure(response);
+    ASSERT_EQ(schedule.due(response), start + 300ms);
+    schedule.next();
+    ASSERT_EQ(schedule.due(response), start + 400ms);
+}
+
+// GIVEN a closed-loop connection
+// WHEN it moves on after a response, and after a failure
+// THEN the next request is due once the connection is free, or after the retry delay
+TEST(LoadTest, ClosedLoopSchedule) {
+    const auto start = Clock::now();
+    Schedule schedule{0.0, 4u, 3u, start};
+    ASSERT_EQ(schedule.due(start), start);
+
+    schedule.next();
+    ASSERT_EQ(schedule.due(start + 350ms), start + 350ms);
+    schedule.next_after_failure(start + 400ms);
+    ASSERT_EQ(schedule.due(start + 400ms), start + 400ms + Schedule::RETRY_DELAY);
+}
@@ -0,0 +1,65 @@
+#include <gtest/gtest.h>
+
+#include <api_server/metrics/histogram.h>
+
+#include <thread>
+#include <vector>
+
+using namespace metrics;
+
+// GIVEN values across the histogram's range
+// WHEN their buckets are found
+// THEN each value is within its bucket's bounds, which are no wider than 1/8 of the value
+TEST(HistogramTest, BucketBounds) {
+    for (uint64_t value = 0; value < (uint64_t{1} << 35); value = value * 17 / 16 + 1)
+    {
+        const auto bucket = HistogramSnapshot::bucket(value);
+        ASSERT_LT(bucket, HistogramSnapshot::BUCKETS);
+        ASSERT_LE(HistogramSnapshot::bucket_lower_bound(bucket), value);
+        ASSERT_GE(HistogramSnapshot::bucket_upper_bound(bucket), value);
+        ASSERT_LE(HistogramSnapshot::bucket_upper_bound(bucket) - HistogramSnapshot::bucket_lower_bound(bucket),
+                  value / 8);
+    }
+    ASSERT_EQ(HistogramSnapshot::bucket(UINT64_MAX), HistogramSnapshot::BUCKETS - 1);
+}
+
+// GIVEN a histogram of the values 1 to 1000 microseconds
+// WHEN quantiles are taken
+// THEN they are within the histogram's resolution of the exact quantiles
+TEST(HistogramTest, Quantiles) {
+    Histogram histogram;
+    for (int value = 1; value <= 1000; ++value)
+        histogram.record(std::chrono::microseconds{value});
+
+    const auto snapshot = histogram.snapshot();
+    ASSERT_EQ(snapshot.count, 1000u);
+    ASSERT_EQ(snapshot.sum, 500500000u);
+    ASSERT_NEAR(static_cast<double>(snapshot.value_at_quantile(0.5)), 500000.0, 500000.0 / 8);
+    ASSERT_NEAR(static_cast<double>(snapshot.value_at_quantile(0.99)), 990000.0, 990000.0 / 8);
+    ASSERT_EQ(snapshot.count_at_most(0u), 0u);
+    ASSERT_EQ(snapshot.count_at_most(UINT64_MAX), 1000u);
+}
+
+// GIVEN several threads recording into one histogram
+// WHEN they have finished
+// THEN every value is counted
+TEST(HistogramTest, ConcurrentRecording) {
+    constexpr int THREADS = 20;
+    constexpr int VALUES = 10000;
+    Histogram histogram;
+
+    std::vector<std::thread> threads;
+    for (int thread = 0; thread < THREADS; ++thread)
+    {
+        threads.emplace_back([&histogram]() {
+            for (int value = 0; value < VALUES; ++value)
+                histogram.record(static_cast<uint64_t>(value));
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    const auto snapshot = histogram.snapshot();
+    ASSERT_EQ(snapshot.count, uint64_t{THREADS} * VALUES);
+    ASSERT_EQ(snapshot.sum, uint64_t{THREADS} * VALUES * (VALUES - 1) / 2);
+}
@@ -0,0 +1,43 @@
+#include <gtest/gtest.h>
+
+#include <api_server/metrics/prometheus.h>
+
+using namespace metrics;
+
+// GIVEN a metric family with labelled samples
+// WHEN it is written
+// THEN it is in the text exposition format, with label values escaped
+TEST(PrometheusWriterTest, Samples) {
+    std::string out;
+    PrometheusWriter writer{out};
+    writer.family("requests_total", "counter", "Requests served");
+    writer.sample("requests_total", {}, 3);
+    writer.sample("requests_total", {{"path", "/a\"b\\c\nd"}, {"code", "200"}}, 1.5);
+
+    ASSERT_EQ(out, "# HELP requests_total Requests served\n"
+                   "# TYPE requests_total counter\n"
+                   "requests_total 3\n"
+                   "requests_total{path=\"/a\\\"b\\\\c\\nd\",code=\"200\"} 1.5\n");
+}
+
+// GIVEN a histogram of durations
+// WHEN it is written
+// THEN the buckets are cumulative in seconds, ending with +Inf, followed by the sum and count
+TEST(PrometheusWriterTest, DurationHistogram) {
+    Histogram histogram;
+    histogram.record(std::chrono::microseconds{50});
+    histogram.record(std::chrono::milliseconds{3});
+    histogram.record(std::chrono::seconds{20});
+
+    std::string out;
+    PrometheusWriter writer{out};
+    writer.duration_histogram("latency_seconds", {{"route", "/"}}, histogram.snapshot());
+
+    ASSERT_NE(out.find("latency_seconds_bucket{route=\"/\",le=\"0.0001\"} 1\n"), std::string::npos);
+    ASSERT_NE(out.find("latency_seconds_bucket{route=\"/\",le=\"0.0025\"} 1\n"), std::string::npos);
+    ASSERT_NE(out.find("latency_seconds_bucket{route=\"/\",le=\"0.005\"} 2\n"), std::string::npos);
+    ASSERT_NE(out.find("latency_seconds_bucket{route=\"/\",le=\"10\"} 2\n"), std::string::npos);
+    ASSERT_NE(out.find("latency_seconds_bucket{route=\"/\",le=\"+Inf\"} 3\n"), std::string::npos);
+    ASSERT_NE(out.find("latency_seconds_sum{route=\"/\"} 20.00305\n"), std::string::npos);
+    ASSERT_NE(out.find("latency_seconds_count{route=\"/\"} 3\n"), std::string::npos);
+}
@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+
+#include <api_server/metrics/trace.h>
+
+#include <nlohmann/json.hpp>
+#include <thread>
+
+using namespace metrics;
+using namespace std::chrono_literals;
+
+class FlightRecorderTest : public ::testing::Test {
+protected:
+    const TraceSpan::Clock::time_point start{TraceSpan::Clock::now()};
+};
+
+// GIVEN a flight recorder that has recorded more spans than it holds
+// WHEN its spans are read
+// THEN the oldest have been overwritten and the rest are in the order they were recorded
+TEST_F(FlightRecorderTest, KeepsMostRecentSpans) {
+    FlightRecorder recorder{3u};
+    for (uint64_t generation = 1; generation <= 5; ++generation)
+        recorder.record("poll", "poll", start, start + 1ms, generation);
+
+    const auto spans = recorder.spans();
+    ASSERT_EQ(spans.size(), 3u);
+    ASSERT_EQ(spans[0].generation, 3u);
+    ASSERT_EQ(spans[1].generation, 4u);
+    ASSERT_EQ(spans[2].generation, 5u);
+}
+
+// GIVEN a flight recorder with a slow threshold
+// WHEN durations are compared to it
+// THEN only those at least as long are slow
+TEST_F(FlightRecorderTest, SlowThreshold) {
+    FlightRecorder recorder{16u, 10ms};
+    ASSERT_FALSE(recorder.is_slow(9ms));
+    ASSERT_TRUE(recorder.is_slow(10ms));
+
+    recorder.set_slow_threshold(1s);
+    ASSERT_FALSE(recorder.is_slow(10ms));
+}
+
+// GIVEN a span with a detail longer than a span holds
+// WHEN it is recorded
+// THEN the detail is truncated
+TEST_F(FlightRecorderTest, TruncatesDetail) {
+    FlightRecorder recorder;
+    recorder.record("read", "slow read", start, start + 1s, 1u, 7, std::string(100, 'x'));
+
+    const auto spans = recorder.spans();
+    ASSERT_EQ(spans.size(), 1u);
+    ASSERT_EQ(std::string{spans[0].detail.data()}, std::string(63, 'x'));
+    ASSERT_EQ(spans[0].pid, 7);
+}
+
+// GIVEN spans recorded on two threads
+// WHEN they are written as a Chrome trace
+// THEN each is a complete event in microseconds, on the thread that recorded it
+TEST_F(FlightRecorderTest, ChromeTrace) {
+    FlightRecorder recorder;
+    recorder.record("poll", "discovery", start, start + 1500us, 4u);
+    std::thread{[&]() { recorder.record("lock", "proc_snapshots", start + 1ms, start + 2ms, 4u); }}.join();
+
+    std::string out;
+    recorder.write_chrome_trace(out);
+
+    const auto events = nlohmann::json::parse(out).at("traceEvents");
+    ASSERT_EQ(events.size(), 2u);
+    ASSERT_EQ(events[0]["name"], "discovery");
+    ASSERT_EQ(events[0]["cat"], "poll");
+    ASSERT_EQ(events[0]["ph"], "X");
+    ASSERT_EQ(events[0]["dur"], 1500.0);
+    ASSERT_EQ(events[0]["args"], nlohmann::json({{"generation", 4}}));
+    ASSERT_EQ(events[1]["ts"].get<double>() - events[0]["ts"].get<double>(), 1000.0);
+    ASSERT_EQ(events[0]["pid"], events[1]["pid"]);
+    ASSERT_NE(events[0]["tid"], events[1]["tid"]);
+}
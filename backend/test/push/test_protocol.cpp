@@ -0,0 +1,197 @@
+#include <gtest/gtest.h>
+
+#include <api_server/push/protocol.h>
+
+#include <limits>
+
+using namespace push;
+
+class ProtocolTest : public ::testing::Test {
+protected:
+    static data::ProcSnapshot MakeProc(const int32_t pid, const std::string& command, const float cpu)
+    {
+        data::ProcSnapshot proc;
+        proc.pid = pid;
+        proc.ppid = 1;
+        proc.name = "proc" + std::to_string(pid);
+        proc.command = command;
+        proc.cgroup = "/system.slice/test.service";
+        proc.cpu_usage_percent = cpu;
+        proc.mem_usage_percent = 1.5f;
+        proc.mem_usage_kB = 2048u;
+        proc.utime = 100u;
+        proc.stime = 20u;
+        return proc;
+    }
+
+    static std::shared_ptr<const data::Snapshot> MakeSnapshot(const uint64_t generation,
+                                                              std::vector<data::ProcSnapshot> procs)
+    {
+        auto snapshot = std::make_shared<data::Snapshot>();
+        snapshot->generation = generation;
+        snapshot->uptime = data::Uptime{1u, 2u, 5u, 3725.5, "01:02:05"};
+        snapshot->cpus = std::vector<data::CpuSnapshot>{{"cpu", 0u, 0u, 0u, 25.0f}, {"cpu0", 0u, 0u, 0u, 50.0f}};
+        snapshot->mem = data::MemSnapshot{1000u, 250u, 75.0f};
+        snapshot->procs = std::make_shared<const std::vector<data::ProcSnapshot>>(std::move(procs));
+        return snapshot;
+    }
+
+    /// @brief Applies an encoded frame, which starts with its size
+    static std::optional<data::Snapshot> Apply(FrameDecoder& decoder, const std::string& frame)
+    {
+        uint32_t size{0u};
+        for (std::size_t i = 0u; i < FRAME_HEADER_SIZE; ++i)
+            size |= static_cast<uint32_t>(static_cast<uint8_t>(frame[i])) << (8u * i);
+        EXPECT_EQ(size, frame.size() - FRAME_HEADER_SIZE);
+        return decoder.apply(std::string_view{frame}.substr(FRAME_HEADER_SIZE));
+    }
+
+    static void ExpectProcsEqual(const data::Snapshot& decoded, const data::Snapshot& expected)
+    {
+        const auto& procs = *decoded.procs.value();
+        const auto& expected_procs = *expected.procs.value();
+        ASSERT_EQ(procs.size(), expected_procs.size());
+        for (std::size_t i = 0u; i < procs.size(); ++i)
+        {
+            EXPECT_EQ(procs[i].pid, expected_procs[i].pid);
+            EXPECT_EQ(procs[i].name, expected_procs[i].name);
+            EXPECT_EQ(procs[i].command, expected_procs[i].command);
+            EXPECT_EQ(procs[i].cgroup, expected_procs[i].cgroup);
+            EXPECT_FLOAT_EQ(procs[i].cpu_usage_percent, expected_procs[i].cpu_usage_percent);
+            EXPECT_EQ(procs[i].utime, expected_procs[i].utime);
+            EXPECT_EQ(procs[i].smaps.has_value(), expected_procs[i].smaps.has_value());
+        }
+    }
+
+    FrameEncoder encoder;
+    FrameDecoder decoder;
+};
+
+// GIVEN a Hello frame and a snapshot encoded in full
+// WHEN they are decoded
+// THEN the node and every dataset of the snapshot are reconstructed
+TEST_F(ProtocolTest, FullFrame) {
+    auto proc = MakeProc(42, "/usr/bin/worker --threads 4", 12.5f);
+    proc.smaps = data::SmapsSample{3720.0, 300u, 200u, 10u};
+    const auto snapshot = MakeSnapshot(7u, {MakeProc(1, "/sbin/init", 0.5f), proc});
+
+    ASSERT_FALSE(Apply(decoder, FrameEncoder::hello("web-1")).has_value());
+    const auto decoded = Apply(decoder, encoder.encode(snapshot, true));
+
+    ASSERT_EQ(decoder.node(), "web-1");
+    ASSERT_EQ(decoder.last_type(), FrameType::Full);
+    ASSERT_TRUE(decoded.has_value());
+    ASSERT_EQ(decoded->generation, 7u);
+    ASSERT_DOUBLE_EQ(decoded->uptime->total_seconds, 3725.5);
+    ASSERT_EQ(decoded->uptime->hours, 1u);
+    ASSERT_EQ(decoded->uptime->minutes, 2u);
+    ASSERT_EQ(decoded->uptime->seconds, 5u);
+    ASSERT_EQ(decoded->cpus->size(), 2u);
+    ASSERT_EQ(decoded->cpus->at(1).id, "cpu0");
+    ASSERT_FLOAT_EQ(decoded->cpus->at(1).usage_percent, 50.0f);
+    ASSERT_EQ(decoded->mem->free_memory_kB, 250u);
+    ExpectProcsEqual(decoded.value(), *snapshot);
+    const auto& worker = decoded->procs.value()->at(1);
+    ASSERT_DOUBLE_EQ(worker.snapshot_time, 3725.5);
+    ASSERT_EQ(worker.smaps->pss_kB, 300u);
+    ASSERT_DOUBLE_EQ(worker.smaps->sample_time, 3720.0);
+}
+
+// GIVEN processes sharing a command and a cgroup
+// WHEN they are encoded
+// THEN each string is sent once
+TEST_F(ProtocolTest, StringsInterned) {
+    const std::string command{"/usr/lib/postgresql/15/bin/postgres -D /var/lib/postgresql/15/main"};
+    const auto frame = encoder.encode(MakeSnapshot(1u, {MakeProc(10, command, 1.0f), MakeProc(11, command, 2.0f),
+                                                        MakeProc(12, command, 3.0f)}),
+                                      true);
+
+    Apply(decoder, FrameEncoder::hello("node"));
+
+    ASSERT_EQ(frame.find(command), frame.rfind(command));
+    ASSERT_EQ(frame.find("/system.slice/test.service"), frame.rfind("/system.slice/test.service"));
+    ASSERT_EQ(Apply(decoder, frame)->procs.value()->at(2).command, command);
+}
+
+// GIVEN a generation after one already sent, in which processes started, exited, changed and stayed the same
+// WHEN it is encoded as a delta
+// THEN only the started and changed processes are sent, and decoding it reconstructs the whole generation
+TEST_F(ProtocolTest, DeltaFrame) {
+    const std::string command{"/usr/bin/unchanged-daemon --config /etc/unchanged-daemon.conf"};
+    const auto base = MakeSnapshot(1u, {MakeProc(1, "/sbin/init", 0.5f), MakeProc(2, command, 1.0f),
+                                        MakeProc(3, "exiting", 5.0f)});
+    auto changed = MakeProc(1, "/sbin/init", 0.75f);
+    changed.utime = 101u;
+    const auto next = MakeSnapshot(2u, {changed, MakeProc(2, command, 1.0f), MakeProc(4, "/usr/bin/new", 9.0f)});
+    Apply(decoder, FrameEncoder::hello("node"));
+    Apply(decoder, encoder.encode(base, true));
+
+    const auto delta = encoder.encode(next, false);
+    const auto decoded = Apply(decoder, delta);
+
+    ASSERT_EQ(decoder.last_type(), FrameType::Delta);
+    ASSERT_EQ(delta.find(command), std::string::npos);
+    FrameEncoder full_encoder;
+    ASSERT_LT(delta.size(), full_encoder.encode(next, true).size());
+    ASSERT_EQ(decoded->generation, 2u);
+    ExpectProcsEqual(decoded.value(), *next);
+    ASSERT_FLOAT_EQ(decoded->procs.value()->at(0).cpu_usage_percent, 0.75f);
+}
+
+// GIVEN a connection on which deltas followed a full frame
+// WHEN another full frame is sent
+// THEN it starts a new string table, which the deltas after it use
+TEST_F(ProtocolTest, FullFrameResetsStrings) {
+    Apply(decoder, FrameEncoder::hello("node"));
+    Apply(decoder, encoder.encode(MakeSnapshot(1u, {MakeProc(1, "first", 1.0f)}), true));
+    Apply(decoder, encoder.encode(MakeSnapshot(2u, {MakeProc(1, "first", 1.0f), MakeProc(2, "second", 1.0f)}), false));
+
+    const auto full = encoder.encode(MakeSnapshot(3u, {MakeProc(2, "second", 1.0f)}), true);
+    Apply(decoder, full);
+    const auto decoded = Apply(decoder, encoder.encode(MakeSnapshot(4u, {MakeProc(2, "second", 2.0f),
+                                                                           MakeProc(3, "third", 1.0f)}),
+                                                       false));
+
+    ASSERT_EQ(full.find("first"), std::string::npos);
+    ASSERT_NE(full.find("second"), std::string::npos);
+    ASSERT_EQ(decoded->procs.value()->size(), 2u);
+    ASSERT_EQ(decoded->procs.value()->at(0).command, "second");
+    ASSERT_EQ(decoded->procs.value()->at(1).command, "third");
+}
+
+// GIVEN frames that are truncated, of another version, before the Hello frame, with an impossible uptime, or deltas
+//       against a generation the receiver doesn't have
+// WHEN they are decoded
+// THEN they are rejected
+TEST_F(ProtocolTest, MalformedFrames) {
+    const auto full = encoder.encode(MakeSnapshot(1u, {MakeProc(1, "init", 1.0f)}), true);
+    const auto delta = encoder.encode(MakeSnapshot(2u, {MakeProc(1, "init", 2.0f)}), false);
+
+    FrameDecoder ungreeted;
+    ASSERT_THROW(Apply(ungreeted, full), std::runtime_error);
+    FrameDecoder truncated;
+    Apply(truncated, FrameEncoder::hello("node"));
+    ASSERT_THROW(truncated.apply(std::string_view{full}.substr(FRAME_HEADER_SIZE, full.size() - 5u)),
+                 std::runtime_error);
+    FrameDecoder without_base;
+    Apply(without_base, FrameEncoder::hello("node"));
+    ASSERT_THROW(Apply(without_base, delta), std::runtime_error);
+    auto hello = FrameEncoder::hello("node");
+    hello[FRAME_HEADER_SIZE + 1u + MAGIC.size()] = 2;
+    ASSERT_THROW(Apply(decoder, hello), std::runtime_error);
+    Apply(decoder, FrameEncoder::hello("node"));
+    auto unknown_type = full;
+    unknown_type[FRAME_HEADER_SIZE] = 9;
+    ASSERT_THROW(Apply(decoder, unknown_type), std::runtime_error);
+    for (const auto uptime : {std::numeric_limits<double>::quiet_NaN(), std::numeric_limits<double>::infinity(), -1.0,
+                              1e12})
+    {
+        auto snapshot = std::const_pointer_cast<data::Snapshot>(MakeSnapshot(1u, {}));
+        snapshot->uptime->total_seconds = uptime;
+        ASSERT_THROW(Apply(decoder, FrameEncoder{}.encode(snapshot, true)), std::runtime_error) << uptime;
+    }
+
+    ASSERT_TRUE(Apply(decoder, full).has_value());
+    ASSERT_TRUE(Apply(decoder, delta).has_value());
+    ASSERT_THROW(Apply(decoder, delta), std::runtime_error);
+}
@@ -0,0 +1,254 @@
+#include <gtest/gtest.h>
+
+#include <api_server/data/datastore.h>
+#include <api_server/logger.h>
+#include <api_server/push/agent.h>
+#include <api_server/push/receiver.h>
+
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+#include <mutex>
+#include <thread>
+
+using namespace push;
+
+/// @brief A generation received by a Collector
+struct Received
+{
+    std::string node;
+    FrameType type;
+    data::Snapshot snapshot;
+    std::size_t frame_size;
+};
+
+/// @brief A PushReceiver on a thread of its own, keeping the generations it receives
+struct Collector
+{
+    explicit Collector(const uint16_t port = 0u,
+                       const std::chrono::milliseconds read_timeout = PushReceiver::DEFAULT_READ_TIMEOUT)
+        : receiver{logger, "127.0.0.1", port, handler(), read_timeout}
+    {
+        thread = std::thread{[this] { receiver.start(); }};
+    }
+
+    ~Collector()
+    {
+        receiver.stop();
+        thread.join();
+    }
+
+    PushReceiver::Handler handler()
+    {
+        return [this](const std::string& node, const data::Snapshot& snapshot, const FrameType type,
+                      const std::size_t frame_size) {
+            const std::unique_lock lock{mutex};
+            received.push_back({node, type, snapshot, frame_size});
+        };
+    }
+
+    std::vector<Received> Frames()
+    {
+        const std::unique_lock lock{mutex};
+        return received;
+    }
+
+    StdStreamLogger logger{LogLevel::Error};
+    PushReceiver receiver;
+    std::thread thread;
+    std::mutex mutex;
+    std::vector<Received> received;
+};
+
+/// @brief A PushAgent on a thread of its own
+struct RunningAgent
+{
+    RunningAgent(const Logger& logger, data::DataStore& datastore, PushConfig config)
+        : agent{logger, datastore, std::move(config)}
+    {
+    }
+
+    ~RunningAgent()
+    {
+        agent.stop();
+        if (thread.joinable())
+            thread.join();
+    }
+
+    void Start()
+    {
+        thread = std::thread{[this] { agent.start(); }};
+    }
+
+    PushAgent agent;
+    std::thread thread;
+};
+
+class PushTest : public ::testing::Test {
+protected:
+    /// @brief Publishes a generation of processes 1 to `count`, whose CPU usage is the generation
+    void Publish(const int32_t count)
+    {
+        std::vector<data::ProcSnapshot> procs;
+        for (int32_t pid = 1; pid <= count; ++pid)
+        {
+            data::ProcSnapshot proc;
+            proc.pid = pid;
+            proc.name = "proc" + std::to_string(pid);
+            proc.command = "/usr/bin/proc" + std::to_string(pid);
+            proc.cpu_usage_percent = static_cast<float>(datastore.generation() + 1u);
+            procs.push_back(proc);
+        }
+        datastore.store_proc_snapshots(procs);
+        datastore.publish_generation();
+    }
+
+    /// @brief Returns once the predicate holds, or fails the test after a few seconds
+    static void WaitFor(const std::function<bool()>& predicate)
+    {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{5};
+        while (!predicate() && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds{5});
+        ASSERT_TRUE(predicate());
+    }
+
+    PushConfig Config(const uint16_t port) const
+    {
+        PushConfig config;
+        config.host = "127.0.0.1";
+        config.port = std::to_string(port);
+        config.node = "node-1";
+        config.min_backoff = std::chrono::milliseconds{10};
+        config.max_backoff = std::chrono::milliseconds{50};
+        return config;
+    }
+
+    StdStreamLogger logger{LogLevel::Error};
+    data::DataStore datastore;
+};
+
+// GIVEN an agent connected to a collector
+// WHEN generations are published
+// THEN each is pushed, in full every full_interval generations and as deltas in between
+TEST_F(PushTest, PushGenerations) {
+    Collector collector;
+    auto config = Config(collector.receiver.port());
+    config.full_interval = 2u;
+    RunningAgent running{logger, datastore, config};
+    running.Start();
+    WaitFor([&running] { return running.agent.stats().connections == 1u; });
+
+    for (std::size_t i = 1u; i <= 5u; ++i)
+    {
+        Publish(static_cast<int32_t>(i) + 2);
+        WaitFor([&collector, i] { return collector.Frames().size() == i; });
+    }
+
+    const auto frames = collector.Frames();
+    const std::vector<FrameType> types{FrameType::Full, FrameType::Delta, FrameType::Delta, FrameType::Full,
+                                       FrameType::Delta};
+    for (std::size_t i = 0u; i < frames.size(); ++i)
+    {
+        EXPECT_EQ(frames[i].node, "node-1");
+        EXPECT_EQ(frames[i].type, types[i]) << i;
+        EXPECT_EQ(frames[i].snapshot.generation, i + 1u);
+    }
+    const auto& last = *frames.back().snapshot.procs.value();
+    ASSERT_EQ(last.size(), 7u);
+    ASSERT_EQ(last[6].command, "/usr/bin/proc7");
+    ASSERT_FLOAT_EQ(last[0].cpu_usage_percent, 5.0f);
+    // The agent counts a frame once its write completes, which may be after the collector has read it
+    WaitFor([&running] { return running.agent.stats().frames_sent == 5u; });
+    const auto stats = running.agent.stats();
+    ASSERT_EQ(stats.frames_sent, 5u);
+    ASSERT_EQ(stats.full_frames, 2u);
+    ASSERT_EQ(stats.dropped_generations, 0u);
+}
+
+// GIVEN an agent that hasn't connected yet
+// WHEN more generations are published than its queue holds
+// THEN the oldest are dropped, and once connected it sends only the latest, in full
+TEST_F(PushTest, DropStaleGenerations) {
+    Collector collector;
+    auto config = Config(collector.receiver.port());
+    config.queue_capacity = 4u;
+    RunningAgent running{logger, datastore, config};
+
+    for (int i = 0; i < 10; ++i)
+        Publish(3);
+    ASSERT_EQ(running.agent.stats().dropped_generations, 6u);
+    running.Start();
+    WaitFor([&collector] { return collector.Frames().size() == 1u; });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds{50});
+    const auto frames = collector.Frames();
+    ASSERT_EQ(frames.size(), 1u);
+    ASSERT_EQ(frames[0].type, FrameType::Full);
+    ASSERT_EQ(frames[0].snapshot.generation, 10u);
+    ASSERT_EQ(running.agent.stats().dropped_generations, 9u);
+}
+
+// GIVEN an agent whose collector restarts
+// WHEN it is reachable again
+// THEN the agent reconnects and starts again from the latest generation in full
+TEST_F(PushTest, Reconnect) {
+    auto collector = std::make_unique<Collector>();
+    const auto port = collector->receiver.port();
+    RunningAgent running{logger, datastore, Config(port)};
+    running.Start();
+    Publish(3);
+    WaitFor([&collector] { return collector->Frames().size() == 1u; });
+
+    collector.reset();
+    Publish(4);
+    Publish(5);
+    collector = std::make_unique<Collector>(port);
+    WaitFor([&collector] { return !collector->Frames().empty(); });
+
+    const auto frames = collector->Frames();
+    ASSERT_EQ(frames[0].type, FrameType::Full);
+    ASSERT_EQ(frames[0].node, "node-1");
+    ASSERT_EQ(frames[0].snapshot.generation, 3u);
+    ASSERT_EQ(frames[0].snapshot.procs.value()->size(), 5u);
+    ASSERT_EQ(running.agent.stats().connections, 2u);
+}
+
+// GIVEN a peer that announces a frame of the largest size allowed
+// WHEN it then sends a few bytes of it and stalls
+// THEN the collector closes the connection after its read timeout, without having received a frame
+TEST_F(PushTest, StalledPeerClosed) {
+    Collector collector{0u, std::chrono::milliseconds{100}};
+    boost::asio::io_context context;
+    boost::asio::ip::tcp::socket peer{context};
+    peer.connect({boost::asio::ip::make_address("127.0.0.1"), collector.receiver.port()});
+    const uint32_t size{MAX_FRAME_SIZE};
+    char header[FRAME_HEADER_SIZE];
+    for (std::size_t i = 0u; i < FRAME_HEADER_SIZE; ++i)
+        header[i] = static_cast<char>((size >> (8u * i)) & 0xffu);
+    boost::asio::write(peer, boost::asio::buffer(header));
+    boost::asio::write(peer, boost::asio::buffer(std::string(16u, 'x')));
+
+    const auto start = std::chrono::steady_clock::now();
+    char byte;
+    boost::system::error_code error;
+    boost::asio::read(peer, boost::asio::buffer(&byte, 1u), error);
+
+    ASSERT_EQ(error, boost::asio::error::eof);
+    ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds{5});
+    ASSERT_TRUE(collector.Frames().empty());
+}
+
+// GIVEN a frame larger than the collector reads at once
+// WHEN it is pushed
+// THEN it is received whole
+TEST_F(PushTest, LargeFrame) {
+    Collector collector;
+    RunningAgent running{logger, datastore, Config(collector.receiver.port())};
+    running.Start();
+    Publish(5000);
+    WaitFor([&collector] { return collector.Frames().size() == 1u; });
+
+    const auto frames = collector.Frames();
+    ASSERT_GT(frames[0].frame_size, PushReceiver::FRAME_READ_SIZE);
+    ASSERT_EQ(frames[0].snapshot.procs.value()->size(), 5000u);
+    ASSERT_EQ(frames[0].snapshot.procs.value()->back().command, "/usr/bin/proc5000");
+}
@@ -0,0 +1,448 @@
+#include <gtest/gtest.h>
+
+#include <api_server/data/datastore.h>
+#include <api_server/filesystem/details.h>
+#include <api_server/logger.h>
+#include <api_server/server/api.h>
+#include <api_server/server/router.h>
+
+#include <unistd.h>
+
+using namespace server;
+
+class ApiControllerTest : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        data::MemSnapshot mem;
+        mem.total_memory_kB = 1000;
+        mem.free_memory_kB = 250;
+        mem.usage_percent = 75.0f;
+        datastore.set_mem_snapshot(mem);
+        datastore.publish_generation();
+    }
+
+    HttpResponse Get(const std::string& target, const std::optional<std::string>& if_none_match = std::nullopt)
+    {
+        BoostHttpRequest request{bb::http::verb::get, target, 11};
+        if (if_none_match)
+            request.set(bb::http::field::if_none_match, if_none_match.value());
+        return router.process_http_request(request);
+    }
+
+    StdStreamLogger logger{LogLevel::Info};
+    data::DataStore datastore;
+    Router router{logger};
+    filesystem::ProcDetailsCollector details_collector{logger};
+    ApiController controller{logger, router, datastore, &details_collector};
+};
+
+// GIVEN the datastore has memory information
+// WHEN it is requested
+// THEN the response has the serialized data and an ETag for the current generation
+TEST_F(ApiControllerTest, GetMem) {
+    const auto response = Get("/api/mem");
+
+    ASSERT_EQ(response.result(), bb::http::status::ok);
+    ASSERT_EQ(response.payload(), R"({"free_memory_kB":250,"total_memory_kB":1000,"usage_percent":75.0})");
+    ASSERT_TRUE(boost::ends_with(response[bb::http::field::etag], "-1\""));
+}
+
+// GIVEN a client has the response for the current generation
+// WHEN it requests the resource with If-None-Match
+// THEN the response is 304 with no body
+TEST_F(ApiControllerTest, NotModified) {
+    const auto etag = std::string{Get("/api/mem")[bb::http::field::etag]};
+    const auto response = Get("/api/mem", "W/\"0\", " + etag);
+
+    ASSERT_EQ(response.result(), bb::http::status::not_modified);
+    ASSERT_TRUE(response.payload().empty());
+}
+
+// GIVEN a client has the response for a previous generation
+// WHEN it requests the resource with If-None-Match
+// THEN the response has the latest data
+TEST_F(ApiControllerTest, ModifiedInNewGeneration) {
+    const auto etag = std::string{Get("/api/mem")[bb::http::field::etag]};
+    datastore.publish_generation();
+    const auto response = Get("/api/mem", etag);
+
+    ASSERT_EQ(response.result(), bb::http::status::ok);
+    ASSERT_TRUE(boost::ends_with(response[bb::http::field::etag], "-2\""));
+    ASSERT_EQ(std::string{response[bb::http::field::etag]}.substr(0u, etag.size() - 2u),
+              etag.substr(0u, etag.size() - 2u));
+}
+
+// GIVEN a client's ETag of a generation, from an earlier run of the server whose generations started over
+// WHEN it requests the resource with If-None-Match
+// THEN the ETag doesn't match, though the generation is the same
+TEST_F(ApiControllerTest, ModifiedAfterRestart) {
+    const auto etag = std::string{Get("/api/mem")[bb::http::field::etag]};
+    data::DataStore restarted_datastore;
+    restarted_datastore.set_mem_snapshot({2000u, 500u, 75.0f});
+    restarted_datastore.publish_generation();
+    Router restarted_router{logger};
+    ApiController restarted{logger, restarted_router, restarted_datastore, &details_collector};
+    BoostHttpRequest request{bb::http::verb::get, "/api/mem", 11};
+    request.set(bb::http::field::if_none_match, etag);
+
+    const auto response = restarted_router.process_http_request(request);
+
+    ASSERT_EQ(response.result(), bb::http::status::ok);
+    ASSERT_NE(response[bb::http::field::etag], etag);
+    ASSERT_TRUE(boost::ends_with(response[bb::http::field::etag], "-1\""));
+}
+
+// GIVEN requests with If-None-Match: *
+// WHEN they are for a resource that exists, and one that doesn't
+// THEN only the existing one is not modified
+TEST_F(ApiControllerTest, NotModifiedAny) {
+    ASSERT_EQ(Get("/api/mem", "*").result(), bb::http::status::not_modified);
+    ASSERT_EQ(Get("/api/proctree?root=999999", "*").result(), bb::http::status::not_found);
+}
+
+// GIVEN several requests for a resource within one generation
+// WHEN they are served
+// THEN they share one serialized body
+TEST_F(ApiControllerTest, SharedBody) {
+    const auto first = Get("/api/mem");
+    const auto second = Get("/api/mem");
+
+    ASSERT_EQ(first.shared_body(), second.shared_body());
+}
+
+// GIVEN a client that prefers MessagePack
+// WHEN it requests a resource
+// THEN the response is the same document in MessagePack, with its own ETag
+TEST_F(ApiControllerTest, MsgPackResponse) {
+    BoostHttpRequest request{bb::http::verb::get, "/api/mem", 11};
+    request.set(bb::http::field::accept, "application/msgpack, application/json;q=0.5");
+    const auto response = router.process_http_request(request);
+
+    ASSERT_EQ(response.result(), bb::http::status::ok);
+    ASSERT_EQ(response[bb::http::field::content_type], "application/msgpack");
+    ASSERT_NE(response[bb::http::field::etag], Get("/api/mem")[bb::http::field::etag]);
+    const auto payload = response.payload();
+    ASSERT_EQ(nlohmann::json::from_msgpack(payload.begin(), payload.end()),
+              data::to_json(datastore.get_mem_snapshot()));
+}
+
+// GIVEN a client that only accepts the binary process table
+// WHEN it requests a resource other than the process list
+// THEN the response is 406
+TEST_F(ApiControllerTest, NotAcceptable) {
+    BoostHttpRequest request{bb::http::verb::get, "/api/mem", 11};
+    request.set(bb::http::field::accept, std::string{data::PROC_TABLE_MEDIA_TYPE});
+
+    ASSERT_EQ(router.process_http_request(request).result(), bb::http::status::not_acceptable);
+
+    request.target("/api/procs");
+    const auto response = router.process_http_request(request);
+    ASSERT_EQ(response.result(), bb::http::status::ok);
+    ASSERT_TRUE(data::decode_proc_table(std::string{response.payload()}).has_value());
+}
+
+// GIVEN a process list large enough to be worth compressing
+// WHEN it is requested by clients that accept gzip
+// THEN they share one compressed body, with its own ETag
+// AND clients that don't accept gzip get the uncompressed body
+TEST_F(ApiControllerTest, CompressedResponse) {
+    std::vector<data::ProcSnapshot> procs(100);
+    for (std::size_t i = 0; i < procs.size(); ++i)
+    {
+        procs[i].pid = static_cast<int32_t>(i + 1);
+        procs[i].command = "/usr/lib/worker --config=/etc/worker/worker.conf";
+    }
+    datastore.store_proc_snapshots(procs);
+    datastore.publish_generation();
+
+    BoostHttpRequest request{bb::http::verb::get, "/api/procs", 11};
+    request.set(bb::http::field::accept_encoding, "gzip, deflate");
+    const auto first = router.process_http_request(request);
+    const auto second = router.process_http_request(request);
+    const auto uncompressed = Get("/api/procs");
+
+    ASSERT_EQ(first[bb::http::field::content_encoding], "gzip");
+    ASSERT_EQ(first.shared_body(), second.shared_body());
+    ASSERT_LT(first.payload().size(), uncompressed.payload().size() / 10);
+    ASSERT_NE(first[bb::http::field::etag], uncompressed[bb::http::field::etag]);
+    ASSERT_TRUE(uncompressed[bb::http::field::content_encoding].empty());
+}
+
+// GIVEN a body smaller than the compression threshold
+// WHEN it is requested by a client that accepts gzip
+// THEN it is not compressed
+TEST_F(ApiControllerTest, SmallResponseNotCompressed) {
+    BoostHttpRequest request{bb::http::verb::get, "/api/mem", 11};
+    request.set(bb::http::field::accept_encoding, "gzip");
+    const auto response = router.process_http_request(request);
+
+    ASSERT_TRUE(response[bb::http::field::content_encoding].empty());
+    ASSERT_EQ(response.payload(), Get("/api/mem").payload());
+}
+
+// GIVEN a process list large enough to be worth streaming
+// WHEN it is requested uncompressed in the current generation
+// THEN it is produced once into the cache and every request shares that body rather than streaming its own
+TEST_F(ApiControllerTest, LargeResponseCached) {
+    std::vector<data::ProcSnapshot> procs(ApiController::STREAM_MIN_PROCS);
+    for (std::size_t i = 0; i < procs.size(); ++i)
+    {
+        procs[i].pid = static_cast<int32_t>(i + 1);
+    }
+    datastore.store_proc_snapshots(procs);
+    datastore.publish_generation();
+
+    const auto first = Get("/api/procs");
+    const auto second = Get("/api/procs");
+    ASSERT_FALSE(first.chunk_source());
+    ASSERT_EQ(first.payload(), data::to_json_string(procs));
+    ASSERT_EQ(first.shared_body(), second.shared_body());
+}
+
+// GIVEN a body of a generation that was superseded while it was being served
+// WHEN it is requested uncompressed, and compressed
+// THEN it is streamed with chunked transfer encoding as it can't be cached
+// AND compressed bodies are still produced whole
+TEST(CachedResponderTest, StreamsSupersededGeneration) {
+    uint64_t current{2u};
+    CachedResponder responder{[&current] { return current; }};
+    const auto procs = std::make_shared<const std::vector<data::ProcSnapshot>>(2u);
+    const auto produce = [procs](const data::Encoding) { return data::to_json_string(*procs); };
+    const auto stream = [procs](const data::Encoding) -> std::optional<ChunkSource> {
+        return json_array_chunks(procs);
+    };
+    BoostHttpRequest request{bb::http::verb::get, "/items", 11};
+
+    auto streamed = responder.respond(HttpRequest{request}, 1u, produce, DOCUMENT_ENCODINGS, stream);
+    ASSERT_TRUE(streamed.chunked());
+    ASSERT_FALSE(streamed[bb::http::field::etag].empty());
+    streamed.collect_chunks();
+    ASSERT_EQ(streamed.payload(), data::to_json_string(*procs));
+    ASSERT_FALSE(responder.respond(HttpRequest{request}, 2u, produce, DOCUMENT_ENCODINGS, stream).chunk_source());
+
+    request.set(bb::http::field::accept_encoding, "gzip");
+    ASSERT_FALSE(responder.respond(HttpRequest{request}, 1u, produce, DOCUMENT_ENCODINGS, stream).chunk_source());
+}
+
+// GIVEN a client subscribed to the event stream
+// WHEN a new generation is published
+// THEN the client receives a snapshot event for it, after one for the generation it subscribed in
+TEST_F(ApiControllerTest, EventStream) {
+    const auto response = Get("/api/stream");
+    ASSERT_EQ(response.result(), bb::http::status::ok);
+    ASSERT_EQ(response[bb::http::field::content_type], "text/event-stream");
+    ASSERT_TRUE(response.event_stream());
+
+    std::vector<std::string> events;
+    const auto record = [&events](Subscription::Message message) { events.push_back(*message); };
+    response.event_stream()->async_next(record);
+    datastore.publish_generation();
+    response.event_stream()->async_next(record);
+
+    ASSERT_EQ(events.size(), 2u);
+    ASSERT_EQ(events[0].rfind("id: 1\nevent: snapshot\ndata: {\"cpus\":[],\"generation\":1,\"mem\":{", 0), 0u);
+    ASSERT_EQ(events[1].rfind("id: 2\n", 0), 0u);
+    ASSERT_EQ(events[1].substr(events[1].size() - 2), "\n\n");
+    const auto data = events[1].substr(events[1].find("data: ") + 6);
+    const auto json = nlohmann::json::parse(data);
+    ASSERT_EQ(json["mem"]["total_memory_kB"], 1000);
+    ASSERT_EQ(json["uptime"]["formatted"], "00:00:00");
+}
+
+// GIVEN a client with the process list of a generation
+// WHEN it requests the processes since that generation
+// THEN the response only has the processes that changed
+// AND invalid generations are rejected
+TEST_F(ApiControllerTest, ProcDelta) {
+    std::vector<data::ProcSnapshot> procs(2);
+    procs[0].pid = 1;
+    procs[1].pid = 2;
+    datastore.store_proc_snapshots(procs);
+    datastore.publish_generation();
+    procs[1].cpu_usage_percent = 25.0f;
+    datastore.store_proc_snapshots(procs);
+    datastore.publish_generation();
+
+    const auto response = Get("/api/procs?since=2");
+    ASSERT_EQ(response.result(), bb::http::status::ok);
+    const auto delta = nlohmann::json::parse(response.payload());
+    ASSERT_EQ(delta["generation"], 3);
+    ASSERT_EQ(delta["full"], false);
+    ASSERT_TRUE(delta["added"].empty());
+    ASSERT_EQ(delta["changed"].size(), 1u);
+    ASSERT_EQ(delta["changed"][0]["pid"], 2);
+    ASSERT_TRUE(delta["removed"].empty());
+
+    ASSERT_EQ(Get("/api/procs?since=2&cpu_threshold=50").payload(),
+              R"({"added":[],"changed":[],"full":false,"generation":3,"removed":[],"since":2})");
+    ASSERT_EQ(Get("/api/procs?since=abc").result(), bb::http::status::bad_request);
+    ASSERT_EQ(Get("/api/procs?since=2&cpu_threshold=-1").result(), bb::http::status::bad_request);
+}
+
+// GIVEN datasets stored for a poll after the last published generation
+// WHEN the snapshot is requested
+// THEN it has the datasets of the published generation only
+TEST_F(ApiControllerTest, SnapshotIsConsistent) {
+    data::MemSnapshot mem;
+    mem.total_memory_kB = 2000;
+    datastore.set_mem_snapshot(mem);
+
+    const auto snapshot = nlohmann::json::parse(Get("/api/snapshot").payload());
+    ASSERT_EQ(snapshot["generation"], 1);
+    ASSERT_EQ(snapshot["mem"]["total_memory_kB"], 1000);
+    ASSERT_TRUE(snapshot["cpus"].empty());
+    ASSERT_TRUE(snapshot["procs"].empty());
+    ASSERT_EQ(snapshot["uptime"]["formatted"], "00:00:00");
+
+    datastore.publish_generation();
+    ASSERT_EQ(nlohmann::json::parse(Get("/api/snapshot").payload())["mem"]["total_memory_kB"], 2000);
+}
+
+// GIVEN datasets stored for a poll after the last published generation
+// WHEN each dataset is requested
+// THEN the responses have the datasets of the published generation, which they are cached under
+TEST_F(ApiControllerTest, DatasetsAreConsistent) {
+    std::vector<data::ProcSnapshot> procs(1);
+    procs[0].pid = 1;
+    datastore.store_proc_snapshots(procs);
+    datastore.publish_generation();
+    procs.resize(2);
+    procs[1].pid = 2;
+    procs[1].ppid = 1;
+    datastore.store_proc_snapshots(procs);
+    datastore.store_cgroup_snapshots(std::vector<data::CgroupSnapshot>(1));
+    datastore.set_mem_snapshot({2000u, 500u, 75.0f});
+
+    ASSERT_EQ(nlohmann::json::parse(Get("/api/mem").payload())["total_memory_kB"], 1000);
+    ASSERT_EQ(nlohmann::json::parse(Get("/api/procs").payload()).size(), 1u);
+    const auto delta = nlohmann::json::parse(Get("/api/procs?since=1").payload());
+    ASSERT_EQ(delta["generation"], 2);
+    ASSERT_EQ(delta["added"].size(), 1u);
+    ASSERT_EQ(nlohmann::json::parse(Get("/api/proctree?root=1").payload())["child_count"], 0);
+    ASSERT_EQ(Get("/api/proctree?root=2").result(), bb::http::status::not_found);
+    ASSERT_EQ(Get("/api/cgroups").payload(), "[]");
+
+    datastore.publish_generation();
+    ASSERT_EQ(nlohmann::json::parse(Get("/api/mem").payload())["total_memory_kB"], 2000);
+    ASSERT_EQ(nlohmann::json::parse(Get("/api/procs").payload()).size(), 2u);
+    ASSERT_EQ(nlohmann::json::parse(Get("/api/proctree?root=1").payload())["child_count"], 1);
+    ASSERT_EQ(nlohmann::json::parse(Get("/api/cgroups").payload()).size(), 1u);
+}
+
+// GIVEN a datastore the monitor hasn't polled into yet
+// WHEN its snapshot is requested, e.g. by a client as soon as the server starts
+// THEN the response has the generation but none of the datasets
+TEST_F(ApiControllerTest, SnapshotBeforeFirstPoll) {
+    data::DataStore empty_datastore;
+    Router empty_router{logger};
+    ApiController empty_controller{logger, empty_router, empty_datastore, &details_collector};
+    const BoostHttpRequest request{bb::http::verb::get, "/api/snapshot?limit=10", 11};
+
+    const auto response = empty_router.process_http_request(request);
+
+    ASSERT_EQ(response.result(), bb::http::status::ok);
+    ASSERT_EQ(response.payload(), R"({"generation":0})");
+}
+
+// GIVEN a controller without a details collector, as during a replay
+// WHEN the details of a process in the datastore are requested
+// THEN they are not found, rather than being read from the live /proc
+TEST_F(ApiControllerTest, NoDetailsWithoutCollector) {
+    data::DataStore replay_datastore;
+    data::ProcSnapshot proc;
+    proc.pid = getpid();
+    replay_datastore.store_proc_snapshots({proc});
+    replay_datastore.publish_generation();
+    Router replay_router{logger};
+    ApiController replay_controller{logger, replay_router, replay_datastore, nullptr};
+    const auto target = "/api/procs/" + std::to_string(getpid());
+
+    const auto details = replay_router.process_http_request(BoostHttpRequest{bb::http::verb::get, target, 11});
+    const auto threads =
+        replay_router.process_http_request(BoostHttpRequest{bb::http::verb::get, target + "/threads", 11});
+
+    ASSERT_EQ(details.result(), bb::http::status::not_found);
+    ASSERT_EQ(threads.result(), bb::http::status::ok);
+}
+
+// GIVEN a snapshot with several processes
+// WHEN it is requested with fields and a limit
+// THEN only those datasets and the processes using the most CPU are included
+TEST_F(ApiControllerTest, SnapshotProjection) {
+    std::vector<data::ProcSnapshot> procs(3);
+    for (std::size_t i = 0; i < procs.size(); ++i)
+    {
+        procs[i].pid = static_cast<int32_t>(i + 1);
+        procs[i].cpu_usage_percent = i == 1 ? 50.0f : 10.0f;
+    }
+    datastore.store_proc_snapshots(procs);
+    datastore.publish_generation();
+
+    const auto snapshot = nlohmann::json::parse(Get("/api/snapshot?fields=mem,procs&limit=2").payload());
+    ASSERT_EQ(snapshot.size(), 3u);
+    ASSERT_TRUE(snapshot.contains("mem"));
+    ASSERT_EQ(snapshot["procs"].size(), 2u);
+    ASSERT_EQ(snapshot["procs"][0]["pid"], 2);
+    ASSERT_EQ(snapshot["procs"][1]["pid"], 1);
+
+    ASSERT_EQ(Get("/api/snapshot?fields=mem,disks").result(), bb::http::status::bad_request);
+    ASSERT_EQ(Get("/api/snapshot?limit=-1").result(), bb::http::status::bad_request);
+}
+
+// GIVEN a snapshot with several processes, a poll phase and a response that have been timed
+// WHEN the metrics are requested
+// THEN they have the host data, the processes using the most CPU and the histograms in Prometheus text format
+TEST_F(ApiControllerTest, Metrics) {
+    std::vector<data::ProcSnapshot> procs(3);
+    for (std::size_t i = 0; i < procs.size(); ++i)
+    {
+        procs[i].pid = static_cast<int32_t>(i + 1);
+        procs[i].name = i == 1 ? "say \"hi\"" : "idle";
+        procs[i].cpu_usage_percent = i == 1 ? 50.0f : 10.0f;
+    }
+    datastore.store_proc_snapshots(procs);
+    datastore.publish_generation();
+    datastore.poll_metrics().discovery.record(std::chrono::microseconds{300});
+    Get("/api/mem").latency_histogram()->record(std::chrono::milliseconds{2});
+
+    const auto response = Get("/metrics?top=1");
+    ASSERT_EQ(response.result(), bb::http::status::ok);
+    ASSERT_EQ(response[bb::http::field::content_type], "text/plain; version=0.0.4; charset=utf-8");
+    const auto body = std::string{response.payload()};
+    const auto has_line = [&body](const std::string& line) { return body.find(line + "\n") != std::string::npos; };
+    ASSERT_TRUE(has_line("# TYPE host_memory_total_bytes gauge"));
+    ASSERT_TRUE(has_line("host_memory_total_bytes 1024000"));
+    ASSERT_TRUE(has_line("host_memory_available_bytes 256000"));
+    ASSERT_TRUE(has_line("host_processes 3"));
+    ASSERT_TRUE(has_line(R"(host_process_cpu_usage_percent{pid="2",name="say \"hi\""} 50)"));
+    ASSERT_FALSE(has_line(R"(host_process_cpu_usage_percent{pid="1",name="idle"} 10)"));
+    ASSERT_TRUE(has_line(R"(api_server_poll_phase_duration_seconds_bucket{phase="discovery",le="0.00025"} 0)"));
+    ASSERT_TRUE(has_line(R"(api_server_poll_phase_duration_seconds_bucket{phase="discovery",le="0.0005"} 1)"));
+    ASSERT_TRUE(has_line(R"(api_server_request_duration_seconds_count{method="GET",route="/api/mem"} 1)"));
+    ASSERT_TRUE(has_line(R"(api_server_request_duration_seconds_count{method="GET",route="/api/procs/{pid}"} 0)"));
+
+    ASSERT_EQ(Get("/metrics?top=x").result(), bb::http::status::bad_request);
+}
+
+// GIVEN the monitor has recorded a poll phase and a slow read in the flight recorder
+// WHEN the trace is requested
+// THEN it is Chrome trace_event JSON with a complete event for each span
+TEST_F(ApiControllerTest, DebugTrace) {
+    const auto start = std::chrono::steady_clock::now();
+    auto& recorder = datastore.flight_recorder();
+    recorder.record("poll", "discovery", start, start + std::chrono::microseconds{250}, 2u);
+    recorder.record("read", "slow read", start, start + std::chrono::seconds{3}, 2u, 42, "/proc/42/cmdline");
+
+    const auto response = Get("/api/debug/trace");
+    ASSERT_EQ(response.result(), bb::http::status::ok);
+    ASSERT_EQ(response[bb::http::field::content_type], "application/json");
+    const auto events = nlohmann::json::parse(response.payload()).at("traceEvents");
+    ASSERT_EQ(events.size(), 2u);
+    ASSERT_EQ(events[0]["name"], "discovery");
+    ASSERT_EQ(events[0]["ph"], "X");
+    ASSERT_EQ(events[0]["dur"], 250.0);
+    ASSERT_EQ(events[1]["cat"], "read");
+    ASSERT_EQ(events[1]["dur"], 3e6);
+    ASSERT_EQ(events[1]["args"], (nlohmann::json{{"detail", "/proc/42/cmdline"}, {"generation", 2}, {"pid", 42}}));
+}
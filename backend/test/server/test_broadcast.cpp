@@ -0,0 +1,110 @@
+#include <gtest/gtest.h>
+
+#include <api_server/server/broadcast.h>
+
+using namespace server;
+
+class BroadcastTest : public ::testing::Test
+{
+protected:
+    static Subscription::Message Message(const std::string& text)
+    {
+        return std::make_shared<const std::string>(text);
+    }
+
+    /// @brief Waits for the next message, recording it in `received`
+    void Next(Subscription& subscription)
+    {
+        subscription.async_next([this](Subscription::Message message) {
+            received.push_back(message ? *message : "<closed>");
+        });
+    }
+
+    Broadcaster broadcaster;
+    std::vector<std::string> received;
+};
+
+// GIVEN a subscriber waiting for a message
+// WHEN a message is published
+// THEN the subscriber receives it
+TEST_F(BroadcastTest, WaitingSubscriberReceivesMessage)
+{
+    const auto subscription = broadcaster.subscribe();
+    Next(*subscription);
+    ASSERT_TRUE(received.empty());
+
+    broadcaster.publish(Message("a"));
+    ASSERT_EQ(received, std::vector<std::string>{"a"});
+}
+
+// GIVEN a message has been published
+// WHEN a new subscriber asks for a message
+// THEN it receives the latest message straight away
+TEST_F(BroadcastTest, NewSubscriberReceivesLatestMessage)
+{
+    broadcaster.publish(Message("a"));
+    broadcaster.publish(Message("b"));
+    const auto subscription = broadcaster.subscribe();
+    Next(*subscription);
+
+    ASSERT_EQ(received, std::vector<std::string>{"b"});
+}
+
+// GIVEN a subscriber that is busy while several messages are published
+// WHEN it asks for the next message
+// THEN it receives only the latest one
+TEST_F(BroadcastTest, SlowSubscriberSkipsIntermediateMessages)
+{
+    const auto subscription = broadcaster.subscribe();
+    broadcaster.publish(Message("a"));
+    broadcaster.publish(Message("b"));
+    broadcaster.publish(Message("c"));
+    Next(*subscription);
+    Next(*subscription);
+    ASSERT_EQ(received, std::vector<std::string>{"c"});
+
+    broadcaster.publish(Message("d"));
+    ASSERT_EQ(received, (std::vector<std::string>{"c", "d"}));
+}
+
+// GIVEN several subscribers
+// WHEN a message is published
+// THEN they all share the same message
+TEST_F(BroadcastTest, SubscribersShareMessage)
+{
+    const auto first = broadcaster.subscribe();
+    const auto second = broadcaster.subscribe();
+    std::vector<Subscription::Message> messages;
+    const auto record = [&messages](Subscription::Message message) { messages.push_back(message); };
+    first->async_next(record);
+    second->async_next(record);
+
+    const auto message = Message("a");
+    broadcaster.publish(message);
+    ASSERT_EQ(messages, (std::vector<Subscription::Message>{message, message}));
+}
+
+// GIVEN a subscriber waiting for a message
+// WHEN the broadcaster is closed
+// THEN the subscriber is told the subscription has ended, and is told so again if it asks for another message
+TEST_F(BroadcastTest, Close)
+{
+    const auto subscription = broadcaster.subscribe();
+    Next(*subscription);
+    broadcaster.close();
+    Next(*subscription);
+
+    ASSERT_EQ(received, (std::vector<std::string>{"<closed>", "<closed>"}));
+}
+
+// GIVEN a subscription
+// WHEN the subscriber releases it
+// THEN it is no longer counted
+TEST_F(BroadcastTest, SubscriberCount)
+{
+    auto subscription = broadcaster.subscribe();
+    ASSERT_EQ(broadcaster.subscriber_count(), 1u);
+
+    subscription.reset();
+    ASSERT_EQ(broadcaster.subscriber_count(), 0u);
+}
@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+
+#include <api_server/server/cache.h>
+
+using namespace server;
+
+class ResponseCacheTest : public ::testing::Test {
+protected:
+    ResponseCache::Producer Producer(const std::string& body)
+    {
+        return [this, body]() -> std::optional<std::string> {
+            ++produced;
+            return body;
+        };
+    }
+
+    uint64_t generation{1u};
+    int produced{0};
+    ResponseCache cache{[this] { return generation; }};
+};
+
+// GIVEN a body has been produced for a key in the current generation
+// WHEN the same key is requested again in the same generation
+// THEN the same body is shared without producing it again
+TEST_F(ResponseCacheTest, HitWithinGeneration) {
+    const auto first = cache.get("/resource", generation, Producer("body"));
+    const auto second = cache.get("/resource", generation, Producer("other"));
+
+    ASSERT_EQ(first, second);
+    ASSERT_EQ(*second, "body");
+    ASSERT_EQ(produced, 1);
+    ASSERT_EQ(cache.stats().hits, 1u);
+    ASSERT_EQ(cache.stats().misses, 1u);
+}
+
+// GIVEN a body has been produced for a key
+// WHEN the key is requested in a later generation
+// THEN the body is produced again
+TEST_F(ResponseCacheTest, MissInNextGeneration) {
+    (void)cache.get("/resource", generation, Producer("body"));
+    ++generation;
+    const auto body = cache.get("/resource", generation, Producer("new body"));
+
+    ASSERT_EQ(*body, "new body");
+    ASSERT_EQ(produced, 2);
+}
+
+// GIVEN the generation changes while a body is being produced
+// WHEN the key is requested again
+// THEN the body was not cached, as it may mix data from both generations
+TEST_F(ResponseCacheTest, NotCachedIfGenerationChanges) {
+    (void)cache.get("/resource", generation, [this]() -> std::optional<std::string> {
+        ++generation;
+        return "body";
+    });
+    (void)cache.get("/resource", generation - 1, Producer("body"));
+
+    ASSERT_EQ(produced, 1);
+    ASSERT_EQ(cache.stats().entries, 0u);
+}
+
+// GIVEN the producer has nothing to serve
+// WHEN the key is requested
+// THEN no body is returned
+TEST_F(ResponseCacheTest, NothingToServe) {
+    ASSERT_EQ(cache.get("/resource", generation, [] { return std::optional<std::string>{}; }), nullptr);
+}
@@ -0,0 +1,68 @@
+#include <gtest/gtest.h>
+
+#include <api_server/server/compression.h>
+
+#include <zlib.h>
+
+using namespace server;
+
+class CompressionTest : public ::testing::Test {
+protected:
+    /// @brief Decompresses gzip or zlib data, detecting the format from its header
+    static std::string Inflate(const std::string& compressed)
+    {
+        z_stream stream{};
+        EXPECT_EQ(inflateInit2(&stream, 15 + 32), Z_OK);
+        std::string inflated(1 << 20, '\0');
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(compressed.data()));
+        stream.avail_in = static_cast<uInt>(compressed.size());
+        stream.next_out = reinterpret_cast<Bytef*>(inflated.data());
+        stream.avail_out = static_cast<uInt>(inflated.size());
+        EXPECT_EQ(inflate(&stream, Z_FINISH), Z_STREAM_END);
+        inflated.resize(stream.total_out);
+        inflateEnd(&stream);
+        return inflated;
+    }
+};
+
+// GIVEN Accept-Encoding headers that allow compression
+// WHEN the content coding is negotiated
+// THEN the most preferred coding is chosen, gzip if there is a tie
+TEST_F(CompressionTest, NegotiateCompression) {
+    ASSERT_EQ(negotiate_content_coding("gzip, deflate, br"), ContentCoding::Gzip);
+    ASSERT_EQ(negotiate_content_coding("deflate"), ContentCoding::Deflate);
+    ASSERT_EQ(negotiate_content_coding("gzip;q=0.5, deflate;q=0.8"), ContentCoding::Deflate);
+    ASSERT_EQ(negotiate_content_coding("*"), ContentCoding::Gzip);
+    ASSERT_EQ(negotiate_content_coding("X-GZIP"), ContentCoding::Gzip);
+}
+
+// GIVEN Accept-Encoding headers that don't allow compression
+// WHEN the content coding is negotiated
+// THEN the body is not compressed
+TEST_F(CompressionTest, NegotiateIdentity) {
+    ASSERT_EQ(negotiate_content_coding(""), ContentCoding::Identity);
+    ASSERT_EQ(negotiate_content_coding("br, identity"), ContentCoding::Identity);
+    ASSERT_EQ(negotiate_content_coding("gzip;q=0, deflate;q=0"), ContentCoding::Identity);
+    ASSERT_EQ(negotiate_content_coding("*, gzip;q=0, deflate;q=0"), ContentCoding::Identity);
+}
+
+// GIVEN a repetitive body, like a process list
+// WHEN it is compressed with either coding
+// THEN it is smaller and decompresses to the original
+TEST_F(CompressionTest, RoundTrip) {
+    std::string body;
+    for (int i = 0; i < 1000; ++i)
+    {
+        body += R"({"command":"/usr/lib/worker --config=/etc/worker/worker.conf","pid":)" + std::to_string(i) + "},";
+    }
+
+    for (const auto coding : {ContentCoding::Gzip, ContentCoding::Deflate})
+    {
+        const auto compressed = compress(body, coding);
+        ASSERT_LT(compressed.size(), body.size() / 10);
+        ASSERT_EQ(Inflate(compressed), body);
+    }
+    ASSERT_EQ(static_cast<uint8_t>(compress(body, ContentCoding::Gzip)[0]), 0x1F); // gzip magic
+    ASSERT_EQ(compress(body, ContentCoding::Identity), body);
+    ASSERT_EQ(Inflate(compress("", ContentCoding::Gzip)), "");
+}
@@ -0,0 +1,53 @@
+#include <gtest/gtest.h>
+
+#include <api_server/server/negotiation.h>
+
+using namespace server;
+using data::Encoding;
+
+class NegotiationTest : public ::testing::Test {
+protected:
+    std::optional<Encoding> Negotiate(const std::string& accept)
+    {
+        return negotiate_encoding(accept, supported);
+    }
+
+    std::vector<Encoding> supported{Encoding::Json, Encoding::MsgPack, Encoding::Cbor};
+};
+
+// GIVEN requests with no preference for the media type
+// WHEN the encoding is negotiated
+// THEN the response is JSON
+TEST_F(NegotiationTest, DefaultsToJson) {
+    ASSERT_EQ(Negotiate(""), Encoding::Json);
+    ASSERT_EQ(Negotiate("*/*"), Encoding::Json);
+    ASSERT_EQ(Negotiate("application/*"), Encoding::Json);
+    ASSERT_EQ(Negotiate("text/html, */*;q=0.8"), Encoding::Json);
+}
+
+// GIVEN requests that accept a binary encoding
+// WHEN the encoding is negotiated
+// THEN the binary encoding is chosen
+TEST_F(NegotiationTest, BinaryEncodings) {
+    ASSERT_EQ(Negotiate("application/msgpack"), Encoding::MsgPack);
+    ASSERT_EQ(Negotiate("application/x-msgpack"), Encoding::MsgPack);
+    ASSERT_EQ(Negotiate("Application/CBOR"), Encoding::Cbor);
+    ASSERT_EQ(Negotiate("application/json;q=0.5, application/cbor"), Encoding::Cbor);
+}
+
+// GIVEN a request with weighted media ranges
+// WHEN the encoding is negotiated
+// THEN the most specific range decides each encoding's weight
+TEST_F(NegotiationTest, MostSpecificRangeWins) {
+    ASSERT_EQ(Negotiate("application/*;q=0.9, application/json;q=0.1"), Encoding::MsgPack);
+    ASSERT_EQ(Negotiate("*/*, application/json;q=0"), Encoding::MsgPack);
+}
+
+// GIVEN requests that only accept media types the endpoint can't produce
+// WHEN the encoding is negotiated
+// THEN there is no acceptable encoding
+TEST_F(NegotiationTest, NotAcceptable) {
+    ASSERT_FALSE(Negotiate("text/html").has_value());
+    ASSERT_FALSE(Negotiate("application/json;q=0").has_value());
+    ASSERT_FALSE(Negotiate(std::string{data::PROC_TABLE_MEDIA_TYPE}).has_value());
+}
@@ -27,11 +27,11 @@ protected:
  
 // GIVEN router has no routes
 // WHEN router gets request for resource
-// THEN router returns bad request response
+// THEN router returns not found response
 TEST_F(RouterTest, NoRoutes) {
-    HttpRequest request{bb::http::verb::get, "/resource", 1};
+    BoostHttpRequest request{bb::http::verb::get, "/resource", 1};
     HttpResponse response = router.process_http_request(request);
-    ASSERT_EQ(response.result(), bb::http::status::bad_request);
+    ASSERT_EQ(response.result(), bb::http::status::not_found);
     ASSERT_EQ(response.version(), request.version());
 }
 
@@ -39,7 +39,7 @@ TEST_F(RouterTest, NoRoutes) {
 // WHEN router gets request with empty URI
 // THEN router returns bad request response
 TEST_F(RouterTest, EmptyURI) {
-    HttpRequest request{bb::http::verb::get, "", 1};
+    BoostHttpRequest request{bb::http::verb::get, "", 1};
     HttpResponse response = router.process_http_request(request);
     ASSERT_EQ(response.result(), bb::http::status::bad_request);
     ASSERT_EQ(response.version(), request.version());
@@ -54,7 +54,7 @@ TEST_F(RouterTest, GetResourceOk) {
     AddMockEndpoint(bb::http::verb::get, "/resource", expected);
     AddMockEndpoint(bb::http::verb::get, "/resource2", responses::NotFound(1, true, ""));
 
-    HttpRequest request{bb::http::verb::get, "/resource", 1};
+    BoostHttpRequest request{bb::http::verb::get, "/resource", 1};
     HttpResponse response = router.process_http_request(request);
 
     ASSERT_EQ(response.result(), expected.result());
@@ -68,7 +68,7 @@ TEST_F(RouterTest, GetResourceOk) {
 TEST_F(RouterTest, GetResourceLongerPathOk) {
     AddMockEndpoint(bb::http::verb::get, "/longer/path", responses::Ok(1, true, "body"));
 
-    HttpRequest request{bb::http::verb::get, "/longer/path", 1};
+    BoostHttpRequest request{bb::http::verb::get, "/longer/path", 1};
     (void)router.process_http_request(request);
 
     ASSERT_TRUE(req_recvd_by_endpoint);
@@ -83,7 +83,7 @@ TEST_F(RouterTest, PostResourceOk) {
     AddMockEndpoint(bb::http::verb::post, "/resource", expected);
     AddMockEndpoint(bb::http::verb::post, "/resource2", responses::NotFound(1, true, ""));
 
-    HttpRequest request{bb::http::verb::post, "/resource", 1};
+    BoostHttpRequest request{bb::http::verb::post, "/resource", 1};
     HttpResponse response = router.process_http_request(request);
 
     ASSERT_EQ(response.result(), expected.result());
@@ -98,7 +98,7 @@ TEST_F(RouterTest, PostResourceOk) {
 TEST_F(RouterTest, ParseUriFragment) {
     AddMockEndpoint(bb::http::verb::get, "/resource", responses::Ok(1, true, "body"));
 
-    HttpRequest request{bb::http::verb::get, "/resource#fragment", 1};
+    BoostHttpRequest request{bb::http::verb::get, "/resource#fragment", 1};
     (void)router.process_http_request(request);
 
     ASSERT_TRUE(req_recvd_by_endpoint.has_value());
@@ -113,7 +113,7 @@ TEST_F(RouterTest, ParseUriFragment) {
 TEST_F(RouterTest, ParseUriQuery) {
     AddMockEndpoint(bb::http::verb::get, "/resource", responses::Ok(1, true, "body"));
 
-    HttpRequest request{bb::http::verb::get, "/resource?key1=value1&key2=value2", 1};
+    BoostHttpRequest request{bb::http::verb::get, "/resource?key1=value1&key2=value2", 1};
     (void)router.process_http_request(request);
 
     ASSERT_TRUE(req_recvd_by_endpoint.has_value());
@@ -123,3 +123,137 @@ TEST_F(RouterTest, ParseUriQuery) {
     ASSERT_EQ(req_recvd_by_endpoint->resource_path(), "/resource");
 }
 
+
+// GIVEN router has GET endpoint
+// WHEN router receives request for URI with percent-encoded query parameters
+// THEN endpoint receives request with decoded query parameters
+TEST_F(RouterTest, DecodeUriQuery) {
+    AddMockEndpoint(bb::http::verb::get, "/resource", responses::Ok(1, true, "body"));
+
+    BoostHttpRequest request{bb::http::verb::get, "/resource?fields=uptime%2Cmem&q=a+b%2bc&k%3Dey=v", 1};
+    (void)router.process_http_request(request);
+
+    ASSERT_TRUE(req_recvd_by_endpoint.has_value());
+    ASSERT_EQ(req_recvd_by_endpoint->query_parameters().size(), 3);
+    ASSERT_EQ(req_recvd_by_endpoint->query_parameters().at("fields"), "uptime,mem");
+    ASSERT_EQ(req_recvd_by_endpoint->query_parameters().at("q"), "a b+c");
+    ASSERT_EQ(req_recvd_by_endpoint->query_parameters().at("k=ey"), "v");
+}
+
+// GIVEN router has GET endpoint
+// WHEN router receives request for URI with a malformed percent-encoding
+// THEN router returns bad request response
+TEST_F(RouterTest, MalformedEncoding) {
+    AddMockEndpoint(bb::http::verb::get, "/resource/{id}", responses::Ok(1, true, "body"));
+
+    for (const auto target : {"/resource/%zz", "/resource/1%2", "/resource/1?key=%"})
+    {
+        BoostHttpRequest request{bb::http::verb::get, target, 1};
+        HttpResponse response = router.process_http_request(request);
+
+        ASSERT_FALSE(req_recvd_by_endpoint.has_value());
+        ASSERT_EQ(response.result(), bb::http::status::bad_request);
+    }
+}
+
+// GIVEN router has GET endpoint with a path parameter
+// WHEN router receives request for URI with a percent-encoded path parameter
+// THEN endpoint receives request with the decoded path parameter and segments
+TEST_F(RouterTest, DecodePathParameter) {
+    AddMockEndpoint(bb::http::verb::get, "/resource/{name}", responses::Ok(1, true, "body"));
+
+    BoostHttpRequest request{bb::http::verb::get, "/resource/a%2Fb+c", 1};
+    (void)router.process_http_request(request);
+
+    ASSERT_TRUE(req_recvd_by_endpoint.has_value());
+    ASSERT_EQ(req_recvd_by_endpoint->path_parameters().at("name"), "a/b+c");
+    ASSERT_EQ(req_recvd_by_endpoint->path_segments().size(), 2);
+    ASSERT_EQ(req_recvd_by_endpoint->resource_path(), "/resource/a%2Fb+c");
+}
+
+// GIVEN router has GET endpoint with a path parameter
+// WHEN router receives request for URI matching the pattern
+// THEN endpoint receives request with path parameter map
+TEST_F(RouterTest, ParsePathParameter) {
+    AddMockEndpoint(bb::http::verb::get, "/resource/{id}/sub", responses::Ok(1, true, "body"));
+
+    BoostHttpRequest request{bb::http::verb::get, "/Resource/AbC/sub?key=value", 1};
+    (void)router.process_http_request(request);
+
+    ASSERT_TRUE(req_recvd_by_endpoint.has_value());
+    ASSERT_EQ(req_recvd_by_endpoint->path_parameters().size(), 1);
+    ASSERT_EQ(req_recvd_by_endpoint->path_parameters().at("id"), "AbC");
+}
+
+// GIVEN router has GET endpoints for a static resource and a pattern that both match a URI
+// WHEN router receives request for the URI
+// THEN the static resource endpoint is called
+TEST_F(RouterTest, StaticRoutePreferredToPattern) {
+    AddMockEndpoint(bb::http::verb::get, "/resource/{id}", responses::NotFound(1, true, ""));
+    AddMockEndpoint(bb::http::verb::get, "/resource/static", responses::Ok(1, true, "body"));
+
+    BoostHttpRequest request{bb::http::verb::get, "/resource/static", 1};
+    HttpResponse response = router.process_http_request(request);
+
+    ASSERT_EQ(response.result(), bb::http::status::ok);
+    ASSERT_TRUE(req_recvd_by_endpoint->path_parameters().empty());
+}
+
+// GIVEN router has GET endpoint with a path parameter
+// WHEN router receives request for URI with a different number of segments
+// THEN router returns not found response
+TEST_F(RouterTest, PathParameterSegmentMismatch) {
+    AddMockEndpoint(bb::http::verb::get, "/resource/{id}", responses::Ok(1, true, "body"));
+
+    BoostHttpRequest request{bb::http::verb::get, "/resource/1/2", 1};
+    HttpResponse response = router.process_http_request(request);
+
+    ASSERT_FALSE(req_recvd_by_endpoint.has_value());
+    ASSERT_EQ(response.result(), bb::http::status::not_found);
+}
+
+// GIVEN router has GET and POST endpoints for a resource
+// WHEN router receives a DELETE request for the resource
+// THEN router returns method not allowed response listing the resource's methods
+TEST_F(RouterTest, MethodNotAllowed) {
+    AddMockEndpoint(bb::http::verb::get, "/resource/{id}", responses::Ok(1, true, "body"));
+    AddMockEndpoint(bb::http::verb::post, "/resource/{id}", responses::Ok(1, true, "body"));
+
+    BoostHttpRequest request{bb::http::verb::delete_, "/resource/1", 1};
+    HttpResponse response = router.process_http_request(request);
+
+    ASSERT_FALSE(req_recvd_by_endpoint.has_value());
+    ASSERT_EQ(response.result(), bb::http::status::method_not_allowed);
+    ASSERT_EQ(response[bb::http::field::allow], "GET, POST");
+}
+
+// GIVEN router has a GET endpoint
+// WHEN router receives requests for the resource in a different case, with repeated and trailing slashes
+// THEN endpoint is called for each
+TEST_F(RouterTest, MatchIgnoresCaseAndSlashes) {
+    AddMockEndpoint(bb::http::verb::get, "/longer/path", responses::Ok(1, true, "body"));
+
+    for (const auto target : {"/LONGER/Path", "/longer/path/", "//longer//path"})
+    {
+        req_recvd_by_endpoint.reset();
+        BoostHttpRequest request{bb::http::verb::get, target, 1};
+        HttpResponse response = router.process_http_request(request);
+
+        ASSERT_EQ(response.result(), bb::http::status::ok);
+        ASSERT_TRUE(req_recvd_by_endpoint.has_value());
+    }
+}
+
+// GIVEN router has GET endpoints for a static resource and a pattern sharing a prefix
+// WHEN router receives request that only matches the pattern after the static segment fails further down
+// THEN the pattern endpoint is called with the path parameter
+TEST_F(RouterTest, BacktracksToPattern) {
+    AddMockEndpoint(bb::http::verb::get, "/resource/static/a", responses::NotFound(1, true, ""));
+    AddMockEndpoint(bb::http::verb::get, "/resource/{id}/b", responses::Ok(1, true, "body"));
+
+    BoostHttpRequest request{bb::http::verb::get, "/resource/static/b", 1};
+    HttpResponse response = router.process_http_request(request);
+
+    ASSERT_EQ(response.result(), bb::http::status::ok);
+    ASSERT_EQ(req_recvd_by_endpoint->path_parameters().at("id"), "static");
+}
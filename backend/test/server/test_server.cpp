@@ -0,0 +1,177 @@
+#include <gtest/gtest.h>
+
+#include <api_server/logger.h>
+#include <api_server/server/router.h>
+#include <api_server/server/server.h>
+
+#include <boost/asio/connect.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/read_until.hpp>
+#include <chrono>
+#include <thread>
+
+using namespace server;
+using boost::asio::ip::tcp;
+
+class ServerTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        router.add_route(bb::http::verb::get, "/resource", [](const HttpRequest& request) {
+            HttpResponse response{bb::http::status::ok, request.version()};
+            response.body() = "body";
+            response.keep_alive(request.keep_alive());
+            return response;
+        });
+        router.add_route(bb::http::verb::get, "/throws", [](const HttpRequest&) -> HttpResponse {
+            throw std::runtime_error{"Endpoint failed"};
+        });
+        router.add_route(bb::http::verb::get, "/events", [this](const HttpRequest& request) {
+            HttpResponse response{bb::http::status::ok, request.version()};
+            response.keep_alive(request.keep_alive());
+            response.event_stream(broadcaster.subscribe());
+            return response;
+        });
+        server_thread = std::thread{[this]() { server.start(); }};
+    }
+
+    void TearDown() override
+    {
+        server.stop();
+        if (server_thread.joinable())
+            server_thread.join();
+    }
+
+    void Connect(bb::tcp_stream& stream)
+    {
+        stream.connect(tcp::endpoint{boost::asio::ip::make_address("127.0.0.1"), server.port()});
+    }
+
+    BoostHttpResponse Get(bb::tcp_stream& stream, const unsigned version = 11, const std::string& target = "/resource")
+    {
+        BoostHttpRequest request{bb::http::verb::get, target, version};
+        request.keep_alive(true);
+        bb::http::write(stream, request);
+        BoostHttpResponse response;
+        bb::http::read(stream, buffer, response);
+        return response;
+    }
+
+    StdStreamLogger logger{LogLevel::Error};
+    Router router{logger};
+    Broadcaster broadcaster;
+    Server server{logger, router, "127.0.0.1", 0, ServerConfig{2u, std::chrono::seconds{1}}};
+    std::thread server_thread;
+    boost::asio::io_context context;
+    bb::flat_buffer buffer;
+};
+
+// GIVEN a running server
+// WHEN several requests are sent over one connection
+// THEN each is answered and the connection is kept open
+TEST_F(ServerTest, KeepAlive)
+{
+    bb::tcp_stream stream{context};
+    Connect(stream);
+    for (int i = 0; i < 3; ++i)
+    {
+        const auto response = Get(stream);
+        ASSERT_EQ(response.result(), bb::http::status::ok);
+        ASSERT_EQ(response.body(), "body");
+        ASSERT_TRUE(response.keep_alive());
+    }
+}
+
+// GIVEN an endpoint that throws
+// WHEN it is requested
+// THEN that request fails with a server error, and the server goes on answering others on the connection
+TEST_F(ServerTest, EndpointThrows)
+{
+    bb::tcp_stream stream{context};
+    Connect(stream);
+
+    const auto failed = Get(stream, 11, "/throws");
+    const auto response = Get(stream);
+
+    ASSERT_EQ(failed.result(), bb::http::status::internal_server_error);
+    ASSERT_TRUE(failed.keep_alive());
+    ASSERT_EQ(response.result(), bb::http::status::ok);
+    ASSERT_EQ(response.body(), "body");
+}
+
+// GIVEN a running server
+// WHEN requests are sent over many connections at once
+// THEN every connection is answered
+TEST_F(ServerTest, ConcurrentConnections)
+{
+    std::vector<bb::tcp_stream> streams;
+    for (int i = 0; i < 16; ++i)
+    {
+        streams.emplace_back(context);
+        Connect(streams.back());
+    }
+    for (auto& stream : streams)
+    {
+        ASSERT_EQ(Get(stream).result(), bb::http::status::ok);
+    }
+}
+
+// GIVEN a connection that sends no request
+// WHEN the idle timeout passes
+// THEN the server closes the connection
+TEST_F(ServerTest, IdleTimeout)
+{
+    bb::tcp_stream stream{context};
+    Connect(stream);
+    char byte;
+    bb::error_code error;
+    stream.expires_after(std::chrono::seconds{5});
+    stream.read_some(boost::asio::buffer(&byte, 1), error);
+    ASSERT_EQ(error, boost::asio::error::eof);
+}
+
+// GIVEN an idle keep-alive connection
+// WHEN the server is stopped
+// THEN the connection is closed and start() returns without waiting for the grace period
+TEST_F(ServerTest, StopClosesIdleConnections)
+{
+    bb::tcp_stream stream{context};
+    Connect(stream);
+    ASSERT_EQ(Get(stream).result(), bb::http::status::ok);
+
+    const auto stop_time = std::chrono::steady_clock::now();
+    server.stop();
+    server_thread.join();
+    ASSERT_LT(std::chrono::steady_clock::now() - stop_time, std::chrono::seconds{1});
+
+    char byte;
+    bb::error_code error;
+    stream.read_some(boost::asio::buffer(&byte, 1), error);
+    ASSERT_EQ(error, boost::asio::error::eof);
+}
+
+// GIVEN a client receiving an event stream
+// WHEN messages are published and then the server is stopped
+// THEN the client receives each message and the stream is ended
+TEST_F(ServerTest, EventStream)
+{
+    broadcaster.publish(std::make_shared<const std::string>("data: a\n\n"));
+    bb::tcp_stream stream{context};
+    Connect(stream);
+    BoostHttpRequest request{bb::http::verb::get, "/events", 11};
+    bb::http::write(stream, request);
+
+    std::string received;
+    auto received_buffer = boost::asio::dynamic_buffer(received);
+    boost::asio::read_until(stream, received_buffer, "data: a\n\n");
+    ASSERT_NE(received.find("Transfer-Encoding: chunked"), std::string::npos);
+    broadcaster.publish(std::make_shared<const std::string>("data: b\n\n"));
+    boost::asio::read_until(stream, received_buffer, "data: b\n\n");
+
+    server.stop();
+    bb::error_code error;
+    boost::asio::read(stream, received_buffer, error);
+    ASSERT_EQ(error, boost::asio::error::eof);
+    ASSERT_EQ(received.substr(received.size() - 5), "0\r\n\r\n");
+}
@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+
+#include <api_server/data/types.h>
+#include <api_server/server/streaming.h>
+
+using namespace server;
+
+class StreamingTest : public ::testing::Test {
+protected:
+    static std::shared_ptr<const std::vector<data::ProcSnapshot>> MakeProcs(const std::size_t count)
+    {
+        auto procs = std::make_shared<std::vector<data::ProcSnapshot>>(count);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            (*procs)[i].pid = static_cast<int32_t>(i + 1);
+            (*procs)[i].command = "/usr/bin/proc --id=" + std::to_string(i);
+        }
+        return procs;
+    }
+
+    /// @brief Reads a stream to the end, returning its chunks
+    static std::vector<std::string> ReadChunks(const ChunkSource& source)
+    {
+        std::vector<std::string> chunks;
+        bool more = true;
+        while (more)
+        {
+            std::string chunk;
+            more = source(chunk);
+            chunks.push_back(chunk);
+        }
+        return chunks;
+    }
+};
+
+// GIVEN lists of processes
+// WHEN they are streamed in small chunks
+// THEN the chunks join up to the same JSON as serializing the list whole
+// AND no chunk is much larger than the chunk size
+TEST_F(StreamingTest, JsonArrayChunks) {
+    for (const auto count : {0u, 1u, 50u})
+    {
+        const auto procs = MakeProcs(count);
+        const auto chunks = ReadChunks(json_array_chunks(procs, 512u));
+
+        std::string joined;
+        for (const auto& chunk : chunks)
+        {
+            ASSERT_LT(chunk.size(), 512u + 256u);
+            joined += chunk;
+        }
+        ASSERT_EQ(joined, data::to_json_string(*procs));
+        if (count == 50u)
+        {
+            ASSERT_GT(chunks.size(), 1u);
+        }
+    }
+}
+
+// GIVEN a response with a streamed body
+// WHEN its chunks are collected, e.g. for an HTTP/1.0 client
+// THEN the body is sent whole with a content length
+TEST_F(StreamingTest, CollectChunks) {
+    const auto procs = MakeProcs(50u);
+    HttpResponse response{bb::http::status::ok, 11};
+    response.chunk_source(json_array_chunks(procs, 512u));
+    ASSERT_TRUE(response.chunked());
+
+    response.collect_chunks();
+
+    ASSERT_FALSE(response.chunked());
+    ASSERT_FALSE(response.chunk_source());
+    ASSERT_EQ(response.payload(), data::to_json_string(*procs));
+    ASSERT_EQ(response[bb::http::field::content_length], std::to_string(response.payload().size()));
+}
@@ -0,0 +1,203 @@
+#include <gtest/gtest.h>
+
+#include <api_server/data/datastore.h>
+#include <api_server/logger.h>
+#include <api_server/shm/exporter.h>
+#include <api_server/shm/reader.h>
+
+#include <atomic>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace shm;
+
+class ShmTest : public ::testing::Test {
+protected:
+    /// @brief Returns a snapshot in which every value is derived from the generation, so that a reader can tell if
+    /// it got parts of different generations
+    static data::Snapshot MakeSnapshot(const uint64_t generation, const std::size_t proc_count)
+    {
+        const auto usage = static_cast<float>(generation % 100u);
+        data::Snapshot snapshot;
+        snapshot.generation = generation;
+        snapshot.uptime = data::Uptime{0u, 0u, 0u, static_cast<double>(generation), ""};
+        snapshot.cpus = std::vector<data::CpuSnapshot>{
+            {"cpu1", 0u, 0u, 0u, usage}, {"cpu", 0u, 0u, 0u, usage}, {"cpu0", 0u, 0u, 0u, usage}};
+        snapshot.mem = data::MemSnapshot{static_cast<uint32_t>(generation), 0u, usage};
+        auto procs = std::make_shared<std::vector<data::ProcSnapshot>>();
+        for (std::size_t i = 0u; i < proc_count; ++i)
+        {
+            data::ProcSnapshot proc;
+            proc.pid = static_cast<int32_t>(i + 1u);
+            proc.name = "proc" + std::to_string(i + 1u);
+            proc.command = "/usr/bin/proc --generation " + std::to_string(generation);
+            proc.cpu_usage_percent = usage;
+            proc.mem_usage_kB = static_cast<uint32_t>(generation);
+            procs->push_back(std::move(proc));
+        }
+        snapshot.procs = std::move(procs);
+        return snapshot;
+    }
+
+    /// @brief Returns true if every part of a snapshot read is from the same generation
+    static bool Consistent(const ShmSnapshot& snapshot)
+    {
+        const auto usage = static_cast<float>(snapshot.generation % 100u);
+        if (snapshot.mem.total_memory_kB != snapshot.generation || snapshot.uptime_seconds != snapshot.generation ||
+            snapshot.cpu_usage_percent != usage || snapshot.core_usage_percent.size() != 2u ||
+            snapshot.core_usage_percent[1] != usage || snapshot.procs.size() != 100u + snapshot.generation % 50u)
+        {
+            return false;
+        }
+        const auto command = "/usr/bin/proc --generation " + std::to_string(snapshot.generation);
+        for (const auto& proc : snapshot.procs)
+        {
+            if (proc.mem_usage_kB != snapshot.generation || proc.cpu_usage_percent != usage || proc.command != command)
+                return false;
+        }
+        return true;
+    }
+
+    const std::string name{"/api_server_test_" + std::to_string(getpid())};
+    StdStreamLogger logger{LogLevel::Error};
+    data::DataStore datastore;
+};
+
+// GIVEN an exporter of the datastore's generations
+// WHEN a generation is published
+// THEN a reader of the segment reads it
+TEST_F(ShmTest, ExportGenerations) {
+    ShmExporter exporter{logger, datastore, name};
+    ShmReader reader{name};
+    ASSERT_EQ(reader.generation(), 0u);
+    ASSERT_FALSE(reader.read().has_value());
+
+    datastore.set_mem_snapshot({1000u, 250u, 75.0f});
+    datastore.store_cpu_snapshots(
+        {{"cpu", 0u, 0u, 0u, 30.0f}, {"cpu0", 0u, 0u, 0u, 20.0f}, {"cpu1", 0u, 0u, 0u, 40.0f}});
+    data::ProcSnapshot proc;
+    proc.pid = 42;
+    proc.name = "worker";
+    proc.cgroup = "/system.slice/worker.service";
+    proc.cpu_usage_percent = 12.5f;
+    proc.smaps = data::SmapsSample{0.0, 300u, 200u, 10u};
+    datastore.store_proc_snapshots({proc});
+    datastore.publish_generation();
+    const auto snapshot = reader.read();
+
+    ASSERT_EQ(reader.generation(), 1u);
+    ASSERT_TRUE(snapshot.has_value());
+    ASSERT_EQ(snapshot->generation, 1u);
+    ASSERT_EQ(snapshot->mem.free_memory_kB, 250u);
+    ASSERT_FLOAT_EQ(snapshot->cpu_usage_percent, 30.0f);
+    ASSERT_EQ(snapshot->core_usage_percent, (std::vector<float>{20.0f, 40.0f}));
+    ASSERT_FALSE(snapshot->truncated);
+    ASSERT_EQ(snapshot->procs.size(), 1u);
+    ASSERT_EQ(snapshot->procs[0].pid, 42);
+    ASSERT_EQ(snapshot->procs[0].cgroup, "/system.slice/worker.service");
+    ASSERT_EQ(snapshot->procs[0].smaps->pss_kB, 300u);
+}
+
+// GIVEN readers reading the segment as fast as they can
+// WHEN generations are written to it at the same time
+// THEN every snapshot read is wholly from one generation, and generations read never go backwards
+TEST_F(ShmTest, ConcurrentReaders) {
+    ShmExporter exporter{logger, datastore, name};
+    std::atomic<bool> writing{true};
+    std::atomic<uint64_t> reads{0u};
+    std::atomic<uint64_t> inconsistent{0u};
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; ++i)
+    {
+        readers.emplace_back([&] {
+            ShmReader reader{name};
+            uint64_t last_generation{0u};
+            while (writing.load())
+            {
+                const auto snapshot = reader.read();
+                if (!snapshot)
+                    continue;
+                if (!Consistent(snapshot.value()) || snapshot->generation < last_generation)
+                    inconsistent.fetch_add(1u);
+                last_generation = snapshot->generation;
+                reads.fetch_add(1u);
+            }
+        });
+    }
+
+    uint64_t generation{0u};
+    while (generation < 1000u || reads.load() < 1000u)
+    {
+        ++generation;
+        exporter.export_snapshot(MakeSnapshot(generation, 100u + generation % 50u));
+    }
+    writing = false;
+    for (auto& reader : readers)
+        reader.join();
+
+    ASSERT_EQ(inconsistent.load(), 0u);
+    ASSERT_EQ(ShmReader{name}.read()->generation, generation);
+}
+
+// GIVEN a segment too small for every process
+// WHEN a generation is exported
+// THEN it has the processes using the most CPU that fit, and is marked as truncated
+TEST_F(ShmTest, TruncatedSegment) {
+    ShmExporter exporter{logger, datastore, name, 16u * 1024u};
+    auto snapshot = MakeSnapshot(1u, 1000u);
+    auto procs = *snapshot.procs.value();
+    for (auto& proc : procs)
+        proc.cpu_usage_percent = static_cast<float>(proc.pid % 100);
+    snapshot.procs = std::make_shared<const std::vector<data::ProcSnapshot>>(procs);
+
+    exporter.export_snapshot(snapshot);
+    const auto read = ShmReader{name}.read();
+
+    ASSERT_TRUE(read->truncated);
+    ASSERT_GT(read->procs.size(), 0u);
+    ASSERT_LT(read->procs.size(), 1000u);
+    ASSERT_FLOAT_EQ(read->procs.front().cpu_usage_percent, 99.0f);
+}
+
+// GIVEN no exporter of the segment
+// WHEN a reader opens it
+// THEN it fails
+TEST_F(ShmTest, MissingSegment) {
+    ASSERT_THROW(ShmReader{name}, std::runtime_error);
+    {
+        ShmExporter exporter{logger, datastore, name};
+    }
+    ASSERT_THROW(ShmReader{name}, std::runtime_error);
+}
+
+// GIVEN an exporter of a segment
+// WHEN another exporter of the same segment is created
+// THEN it fails, leaving the segment to the first, until the first is destroyed
+TEST_F(ShmTest, SegmentInUse) {
+    {
+        ShmExporter exporter{logger, datastore, name};
+        exporter.export_snapshot(MakeSnapshot(7u, 100u));
+
+        ASSERT_THROW((ShmExporter{logger, datastore, name}), std::runtime_error);
+        ASSERT_EQ(ShmReader{name}.generation(), 7u);
+    }
+    ShmExporter exporter{logger, datastore, name};
+    ASSERT_EQ(ShmReader{name}.generation(), 0u);
+}
+
+// GIVEN a segment left by an exporter that exited without removing it, which no one holds the lock on
+// WHEN an exporter of the same segment is created
+// THEN it replaces it
+TEST_F(ShmTest, AbandonedSegment) {
+    const auto fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(ftruncate(fd, 4096), 0);
+    close(fd);
+
+    ShmExporter exporter{logger, datastore, name};
+    exporter.export_snapshot(MakeSnapshot(3u, 100u));
+
+    ASSERT_EQ(ShmReader{name}.generation(), 3u);
+}
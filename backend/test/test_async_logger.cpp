@@ -0,0 +1,146 @@
+#include <gtest/gtest.h>
+
+#include <api_server/async_logger.h>
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+/// @brief Counts how many times it is formatted
+struct Counted
+{
+    int& count;
+};
+
+} // namespace
+
+template <> struct fmt::formatter<Counted> : fmt::formatter<int>
+{
+    auto format(const Counted& counted, format_context& context) const
+    {
+        return fmt::formatter<int>::format(++counted.count, context);
+    }
+};
+
+class AsyncLoggerTest : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        root = fs::temp_directory_path() / ("test_async_logger_" + std::to_string(getpid()));
+        fs::create_directories(root);
+        config.file_path = (root / "api_server.log").string();
+    }
+
+    void TearDown() override
+    {
+        fs::remove_all(root);
+    }
+
+    std::vector<std::string> ReadLines(const fs::path& path)
+    {
+        std::ifstream file{path};
+        std::vector<std::string> lines;
+        for (std::string line; std::getline(file, line);)
+            lines.push_back(line);
+        return lines;
+    }
+
+    fs::path root;
+    AsyncLoggerConfig config;
+};
+
+// GIVEN an async logger writing to a file
+// WHEN several threads log messages and the logger is flushed
+// THEN every message is in the file, in the order each thread logged them
+TEST_F(AsyncLoggerTest, WritesMessagesFromAllThreads) {
+    constexpr int THREADS = 4;
+    constexpr int MESSAGES = 1000;
+    AsyncLogger logger{LogLevel::Info, config};
+
+    std::vector<std::thread> threads;
+    for (int thread = 0; thread < THREADS; ++thread)
+    {
+        threads.emplace_back([&logger, thread]() {
+            for (int message = 0; message < MESSAGES; ++message)
+                logger.info("{} {}", thread, message);
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    logger.flush();
+
+    const auto lines = ReadLines(config.file_path);
+    ASSERT_EQ(logger.dropped(), 0u);
+    ASSERT_EQ(lines.size(), THREADS * MESSAGES);
+    std::vector<int> next(THREADS, 0);
+    for (const auto& line : lines)
+    {
+        int thread, message;
+        std::istringstream{line} >> thread >> message;
+        ASSERT_EQ(message, next[thread]++);
+    }
+}
+
+// GIVEN an async logger at info level
+// WHEN a debug message is logged
+// THEN its arguments are not formatted and it isn't written
+TEST_F(AsyncLoggerTest, SkipsDisabledLevelsBeforeFormatting) {
+    int count = 0;
+    {
+        AsyncLogger logger{LogLevel::Info, config};
+        logger.debug("debug {}", Counted{count});
+        logger.warning("warning {}", Counted{count});
+    }
+
+    ASSERT_EQ(count, 1);
+    ASSERT_EQ(ReadLines(config.file_path), std::vector<std::string>{"warning 1"});
+}
+
+// GIVEN an async logger rotating its file at a small size
+// WHEN more than that is logged
+// THEN older messages are moved to numbered files, keeping only the configured number of them
+TEST_F(AsyncLoggerTest, RotatesFile) {
+    config.rotate_size = 100u;
+    config.rotated_files = 2u;
+    {
+        AsyncLogger logger{LogLevel::Info, config};
+        for (int message = 0; message < 5; ++message)
+        {
+            logger.info("{:079}", message); // 80 bytes with the newline, so each message rotates the file
+            logger.flush();
+        }
+    }
+
+    ASSERT_EQ(ReadLines(config.file_path), std::vector<std::string>{fmt::format("{:079}", 4)});
+    ASSERT_EQ(ReadLines(config.file_path + ".1"), std::vector<std::string>{fmt::format("{:079}", 3)});
+    ASSERT_EQ(ReadLines(config.file_path + ".2"), std::vector<std::string>{fmt::format("{:079}", 2)});
+    ASSERT_FALSE(fs::exists(config.file_path + ".3"));
+}
+
+// GIVEN an async logger whose ring is full while the writer sleeps
+// WHEN more messages are logged
+// THEN they are dropped without blocking, and the number dropped is logged
+TEST_F(AsyncLoggerTest, DropsMessagesWhenFull) {
+    config.capacity = 4u;
+    config.poll_interval = std::chrono::milliseconds{500};
+    {
+        AsyncLogger logger{LogLevel::Info, config};
+        std::this_thread::sleep_for(std::chrono::milliseconds{50}); // Until the writer sleeps on the empty ring
+        for (int message = 0; message < 10; ++message)
+            logger.info("{}", message);
+
+        ASSERT_EQ(logger.dropped(), 6u);
+    }
+
+    const auto lines = ReadLines(config.file_path);
+    ASSERT_EQ(lines, (std::vector<std::string>{"0", "1", "2", "3",
+                                               "AsyncLogger - dropped 6 messages, the writer fell behind"}));
+}
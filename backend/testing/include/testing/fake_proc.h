@@ -0,0 +1,166 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fmt/format.h>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+
+namespace filesystem
+{
+
+/// @brief A fake /proc tree in a temporary directory, for running the Monitor against a reproducible host of any
+/// size in benchmarks and load tests. Each process has status, stat, cmdline and cgroup files in the kernel's formats,
+/// with values varying between processes, and the tree has a cgroup v2 hierarchy of one service per 100 processes.
+/// The directory is removed when the tree is destroyed.
+class FakeProcTree
+{
+public:
+    static constexpr std::size_t CPUS{8u};
+    static constexpr std::size_t PROCS_PER_SERVICE{100u};
+
+    explicit FakeProcTree(const std::size_t procs)
+        : m_root{std::filesystem::temp_directory_path() /
+                 fmt::format("fake_proc_{}_{}_{}", getpid(), procs, next_tree_id())},
+          m_services{procs / PROCS_PER_SERVICE + 1u}
+    {
+        std::filesystem::create_directories(proc_root());
+        std::filesystem::create_directories(cgroup_root() / "system.slice");
+        write(cgroup_root() / "cgroup.controllers", "cpuset cpu io memory pids\n");
+        write_cgroup(cgroup_root());
+        for (std::size_t service = 0; service < m_services; ++service)
+            write_cgroup(cgroup_root() / "system.slice" / fmt::format("worker-{}.service", service));
+        for (std::size_t i = 0; i < procs; ++i)
+            add_proc();
+        advance();
+    }
+
+    ~FakeProcTree()
+    {
+        std::error_code error;
+        std::filesystem::remove_all(m_root, error);
+    }
+
+    FakeProcTree(const FakeProcTree&) = delete;
+    FakeProcTree& operator=(const FakeProcTree&) = delete;
+
+    std::filesystem::path proc_root() const
+    {
+        return m_root / "proc";
+    }
+
+    std::filesystem::path cgroup_root() const
+    {
+        return m_root / "cgroup";
+    }
+
+    const std::deque<int32_t>& pids() const
+    {
+        return m_pids;
+    }
+
+    /// @brief Replaces the oldest processes with new ones, as short-lived processes do between polls
+    void churn(const std::size_t exited)
+    {
+        for (std::size_t i = 0; i < exited && !m_pids.empty(); ++i)
+        {
+            std::filesystem::remove_all(proc_root() / std::to_string(m_pids.front()));
+            m_pids.pop_front();
+            add_proc();
+        }
+    }
+
+    /// @brief Moves the system's uptime and CPU times forward by a second
+    void advance()
+    {
+        ++m_seconds;
+        write(proc_root() / "uptime", fmt::format("{}.42 {}.17\n", 3600 + m_seconds, 3600 * CPUS + m_seconds * 4));
+        std::string stat;
+        const auto ticks = m_seconds * 100u;
+        fmt::format_to(std::back_inserter(stat), "cpu  {} 0 {} {} 0 0 0 0 0 0\n", ticks * CPUS / 2, ticks * CPUS / 4,
+                       ticks * CPUS / 4);
+        for (std::size_t cpu = 0; cpu < CPUS; ++cpu)
+            fmt::format_to(std::back_inserter(stat), "cpu{} {} 0 {} {} 0 0 0 0 0 0\n", cpu, ticks / 2, ticks / 4,
+                           ticks / 4);
+        stat.append("intr 1234567 0 0 0\nctxt 7654321\nbtime 1700000000\nprocesses 98765\nprocs_running 3\n"
+                    "procs_blocked 0\n");
+        write(proc_root() / "stat", stat);
+        write(proc_root() / "meminfo", "MemTotal:       65536000 kB\nMemFree:        12000000 kB\n"
+                                       "MemAvailable:   32000000 kB\nBuffers:          500000 kB\n"
+                                       "Cached:         16000000 kB\nSwapCached:            0 kB\n"
+                                       "SwapTotal:       8000000 kB\nSwapFree:        8000000 kB\n");
+    }
+
+private:
+    static std::size_t next_tree_id()
+    {
+        static std::size_t id{0u};
+        return id++;
+    }
+
+    static void write(const std::filesystem::path& path, const std::string& contents)
+    {
+        std::ofstream{path} << contents;
+    }
+
+    static void write_cgroup(const std::filesystem::path& dir)
+    {
+        std::filesystem::create_directories(dir);
+        write(dir / "cpu.stat", "usage_usec 123456789\nuser_usec 100000000\nsystem_usec 23456789\n");
+        write(dir / "memory.current", "104857600\n");
+        write(dir / "memory.stat", "anon 52428800\nfile 52428800\n");
+    }
+
+    void add_proc()
+    {
+        const auto pid = m_next_pid++;
+        m_pids.push_back(pid);
+        const auto index = static_cast<std::size_t>(pid);
+        const auto dir = proc_root() / std::to_string(pid);
+        std::filesystem::create_directory(dir);
+
+        const auto name = fmt::format("worker-{}", index % 1000);
+        const auto ppid = pid > 1 ? 1 + static_cast<int32_t>(index % 97) : 0;
+        const auto rss_kB = 1024u + (index * 7919u) % 500000u;
+        write(dir / "status",
+              fmt::format("Name:\t{0}\nUmask:\t0022\nState:\tS (sleeping)\nTgid:\t{1}\nNgid:\t0\nPid:\t{1}\n"
+                          "PPid:\t{2}\nTracerPid:\t0\nUid:\t1000\t1000\t1000\t1000\nGid:\t1000\t1000\t1000\t1000\n"
+                          "FDSize:\t64\nGroups:\t4 24 27 1000\nNStgid:\t{1}\nNSpid:\t{1}\nNSpgid:\t{1}\nNSsid:\t{1}\n"
+                          "VmPeak:\t{4} kB\nVmSize:\t{4} kB\nVmLck:\t0 kB\nVmPin:\t0 kB\nVmHWM:\t{3} kB\n"
+                          "VmRSS:\t{3} kB\nRssAnon:\t{5} kB\nRssFile:\t{5} kB\nRssShmem:\t0 kB\nVmData:\t{5} kB\n"
+                          "VmStk:\t132 kB\nVmExe:\t1024 kB\nVmLib:\t8192 kB\nVmPTE:\t256 kB\nVmSwap:\t0 kB\n"
+                          "HugetlbPages:\t0 kB\nCoreDumping:\t0\nTHP_enabled:\t1\nThreads:\t{6}\n"
+                          "SigQ:\t0/255831\nSigPnd:\t0000000000000000\nShdPnd:\t0000000000000000\n"
+                          "SigBlk:\t0000000000000000\nSigIgn:\t0000000000001000\nSigCgt:\t0000000180004a02\n"
+                          "CapInh:\t0000000000000000\nCapPrm:\t0000000000000000\nCapEff:\t0000000000000000\n"
+                          "CapBnd:\t000001ffffffffff\nCapAmb:\t0000000000000000\nNoNewPrivs:\t0\nSeccomp:\t0\n"
+                          "Seccomp_filters:\t0\nSpeculation_Store_Bypass:\tthread vulnerable\n"
+                          "Cpus_allowed:\tff\nCpus_allowed_list:\t0-7\nMems_allowed:\t00000001\n"
+                          "Mems_allowed_list:\t0\nvoluntary_ctxt_switches:\t{7}\nnonvoluntary_ctxt_switches:\t42\n",
+                          name, pid, ppid, rss_kB, rss_kB * 4u, rss_kB / 2u, 1u + index % 16u, index * 13u));
+        write(dir / "stat",
+              fmt::format("{0} ({1}) S {2} {0} {0} 0 -1 4194560 {3} 0 0 0 {4} {5} 0 0 20 0 {6} 0 {7} {8} {9} "
+                          "18446744073709551615 1 1 0 0 0 0 0 4096 16386 0 0 0 17 {10} 0 0 0 0 0 0 0 0 0 0 0 0 0\n",
+                          pid, name, ppid, index * 31u, index % 5000u, index % 700u, 1u + index % 16u, index * 10u,
+                          rss_kB * 4096u, rss_kB / 4u, index % CPUS));
+        std::string cmdline = fmt::format("/usr/lib/worker/{}", name);
+        for (const auto& arg : {std::string{"--config=/etc/worker/worker.conf"}, fmt::format("--id={}", index)})
+        {
+            cmdline.push_back('\0');
+            cmdline.append(arg);
+        }
+        cmdline.push_back('\0');
+        write(dir / "cmdline", cmdline);
+        write(dir / "cgroup", fmt::format("0::/system.slice/worker-{}.service\n", index % m_services));
+    }
+
+    const std::filesystem::path m_root;
+    const std::size_t m_services;
+    std::deque<int32_t> m_pids;
+    int32_t m_next_pid{1};
+    std::size_t m_seconds{0u};
+};
+
+} // namespace filesystem